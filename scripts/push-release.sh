@@ -7,6 +7,7 @@ git clone -b release "https://${GH_TOKEN}@github.com/haowen-xu/ml-gridengine-exe
 
 # deploy the main executable
 cp build/ml-gridengine-executor "${WORKDIR}" || exit 1
+cp build/ml-gridengine-ring-recover "${WORKDIR}" || exit 1
 
 # deploy the tests
 mkdir -p "${WORKDIR}/tests/" || exit 1
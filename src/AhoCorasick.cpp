@@ -0,0 +1,62 @@
+#include <ctype.h>
+#include <algorithm>
+#include "AhoCorasick.h"
+
+AhoCorasick::AhoCorasick(std::vector<Pattern> const& patterns, bool ignoreCase) {
+  const uint32_t NONE = UINT32_MAX;
+
+  // the trie of the patterns, of the lower case letters if the case is ignored
+  _next.assign(256, NONE);
+  _output.assign(1, -1);
+  for (Pattern const& pattern: patterns) {
+    if (pattern.first.empty()) {
+      continue;
+    }
+    uint32_t state = 0;
+    for (char ch: pattern.first) {
+      size_t edge = (state << 8) | (Byte)(ignoreCase ? tolower((Byte)ch) : ch);
+      if (_next[edge] == NONE) {
+        _next[edge] = (uint32_t)_output.size();
+        _output.push_back(-1);
+        _next.resize(_next.size() + 256, NONE);
+      }
+      state = _next[edge];
+    }
+    _output[state] = std::max(_output[state], pattern.second);
+  }
+
+  // resolve the missing transitions by the failure links, in breadth-first order
+  std::vector<uint32_t> fail(_output.size(), 0);
+  std::vector<uint32_t> queue;
+  for (int c=0; c<256; ++c) {
+    uint32_t &child = _next[c];
+    if (child == NONE) {
+      child = 0;
+    } else {
+      queue.push_back(child);
+    }
+  }
+  for (size_t i=0; i<queue.size(); ++i) {
+    uint32_t state = queue[i];
+    _output[state] = std::max(_output[state], _output[fail[state]]);
+    for (int c=0; c<256; ++c) {
+      uint32_t &child = _next[(state << 8) | c];
+      uint32_t fallback = _next[(fail[state] << 8) | c];
+      if (child == NONE) {
+        child = fallback;
+      } else {
+        fail[child] = fallback;
+        queue.push_back(child);
+      }
+    }
+  }
+
+  // the upper case letters take the transitions of the lower case ones
+  if (ignoreCase) {
+    for (size_t state=0; state<_output.size(); ++state) {
+      for (int c='A'; c<='Z'; ++c) {
+        _next[(state << 8) | c] = _next[(state << 8) | (c - 'A' + 'a')];
+      }
+    }
+  }
+}
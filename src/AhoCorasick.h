@@ -0,0 +1,47 @@
+#ifndef ML_GRIDENGINE_EXECUTOR_AHOCORASICK_H
+#define ML_GRIDENGINE_EXECUTOR_AHOCORASICK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+typedef unsigned char Byte;
+
+/**
+ * The Aho-Corasick automaton of a set of patterns, compiled into a full transition table, such
+ * that each byte takes exactly one lookup.  The output of a state is the largest value of the
+ * patterns ending there, or -1 if none.
+ *
+ * The automaton is immutable once constructed, so it can be shared by threads.
+ */
+class AhoCorasick {
+public:
+  /** A pattern, and the value it outputs when matched. */
+  typedef std::pair<std::string, int> Pattern;
+
+private:
+  std::vector<uint32_t> _next;  // _next[(state << 8) | byte]
+  std::vector<int> _output;     // largest value matched at each state, or -1
+
+public:
+  /**
+   * Compile the automaton of {@arg patterns}.  Empty patterns are ignored.
+   *
+   * @param ignoreCase Whether or not the ASCII letters match regardless of their case.
+   */
+  explicit AhoCorasick(std::vector<Pattern> const& patterns, bool ignoreCase=false);
+
+  /** Number of states, the initial state being 0. */
+  inline size_t stateCount() const { return _output.size(); }
+
+  /** The state after {@arg state} reads {@arg byte}. */
+  inline uint32_t next(uint32_t state, Byte byte) const { return _next[(state << 8) | byte]; }
+
+  /** The largest value of the patterns ending at {@arg state}, or -1 if none. */
+  inline int output(uint32_t state) const { return _output[state]; }
+};
+
+
+#endif //ML_GRIDENGINE_EXECUTOR_AHOCORASICK_H
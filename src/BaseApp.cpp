@@ -5,6 +5,7 @@
 #include <vector>
 #include <iostream>
 #include <cassert>
+#include <cstdlib>
 #include <Poco/NumberParser.h>
 #include <Poco/Net/HTTPServer.h>
 #include <Poco/RegularExpression.h>
@@ -100,6 +101,196 @@ void BaseApp::defineOptions(OptionSet &options) {
           .callback(OptionCallback<BaseApp>(this, &BaseApp::handleSetBufferSize))
           .validator(new RegExpValidator(BUFFER_SIZE_PATTERN)));
 
+  options.addOption(
+      Option().fullName("stderr-buffer-size")
+          .description("Capture the stderr of the program by a separated pipe, and keep its latest output "
+                       "of this size in its own memory buffer, such that it is not evicted by the stdout.  "
+                       "The stream can be polled by \"stream=stdout|stderr|merged\".")
+          .argument("BUFFER-SIZE")
+          .required(false)
+          .callback(OptionCallback<BaseApp>(this, &BaseApp::handleSetStderrBufferSize))
+          .validator(new RegExpValidator(BUFFER_SIZE_PATTERN)));
+
+  options.addOption(
+      Option().fullName("head-size")
+          .description("Retain the first output of this size apart from the memory buffer, such that it "
+                       "is never evicted.  The rest of the buffer size keeps the latest output, and the "
+                       "output file has both, separated by the discarded size.")
+          .argument("BUFFER-SIZE")
+          .required(false)
+          .callback(OptionCallback<BaseApp>(this, &BaseApp::handleSetHeadSize))
+          .validator(new RegExpValidator(BUFFER_SIZE_PATTERN)));
+
+  options.addOption(
+      Option().fullName("optimistic-read")
+          .description("Let output readers copy from the memory buffer without taking its lock, "
+                       "so that many polling clients do not stall the program output.")
+          .required(false)
+          .callback(OptionCallback<BaseApp>(this, &BaseApp::handleSetOptimisticRead)));
+
+  options.addOption(
+      Option().fullName("mirrored-buffer")
+          .description("Map the memory buffer twice back-to-back, such that the output can always be "
+                       "copied or sent as a single contiguous block.  Falls back to the ordinary "
+                       "memory buffer if not supported by the system.")
+          .required(false)
+          .callback(OptionCallback<BaseApp>(this, &BaseApp::handleSetMirroredBuffer)));
+
+  options.addOption(
+      Option().fullName("spool-dir")
+          .description("Spill the output evicted from the memory buffer into segment files under this "
+                       "directory, such that the full output history can still be read.")
+          .argument("PATH")
+          .required(false)
+          .callback(OptionCallback<BaseApp>(this, &BaseApp::handleSetSpoolDir))
+          .validator(new RegExpValidator("^.+$")));
+
+  options.addOption(
+      Option().fullName("spool-max-size")
+          .description("Keep at most this size of the spilled output under \"--spool-dir\", deleting the "
+                       "oldest segment files beyond it.  Unlimited if not specified.")
+          .argument("SPOOL-SIZE")
+          .required(false)
+          .callback(OptionCallback<BaseApp>(this, &BaseApp::handleSetSpoolMaxSize))
+          .validator(new RegExpValidator(BUFFER_SIZE_PATTERN)));
+
+  options.addOption(
+      Option().fullName("compressed-history")
+          .description("Keep only a small window of the latest output in the memory buffer as-is, and "
+                       "compress the older output in blocks within the rest of the buffer size.")
+          .required(false)
+          .callback(OptionCallback<BaseApp>(this, &BaseApp::handleSetCompressedHistory)));
+
+  options.addOption(
+      Option().fullName("ring-file")
+          .description("Back the memory buffer with a memory-mapped file, such that the latest output "
+                       "can be recovered by \"ml-gridengine-ring-recover\" even if the executor dies.  "
+                       "If the file was left unclosed by a previous executor, it is kept aside with "
+                       "its generation number as the suffix.")
+          .argument("PATH")
+          .required(false)
+          .callback(OptionCallback<BaseApp>(this, &BaseApp::handleSetRingFile))
+          .validator(new RegExpValidator("^.+$")));
+
+  options.addOption(
+      Option().fullName("shm-export")
+          .description("Export the memory buffer into the read-only shared memory \"/NAME\", such that "
+                       "the local agents can tail the output without any request, by the C library "
+                       "\"ml-gridengine-ring\".  Cannot be used with \"--ring-file\".")
+          .argument("NAME")
+          .required(false)
+          .callback(OptionCallback<BaseApp>(this, &BaseApp::handleSetShmExport))
+          .validator(new RegExpValidator("^[A-Za-z0-9_.-]+$")));
+
+  options.addOption(
+      Option().fullName("shm-export-mode")
+          .description("Octal permission mode of the shared memory exported by \"--shm-export\", e.g., "
+                       "\"0640\" to let the agents in the group of the executor read it.  Default is \"0600\".")
+          .argument("MODE")
+          .required(false)
+          .callback(OptionCallback<BaseApp>(this, &BaseApp::handleSetShmExportMode))
+          .validator(new RegExpValidator("^0?[0-7]{3}$")));
+
+  options.addOption(
+      Option().fullName("compact-progress")
+          .description("Collapse the progress bars redrawn by carriage returns (\"\\r\") to their latest "
+                       "state before the output is buffered, keeping at most one redraw per second.")
+          .required(false)
+          .callback(OptionCallback<BaseApp>(this, &BaseApp::handleSetCompactProgress)));
+
+  options.addOption(
+      Option().fullName("strip-ansi")
+          .description("Strip the ANSI escape sequences (e.g., colours) from the output before it is buffered.")
+          .required(false)
+          .callback(OptionCallback<BaseApp>(this, &BaseApp::handleSetStripAnsi)));
+
+  options.addOption(
+      Option().fullName("repair-utf8")
+          .description("Replace the invalid UTF-8 sequences in the output with U+FFFD before it is buffered.")
+          .required(false)
+          .callback(OptionCallback<BaseApp>(this, &BaseApp::handleSetRepairUtf8)));
+
+  options.addOption(
+      Option().fullName("redact-secrets")
+          .description("Replace the values after the common secret keys in the output (e.g., \"password=\", "
+                       "\"token: \", \"Bearer \", \"AKIA\") with \"[REDACTED]\" before it is buffered.")
+          .required(false)
+          .callback(OptionCallback<BaseApp>(this, &BaseApp::handleSetRedactSecrets)));
+
+  options.addOption(
+      Option().fullName("redact")
+          .description("Replace the value after KEY (e.g., \"MY_TOKEN=\") in the output with \"[REDACTED]\", "
+                       "ignoring the case.  The value ends at a whitespace, a quote or one of \",;&<>\".")
+          .argument("KEY")
+          .required(false)
+          .repeatable(true)
+          .callback(OptionCallback<BaseApp>(this, &BaseApp::handleAddRedactPattern))
+          .validator(new RegExpValidator("^.+$")));
+
+  options.addOption(
+      Option().fullName("coalesce-window")
+          .description("Batch the small writes of the program arriving within this many microseconds of "
+                       "each other into a single write of the memory buffer, such that the readers are "
+                       "woken up at most once per window.  Sparse output is never delayed.  Specify 0 "
+                       "to disable.")
+          .argument("MICROS")
+          .required(false)
+          .callback(OptionCallback<BaseApp>(this, &BaseApp::handleSetCoalesceWindow))
+          .validator(new RegExpValidator("^\\d+$")));
+
+  options.addOption(
+      Option().fullName("coalesce-bytes")
+          .description("The maximum size of the writes batched by --coalesce-window.")
+          .argument("BUFFER-SIZE")
+          .required(false)
+          .callback(OptionCallback<BaseApp>(this, &BaseApp::handleSetCoalesceBytes))
+          .validator(new RegExpValidator(BUFFER_SIZE_PATTERN)));
+
+  options.addOption(
+      Option().fullName("dedup-lines")
+          .description("Store the consecutive identical lines of the output only once, with the number "
+                       "of repeats.  Pollers get a \"[repeated N more times]\" line after the stored one, "
+                       "or the lines expanded by \"repeats=expand\".")
+          .required(false)
+          .callback(OptionCallback<BaseApp>(this, &BaseApp::handleSetDedupLines)));
+
+  options.addOption(
+      Option().fullName("index-severity")
+          .description("Index the errors, warnings, Python tracebacks and CUDA or NaN failures in the output "
+                       "as it arrives, such that they can be listed by \"/output/_errors\" without scanning "
+                       "the output.")
+          .required(false)
+          .callback(OptionCallback<BaseApp>(this, &BaseApp::handleSetIndexSeverity)));
+
+  options.addOption(
+      Option().fullName("search-index")
+          .description("Index the trigrams of the retained output by blocks within this much memory, such that "
+                       "\"/output/_search\" only scans the blocks which may contain the query.  The oldest "
+                       "blocks are searched without the index if it exceeds the size.")
+          .argument("INDEX-SIZE")
+          .required(false)
+          .callback(OptionCallback<BaseApp>(this, &BaseApp::handleSetSearchIndex))
+          .validator(new RegExpValidator(BUFFER_SIZE_PATTERN)));
+
+  options.addOption(
+      Option().fullName("lossless")
+          .description("Never discard the output.  The output is saved into the output file as it is "
+                       "written, and the program is stalled while the memory buffer is full of output "
+                       "not yet saved.  Requires --output-file or --output-archive.")
+          .required(false)
+          .callback(OptionCallback<BaseApp>(this, &BaseApp::handleSetLossless)));
+
+  options.addOption(
+      Option().fullName("extra-stream")
+          .description("Capture the file descriptor FD of the program (e.g., 3 for \"/dev/fd/3\") as the named "
+                       "output stream NAME, which can be polled by \"stream=NAME\".  All the streams share the "
+                       "memory budget of --buffer-size and --stderr-buffer-size.")
+          .argument("NAME=FD")
+          .required(false)
+          .repeatable(true)
+          .callback(OptionCallback<BaseApp>(this, &BaseApp::handleAddExtraStream))
+          .validator(new RegExpValidator("^([A-Za-z0-9_.-]+)=(\\d+)$")));
+
   options.addOption(
       Option().fullName("callback-api")
           .description("Set the URI of the callback API.")
@@ -123,6 +314,16 @@ void BaseApp::defineOptions(OptionSet &options) {
           .callback(OptionCallback<BaseApp>(this, &BaseApp::handleSetOutputFile))
           .validator(new RegExpValidator("^.+$")));
 
+  options.addOption(
+      Option().fullName("output-archive")
+          .description("Save program output to this file as it is written, in blocks compressed apart with "
+                       "a trailing index, such that any byte or line range can be read by "
+                       "\"ml-gridengine-archive-read\" without decompressing the rest.")
+          .argument("PATH")
+          .required(false)
+          .callback(OptionCallback<BaseApp>(this, &BaseApp::handleSetOutputArchive))
+          .validator(new RegExpValidator("^.+$")));
+
   options.addOption(
       Option().fullName("status-file")
           .description("Save executor status to this file. "
@@ -179,21 +380,116 @@ void BaseApp::handleSetServerPort(const std::string &name, const std::string &va
   _serverPort = Poco::NumberParser::parse(value);
 }
 
-void BaseApp::handleSetBufferSize(const std::string &name, const std::string &value) {
-  Poco::RegularExpression p(BUFFER_SIZE_PATTERN);
-  Poco::RegularExpression::MatchVec m;
-  p.match(value, 0, m);
-
-  std::string sValue = value.substr(m.at(1).offset, m.at(1).length);
-  std::string sUnit = Poco::toUpper(value.substr(m.at(2).offset, m.at(2).length));
-  double bufferSize = Poco::NumberParser::parseFloat(sValue);
-  if (sUnit == "M" || sUnit == "MB") {
-    bufferSize *= 1024 * 1024;
-  } else if (sUnit == "K" || sUnit == "KB") {
-    bufferSize *= 1024;
+namespace {
+  size_t parseBufferSize(const std::string &value) {
+    Poco::RegularExpression p(BUFFER_SIZE_PATTERN);
+    Poco::RegularExpression::MatchVec m;
+    p.match(value, 0, m);
+
+    std::string sValue = value.substr(m.at(1).offset, m.at(1).length);
+    std::string sUnit = Poco::toUpper(value.substr(m.at(2).offset, m.at(2).length));
+    double bufferSize = Poco::NumberParser::parseFloat(sValue);
+    if (sUnit == "M" || sUnit == "MB") {
+      bufferSize *= 1024 * 1024;
+    } else if (sUnit == "K" || sUnit == "KB") {
+      bufferSize *= 1024;
+    }
+    return (size_t)bufferSize;
   }
+}
 
-  _bufferSize = (size_t)bufferSize;
+void BaseApp::handleSetBufferSize(const std::string &name, const std::string &value) {
+  _bufferSize = parseBufferSize(value);
+}
+
+void BaseApp::handleSetStderrBufferSize(const std::string &name, const std::string &value) {
+  _stderrBufferSize = parseBufferSize(value);
+}
+
+void BaseApp::handleSetHeadSize(const std::string &name, const std::string &value) {
+  _headSize = parseBufferSize(value);
+}
+
+void BaseApp::handleSetOptimisticRead(const std::string &name, const std::string &value) {
+  _optimisticRead = true;
+}
+
+void BaseApp::handleSetMirroredBuffer(const std::string &name, const std::string &value) {
+  _mirroredBuffer = true;
+}
+
+void BaseApp::handleSetSpoolDir(const std::string &name, const std::string &value) {
+  _spoolDir = value;
+}
+
+void BaseApp::handleSetSpoolMaxSize(const std::string &name, const std::string &value) {
+  _spoolMaxSize = parseBufferSize(value);
+}
+
+void BaseApp::handleSetCompressedHistory(const std::string &name, const std::string &value) {
+  _compressedHistory = true;
+}
+
+void BaseApp::handleSetRingFile(const std::string &name, const std::string &value) {
+  _ringFile = value;
+}
+
+void BaseApp::handleSetShmExport(const std::string &name, const std::string &value) {
+  _shmExport = value;
+}
+
+void BaseApp::handleSetShmExportMode(const std::string &name, const std::string &value) {
+  _shmExportMode = (unsigned)std::strtoul(value.c_str(), nullptr, 8);
+}
+
+void BaseApp::handleSetCompactProgress(const std::string &name, const std::string &value) {
+  _compactProgress = true;
+}
+
+void BaseApp::handleSetStripAnsi(const std::string &name, const std::string &value) {
+  _filterOptions.stripAnsi = true;
+}
+
+void BaseApp::handleSetRepairUtf8(const std::string &name, const std::string &value) {
+  _filterOptions.repairUtf8 = true;
+}
+
+void BaseApp::handleSetRedactSecrets(const std::string &name, const std::string &value) {
+  _filterOptions.redactSecrets = true;
+}
+
+void BaseApp::handleAddRedactPattern(const std::string &name, const std::string &value) {
+  _filterOptions.redactPatterns.push_back(value);
+}
+
+void BaseApp::handleSetCoalesceWindow(const std::string &name, const std::string &value) {
+  _coalesceWindow = Poco::NumberParser::parse64(value);
+}
+
+void BaseApp::handleSetCoalesceBytes(const std::string &name, const std::string &value) {
+  _coalesceBytes = parseBufferSize(value);
+}
+
+void BaseApp::handleSetDedupLines(const std::string &name, const std::string &value) {
+  _dedupLines = true;
+}
+
+void BaseApp::handleSetIndexSeverity(const std::string &name, const std::string &value) {
+  _indexSeverity = true;
+}
+
+void BaseApp::handleSetSearchIndex(const std::string &name, const std::string &value) {
+  _searchIndexSize = parseBufferSize(value);
+}
+
+void BaseApp::handleSetLossless(const std::string &name, const std::string &value) {
+  _lossless = true;
+}
+
+void BaseApp::handleAddExtraStream(const std::string &name, const std::string &value) {
+  size_t pos = value.find('=');
+  assert(pos != std::string::npos);
+  _extraStreams.emplace_back(value.substr(0, pos), Poco::NumberParser::parse(value.substr(pos + 1)));
 }
 
 void BaseApp::handleSetCallbackAPI(const std::string &name, const std::string &value) {
@@ -208,6 +504,10 @@ void BaseApp::handleSetOutputFile(const std::string &name, const std::string &va
   _outputFile = value;
 }
 
+void BaseApp::handleSetOutputArchive(const std::string &name, const std::string &value) {
+  _outputArchive = value;
+}
+
 void BaseApp::handleSetStatusFile(const std::string &name, const std::string &value) {
   _statusFile = value;
 }
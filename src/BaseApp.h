@@ -6,8 +6,11 @@
 #define ML_GRIDENGINE_EXECUTOR_BASEAPP_H
 
 #include <string>
+#include <utility>
+#include <vector>
 #include <Poco/Util/Application.h>
 #include "macros.h"
+#include "IngestFilter.h"
 #include "ProgramExecutor.h"
 
 class BaseApp : public Poco::Util::Application {
@@ -21,9 +24,29 @@ protected:
   std::string _serverHost;
   Poco::UInt16 _serverPort = 0;
   size_t _bufferSize = ML_GRIDENGINE_DEFAULT_BUFFER_SIZE;
+  size_t _stderrBufferSize = 0;
+  size_t _headSize = 0;
+  bool _optimisticRead = false;
+  bool _mirroredBuffer = false;
+  std::string _spoolDir;
+  size_t _spoolMaxSize = 0;
+  bool _compressedHistory = false;
+  std::string _ringFile;
+  std::string _shmExport;
+  unsigned _shmExportMode = ML_GRIDENGINE_SHM_EXPORT_MODE;
+  bool _compactProgress = false;
+  int64_t _coalesceWindow = ML_GRIDENGINE_COALESCE_WINDOW_MICROS;
+  size_t _coalesceBytes = ML_GRIDENGINE_COALESCE_MAX_BYTES;
+  IngestFilterOptions _filterOptions;
+  bool _dedupLines = false;
+  bool _indexSeverity = false;
+  size_t _searchIndexSize = 0;
+  bool _lossless = false;
+  std::vector<std::pair<std::string, int>> _extraStreams;
   std::string _callbackAPI;
   std::string _callbackToken;
   std::string _outputFile;
+  std::string _outputArchive;
   std::string _statusFile;
   std::string _runAfter;
 
@@ -49,12 +72,58 @@ protected:
 
   void handleSetBufferSize(const std::string &name, const std::string &value);
 
+  void handleSetStderrBufferSize(const std::string &name, const std::string &value);
+
+  void handleSetHeadSize(const std::string &name, const std::string &value);
+
+  void handleSetOptimisticRead(const std::string &name, const std::string &value);
+
+  void handleSetMirroredBuffer(const std::string &name, const std::string &value);
+
+  void handleSetSpoolDir(const std::string &name, const std::string &value);
+
+  void handleSetSpoolMaxSize(const std::string &name, const std::string &value);
+
+  void handleSetCompressedHistory(const std::string &name, const std::string &value);
+
+  void handleSetRingFile(const std::string &name, const std::string &value);
+
+  void handleSetShmExport(const std::string &name, const std::string &value);
+
+  void handleSetShmExportMode(const std::string &name, const std::string &value);
+
+  void handleSetCompactProgress(const std::string &name, const std::string &value);
+
+  void handleSetStripAnsi(const std::string &name, const std::string &value);
+
+  void handleSetRepairUtf8(const std::string &name, const std::string &value);
+
+  void handleSetRedactSecrets(const std::string &name, const std::string &value);
+
+  void handleAddRedactPattern(const std::string &name, const std::string &value);
+
+  void handleSetCoalesceWindow(const std::string &name, const std::string &value);
+
+  void handleSetCoalesceBytes(const std::string &name, const std::string &value);
+
+  void handleSetDedupLines(const std::string &name, const std::string &value);
+
+  void handleSetIndexSeverity(const std::string &name, const std::string &value);
+
+  void handleSetSearchIndex(const std::string &name, const std::string &value);
+
+  void handleSetLossless(const std::string &name, const std::string &value);
+
+  void handleAddExtraStream(const std::string &name, const std::string &value);
+
   void handleSetCallbackAPI(const std::string &name, const std::string &value);
 
   void handleSetCallbackToken(const std::string &name, const std::string &value);
 
   void handleSetOutputFile(const std::string &name, const std::string &value);
 
+  void handleSetOutputArchive(const std::string &name, const std::string &value);
+
   void handleSetStatusFile(const std::string &name, const std::string &value);
 
   void handleSetRunAfter(const std::string &name, const std::string &value);
@@ -0,0 +1,173 @@
+#include <algorithm>
+#include <string.h>
+#include <Poco/Clock.h>
+#include <Poco/Mutex.h>
+#include "CompressedHistory.h"
+#include "Compression.h"
+
+double CompressedHistory::Statistics::compressionRatio() const {
+  return compressedBytes > 0 ? (double)sealedBytes / compressedBytes : 0.0;
+}
+
+double CompressedHistory::Statistics::decompressMicrosPerRead() const {
+  return reads > 0 ? (double)decompressMicros / reads : 0.0;
+}
+
+CompressedHistory::CompressedHistory(size_t maxSize, size_t blockSize) :
+  _maxSize(maxSize),
+  _blockSize(std::max(blockSize, (size_t)1)),
+  _mutex(new Poco::Mutex()),
+  _flushMutex(new Poco::Mutex()),
+  _begin(0),
+  _end(0),
+  _compressedBytes(0),
+  _cachedBegin(0),
+  _reads(0),
+  _decompressions(0),
+  _decompressMicros(0)
+{
+  _pending.reserve(_blockSize);
+}
+
+CompressedHistory::~CompressedHistory() {
+  delete _flushMutex;
+  delete _mutex;
+}
+
+size_t CompressedHistory::begin() const {
+  Poco::Mutex::ScopedLock scopedLock(*_mutex);
+  return _begin;
+}
+
+size_t CompressedHistory::end() const {
+  Poco::Mutex::ScopedLock scopedLock(*_mutex);
+  return _end;
+}
+
+void CompressedHistory::_seal() {
+  std::shared_ptr<std::vector<Byte>> data(new std::vector<Byte>());
+  data->swap(_pending);
+  _pending.reserve(_blockSize);
+  RawBlock block = {_end - data->size(), data};
+  _sealed.push_back(block);
+}
+
+void CompressedHistory::_dropOldBlocks() {
+  // the raw blocks and the decompressed block are all counted at their full size
+  while (!_blocks.empty() && _compressedBytes + (_sealed.size() + 2) * _blockSize > _maxSize) {
+    Block const& block = _blocks.front();
+    _compressedBytes -= block.data->size();
+    if (_cached && _cachedBegin == block.begin) {
+      _cached.reset();
+    }
+    _blocks.pop_front();
+    if (!_blocks.empty()) {
+      _begin = _blocks.front().begin;
+    } else {
+      _begin = _sealed.empty() ? _end - _pending.size() : _sealed.front().begin;
+    }
+  }
+}
+
+void CompressedHistory::append(const Byte *data, size_t count) {
+  Poco::Mutex::ScopedLock scopedLock(*_mutex);
+  while (count > 0) {
+    size_t n = std::min(count, _blockSize - _pending.size());
+    _pending.insert(_pending.end(), data, data + n);
+    _end += n;
+    data += n;
+    count -= n;
+    if (_pending.size() >= _blockSize) {
+      _seal();
+    }
+  }
+}
+
+void CompressedHistory::flush() {
+  Poco::Mutex::ScopedLock flushLock(*_flushMutex);
+  for (;;) {
+    RawBlock raw;
+    {
+      Poco::Mutex::ScopedLock scopedLock(*_mutex);
+      if (_sealed.empty()) {
+        return;
+      }
+      raw = _sealed.front();
+    }
+
+    // the raw block stays readable while being compressed, and is replaced afterwards
+    std::shared_ptr<std::string> data(new std::string(Compression::compress(raw.data->data(), raw.data->size())));
+    Block block = {raw.begin, raw.data->size(), data};
+    Poco::Mutex::ScopedLock scopedLock(*_mutex);
+    _blocks.push_back(block);
+    _compressedBytes += data->size();
+    _sealed.pop_front();
+    _dropOldBlocks();
+  }
+}
+
+size_t CompressedHistory::read(size_t begin, Byte *target, size_t count) {
+  Block block;
+  {
+    Poco::Mutex::ScopedLock scopedLock(*_mutex);
+    if (begin < _begin || begin >= _end) {
+      return 0;
+    }
+    ++_reads;
+
+    size_t pendingBegin = _end - _pending.size();
+    if (begin >= pendingBegin) {
+      size_t n = std::min(count, _end - begin);
+      memcpy(target, _pending.data() + (begin - pendingBegin), n);
+      return n;
+    }
+    if (!_sealed.empty() && begin >= _sealed.front().begin) {
+      auto it = std::upper_bound(_sealed.begin(), _sealed.end(), begin,
+                                 [] (size_t pos, RawBlock const& block) { return pos < block.begin; });
+      RawBlock const& raw = *(it - 1);
+      size_t n = std::min(count, raw.data->size() - (begin - raw.begin));
+      memcpy(target, raw.data->data() + (begin - raw.begin), n);
+      return n;
+    }
+
+    auto it = std::upper_bound(_blocks.begin(), _blocks.end(), begin,
+                               [] (size_t pos, Block const& block) { return pos < block.begin; });
+    block = *(it - 1);
+    if (_cached && _cachedBegin == block.begin) {
+      size_t n = std::min(count, block.size - (begin - block.begin));
+      memcpy(target, _cached->data() + (begin - block.begin), n);
+      return n;
+    }
+  }
+
+  // the compressed block is kept alive by `block.data`, even if it is dropped meanwhile
+  Poco::Clock start;
+  std::shared_ptr<std::vector<Byte>> raw(new std::vector<Byte>(block.size));
+  Compression::decompress(block.data->data(), block.data->size(), raw->data(), block.size);
+  size_t elapsed = (size_t)start.elapsed();
+
+  size_t n = std::min(count, block.size - (begin - block.begin));
+  memcpy(target, raw->data() + (begin - block.begin), n);
+
+  Poco::Mutex::ScopedLock scopedLock(*_mutex);
+  ++_decompressions;
+  _decompressMicros += elapsed;
+  if (block.begin >= _begin) {
+    _cachedBegin = block.begin;
+    _cached = raw;
+  }
+  return n;
+}
+
+CompressedHistory::Statistics CompressedHistory::statistics() const {
+  Poco::Mutex::ScopedLock scopedLock(*_mutex);
+  Statistics stats;
+  stats.retainedBytes = _end - _begin;
+  stats.sealedBytes = (_sealed.empty() ? _end - _pending.size() : _sealed.front().begin) - _begin;
+  stats.compressedBytes = _compressedBytes;
+  stats.blockCount = _blocks.size();
+  stats.reads = _reads;
+  stats.decompressions = _decompressions;
+  stats.decompressMicros = _decompressMicros;
+  return stats;
+}
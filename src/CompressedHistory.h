@@ -0,0 +1,104 @@
+#ifndef ML_GRIDENGINE_EXECUTOR_COMPRESSEDHISTORY_H
+#define ML_GRIDENGINE_EXECUTOR_COMPRESSEDHISTORY_H
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include "OutputHistory.h"
+
+namespace Poco {
+  class Mutex;
+}
+
+/**
+ * An {@class OutputHistory} which keeps the evicted output compressed in memory.
+ *
+ * The evicted output is collected into a raw block, which is sealed once it reaches
+ * {@code blockSize}.  The sealed blocks are compressed by {@code flush}, outside of the lock of
+ * the output buffer, and can be read as-is until then.  The oldest compressed blocks are dropped
+ * whenever the memory used by the history (the compressed blocks, the raw blocks, and the last
+ * decompressed block) would exceed {@code maxSize}.  Compressed blocks are decompressed on
+ * demand, outside of the lock.
+ */
+class CompressedHistory : public OutputHistory {
+public:
+  struct Statistics {
+    /** Number of output bytes retained in the history. */
+    size_t retainedBytes;
+    /** Number of bytes in the compressed blocks before compression. */
+    size_t sealedBytes;
+    /** Number of bytes in the compressed blocks after compression. */
+    size_t compressedBytes;
+    /** Number of compressed blocks. */
+    size_t blockCount;
+    /** Number of reads from the history. */
+    size_t reads;
+    /** Number of reads which had to decompress a block. */
+    size_t decompressions;
+    /** Total time spent in decompression, in microseconds. */
+    size_t decompressMicros;
+
+    /** The ratio of {@code sealedBytes} to {@code compressedBytes}. */
+    double compressionRatio() const;
+
+    /** Average decompression time per read, in microseconds. */
+    double decompressMicrosPerRead() const;
+  };
+
+private:
+  struct Block {
+    size_t begin;
+    size_t size;
+    std::shared_ptr<std::string> data;
+  };
+
+  struct RawBlock {
+    size_t begin;
+    std::shared_ptr<std::vector<Byte>> data;
+  };
+
+  size_t _maxSize;
+  size_t _blockSize;
+  Poco::Mutex *_mutex;
+  Poco::Mutex *_flushMutex;       // serializes the flushes, which compress without `_mutex`
+  std::deque<Block> _blocks;
+  std::deque<RawBlock> _sealed;   // the sealed blocks waiting for compression
+  std::vector<Byte> _pending;
+  size_t _begin;
+  size_t _end;
+  size_t _compressedBytes;
+
+  size_t _cachedBegin;
+  std::shared_ptr<std::vector<Byte>> _cached;
+
+  size_t _reads;
+  size_t _decompressions;
+  size_t _decompressMicros;
+
+  void _seal();
+  void _dropOldBlocks();
+
+public:
+  /**
+   * Construct a new {@class CompressedHistory}.
+   *
+   * @param maxSize Maximum memory used by the history.
+   * @param blockSize Number of raw bytes in each compressed block.
+   */
+  explicit CompressedHistory(size_t maxSize, size_t blockSize=64 * 1024);
+
+  ~CompressedHistory();
+
+  size_t begin() const override;
+  size_t end() const override;
+  void append(const Byte *data, size_t count) override;
+  void flush() override;
+  size_t read(size_t begin, Byte *target, size_t count) override;
+
+  /** Get the statistics of the history. */
+  Statistics statistics() const;
+};
+
+
+#endif //ML_GRIDENGINE_EXECUTOR_COMPRESSEDHISTORY_H
@@ -0,0 +1,23 @@
+#include <sstream>
+#include <Poco/DeflatingStream.h>
+#include <Poco/InflatingStream.h>
+#include <Poco/MemoryStream.h>
+#include <Poco/Exception.h>
+#include "Compression.h"
+
+std::string Compression::compress(void const *data, size_t count) {
+  std::ostringstream oss;
+  Poco::DeflatingOutputStream deflater(oss, Poco::DeflatingStreamBuf::STREAM_ZLIB, Z_BEST_SPEED);
+  deflater.write((char const*)data, count);
+  deflater.close();
+  return oss.str();
+}
+
+void Compression::decompress(void const *data, size_t count, void *target, size_t rawSize) {
+  Poco::MemoryInputStream input((char const*)data, count);
+  Poco::InflatingInputStream inflater(input, Poco::InflatingStreamBuf::STREAM_ZLIB);
+  inflater.read((char*)target, rawSize);
+  if ((size_t)inflater.gcount() != rawSize) {
+    throw Poco::DataFormatException("Compressed block is truncated.");
+  }
+}
@@ -0,0 +1,32 @@
+#ifndef ML_GRIDENGINE_EXECUTOR_COMPRESSION_H
+#define ML_GRIDENGINE_EXECUTOR_COMPRESSION_H
+
+#include <string>
+
+
+/** Block compression of the program output, using the zlib bundled with Poco. */
+class Compression {
+public:
+  /**
+   * Compress a block of bytes, favoring speed over ratio.
+   *
+   * @param data The bytes to compress.
+   * @param count Number of bytes to compress.
+   * @return The compressed bytes.
+   */
+  static std::string compress(void const *data, size_t count);
+
+  /**
+   * Decompress a block of bytes produced by {@code compress}.
+   *
+   * @param data The compressed bytes.
+   * @param count Number of compressed bytes.
+   * @param target Where to put the decompressed bytes.
+   * @param rawSize Number of bytes before compression.
+   * @throw Poco::DataFormatException If fewer than {@arg rawSize} bytes can be decompressed.
+   */
+  static void decompress(void const *data, size_t count, void *target, size_t rawSize);
+};
+
+
+#endif //ML_GRIDENGINE_EXECUTOR_COMPRESSION_H
@@ -0,0 +1,138 @@
+#include <Poco/NumberParser.h>
+#include "CursorRegistry.h"
+
+CursorRegistry::CursorRegistry(OutputBuffer *outputBuffer, long idleTimeoutMillis, size_t maxCursors) :
+  _outputBuffer(outputBuffer),
+  _idleTimeoutMillis(idleTimeoutMillis),
+  _maxCursors(std::max(maxCursors, (size_t)1)),
+  _nextId(1)
+{
+}
+
+CursorRegistry::~CursorRegistry() {
+  Poco::Mutex::ScopedLock scopedLock(_mutex);
+  while (!_cursors.empty()) {
+    _remove(_cursors.begin());
+  }
+}
+
+size_t CursorRegistry::_storedPosition(RepeatMode mode, size_t position) const {
+  if (!_outputBuffer->deduplicateLines()) {
+    return position;
+  }
+  // a position within the synthesized bytes needs nothing stored after the repeated line
+  return _outputBuffer->repeatSpan(mode, position, 1).storedBegin;
+}
+
+size_t CursorRegistry::_writtenBytes(RepeatMode mode) const {
+  return _outputBuffer->deduplicateLines() ? _outputBuffer->repeatWrittenBytes(mode) : _outputBuffer->writtenBytes();
+}
+
+CursorInfo CursorRegistry::_describe(Cursor const& cursor) const {
+  CursorInfo info = cursor.info;
+  size_t writtenBytes = _writtenBytes(info.repeatMode);
+  info.lag = writtenBytes > info.position ? writtenBytes - info.position : 0;
+  info.durable = cursor.consumerId > 0 && _outputBuffer->durableConsumerAttached(cursor.consumerId);
+  return info;
+}
+
+std::map<size_t, CursorRegistry::Cursor>::iterator CursorRegistry::_find(std::string const& id) {
+  Poco::UInt64 key;
+  if (!Poco::NumberParser::tryParseUnsigned64(id, key)) {
+    return _cursors.end();
+  }
+  return _cursors.find((size_t)key);
+}
+
+void CursorRegistry::_remove(std::map<size_t, Cursor>::iterator it) {
+  if (it->second.consumerId > 0) {
+    _outputBuffer->detachDurableConsumer(it->second.consumerId);
+  }
+  _cursors.erase(it);
+}
+
+CursorInfo CursorRegistry::create(bool durable, RepeatMode mode, ssize_t begin) {
+  Poco::Mutex::ScopedLock scopedLock(_mutex);
+
+  // make room by removing the least recently polled cursor
+  if (_cursors.size() >= _maxCursors) {
+    auto oldest = _cursors.begin();
+    for (auto it = _cursors.begin(); it != _cursors.end(); ++it) {
+      if (it->second.info.lastPollTime < oldest->second.info.lastPollTime) {
+        oldest = it;
+      }
+    }
+    _remove(oldest);
+  }
+
+  if (begin < 0) {
+    begin = std::max(begin + (ssize_t)_writtenBytes(mode), (ssize_t)0);
+  }
+  size_t id = _nextId++;
+  Cursor cursor;
+  cursor.info.id = std::to_string(id);
+  cursor.info.position = (size_t)begin;
+  cursor.info.repeatMode = mode;
+  cursor.info.createdTime = cursor.info.lastPollTime = TimeIndex::now();
+  cursor.consumerId = durable ?
+      _outputBuffer->attachDurableConsumer(_storedPosition(mode, (size_t)begin), _idleTimeoutMillis) : 0;
+  _cursors[id] = cursor;
+  return _describe(cursor);
+}
+
+bool CursorRegistry::poll(std::string const& id, CursorInfo *info) {
+  Poco::Mutex::ScopedLock scopedLock(_mutex);
+  auto it = _find(id);
+  if (it == _cursors.end()) {
+    return false;
+  }
+  it->second.info.lastPollTime = TimeIndex::now();
+  *info = _describe(it->second);
+  return true;
+}
+
+bool CursorRegistry::advance(std::string const& id, size_t begin, size_t end) {
+  Poco::Mutex::ScopedLock scopedLock(_mutex);
+  auto it = _find(id);
+  if (it == _cursors.end()) {
+    return false;
+  }
+  Cursor &cursor = it->second;
+  cursor.info.lastPollTime = TimeIndex::now();
+  if (end <= cursor.info.position) {
+    return true;
+  }
+  if (begin > cursor.info.position) {
+    cursor.info.droppedBytes += begin - cursor.info.position;
+  }
+  cursor.info.deliveredBytes += end - std::max(begin, cursor.info.position);
+  cursor.info.position = end;
+  if (cursor.consumerId > 0) {
+    _outputBuffer->advanceDurable(cursor.consumerId, _storedPosition(cursor.info.repeatMode, end));
+  }
+  return true;
+}
+
+bool CursorRegistry::remove(std::string const& id) {
+  Poco::Mutex::ScopedLock scopedLock(_mutex);
+  auto it = _find(id);
+  if (it == _cursors.end()) {
+    return false;
+  }
+  _remove(it);
+  return true;
+}
+
+std::vector<CursorInfo> CursorRegistry::list() const {
+  Poco::Mutex::ScopedLock scopedLock(_mutex);
+  std::vector<CursorInfo> ret;
+  for (auto const& it: _cursors) {
+    ret.push_back(_describe(it.second));
+  }
+  return ret;
+}
+
+size_t CursorRegistry::size() const {
+  Poco::Mutex::ScopedLock scopedLock(_mutex);
+  return _cursors.size();
+}
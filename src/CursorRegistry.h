@@ -0,0 +1,132 @@
+#ifndef ML_GRIDENGINE_EXECUTOR_CURSORREGISTRY_H
+#define ML_GRIDENGINE_EXECUTOR_CURSORREGISTRY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <map>
+#include <string>
+#include <vector>
+#include <Poco/Mutex.h>
+#include "OutputBuffer.h"
+
+/** State of a reader cursor. */
+struct CursorInfo {
+  /** The cursor id. */
+  std::string id;
+  /** The next byte to be delivered, in the presented output of {@code repeatMode}. */
+  size_t position;
+  /** Number of bytes delivered to the reader. */
+  size_t deliveredBytes;
+  /** Number of bytes evicted from the buffer before being delivered. */
+  size_t droppedBytes;
+  /** Number of bytes written but not yet delivered. */
+  size_t lag;
+  /** Whether or not the cursor is a durable consumer of the buffer. */
+  bool durable;
+  /** How the repeated lines are presented, if the buffer deduplicates lines. */
+  RepeatMode repeatMode;
+  /** Time of creating the cursor, in microseconds since the epoch. */
+  int64_t createdTime;
+  /** Time of the last poll by the cursor, in microseconds since the epoch. */
+  int64_t lastPollTime;
+
+  CursorInfo() : position(0), deliveredBytes(0), droppedBytes(0), lag(0), durable(false),
+                 repeatMode(REPEATS_MARKER), createdTime(0), lastPollTime(0) {}
+};
+
+/**
+ * The server-side reader cursors of an {@class OutputBuffer}.
+ *
+ * A cursor tracks the position of a reader in the merged output, such that the reader may
+ * poll without keeping the position itself, and the executor knows how far each reader lags
+ * behind and exactly how many bytes it has missed.  A durable cursor is also attached to the
+ * buffer as a durable consumer: in the lossless mode the writer waits for it (until it has
+ * been idle for too long), otherwise its position is a hint of the output still wanted.
+ *
+ * The number of cursors is bounded, and the least recently polled one is removed to make
+ * room for a new one.
+ */
+class CursorRegistry {
+private:
+  struct Cursor {
+    CursorInfo info;
+    size_t consumerId;      // the durable consumer id, or 0 if not durable
+  };
+
+  OutputBuffer *_outputBuffer;
+  long _idleTimeoutMillis;
+  size_t _maxCursors;
+  mutable Poco::Mutex _mutex;
+  std::map<size_t, Cursor> _cursors;
+  size_t _nextId;
+
+  /** Find the cursor {@arg id}.  The caller must hold the mutex. */
+  std::map<size_t, Cursor>::iterator _find(std::string const& id);
+
+  /** Position in the stored output of {@arg position} in the presented output of {@arg mode}. */
+  size_t _storedPosition(RepeatMode mode, size_t position) const;
+
+  /** Number of bytes in the presented output of {@arg mode}. */
+  size_t _writtenBytes(RepeatMode mode) const;
+
+  /** Fill in the fields of {@arg cursor} derived from the buffer.  The caller must hold the mutex. */
+  CursorInfo _describe(Cursor const& cursor) const;
+
+  /** Remove the cursor, detaching its durable consumer.  The caller must hold the mutex. */
+  void _remove(std::map<size_t, Cursor>::iterator it);
+
+public:
+  /**
+   * Construct a new {@class CursorRegistry}.
+   *
+   * @param outputBuffer The merged program output.
+   * @param idleTimeoutMillis Durable cursors blocking the writer without polling for this long
+   *                          are detached from the buffer.  Zero means never.
+   * @param maxCursors Maximum number of cursors.
+   */
+  explicit CursorRegistry(OutputBuffer *outputBuffer, long idleTimeoutMillis=0, size_t maxCursors=1024);
+
+  ~CursorRegistry();
+
+  /**
+   * Create a new cursor.
+   *
+   * @param durable Whether or not the cursor is a durable consumer of the buffer.
+   * @param mode How the repeated lines are presented, if the buffer deduplicates lines.
+   * @param begin The first byte to be delivered.  Negative value means counting from the end.
+   */
+  CursorInfo create(bool durable, RepeatMode mode, ssize_t begin=0);
+
+  /**
+   * Get the cursor {@arg id}, and mark it as being polled.
+   *
+   * @return Whether or not the cursor exists.
+   */
+  bool poll(std::string const& id, CursorInfo *info);
+
+  /**
+   * Advance the cursor {@arg id} after a poll has delivered the bytes from {@arg begin} to
+   * {@arg end}.  The bytes between the cursor position and {@arg begin} are counted as dropped.
+   * A range before the cursor position, e.g., from a concurrent poll, does not move it back.
+   *
+   * @return Whether or not the cursor exists.
+   */
+  bool advance(std::string const& id, size_t begin, size_t end);
+
+  /**
+   * Remove the cursor {@arg id}.
+   *
+   * @return Whether or not the cursor existed.
+   */
+  bool remove(std::string const& id);
+
+  /** All the cursors, in the order of creation. */
+  std::vector<CursorInfo> list() const;
+
+  /** Number of cursors. */
+  size_t size() const;
+};
+
+
+#endif //ML_GRIDENGINE_EXECUTOR_CURSORREGISTRY_H
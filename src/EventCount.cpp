@@ -0,0 +1,87 @@
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#ifdef SYS_futex
+#include <linux/futex.h>
+#endif
+#include <chrono>
+#include "EventCount.h"
+
+EventCount::Deadline EventCount::Deadline::after(long millis) {
+  Deadline ret;
+  ret.infinite = millis <= 0;
+  clock_gettime(CLOCK_MONOTONIC, &ret.time);
+  if (!ret.infinite) {
+    ret.time.tv_sec += millis / 1000;
+    ret.time.tv_nsec += (millis % 1000) * 1000000L;
+    if (ret.time.tv_nsec >= 1000000000L) {
+      ret.time.tv_sec += 1;
+      ret.time.tv_nsec -= 1000000000L;
+    }
+  }
+  return ret;
+}
+
+long EventCount::Deadline::remainingNanos() const {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (time.tv_sec - now.tv_sec) * 1000000000L + (time.tv_nsec - now.tv_nsec);
+}
+
+#ifdef SYS_futex
+
+bool EventCount::wait(Key key, Deadline const& deadline) {
+  bool notified = true;
+  while (_epoch.load(std::memory_order_seq_cst) == key) {
+    // FUTEX_WAIT_BITSET takes an absolute timeout on the monotonic clock
+    long ret = syscall(SYS_futex, (uint32_t*)&_epoch, FUTEX_WAIT_BITSET | FUTEX_PRIVATE_FLAG, key,
+                       deadline.infinite ? nullptr : &deadline.time, nullptr, FUTEX_BITSET_MATCH_ANY);
+    if (ret < 0 && errno == ETIMEDOUT) {
+      notified = _epoch.load(std::memory_order_seq_cst) != key;
+      break;
+    }
+  }
+  _waiters.fetch_sub(1, std::memory_order_seq_cst);
+  return notified;
+}
+
+void EventCount::notifyAll() {
+  _epoch.fetch_add(1, std::memory_order_seq_cst);
+  if (_waiters.load(std::memory_order_seq_cst) > 0) {
+    syscall(SYS_futex, (uint32_t*)&_epoch, FUTEX_WAKE | FUTEX_PRIVATE_FLAG, INT_MAX, nullptr, nullptr, 0);
+  }
+}
+
+#else
+
+bool EventCount::wait(Key key, Deadline const& deadline) {
+  bool notified = true;
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (_epoch.load(std::memory_order_seq_cst) == key) {
+      if (deadline.infinite) {
+        _cond.wait(lock);
+        continue;
+      }
+      long remaining = deadline.remainingNanos();
+      if (remaining <= 0) {
+        notified = false;
+        break;
+      }
+      _cond.wait_for(lock, std::chrono::nanoseconds(remaining));
+    }
+  }
+  _waiters.fetch_sub(1, std::memory_order_seq_cst);
+  return notified;
+}
+
+void EventCount::notifyAll() {
+  _epoch.fetch_add(1, std::memory_order_seq_cst);
+  if (_waiters.load(std::memory_order_seq_cst) > 0) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _cond.notify_all();
+  }
+}
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef ML_GRIDENGINE_EXECUTOR_EVENTCOUNT_H
+#define ML_GRIDENGINE_EXECUTOR_EVENTCOUNT_H
+
+#include <stdint.h>
+#include <time.h>
+#include <sys/syscall.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+/**
+ * An event count, which lets any number of threads wait for a condition without a lock.
+ *
+ * A waiter calls {@code prepareWait}, checks its condition, and then either calls
+ * {@code cancelWait} if the condition holds, or {@code wait} with the key returned
+ * by {@code prepareWait}.  The notifier updates the state of the condition before
+ * calling {@code notifyAll}.  Waiters never miss a notification issued after their
+ * {@code prepareWait}, but they may wake up spuriously, so the condition must be
+ * checked again after waking up.
+ *
+ * On Linux, the waiters sleep on a single futex, so no per-waiter object is needed,
+ * and timeouts are absolute deadlines handled by the kernel.
+ */
+class EventCount {
+public:
+  typedef uint32_t Key;
+
+  /** An absolute time on the monotonic clock. */
+  struct Deadline {
+    struct timespec time;
+    bool infinite;
+
+    /** Get the deadline {@arg millis} milliseconds later.  Specify <= 0 for no deadline. */
+    static Deadline after(long millis);
+
+    /** Nanoseconds until the deadline, which is not infinite. */
+    long remainingNanos() const;
+  };
+
+private:
+  std::atomic<Key> _epoch;
+  std::atomic<uint32_t> _waiters;
+#ifndef SYS_futex
+  std::mutex _mutex;
+  std::condition_variable _cond;
+#endif
+
+public:
+  EventCount() : _epoch(0), _waiters(0) {}
+
+  EventCount(EventCount const&) = delete;
+  EventCount& operator=(EventCount const&) = delete;
+
+  /** Number of threads between {@code prepareWait} and the return of {@code wait} or {@code cancelWait}. */
+  inline uint32_t waiters() const { return _waiters.load(std::memory_order_relaxed); }
+
+  /** Announce the intention to wait.  The condition must be checked after this call. */
+  inline Key prepareWait() {
+    _waiters.fetch_add(1, std::memory_order_seq_cst);
+    return _epoch.load(std::memory_order_seq_cst);
+  }
+
+  /** Give up waiting, since the condition already holds. */
+  inline void cancelWait() {
+    _waiters.fetch_sub(1, std::memory_order_seq_cst);
+  }
+
+  /**
+   * Wait for a notification issued after {@code prepareWait} returned {@arg key}.
+   *
+   * @return false if the deadline has passed before any notification, true otherwise.
+   */
+  bool wait(Key key, Deadline const& deadline);
+
+  /** Wake up all the waiting threads. */
+  void notifyAll();
+};
+
+
+#endif //ML_GRIDENGINE_EXECUTOR_EVENTCOUNT_H
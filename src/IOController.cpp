@@ -2,19 +2,42 @@
 // Created by 许昊文 on 2018/11/18.
 //
 
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
 #include <Poco/Thread.h>
 #include <Poco/Exception.h>
 #include "AutoFreePtr.h"
 #include "Logger.h"
+#include "TimeIndex.h"
 #include "IOController.h"
+#include "macros.h"
 
-IOController::IOController(ProgramExecutor *executor, OutputBuffer *outputBuffer, size_t bufferSize) :
+IOController::IOController(ProgramExecutor *executor, OutputBuffer *outputBuffer, OutputBuffer *errorBuffer,
+                           bool compactProgress, size_t bufferSize) :
   _executor(executor),
   _outputBuffer(outputBuffer),
+  _errorBuffer(errorBuffer),
   _bufferSize(bufferSize),
+  _compactors{nullptr, nullptr},
+  _coalesceBytes(ML_GRIDENGINE_COALESCE_MAX_BYTES),
+  _coalesceWindow(0),
+  _startTime(0),
+  _stopTime(0),
   _ioThread(new Poco::Thread()),
   _running(false)
 {
+  if (compactProgress) {
+    // each stream has its own line being redrawn
+    for (int i=0; i<2; ++i) {
+      ProgramStream stream = (ProgramStream)i;
+      _compactors[i] = new ProgressCompactor([this, stream] (const Byte *data, size_t count) {
+        this->_coalescers[0]->write(stream, data, count);
+      }, 1000000, bufferSize);
+    }
+  }
 }
 
 IOController::~IOController() {
@@ -22,16 +45,209 @@ IOController::~IOController() {
     join();
   }
   delete _ioThread;
+  delete _compactors[0];
+  delete _compactors[1];
+  for (auto coalescer: _coalescers) {
+    delete coalescer;
+  }
+  for (auto chain: _filterChains) {
+    delete chain;
+  }
 }
 
-#include <string>
-#include "Logger.h"
+void IOController::setExtraBuffers(std::vector<OutputBuffer*> const& buffers) {
+  if (_running) {
+    throw Poco::IllegalStateException("Extra buffers must be set before the IO thread starts.");
+  }
+  _extraBuffers = buffers;
+}
+
+void IOController::setCoalescing(size_t maxBytes, int64_t window) {
+  if (_running) {
+    throw Poco::IllegalStateException("Coalescing must be set before the IO thread starts.");
+  }
+  _coalesceBytes = maxBytes;
+  _coalesceWindow = window;
+}
+
+void IOController::setFilters(IngestFilterOptions const& options) {
+  if (_running) {
+    throw Poco::IllegalStateException("Filters must be set before the IO thread starts.");
+  }
+  _filterOptions = options;
+}
+
+IngestStatistics IOController::ingestStatistics() const {
+  IngestStatistics ret;
+  for (auto coalescer: _coalescers) {
+    ret.writes += coalescer->writes();
+    ret.wakeups += coalescer->flushes();
+  }
+  if (_startTime > 0) {
+    int64_t stopTime = _stopTime.load();
+    ret.seconds = ((stopTime > 0 ? stopTime : TimeIndex::now()) - _startTime) / 1e6;
+  }
+  return ret;
+}
+
+size_t IOController::compactedBytes() const {
+  size_t ret = 0;
+  for (auto compactor: _compactors) {
+    if (compactor) {
+      ret += compactor->savedBytes();
+    }
+  }
+  return ret;
+}
+
+int64_t IOController::filteredBytes() const {
+  int64_t ret = 0;
+  for (auto chain: _filterChains) {
+    ret += (int64_t)chain->inputBytes() - (int64_t)chain->outputBytes();
+  }
+  return ret;
+}
 
 void IOController::_run() {
-  ssize_t nBytes;
+  if (_executor->separateStderr() || _compactors[0] || !_extraBuffers.empty() || _coalesceWindow > 0 ||
+      !_filterChains.empty()) {
+    _runPolling();
+  } else {
+    ssize_t nBytes;
+    AutoFreePtr<void> buffer(malloc(_bufferSize));
+    while ((nBytes = _executor->readOutput(buffer.ptr, _bufferSize)) > 0) {
+      _coalescers[0]->write(STDOUT_STREAM, (const Byte*)buffer.ptr, (size_t)nBytes);
+    }
+  }
+  _stopTime = TimeIndex::now();
+}
+
+int IOController::_pollTimeout(int64_t now) const {
+  int64_t deadline = -1;
+  if (_compactors[0]) {
+    deadline = now + _compactors[0]->interval();
+  }
+  for (auto coalescer: _coalescers) {
+    int64_t due = coalescer->deadline();
+    if (due >= 0 && (deadline < 0 || due < deadline)) {
+      deadline = due;
+    }
+  }
+  if (deadline < 0) {
+    return -1;
+  }
+  // round up, such that the batched output is due when poll returns
+  return (int)std::max((deadline - now + 999) / 1000, (int64_t)0);
+}
+
+void IOController::_runPolling() {
   AutoFreePtr<void> buffer(malloc(_bufferSize));
-  while ((nBytes = _executor->readOutput(buffer.ptr, _bufferSize)) > 0) {
-    _outputBuffer->write(buffer.ptr, (size_t)nBytes);
+  // stdout, stderr, then the extra outputs
+  std::vector<struct pollfd> fds(2 + _extraBuffers.size());
+  fds[0].fd = _executor->outputFd();
+  fds[1].fd = _executor->separateStderr() ? _executor->errorFd() : -1;  // negative fds are ignored by poll
+  for (size_t i=0; i<_extraBuffers.size(); ++i) {
+    fds[2 + i].fd = _executor->extraOutputFd(i);
+  }
+  int openCount = 0;
+  for (struct pollfd &fd: fds) {
+    fd.events = POLLIN;
+    openCount += fd.fd >= 0 ? 1 : 0;
+  }
+  while (openCount > 0) {
+    int ret = poll(fds.data(), fds.size(), _pollTimeout(TimeIndex::now()));
+    if (ret < 0) {
+      if (errno == EINTR)
+        continue;
+      Logger::getLogger().error("Failed to poll the program output: %s", std::string(strerror(errno)));
+      break;
+    }
+    if (ret == 0) {
+      // the program is quiet, so let the readers see the latest state of its progress bars
+      int64_t now = TimeIndex::now();
+      if (_compactors[0]) {
+        for (auto compactor: _compactors) {
+          compactor->flushIfStale(now);
+        }
+      }
+      for (auto coalescer: _coalescers) {
+        coalescer->flushIfDue(now);
+      }
+      continue;
+    }
+    for (size_t i=0; i<fds.size(); ++i) {
+      if (fds[i].fd < 0 || fds[i].revents == 0)
+        continue;
+      ssize_t nBytes;
+      if (i >= 2) {
+        nBytes = _executor->readExtraOutput(i - 2, buffer.ptr, _bufferSize);
+        if (nBytes > 0) {
+          _ingestExtra(i - 2, buffer.ptr, (size_t)nBytes);
+        }
+      } else {
+        nBytes = i == 0 ? _executor->readOutput(buffer.ptr, _bufferSize) :
+                          _executor->readError(buffer.ptr, _bufferSize);
+        if (nBytes > 0) {
+          _ingest((ProgramStream)i, buffer.ptr, (size_t)nBytes);
+        }
+      }
+      if (nBytes <= 0) {
+        _finishStream(i);
+        fds[i].fd = -1;
+        --openCount;
+      }
+    }
+
+    // the output keeps arriving, so poll may never time out before the batched output is due
+    int64_t now = TimeIndex::now();
+    for (auto coalescer: _coalescers) {
+      coalescer->flushIfDue(now);
+    }
+  }
+  for (auto coalescer: _coalescers) {
+    coalescer->flush();
+  }
+}
+
+void IOController::_ingest(ProgramStream stream, const void *data, size_t count) {
+  if (!_filterChains.empty()) {
+    _filterChains[stream]->write((const Byte*)data, count);
+  } else {
+    _compact(stream, data, count);
+  }
+}
+
+void IOController::_compact(ProgramStream stream, const void *data, size_t count) {
+  if (_compactors[stream]) {
+    _compactors[stream]->write((const Byte*)data, count);
+  } else {
+    _coalescers[0]->write(stream, (const Byte*)data, count);
+  }
+}
+
+void IOController::_ingestExtra(size_t i, const void *data, size_t count) {
+  if (!_filterChains.empty()) {
+    _filterChains[2 + i]->write((const Byte*)data, count);
+  } else {
+    _coalescers[1 + i]->write(STDOUT_STREAM, (const Byte*)data, count);
+  }
+}
+
+void IOController::_finishStream(size_t fdIndex) {
+  if (!_filterChains.empty()) {
+    _filterChains[fdIndex]->finish();
+  }
+  if (fdIndex >= 2) {
+    _coalescers[fdIndex - 1]->flush();
+  } else if (_compactors[fdIndex]) {
+    _compactors[fdIndex]->flush();
+  }
+}
+
+void IOController::_writeStream(ProgramStream stream, const void *data, size_t count) {
+  _outputBuffer->write(data, count, stream);
+  if (stream == STDERR_STREAM && _errorBuffer) {
+    _errorBuffer->write(data, count);
   }
 }
 
@@ -39,6 +255,31 @@ void IOController::start() {
   if (_running) {
     throw Poco::IllegalStateException("The IO thread has already started.");
   }
+  if (_coalescers.empty()) {
+    _coalescers.push_back(new WriteCoalescer([this] (ProgramStream stream, const Byte *data, size_t count) {
+      this->_writeStream(stream, data, count);
+    }, _coalesceBytes, _coalesceWindow));
+    for (OutputBuffer *extraBuffer: _extraBuffers) {
+      _coalescers.push_back(new WriteCoalescer([extraBuffer] (ProgramStream stream, const Byte *data, size_t count) {
+        extraBuffer->write(data, count);
+      }, _coalesceBytes, _coalesceWindow));
+    }
+  }
+  if (_filterChains.empty() && _filterOptions.enabled()) {
+    for (int i=0; i<2; ++i) {
+      ProgramStream stream = (ProgramStream)i;
+      _filterChains.push_back(new IngestFilterChain([this, stream] (const Byte *data, size_t count) {
+        this->_compact(stream, data, count);
+      }, _filterOptions));
+    }
+    for (size_t i=0; i<_extraBuffers.size(); ++i) {
+      WriteCoalescer *coalescer = _coalescers[1 + i];
+      _filterChains.push_back(new IngestFilterChain([coalescer] (const Byte *data, size_t count) {
+        coalescer->write(STDOUT_STREAM, data, count);
+      }, _filterOptions));
+    }
+  }
+  _startTime = TimeIndex::now();
   _ioThread->startFunc([this] {
     this->_run();
   });
@@ -5,28 +5,130 @@
 #ifndef ML_GRIDENGINE_EXECUTOR_IOCONTROLLER_H
 #define ML_GRIDENGINE_EXECUTOR_IOCONTROLLER_H
 
+#include <atomic>
+#include <vector>
 #include "ProgramExecutor.h"
 #include "OutputBuffer.h"
+#include "IngestFilter.h"
+#include "ProgressCompactor.h"
+#include "WriteCoalescer.h"
 
 namespace Poco {
   class Thread;
 }
 
+/** Statistics of the output ingested by an {@class IOController}. */
+struct IngestStatistics {
+  /** Number of chunks read from the program. */
+  size_t writes;
+  /** Number of writes into the output buffers, each of which wakes up the readers once. */
+  size_t wakeups;
+  /** Seconds since the IO thread started, until it stopped. */
+  double seconds;
+
+  IngestStatistics() : writes(0), wakeups(0), seconds(0) {}
+
+  inline double writesPerSecond() const { return seconds > 0 ? writes / seconds : 0; }
+
+  inline double wakeupsPerSecond() const { return seconds > 0 ? wakeups / seconds : 0; }
+};
+
 class IOController {
 private:
   ProgramExecutor *_executor;
   OutputBuffer *_outputBuffer;
+  OutputBuffer *_errorBuffer;
   size_t _bufferSize;
+  ProgressCompactor *_compactors[2];  // indexed by {@code ProgramStream}, NULL if not compacted
+  std::vector<OutputBuffer*> _extraBuffers;  // indexed as the extra outputs of the executor
+  IngestFilterOptions _filterOptions;
+  // stdout, stderr, then the extra outputs, empty if not filtered
+  std::vector<IngestFilterChain*> _filterChains;
+  size_t _coalesceBytes;
+  int64_t _coalesceWindow;
+  // the main output (stdout and stderr), then the extra outputs
+  std::vector<WriteCoalescer*> _coalescers;
+  int64_t _startTime;
+  std::atomic<int64_t> _stopTime;  // set by the IO thread when it stops
   Poco::Thread *_ioThread;
   volatile bool _running;
 
   void _run();
 
+  /**
+   * Read stdout and stderr from their separated pipes (or stdout alone if not separated), and
+   * the extra outputs, in the order of arrival.  Wakes up every compaction interval to flush the
+   * stale progress bars, and when the batched output is due.
+   */
+  void _runPolling();
+
+  /** Milliseconds for {@code poll} to wait at {@arg now}, or -1 to wait for the output. */
+  int _pollTimeout(int64_t now) const;
+
+  /**
+   * Pass the output of {@arg stream} through its filters, compactor and coalescer, and write it to
+   * the buffers.
+   */
+  void _ingest(ProgramStream stream, const void *data, size_t count);
+
+  /** Pass the filtered output of {@arg stream} through its compactor and coalescer. */
+  void _compact(ProgramStream stream, const void *data, size_t count);
+
+  /** Pass the extra output {@arg i} through its filters and coalescer, and write it to its buffer. */
+  void _ingestExtra(size_t i, const void *data, size_t count);
+
+  /** Pass on everything held back for the output at {@arg fdIndex} of {@code _runPolling}, which has ended. */
+  void _finishStream(size_t fdIndex);
+
+  /** Write the output of {@arg stream} to the buffers. */
+  void _writeStream(ProgramStream stream, const void *data, size_t count);
+
 public:
-  explicit IOController(ProgramExecutor *executor, OutputBuffer *outputBuffer, size_t bufferSize=8192);
+  /**
+   * Construct a new {@class IOController}.
+   *
+   * @param outputBuffer Where to write the program output.  If stderr is separated by the executor,
+   *                     it is still written here, tagged as {@code STDERR_STREAM}.
+   * @param errorBuffer Where to write the separated stderr as well, with its own capacity.  May be NULL.
+   * @param compactProgress Whether or not to collapse the progress bars by {@class ProgressCompactor}.
+   */
+  explicit IOController(ProgramExecutor *executor, OutputBuffer *outputBuffer, OutputBuffer *errorBuffer=nullptr,
+                        bool compactProgress=false, size_t bufferSize=8192);
 
   ~IOController();
 
+  /**
+   * Write the extra outputs of the executor (see {@code ProgramExecutor::setExtraOutputs}) into
+   * {@arg buffers}, in the same order.  Must be called before {@code start}.
+   */
+  void setExtraBuffers(std::vector<OutputBuffer*> const& buffers);
+
+  /**
+   * Batch the small writes of the program arriving at a high rate, see {@class WriteCoalescer}.
+   * Must be called before {@code start}.
+   *
+   * @param maxBytes Maximum number of bytes held back.
+   * @param window Maximum time of the output being held back, in microseconds.  Zero disables
+   *               the batching.
+   */
+  void setCoalescing(size_t maxBytes, int64_t window);
+
+  /**
+   * Filter the program output, e.g., strip the ANSI escape sequences and redact the secrets, before
+   * anything else, see {@class IngestFilterChain}.  Each output has its own chain.  Must be called
+   * before {@code start}.
+   */
+  void setFilters(IngestFilterOptions const& options);
+
+  /** Number of writes read from the program, and of writes into the buffers waking up the readers. */
+  IngestStatistics ingestStatistics() const;
+
+  /** Number of bytes saved by collapsing the progress bars, of both streams. */
+  size_t compactedBytes() const;
+
+  /** Number of bytes removed (or added, if negative) by the filters, of all the outputs. */
+  int64_t filteredBytes() const;
+
   void start();
 
   void join();
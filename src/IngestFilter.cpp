@@ -0,0 +1,505 @@
+#include <ctype.h>
+#include <string.h>
+#include <algorithm>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define ML_GRIDENGINE_INGEST_AVX2
+#endif
+#include "IngestFilter.h"
+
+namespace {
+  const Byte ESC = 0x1b;
+  const Byte BEL = 0x07;
+
+  // bytes scanned at once by the fast paths
+  const size_t BLOCK_SIZE = 32;
+
+  /** Number of the leading ASCII bytes of {@arg data}, testing the high bits of a block at once. */
+  size_t asciiPrefix(const Byte *data, size_t count) {
+    size_t i = 0;
+#ifdef __SSE2__
+    for (; i + BLOCK_SIZE <= count; i += BLOCK_SIZE) {
+      __m128i a = _mm_loadu_si128((const __m128i*)(data + i));
+      __m128i b = _mm_loadu_si128((const __m128i*)(data + i + 16));
+      if (_mm_movemask_epi8(_mm_or_si128(a, b)) != 0) {
+        break;
+      }
+    }
+#else
+    for (; i + 8 <= count; i += 8) {
+      uint64_t word;
+      memcpy(&word, data + i, 8);
+      if (word & 0x8080808080808080ULL) {
+        break;
+      }
+    }
+#endif
+    while (i < count && data[i] < 0x80) {
+      ++i;
+    }
+    return i;
+  }
+
+  typedef enum {
+    SEQUENCE_VALID,
+    SEQUENCE_INVALID,
+    SEQUENCE_INCOMPLETE
+  } SequenceStatus;
+
+  /**
+   * Decode the UTF-8 sequence at the beginning of {@arg data}, having {@arg count} > 0 bytes.
+   *
+   * @param length Gets the length of the valid sequence, of the maximal invalid subpart to be
+   *               replaced, or of the incomplete sequence (i.e., {@arg count}).
+   */
+  inline SequenceStatus decodeSequence(const Byte *data, size_t count, size_t *length) {
+    Byte lead = data[0];
+    Byte low = 0x80, high = 0xbf;   // range of the second byte
+    size_t trailing;
+    if (lead < 0x80) {
+      *length = 1;
+      return SEQUENCE_VALID;
+    } else if (lead >= 0xc2 && lead <= 0xdf) {
+      trailing = 1;
+    } else if (lead >= 0xe0 && lead <= 0xef) {
+      trailing = 2;
+      low = lead == 0xe0 ? 0xa0 : 0x80;   // overlong
+      high = lead == 0xed ? 0x9f : 0xbf;  // surrogates
+    } else if (lead >= 0xf0 && lead <= 0xf4) {
+      trailing = 3;
+      low = lead == 0xf0 ? 0x90 : 0x80;   // overlong
+      high = lead == 0xf4 ? 0x8f : 0xbf;  // beyond U+10FFFF
+    } else {
+      *length = 1;
+      return SEQUENCE_INVALID;
+    }
+    for (size_t k=1; k<=trailing; ++k) {
+      if (k >= count) {
+        *length = count;
+        return SEQUENCE_INCOMPLETE;
+      }
+      if (data[k] < low || data[k] > high) {
+        *length = k;
+        return SEQUENCE_INVALID;
+      }
+      low = 0x80;
+      high = 0xbf;
+    }
+    *length = trailing + 1;
+    return SEQUENCE_VALID;
+  }
+
+  const Byte REPLACEMENT[] = {0xef, 0xbf, 0xbd};  // U+FFFD
+
+  inline void appendReplacement(std::vector<Byte> &out) {
+    out.insert(out.end(), REPLACEMENT, REPLACEMENT + sizeof(REPLACEMENT));
+  }
+
+  typedef enum {
+    ANSI_TEXT,
+    ANSI_ESCAPE,          // after ESC
+    ANSI_CSI,             // after "ESC [", until a final byte
+    ANSI_STRING,          // after "ESC ]" (OSC) and the like, until BEL or "ESC \"
+    ANSI_STRING_ESCAPE,   // after ESC within a string
+    ANSI_INTERMEDIATE     // after "ESC" and an intermediate byte, e.g., "ESC (", until a final byte
+  } AnsiState;
+
+  struct DelimiterTable {
+    bool delimiters[256];
+
+    DelimiterTable() {
+      std::fill(delimiters, delimiters + 256, false);
+      for (const char *p = " \t\r\n\v\f\"'`,;&<>"; *p; ++p) {
+        delimiters[(Byte)*p] = true;
+      }
+    }
+  };
+
+  const DelimiterTable DELIMITER_TABLE;
+
+  // the prefixes are tested one by one, so too many of them make the fast path slower than the automaton
+  const size_t MAX_PREFILTER_PREFIXES = 24;
+  const size_t PREFIX_LENGTH = 3;
+
+#ifdef __SSE2__
+  /**
+   * Positions within the block at {@arg p} where any of the prefixes starts, ignoring the case.
+   *
+   * @param rows The bytes of each prefix, each of them repeated 32 times and in lower case.
+   * @return Bit {@code 1 << k} is set if a prefix starts at {@code p + k}.
+   */
+  uint32_t prefixStarts(const Byte *p, const Byte *rows, size_t prefixCount) {
+    const __m128i fold = _mm_set1_epi8(0x20);
+    __m128i v[2][PREFIX_LENGTH];
+    for (size_t h=0; h<2; ++h) {
+      for (size_t k=0; k<PREFIX_LENGTH; ++k) {
+        v[h][k] = _mm_or_si128(_mm_loadu_si128((const __m128i*)(p + h * 16 + k)), fold);
+      }
+    }
+    __m128i found[2] = {_mm_setzero_si128(), _mm_setzero_si128()};
+    for (size_t j=0; j<prefixCount; ++j, rows += 32 * PREFIX_LENGTH) {
+      __m128i b0 = _mm_loadu_si128((const __m128i*)rows);
+      __m128i b1 = _mm_loadu_si128((const __m128i*)(rows + 32));
+      __m128i b2 = _mm_loadu_si128((const __m128i*)(rows + 64));
+      __m128i m0 = _mm_and_si128(_mm_and_si128(_mm_cmpeq_epi8(v[0][0], b0), _mm_cmpeq_epi8(v[0][1], b1)),
+                                 _mm_cmpeq_epi8(v[0][2], b2));
+      __m128i m1 = _mm_and_si128(_mm_and_si128(_mm_cmpeq_epi8(v[1][0], b0), _mm_cmpeq_epi8(v[1][1], b1)),
+                                 _mm_cmpeq_epi8(v[1][2], b2));
+      found[0] = _mm_or_si128(found[0], m0);
+      found[1] = _mm_or_si128(found[1], m1);
+    }
+    return (uint32_t)_mm_movemask_epi8(found[0]) | ((uint32_t)_mm_movemask_epi8(found[1]) << 16);
+  }
+#endif
+
+#ifdef ML_GRIDENGINE_INGEST_AVX2
+  /** {@code prefixStarts} by 32-byte vectors, if the CPU supports AVX2. */
+  __attribute__((target("avx2")))
+  uint32_t prefixStartsAvx2(const Byte *p, const Byte *rows, size_t prefixCount) {
+    const __m256i fold = _mm256_set1_epi8(0x20);
+    __m256i v0 = _mm256_or_si256(_mm256_loadu_si256((const __m256i*)p), fold);
+    __m256i v1 = _mm256_or_si256(_mm256_loadu_si256((const __m256i*)(p + 1)), fold);
+    __m256i v2 = _mm256_or_si256(_mm256_loadu_si256((const __m256i*)(p + 2)), fold);
+    __m256i found = _mm256_setzero_si256();
+    for (size_t j=0; j<prefixCount; ++j, rows += 32 * PREFIX_LENGTH) {
+      __m256i m = _mm256_and_si256(_mm256_cmpeq_epi8(v0, _mm256_loadu_si256((const __m256i*)rows)),
+                                   _mm256_cmpeq_epi8(v1, _mm256_loadu_si256((const __m256i*)(rows + 32))));
+      m = _mm256_and_si256(m, _mm256_cmpeq_epi8(v2, _mm256_loadu_si256((const __m256i*)(rows + 64))));
+      found = _mm256_or_si256(found, m);
+    }
+    return (uint32_t)_mm256_movemask_epi8(found);
+  }
+#endif
+}
+
+AnsiStripFilter::AnsiStripFilter() : _state(ANSI_TEXT) {}
+
+bool AnsiStripFilter::filter(const Byte *data, size_t count, std::vector<Byte> &out) {
+  if (_state == ANSI_TEXT && !memchr(data, ESC, count)) {
+    return false;
+  }
+  size_t i = 0;
+  while (i < count) {
+    Byte b = data[i];
+    switch (_state) {
+      case ANSI_TEXT: {
+        const Byte *escape = (const Byte*)memchr(data + i, ESC, count - i);
+        size_t end = escape ? escape - data : count;
+        out.insert(out.end(), data + i, data + end);
+        i = end;
+        if (escape) {
+          _state = ANSI_ESCAPE;
+          ++i;
+        }
+        continue;
+      }
+      case ANSI_ESCAPE:
+        if (b == '[') {
+          _state = ANSI_CSI;
+        } else if (b == ']' || b == 'P' || b == 'X' || b == '^' || b == '_') {
+          _state = ANSI_STRING;
+        } else if (b >= 0x20 && b <= 0x2f) {
+          _state = ANSI_INTERMEDIATE;
+        } else if (b >= 0x30 && b <= 0x7e) {
+          _state = ANSI_TEXT;
+        } else if (b != ESC) {
+          // a lone ESC is dropped
+          _state = ANSI_TEXT;
+          continue;
+        }
+        break;
+      case ANSI_CSI:
+        if (b >= 0x40 && b <= 0x7e) {
+          _state = ANSI_TEXT;
+        } else if (b < 0x20 || b > 0x3f) {
+          // not a CSI sequence after all
+          _state = ANSI_TEXT;
+          continue;
+        }
+        break;
+      case ANSI_STRING:
+        if (b == BEL) {
+          _state = ANSI_TEXT;
+        } else if (b == ESC) {
+          _state = ANSI_STRING_ESCAPE;
+        } else if (b == '\n') {
+          // never swallow the lines after an unterminated string
+          _state = ANSI_TEXT;
+          continue;
+        }
+        break;
+      case ANSI_STRING_ESCAPE:
+        if (b == '\\') {
+          _state = ANSI_TEXT;
+        } else {
+          _state = ANSI_ESCAPE;
+          continue;
+        }
+        break;
+      case ANSI_INTERMEDIATE:
+        if (b >= 0x30 && b <= 0x7e) {
+          _state = ANSI_TEXT;
+        } else if (b < 0x20 || b > 0x2f) {
+          _state = ANSI_TEXT;
+          continue;
+        }
+        break;
+    }
+    ++i;
+  }
+  return true;
+}
+
+void AnsiStripFilter::finish(std::vector<Byte> &out) {
+  _state = ANSI_TEXT;
+}
+
+Utf8RepairFilter::Utf8RepairFilter() : _carryCount(0) {}
+
+bool Utf8RepairFilter::filter(const Byte *data, size_t count, std::vector<Byte> &out) {
+  size_t i = 0, emitted = 0;
+  bool changed = false;
+  size_t length;
+  if (_carryCount > 0) {
+    // complete the sequence held back by the beginning of this chunk
+    Byte sequence[8];
+    size_t taken = std::min(count, sizeof(_carry) - 1);
+    memcpy(sequence, _carry, _carryCount);
+    memcpy(sequence + _carryCount, data, taken);
+    SequenceStatus status = decodeSequence(sequence, _carryCount + taken, &length);
+    if (status == SEQUENCE_INCOMPLETE) {
+      memcpy(_carry, sequence, length);
+      _carryCount = length;
+      return true;
+    }
+    if (status == SEQUENCE_VALID) {
+      out.insert(out.end(), sequence, sequence + length);
+    } else {
+      appendReplacement(out);
+    }
+    // the bytes held back are always a valid beginning, so the sequence covers all of them
+    i = emitted = length - _carryCount;
+    _carryCount = 0;
+    changed = true;
+  }
+  while (i < count) {
+    if (data[i] < 0x80) {
+      i += asciiPrefix(data + i, count - i);
+      continue;
+    }
+    SequenceStatus status = decodeSequence(data + i, count - i, &length);
+    if (status == SEQUENCE_VALID) {
+      i += length;
+      continue;
+    }
+    out.insert(out.end(), data + emitted, data + i);
+    changed = true;
+    if (status == SEQUENCE_INVALID) {
+      appendReplacement(out);
+    } else {
+      memcpy(_carry, data + i, length);
+      _carryCount = length;
+    }
+    i += length;
+    emitted = i;
+  }
+  if (!changed) {
+    return false;
+  }
+  out.insert(out.end(), data + emitted, data + count);
+  return true;
+}
+
+void Utf8RepairFilter::finish(std::vector<Byte> &out) {
+  if (_carryCount > 0) {
+    appendReplacement(out);
+    _carryCount = 0;
+  }
+}
+
+const char *RedactFilter::MARK = "[REDACTED]";
+
+std::vector<std::string> const& RedactFilter::defaultPatterns() {
+  static const std::vector<std::string> patterns = {
+    "password=", "password: ", "password\": \"", "passwd=", "pwd=",
+    "secret=", "secret: ", "secret\": \"", "secret_key=", "access_key=",
+    "token=", "token: ", "token\": \"", "api_key=", "apikey=", "api-key: ",
+    "bearer ", "authorization: basic ",
+    "AKIA", "ghp_", "gho_", "github_pat_", "xoxb-", "xoxp-",
+  };
+  return patterns;
+}
+
+RedactFilter::RedactFilter(std::vector<std::string> const& patterns) :
+  _automaton([&patterns] {
+    std::vector<AhoCorasick::Pattern> ret;
+    for (std::string const& pattern: patterns) {
+      ret.emplace_back(pattern, 0);
+    }
+    return ret;
+  }(), true),
+  _prefixCount(0),
+  _prefixStarts(nullptr),
+  _state(0),
+  _redacting(false),
+  _marked(false),
+  _redactions(0)
+{
+  // the prefilter takes the first bytes of the patterns, unless any of them is too short
+  std::vector<std::string> prefixes;
+  for (std::string const& pattern: patterns) {
+    if (pattern.empty()) {
+      continue;
+    }
+    if (pattern.size() < PREFIX_LENGTH) {
+      prefixes.clear();
+      break;
+    }
+    std::string prefix = pattern.substr(0, PREFIX_LENGTH);
+    if (std::find(prefixes.begin(), prefixes.end(), prefix) == prefixes.end()) {
+      prefixes.push_back(prefix);
+    }
+  }
+#ifdef __SSE2__
+  if (prefixes.size() <= MAX_PREFILTER_PREFIXES) {
+    for (std::string const& prefix: prefixes) {
+      for (char ch: prefix) {
+        _prefilter.insert(_prefilter.end(), 32, (Byte)(ch | 0x20));
+      }
+    }
+    _prefixCount = prefixes.size();
+    _prefixStarts = prefixStarts;
+#ifdef ML_GRIDENGINE_INGEST_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+      _prefixStarts = prefixStartsAvx2;
+    }
+#endif
+  }
+#endif
+}
+
+size_t RedactFilter::_nextCandidate(const Byte *data, size_t i, size_t count) const {
+#ifdef __SSE2__
+  // the prefixes starting within a block may take the next PREFIX_LENGTH - 1 bytes
+  for (; i + BLOCK_SIZE + PREFIX_LENGTH - 1 <= count; i += BLOCK_SIZE) {
+    uint32_t starts = _prefixStarts(data + i, _prefilter.data(), _prefixCount);
+    if (starts != 0) {
+      return i + __builtin_ctz(starts);
+    }
+  }
+#endif
+  return i;
+}
+
+bool RedactFilter::filter(const Byte *data, size_t count, std::vector<Byte> &out) {
+  size_t i = 0, emitted = 0;
+  bool changed = false;
+  uint32_t state = _state;
+  while (i < count) {
+    if (_redacting) {
+      size_t end = i;
+      while (end < count && !DELIMITER_TABLE.delimiters[data[end]]) {
+        ++end;
+      }
+      if (end > i) {
+        out.insert(out.end(), data + emitted, data + i);
+        if (!_marked) {
+          out.insert(out.end(), MARK, MARK + strlen(MARK));
+          _marked = true;
+          ++_redactions;
+        }
+        emitted = end;
+        changed = true;
+      }
+      i = end;
+      if (end < count) {
+        _redacting = false;
+        state = 0;
+      }
+      continue;
+    }
+    // no pattern is being matched, so the automaton may skip to where a pattern may start
+    if (state == 0 && _prefixCount > 0) {
+      i = _nextCandidate(data, i, count);
+    }
+    // and runs until no pattern is being matched again
+    do {
+      state = _automaton.next(state, data[i++]);
+      if (_automaton.output(state) >= 0) {
+        _redacting = true;
+        _marked = false;
+        break;
+      }
+    } while (i < count && (state != 0 || _prefixCount == 0));
+  }
+  _state = state;
+  if (!changed) {
+    return false;
+  }
+  out.insert(out.end(), data + emitted, data + count);
+  return true;
+}
+
+IngestFilterChain::IngestFilterChain(Sink sink) :
+  _sink(std::move(sink)),
+  _inputBytes(0),
+  _outputBytes(0)
+{
+}
+
+IngestFilterChain::IngestFilterChain(Sink sink, IngestFilterOptions const& options) :
+  IngestFilterChain(std::move(sink))
+{
+  if (options.stripAnsi) {
+    add(new AnsiStripFilter());
+  }
+  if (options.repairUtf8) {
+    add(new Utf8RepairFilter());
+  }
+  if (options.redactSecrets || !options.redactPatterns.empty()) {
+    std::vector<std::string> patterns = options.redactPatterns;
+    if (options.redactSecrets) {
+      patterns.insert(patterns.end(), RedactFilter::defaultPatterns().begin(), RedactFilter::defaultPatterns().end());
+    }
+    add(new RedactFilter(patterns));
+  }
+}
+
+void IngestFilterChain::add(IngestFilter *filter) {
+  _filters.emplace_back(filter);
+}
+
+void IngestFilterChain::_write(size_t first, const Byte *data, size_t count) {
+  int current = -1;   // which buffer holds data, if any
+  for (size_t i=first; i<_filters.size() && count > 0; ++i) {
+    int next = current == 0 ? 1 : 0;
+    std::vector<Byte> &out = _buffers[next];
+    out.clear();
+    if (_filters[i]->filter(data, count, out)) {
+      data = out.data();
+      count = out.size();
+      current = next;
+    }
+  }
+  if (count > 0) {
+    _outputBytes += count;
+    _sink(data, count);
+  }
+}
+
+void IngestFilterChain::write(const Byte *data, size_t count) {
+  _inputBytes += count;
+  _write(0, data, count);
+}
+
+void IngestFilterChain::finish() {
+  std::vector<Byte> held;
+  for (size_t i=0; i<_filters.size(); ++i) {
+    held.clear();
+    _filters[i]->finish(held);
+    _write(i + 1, held.data(), held.size());
+  }
+}
@@ -0,0 +1,186 @@
+#ifndef ML_GRIDENGINE_EXECUTOR_INGESTFILTER_H
+#define ML_GRIDENGINE_EXECUTOR_INGESTFILTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "AhoCorasick.h"
+
+typedef unsigned char Byte;
+
+/**
+ * A stage of {@class IngestFilterChain}, which rewrites the program output before it is buffered.
+ *
+ * The output arrives in arbitrary chunks, so a stage keeps its state across them, and may hold
+ * back the bytes it cannot decide on yet (e.g., half of an escape sequence) until the next chunk.
+ */
+class IngestFilter {
+public:
+  virtual ~IngestFilter() {}
+
+  /** Name of the stage, e.g., "strip-ansi". */
+  virtual const char *name() const = 0;
+
+  /**
+   * Filter a chunk of output.
+   *
+   * @param out Where to append the filtered output.  Left untouched if the chunk passes unchanged.
+   * @return Whether or not the chunk has been changed (or held back), i.e., {@arg out} should be
+   *         passed on instead of the chunk.
+   */
+  virtual bool filter(const Byte *data, size_t count, std::vector<Byte> &out) = 0;
+
+  /** Append the bytes held back to {@arg out}, at the end of the output. */
+  virtual void finish(std::vector<Byte> &out) {}
+};
+
+/**
+ * Strips the ANSI escape sequences, e.g., colours and cursor movements, which are noise for
+ * everything other than a terminal.  CSI ({@code "\x1b[...m"}), OSC ({@code "\x1b]...\x07"}) and
+ * the other two-byte sequences are removed, while the output without ESC passes at the speed of
+ * {@code memchr}.
+ */
+class AnsiStripFilter : public IngestFilter {
+private:
+  int _state;                 // where we are within an escape sequence
+
+public:
+  AnsiStripFilter();
+
+  const char *name() const override { return "strip-ansi"; }
+
+  bool filter(const Byte *data, size_t count, std::vector<Byte> &out) override;
+
+  void finish(std::vector<Byte> &out) override;
+};
+
+/**
+ * Replaces the invalid UTF-8 sequences with U+FFFD, one per maximal invalid subpart as Unicode
+ * recommends, such that the output can always be embedded into JSON.  The blocks of ASCII bytes
+ * are skipped by testing their high bits at once.  A sequence split between two chunks is held
+ * back until it completes.
+ */
+class Utf8RepairFilter : public IngestFilter {
+private:
+  Byte _carry[4];             // incomplete sequence at the end of the last chunk
+  size_t _carryCount;
+
+public:
+  Utf8RepairFilter();
+
+  const char *name() const override { return "repair-utf8"; }
+
+  bool filter(const Byte *data, size_t count, std::vector<Byte> &out) override;
+
+  void finish(std::vector<Byte> &out) override;
+};
+
+/**
+ * Redacts the secrets following a set of key patterns, e.g., {@code "password=hunter2"} becomes
+ * {@code "password=[REDACTED]"}.  The value ends at a whitespace, quote or one of {@code ",;&<>"}.
+ *
+ * The patterns are matched regardless of the ASCII case by an Aho-Corasick automaton.  Since the
+ * automaton takes a lookup per byte, it only runs from where the first three bytes of a pattern
+ * are found by vector comparisons, which skip the blocks without them at once.
+ */
+class RedactFilter : public IngestFilter {
+private:
+  AhoCorasick _automaton;
+  std::vector<Byte> _prefilter;   // first bytes of the patterns, each repeated to fill a vector
+  size_t _prefixCount;            // number of the distinct prefixes, 0 if not prefiltered
+  // positions within a 32-byte block where the prefixes start, by the best vectors of the CPU
+  uint32_t (*_prefixStarts)(const Byte *p, const Byte *rows, size_t prefixCount);
+  uint32_t _state;            // state of the automaton
+  bool _redacting;            // whether or not within a value
+  bool _marked;               // whether or not the current value has been replaced by the mark
+  size_t _redactions;
+
+  /**
+   * The first position at or after {@arg i} where a pattern may start, by the prefilter.  The last
+   * few bytes of the chunk are never skipped.
+   */
+  size_t _nextCandidate(const Byte *data, size_t i, size_t count) const;
+
+public:
+  /** The default patterns, e.g., {@code "password="}, {@code "Bearer "}, {@code "AKIA"}. */
+  static std::vector<std::string> const& defaultPatterns();
+
+  /** What replaces a value. */
+  static const char *MARK;
+
+  explicit RedactFilter(std::vector<std::string> const& patterns = defaultPatterns());
+
+  const char *name() const override { return "redact"; }
+
+  /** Number of values redacted. */
+  inline size_t redactions() const { return _redactions; }
+
+  bool filter(const Byte *data, size_t count, std::vector<Byte> &out) override;
+};
+
+/** Which stages to run on the program output. */
+struct IngestFilterOptions {
+  bool stripAnsi;
+  bool repairUtf8;
+  /** Whether or not to redact the values after {@code RedactFilter::defaultPatterns()}. */
+  bool redactSecrets;
+  /** Extra key patterns to redact. */
+  std::vector<std::string> redactPatterns;
+
+  IngestFilterOptions() : stripAnsi(false), repairUtf8(false), redactSecrets(false) {}
+
+  inline bool enabled() const { return stripAnsi || repairUtf8 || redactSecrets || !redactPatterns.empty(); }
+};
+
+/**
+ * Ingest stage which passes the program output through a chain of {@class IngestFilter}s, in
+ * the order they are added, before it goes on to the other stages and the buffers.
+ *
+ * A chunk which no filter changes is passed on as-is, without being copied.
+ *
+ * This class is not thread-safe.  It is driven by the IO thread of {@class IOController}.
+ */
+class IngestFilterChain {
+public:
+  /** Where the filtered output goes. */
+  typedef std::function<void (const Byte *data, size_t count)> Sink;
+
+private:
+  Sink _sink;
+  std::vector<std::unique_ptr<IngestFilter>> _filters;
+  std::vector<Byte> _buffers[2];  // output of the filters, used in turns
+  size_t _inputBytes;
+  size_t _outputBytes;
+
+  /** Pass {@arg data} through the filters from {@arg first}, and then to the sink. */
+  void _write(size_t first, const Byte *data, size_t count);
+
+public:
+  explicit IngestFilterChain(Sink sink);
+
+  /** Construct the chain of the stages in {@arg options}: stripping, repairing, then redacting. */
+  IngestFilterChain(Sink sink, IngestFilterOptions const& options);
+
+  /** Append {@arg filter} to the chain, which takes its ownership. */
+  void add(IngestFilter *filter);
+
+  inline std::vector<std::unique_ptr<IngestFilter>> const& filters() const { return _filters; }
+
+  /** Number of bytes written into the chain. */
+  inline size_t inputBytes() const { return _inputBytes; }
+
+  /** Number of bytes passed on to the sink. */
+  inline size_t outputBytes() const { return _outputBytes; }
+
+  /** Filter a chunk of output. */
+  void write(const Byte *data, size_t count);
+
+  /** Pass the bytes held back by the filters on, at the end of the output. */
+  void finish();
+};
+
+
+#endif //ML_GRIDENGINE_EXECUTOR_INGESTFILTER_H
@@ -0,0 +1,59 @@
+#include <algorithm>
+#include <string.h>
+#include "LineIndex.h"
+
+size_t LineIndex::firstLine() const {
+  // a line is retained only if all of it is, so line 0 is lost as soon as any byte is trimmed
+  return _begin == 0 ? 0 : _droppedNewlines + 1;
+}
+
+size_t LineIndex::lineCount() const {
+  size_t newlines = _droppedNewlines + _newlines.size();
+  return _end > _lastLineBegin ? newlines + 1 : newlines;
+}
+
+size_t LineIndex::lineBegin(size_t line) const {
+  if (line >= lineCount()) {
+    return _end;
+  }
+  if (line == 0) {
+    return 0;
+  }
+  return _newlines[line - 1 - _droppedNewlines] + 1;
+}
+
+size_t LineIndex::lineAt(size_t position) const {
+  auto it = std::lower_bound(_newlines.begin(), _newlines.end(), position);
+  return _droppedNewlines + (it - _newlines.begin());
+}
+
+void LineIndex::append(const Byte *data, size_t count) {
+  // memchr is vectorized by the C library, which is much faster than a byte-by-byte loop
+  const Byte *p = data, *end = data + count;
+  while (p < end) {
+    const Byte *newline = (const Byte*)memchr(p, '\n', end - p);
+    if (!newline)
+      break;
+    _newlines.push_back(_end + (newline - data));
+    p = newline + 1;
+    _lastLineBegin = _end + (p - data);
+  }
+  _end += count;
+}
+
+void LineIndex::trim(size_t begin) {
+  while (!_newlines.empty() && _newlines.front() + 1 < begin) {
+    _newlines.pop_front();
+    ++_droppedNewlines;
+  }
+  _begin = std::max(_begin, begin);
+}
+
+void LineIndex::fit(size_t maxBytes, size_t limit) {
+  size_t maxNewlines = maxBytes / sizeof(size_t);
+  while (_newlines.size() > maxNewlines && _newlines.front() + 1 < limit) {
+    _begin = std::max(_begin, _newlines.front() + 1);
+    _newlines.pop_front();
+    ++_droppedNewlines;
+  }
+}
@@ -0,0 +1,61 @@
+#ifndef ML_GRIDENGINE_EXECUTOR_LINEINDEX_H
+#define ML_GRIDENGINE_EXECUTOR_LINEINDEX_H
+
+#include <stddef.h>
+#include <deque>
+
+typedef unsigned char Byte;
+
+/**
+ * Incremental index of the newlines in the program output.
+ *
+ * Lines are numbered from zero since the program started.  Line {@code k > 0} begins right
+ * after the {@code k}-th newline, and the last line may not be terminated yet.  The index only
+ * covers the lines beginning at or after the position given to {@code trim}, and its oldest
+ * lines may be dropped earlier by {@code fit} to bound its memory.
+ *
+ * This class is not thread-safe.  {@class OutputBuffer} maintains it under its own lock.
+ */
+class LineIndex {
+private:
+  std::deque<size_t> _newlines;   // positions of the retained newlines
+  size_t _droppedNewlines;        // number of newlines trimmed from the index
+  size_t _begin;                  // position given to the last `trim`
+  size_t _end;                    // number of bytes ever indexed
+  size_t _lastLineBegin;          // beginning position of the last line
+
+public:
+  LineIndex() : _droppedNewlines(0), _begin(0), _end(0), _lastLineBegin(0) {}
+
+  /** Number of bytes ever indexed. */
+  inline size_t end() const { return _end; }
+
+  /** The first line which is completely retained. */
+  size_t firstLine() const;
+
+  /** Number of lines ever indexed, including the last unterminated line. */
+  size_t lineCount() const;
+
+  /**
+   * Beginning position of line {@arg line}.
+   *
+   * @param line The line number, in {@code [firstLine(), lineCount()]}.  For {@code lineCount()},
+   *             the end of the indexed output is returned.
+   */
+  size_t lineBegin(size_t line) const;
+
+  /** The line containing position {@arg position}, which must be at or after {@code lineBegin(firstLine())}. */
+  size_t lineAt(size_t position) const;
+
+  /** Index the newlines in {@arg count} bytes following {@code end()}. */
+  void append(const Byte *data, size_t count);
+
+  /** Drop the lines beginning before {@arg begin}. */
+  void trim(size_t begin);
+
+  /** Drop the oldest lines beginning before {@arg limit}, until the index takes at most {@arg maxBytes}. */
+  void fit(size_t maxBytes, size_t limit);
+};
+
+
+#endif //ML_GRIDENGINE_EXECUTOR_LINEINDEX_H
@@ -0,0 +1,329 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <Poco/Exception.h>
+#include "OutputArchive.h"
+#include "Compression.h"
+
+#define ARCHIVE_MAGIC "MLGEARCH"
+#define ARCHIVE_INDEX_MAGIC "MLGEAIDX"
+#define ARCHIVE_VERSION 1
+#define ARCHIVE_BLOCK_MAGIC 0x4b4c4247U  // "GBLK"
+
+namespace {
+  inline std::string errorMessage() {
+    return std::string(strerror(errno));
+  }
+
+  /** Read exactly {@arg count} bytes at {@arg offset}, or return false. */
+  bool preadFully(int fd, void *target, size_t count, size_t offset) {
+    Byte *p = (Byte*)target;
+    while (count > 0) {
+      ssize_t n = pread(fd, p, count, (off_t)offset);
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      if (n <= 0) {
+        return false;
+      }
+      p += n;
+      offset += n;
+      count -= n;
+    }
+    return true;
+  }
+}
+
+OutputArchiveWriter::OutputArchiveWriter(std::string const& path, size_t blockSize) :
+  _path(path),
+  _fd(::open(path.c_str(), O_CREAT | O_TRUNC | O_WRONLY | O_CLOEXEC, 0644)),
+  _blockSize(std::max(blockSize, (size_t)1)),
+  _pendingBegin(0),
+  _pendingLines(0),
+  _end(0),
+  _lineCount(0),
+  _fileSize(0),
+  _rawBytes(0),
+  _finished(false)
+{
+  if (_fd < 0) {
+    throw Poco::CreateFileException(path + ": " + errorMessage());
+  }
+  ArchiveHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, ARCHIVE_MAGIC, sizeof(header.magic));
+  header.version = ARCHIVE_VERSION;
+  header.blockSize = (uint32_t)_blockSize;
+  try {
+    _write(&header, sizeof(header));
+  } catch (...) {
+    ::close(_fd);
+    throw;
+  }
+}
+
+OutputArchiveWriter::~OutputArchiveWriter() {
+  ::close(_fd);
+}
+
+void OutputArchiveWriter::_write(void const *data, size_t count) {
+  Byte const *p = (Byte const*)data;
+  while (count > 0) {
+    ssize_t n = ::write(_fd, p, count);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      throw Poco::WriteFileException(_path + ": " + errorMessage());
+    }
+    p += n;
+    count -= n;
+    _fileSize += n;
+  }
+}
+
+void OutputArchiveWriter::append(size_t begin, const Byte *data, size_t count) {
+  if (_finished) {
+    throw Poco::IllegalStateException("The output archive has been finished.");
+  }
+  // skip the bytes already appended, and start a new block after the discarded ones
+  if (begin < _end) {
+    size_t overlap = std::min(_end - begin, count);
+    data += overlap;
+    count -= overlap;
+  } else if (begin > _end) {
+    flush();
+    _end = begin;
+  }
+  while (count > 0) {
+    if (_pending.empty()) {
+      _pendingBegin = _end;
+    }
+    size_t n = std::min(count, _blockSize - _pending.size());
+    _pending.insert(_pending.end(), data, data + n);
+    _pendingLines += std::count(data, data + n, '\n');
+    _end += n;
+    _rawBytes += n;
+    data += n;
+    count -= n;
+    if (_pending.size() >= _blockSize) {
+      flush();
+    }
+  }
+}
+
+void OutputArchiveWriter::flush() {
+  if (_pending.empty()) {
+    return;
+  }
+  std::string compressed = Compression::compress(_pending.data(), _pending.size());
+  ArchiveIndexEntry entry;
+  entry.offset = _fileSize;
+  entry.block.magic = ARCHIVE_BLOCK_MAGIC;
+  entry.block.rawSize = (uint32_t)_pending.size();
+  entry.block.compressedSize = (uint32_t)compressed.size();
+  entry.block.lineCount = (uint32_t)_pendingLines;
+  entry.block.begin = _pendingBegin;
+  entry.block.line = _lineCount;
+  _write(&entry.block, sizeof(entry.block));
+  _write(compressed.data(), compressed.size());
+  _index.push_back(entry);
+  _lineCount += _pendingLines;
+  _pending.clear();
+  _pendingLines = 0;
+}
+
+void OutputArchiveWriter::finish() {
+  if (_finished) {
+    return;
+  }
+  flush();
+  ArchiveFooter footer;
+  memset(&footer, 0, sizeof(footer));
+  footer.indexOffset = _fileSize;
+  footer.blockCount = _index.size();
+  footer.end = _end;
+  memcpy(footer.magic, ARCHIVE_INDEX_MAGIC, sizeof(footer.magic));
+  if (!_index.empty()) {
+    _write(_index.data(), _index.size() * sizeof(ArchiveIndexEntry));
+  }
+  _write(&footer, sizeof(footer));
+  _finished = true;
+}
+
+OutputArchiveReader::OutputArchiveReader(std::string const& path) :
+  _fd(::open(path.c_str(), O_RDONLY | O_CLOEXEC)),
+  _complete(false),
+  _end(0),
+  _lineCount(0),
+  _blocksRead(0),
+  _cachedBlock((size_t)-1)
+{
+  if (_fd < 0) {
+    throw Poco::OpenFileException(path + ": " + errorMessage());
+  }
+  try {
+    struct stat st;
+    if (fstat(_fd, &st) != 0) {
+      throw Poco::FileException(path + ": " + errorMessage());
+    }
+    size_t fileSize = (size_t)st.st_size;
+    ArchiveHeader header;
+    if (!preadFully(_fd, &header, sizeof(header), 0) ||
+        memcmp(header.magic, ARCHIVE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != ARCHIVE_VERSION) {
+      throw Poco::DataFormatException("Not an output archive: " + path);
+    }
+
+    // take the index if the archive has completed, or scan the blocks otherwise
+    ArchiveFooter footer;
+    if (fileSize >= sizeof(header) + sizeof(footer) &&
+        preadFully(_fd, &footer, sizeof(footer), fileSize - sizeof(footer)) &&
+        memcmp(footer.magic, ARCHIVE_INDEX_MAGIC, sizeof(footer.magic)) == 0 &&
+        footer.indexOffset + footer.blockCount * sizeof(ArchiveIndexEntry) + sizeof(footer) == fileSize) {
+      std::vector<ArchiveIndexEntry> index(footer.blockCount);
+      if (!index.empty() && !preadFully(_fd, index.data(), index.size() * sizeof(ArchiveIndexEntry), footer.indexOffset)) {
+        throw Poco::ReadFileException(path + ": " + errorMessage());
+      }
+      for (ArchiveIndexEntry const& entry: index) {
+        ArchiveBlock block = {entry.offset, entry.block.begin, entry.block.rawSize, entry.block.compressedSize,
+                              entry.block.line, entry.block.lineCount};
+        _blocks.push_back(block);
+      }
+      _end = footer.end;
+      _complete = true;
+    } else {
+      _scanBlocks(fileSize);
+      _end = _blocks.empty() ? 0 : _blocks.back().begin + _blocks.back().rawSize;
+    }
+    _lineCount = _blocks.empty() ? 0 : _blocks.back().line + _blocks.back().lineCount;
+  } catch (...) {
+    ::close(_fd);
+    throw;
+  }
+}
+
+OutputArchiveReader::~OutputArchiveReader() {
+  ::close(_fd);
+}
+
+void OutputArchiveReader::_scanBlocks(size_t fileSize) {
+  size_t offset = sizeof(ArchiveHeader);
+  ArchiveBlockHeader header;
+  // the last block may be partially written by a live executor
+  while (offset + sizeof(header) <= fileSize && preadFully(_fd, &header, sizeof(header), offset) &&
+         header.magic == ARCHIVE_BLOCK_MAGIC && offset + sizeof(header) + header.compressedSize <= fileSize) {
+    ArchiveBlock block = {offset, header.begin, header.rawSize, header.compressedSize, header.line, header.lineCount};
+    _blocks.push_back(block);
+    offset += sizeof(header) + header.compressedSize;
+  }
+}
+
+size_t OutputArchiveReader::lineCount() {
+  if (_blocks.empty()) {
+    return 0;
+  }
+  std::vector<Byte> const& last = _loadBlock(_blocks.size() - 1);
+  return _lineCount + (last.empty() || last.back() == '\n' ? 0 : 1);
+}
+
+size_t OutputArchiveReader::_findBlock(size_t position) const {
+  auto it = std::upper_bound(_blocks.begin(), _blocks.end(), position, [] (size_t pos, ArchiveBlock const& block) {
+    return pos < block.begin + block.rawSize;
+  });
+  return (size_t)(it - _blocks.begin());
+}
+
+std::vector<Byte> const& OutputArchiveReader::_loadBlock(size_t i) {
+  if (_cachedBlock == i) {
+    return _cache;
+  }
+  ArchiveBlock const& block = _blocks[i];
+  std::vector<Byte> compressed(block.compressedSize);
+  if (!preadFully(_fd, compressed.data(), compressed.size(), block.offset + sizeof(ArchiveBlockHeader))) {
+    throw Poco::ReadFileException("Cannot read the block of output archive: " + errorMessage());
+  }
+  _cachedBlock = (size_t)-1;
+  _cache.resize(block.rawSize);
+  Compression::decompress(compressed.data(), compressed.size(), _cache.data(), block.rawSize);
+  _cachedBlock = i;
+  ++_blocksRead;
+  return _cache;
+}
+
+size_t OutputArchiveReader::_lineBegin(size_t line) {
+  if (line == 0) {
+    return begin();
+  }
+  // the block containing the newline which ends the previous line
+  auto it = std::lower_bound(_blocks.begin(), _blocks.end(), line, [] (ArchiveBlock const& block, size_t n) {
+    return block.line + block.lineCount < n;
+  });
+  if (it == _blocks.end()) {
+    return _end;
+  }
+  size_t i = (size_t)(it - _blocks.begin());
+  std::vector<Byte> const& data = _loadBlock(i);
+  size_t remaining = line - it->line;
+  const Byte *p = data.data(), *end = data.data() + data.size();
+  for (;;) {
+    const Byte *newline = (const Byte*)memchr(p, '\n', end - p);
+    if (!newline) {
+      throw Poco::DataFormatException("The line count of the output archive is corrupted.");
+    }
+    if (--remaining == 0) {
+      return _blocks[i].begin + (newline + 1 - data.data());
+    }
+    p = newline + 1;
+  }
+}
+
+void OutputArchiveReader::scan(size_t begin, size_t count, Consumer const& consumer) {
+  size_t end = begin + std::min(count, (size_t)-1 - begin);
+  for (size_t i = _findBlock(begin); i < _blocks.size() && _blocks[i].begin < end; ++i) {
+    ArchiveBlock const& block = _blocks[i];
+    size_t from = std::max(begin, block.begin);
+    size_t to = std::min(end, block.begin + block.rawSize);
+    std::vector<Byte> const& data = _loadBlock(i);
+    if (!consumer(from, data.data() + (from - block.begin), to - from)) {
+      break;
+    }
+  }
+}
+
+void OutputArchiveReader::scanLines(size_t first, size_t count, Consumer const& consumer) {
+  size_t begin = _lineBegin(first);
+  size_t end = count >= (size_t)-1 - first ? _end : _lineBegin(first + count);
+  if (end > begin) {
+    scan(begin, end - begin, consumer);
+  }
+}
+
+std::string OutputArchiveReader::read(size_t begin, size_t count, size_t *actualBegin) {
+  std::string ret;
+  bool found = false;
+  scan(begin, count, [&ret, &found, actualBegin] (size_t position, const Byte *data, size_t n) {
+    if (!found && actualBegin) {
+      *actualBegin = position;
+    }
+    found = true;
+    ret.append((const char*)data, n);
+    return true;
+  });
+  if (!found && actualBegin) {
+    *actualBegin = std::min(begin, _end);
+  }
+  return ret;
+}
+
+std::string OutputArchiveReader::readLines(size_t first, size_t count) {
+  std::string ret;
+  scanLines(first, count, [&ret] (size_t position, const Byte *data, size_t n) {
+    ret.append((const char*)data, n);
+    return true;
+  });
+  return ret;
+}
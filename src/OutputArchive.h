@@ -0,0 +1,236 @@
+#ifndef ML_GRIDENGINE_EXECUTOR_OUTPUTARCHIVE_H
+#define ML_GRIDENGINE_EXECUTOR_OUTPUTARCHIVE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+typedef unsigned char Byte;
+
+/*
+ * An output archive is a file of independently compressed blocks, followed by an index of the
+ * blocks once the output has completed:
+ *
+ *     ArchiveHeader, (ArchiveBlockHeader, compressed bytes)*, ArchiveIndexEntry*, ArchiveFooter
+ *
+ * Each block holds the output of a range of positions, counted from the very beginning when the
+ * program started, and the number of lines before it.  A reader thus decompresses only the blocks
+ * of the byte or line range it wants.  The blocks are written as the output arrives, so an archive
+ * left without the index (e.g., the executor was killed) can still be read by scanning the blocks.
+ * The lines are counted only by the archived newlines, so once any output has been discarded
+ * before archived, they fall behind the line numbers of the buffer (e.g., "/output/_poll?line=").
+ * All the integers are in the native byte order.
+ */
+
+/** Header at the beginning of an output archive. */
+struct ArchiveHeader {
+  char magic[8];          // "MLGEARCH"
+  uint32_t version;
+  uint32_t blockSize;     // maximum number of raw bytes in a block
+};
+
+/** Header of each compressed block, also copied into the index. */
+struct ArchiveBlockHeader {
+  uint32_t magic;         // ARCHIVE_BLOCK_MAGIC
+  uint32_t rawSize;       // number of bytes before compression
+  uint32_t compressedSize;
+  uint32_t lineCount;     // number of newlines in the block
+  uint64_t begin;         // position of the first byte in the output
+  uint64_t line;          // number of newlines archived before the block, not counting the discarded output
+};
+
+/** Entry of the trailing index. */
+struct ArchiveIndexEntry {
+  uint64_t offset;        // position of the block header in the file
+  ArchiveBlockHeader block;
+};
+
+/** Footer at the end of a completed output archive. */
+struct ArchiveFooter {
+  uint64_t indexOffset;   // position of the first index entry in the file
+  uint64_t blockCount;
+  uint64_t end;           // position after the last archived byte in the output
+  char magic[8];          // "MLGEAIDX"
+};
+
+/**
+ * Writes the output into an archive as it arrives.
+ *
+ * The output is collected until a block is full, or {@code flush} is called, and then the block
+ * is compressed and appended to the file.  A gap in the positions (i.e., output discarded before
+ * archived) also starts a new block.
+ *
+ * This class is not thread-safe.
+ */
+class OutputArchiveWriter {
+private:
+  std::string _path;
+  int _fd;
+  size_t _blockSize;
+  std::vector<ArchiveIndexEntry> _index;
+  std::vector<Byte> _pending;
+  size_t _pendingBegin;
+  size_t _pendingLines;
+  size_t _end;            // position after the last byte appended
+  size_t _lineCount;      // newlines sealed into the blocks
+  size_t _fileSize;
+  size_t _rawBytes;
+  bool _finished;
+
+  void _write(void const *data, size_t count);
+
+public:
+  /**
+   * Create a new archive at {@arg path}, which is truncated.
+   *
+   * @param blockSize Maximum number of raw bytes in a block.
+   * @throws Poco::CreateFileException If the file cannot be created.
+   */
+  explicit OutputArchiveWriter(std::string const& path, size_t blockSize=1024 * 1024);
+
+  /** Close the file.  The archive is left without the index if not finished. */
+  ~OutputArchiveWriter();
+
+  /** Position after the last byte appended. */
+  inline size_t end() const { return _end; }
+
+  /** Number of bytes appended. */
+  inline size_t rawBytes() const { return _rawBytes; }
+
+  /** Size of the archive file. */
+  inline size_t fileSize() const { return _fileSize; }
+
+  /** Number of blocks written. */
+  inline size_t blockCount() const { return _index.size(); }
+
+  /** Number of bytes appended but not written into a block yet. */
+  inline size_t pendingBytes() const { return _pending.size(); }
+
+  /**
+   * Append the output at {@arg begin}.  The positions before {@arg begin} not appended yet are
+   * recorded as discarded.
+   *
+   * @throws Poco::WriteFileException If the file cannot be written.
+   */
+  void append(size_t begin, const Byte *data, size_t count);
+
+  /** Write the bytes appended into a block, such that a reader can see them. */
+  void flush();
+
+  /** Write the last block and the index.  Nothing can be appended afterwards. */
+  void finish();
+};
+
+/** A block of an output archive. */
+struct ArchiveBlock {
+  /** Position of the block header in the file. */
+  size_t offset;
+  /** Position of the first byte in the output. */
+  size_t begin;
+  /** Number of bytes before compression. */
+  size_t rawSize;
+  size_t compressedSize;
+  /** Number of lines archived before the block, not counting the discarded output. */
+  size_t line;
+  /** Number of newlines in the block. */
+  size_t lineCount;
+};
+
+/**
+ * Reads byte or line ranges from an output archive, decompressing only the blocks they touch.
+ *
+ * This class is not thread-safe.
+ */
+class OutputArchiveReader {
+public:
+  /**
+   * Takes the archived bytes at {@arg position}, which are valid only during the call.  The
+   * discarded positions show as a gap between {@arg position} and the end of the previous bytes.
+   *
+   * @return Whether or not to continue.
+   */
+  typedef std::function<bool (size_t position, const Byte *data, size_t count)> Consumer;
+
+private:
+  int _fd;
+  std::vector<ArchiveBlock> _blocks;
+  bool _complete;
+  size_t _end;
+  size_t _lineCount;
+  size_t _blocksRead;
+  // the last decompressed block, since the ranges often share their boundary blocks
+  size_t _cachedBlock;
+  std::vector<Byte> _cache;
+
+  /** Index of the first block ending after {@arg position}, or the number of blocks if none. */
+  size_t _findBlock(size_t position) const;
+
+  /** The decompressed bytes of the block {@arg i}. */
+  std::vector<Byte> const& _loadBlock(size_t i);
+
+  /** Position of the beginning of line {@arg line}, or {@code end()} if not archived. */
+  size_t _lineBegin(size_t line);
+
+  /** Rebuild the index by scanning the blocks, for an archive left without the index. */
+  void _scanBlocks(size_t fileSize);
+
+public:
+  /**
+   * Open the archive at {@arg path}.  The archive may still be written by a live executor.
+   *
+   * @throws Poco::FileException If the file cannot be read.
+   * @throws Poco::DataFormatException If the file is not an output archive.
+   */
+  explicit OutputArchiveReader(std::string const& path);
+
+  ~OutputArchiveReader();
+
+  /** Whether or not the archive has its index, i.e., the output had completed. */
+  inline bool complete() const { return _complete; }
+
+  /** All the blocks, in the order of positions. */
+  inline std::vector<ArchiveBlock> const& blocks() const { return _blocks; }
+
+  /** Position of the first archived byte. */
+  inline size_t begin() const { return _blocks.empty() ? _end : _blocks.front().begin; }
+
+  /** Position after the last archived byte. */
+  inline size_t end() const { return _end; }
+
+  /**
+   * Number of lines archived, including the last line even if not terminated, which takes
+   * decompressing the last block.
+   */
+  size_t lineCount();
+
+  /** Number of blocks having been decompressed. */
+  inline size_t blocksRead() const { return _blocksRead; }
+
+  /**
+   * Read the archived bytes within {@code [begin, begin + count)} block by block, passing them to
+   * {@arg consumer} in the order of positions, without collecting them.
+   */
+  void scan(size_t begin, size_t count, Consumer const& consumer);
+
+  /** Read {@arg count} lines starting from line {@arg first} like {@code scan}, see {@code readLines}. */
+  void scanLines(size_t first, size_t count, Consumer const& consumer);
+
+  /**
+   * Read the archived bytes within {@code [begin, begin + count)}.  The discarded positions
+   * within the range are skipped without any marker, see {@code scan} to find them.
+   *
+   * @param actualBegin If not NULL, gets the position of the first byte read.
+   */
+  std::string read(size_t begin, size_t count, size_t *actualBegin=nullptr);
+
+  /**
+   * Read {@arg count} lines starting from line {@arg first}, counted from zero.  The lines are
+   * counted only by the archived newlines, see {@code ArchiveBlock::line}.
+   */
+  std::string readLines(size_t first, size_t count);
+};
+
+
+#endif //ML_GRIDENGINE_EXECUTOR_OUTPUTARCHIVE_H
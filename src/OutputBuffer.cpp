@@ -5,127 +5,96 @@
 #include <memory>
 #include <algorithm>
 #include <cassert>
+#include <cstdint>
 #include <cstdlib>
-#include <queue>
-#include <boost/heap/pairing_heap.hpp>
-#include <Poco/Condition.h>
+#include <cstring>
 #include <Poco/Mutex.h>
-#include "AutoFreePtr.h"
+#include <Poco/Thread.h>
+#include "RingStore.h"
+#include "OutputHistory.h"
 #include "OutputBuffer.h"
 #include "Logger.h"
+#include "macros.h"
 
 
-namespace {
-  struct ReadRequest {
-    Poco::Condition cond;
-    ReadResult result;
-    Byte* target;
-    size_t count;
-    size_t begin;
-    bool cancelled;
-
-    ReadRequest(size_t begin, Byte* target, size_t count):
-      cond(), result(), begin(begin), target(target), count(count), cancelled(false) {}
-
-    void cancel() {
-      cancelled = true;
-    }
-  };
-
-  typedef std::shared_ptr<ReadRequest> ReadRequestPtr;
-
-  struct ReaderOrdering {
-    bool operator ()(ReadRequestPtr const& left, ReadRequestPtr const& right) const {
-      return left->begin > right->begin;
-    }
-  };
-
-  template <typename T>
-  struct AutoDelete {
-    T* ptr;
-    AutoDelete(T* ptr) : ptr(ptr) {}
-    ~AutoDelete() { delete ptr; }
-    void swap(T** dst) {
-      T* tmp = *dst;
-      *dst = ptr;
-      ptr = tmp;
-    }
-  };
-}
-
-class OutputBuffer::ReaderList {
-  typedef boost::heap::pairing_heap<ReadRequestPtr, boost::heap::compare<ReaderOrdering>> HeapType;
-
-private:
-  HeapType *_heap;
-  size_t _heapSize;
-  size_t _activeCount;
-
-public:
-  ReaderList() : _heap(new HeapType), _heapSize(0), _activeCount(0) {}
-
-  ~ReaderList() { delete _heap; }
-
-  void add(ReadRequestPtr const& ptr) {
-    _heap->push(ptr);
-    ++_heapSize;
-    ++_activeCount;
-  }
-
-  void cancel(ReadRequestPtr const& ptr) {
-    --_activeCount;
-    ptr->cancel();
-    if (_activeCount * 8 < _heapSize && _heapSize > 1000) {
-      AutoDelete<HeapType> newHeap(new HeapType);
-      for (auto const &itm: *_heap) {
-        if (!itm->cancelled) {
-          newHeap.ptr->push(itm);
-        }
-      }
-      newHeap.swap(&_heap);
-      size_t oldHeapSize = _heapSize;
-      _heapSize = _activeCount;
-      Logger::getLogger().info(
-          "Waiting queue for output buffer readers has been re-allocated (%z -> %z).", oldHeapSize, _heapSize);
+OutputBuffer::OutputBuffer(size_t maxCapacity, size_t initialCapacity, OutputBufferReadMode readMode,
+                           OutputBufferStoreType storeType, OutputHistory *history) :
+  _store(nullptr),
+  _buffer(nullptr),
+  _storeType(storeType),
+  _mirrored(false),
+  _capacity(std::min(initialCapacity, maxCapacity)),
+  _maxCapacity(maxCapacity),
+  _capacityLimit(maxCapacity),
+  _releasedEnd(0),
+  _size(0),
+  _head(0),
+  _writtenBytes(0),
+  _history(history),
+  _indexBudget(0),
+  _severityIndexing(false),
+  _headSize(0),
+  _mutex(new Poco::Mutex()),
+  _closed(false),
+  _readMode(readMode),
+  _sequence(0),
+  _lowWatermark(0)
+{
+  if (storeType == MIRRORED_STORE) {
+    // The memory file is not populated until written, so the mirrored store
+    // can be created with the maximum capacity at once.
+    _store = MirroredRingStore::create(maxCapacity);
+    if (!_store) {
+      Logger::getLogger().warn("Mirrored output buffer is not available, fall back to malloc.");
     }
-  }
-
-  void close() {
-    while (!_heap->empty()) {
-      ReadRequestPtr const& itm = _heap->top();
-      itm->result = ReadResult::Closed();
-      itm->cond.signal();
-      _heap->pop();
+  } else if (storeType == RESERVED_STORE) {
+    // Likewise, the reserved pages are not allocated until written.
+    _store = ReservedRingStore::create(maxCapacity);
+    if (!_store) {
+      Logger::getLogger().warn("Reserved output buffer is not available, fall back to malloc.");
     }
-    _heapSize = _activeCount = 0;
   }
-
-  template <typename Function>
-  void process(size_t writtenBytes, Function const& f) {
-    while (!_heap->empty() && _heap->top()->begin < writtenBytes) {
-      ReadRequestPtr const& reader = _heap->top();
-      if (!reader->cancelled) {
-        f(reader);
-        reader->cond.signal();
-        --_activeCount;
-      }
-      _heap->pop();
-      --_heapSize;
-    }
+  if (_store) {
+    _maxCapacity = _capacityLimit = _store->capacity();
+  } else {
+    _store = new MallocRingStore(_capacity);
+    _storeType = MALLOC_STORE;
   }
-};
+  _attachStore(_store);
+  _indexBudget = std::max(_maxCapacity / ML_GRIDENGINE_INDEX_BUDGET_RATIO, (size_t)ML_GRIDENGINE_MIN_INDEX_BUDGET);
+}
 
-OutputBuffer::OutputBuffer(size_t maxCapacity, size_t initialCapacity) :
-  _buffer((Byte*)malloc(maxCapacity)),
-  _capacity(std::min(initialCapacity, maxCapacity)),
-  _maxCapacity(maxCapacity),
+OutputBuffer::OutputBuffer(FileRingStore *store, OutputBufferReadMode readMode, OutputHistory *history) :
+  _store(nullptr),
+  _buffer(nullptr),
+  _storeType(FILE_STORE),
+  _mirrored(false),
+  _capacity(store->capacity()),
+  _maxCapacity(store->capacity()),
+  _capacityLimit(store->capacity()),
+  _releasedEnd(0),
   _size(0),
   _head(0),
   _writtenBytes(0),
+  _history(history),
+  _indexBudget(0),
+  _severityIndexing(false),
+  _headSize(0),
   _mutex(new Poco::Mutex()),
   _closed(false),
-  _readerList(new ReaderList())
+  _readMode(readMode),
+  _sequence(0),
+  _lowWatermark(0)
 {
+  _attachStore(store);
+  _indexBudget = std::max(_maxCapacity / ML_GRIDENGINE_INDEX_BUDGET_RATIO, (size_t)ML_GRIDENGINE_MIN_INDEX_BUDGET);
+}
+
+void OutputBuffer::_attachStore(RingStore *store) {
+  _store = store;
+  _buffer = store->data();
+  _capacity = store->capacity();
+  _mirrored = store->mirrored();
 }
 
 OutputBuffer::~OutputBuffer() {
@@ -133,93 +102,184 @@ OutputBuffer::~OutputBuffer() {
     close();
   }
 
-  delete _readerList;
   delete _mutex;
-  free(_buffer);
-  _readerList = nullptr;
+  delete _store;
+  delete _history;
+  for (RingStore *retired: _retiredStores) {
+    delete retired;
+  }
   _mutex = nullptr;
+  _store = nullptr;
   _buffer = nullptr;
+  _history = nullptr;
 }
 
 void OutputBuffer::_expandBuffer(size_t desiredCapacity) {
-  size_t newCapacity = std::min(std::max(_capacity << 1, desiredCapacity), _maxCapacity);
+  // the memory of a malloc ring is never given back, so it grows no more than the limit
+  size_t newCapacity = std::min(std::max(_capacity << 1, desiredCapacity), _capacityLimit);
   if (newCapacity > _capacity) {
-    AutoFreePtr<Byte> autoFree((Byte*)malloc(newCapacity));
-    if (_head + _size > _capacity) {
-      size_t rightSize = _capacity - _head;
-      std::memcpy(autoFree.ptr, _buffer + _head, rightSize);
-      std::memcpy(autoFree.ptr + rightSize, _buffer, _size - rightSize);
-    } else {
-      std::memcpy(autoFree.ptr, _buffer + _head, _size);
-    }
-    autoFree.swap(&_buffer);
+    RingStore *newStore = new MallocRingStore(newCapacity);
+    _copyFromRing(newStore->data(), _buffer, _capacity, _head, _size);
+    _beginUpdate();
+    // optimistic readers and views may still be pointing to the old store
+    _retiredStores.push_back(_store);
+    _store = newStore;
+    _buffer = newStore->data();
     _capacity = newCapacity;
     _head = 0;
+    _endUpdate();
   }
 }
 
-size_t OutputBuffer::_circularWrite(const Byte *data, size_t count) {
-  size_t room = _capacity - _size;
-  size_t bytesToWrite = std::min(count, room);
-  size_t tail = (_head + _size) % _capacity;
+void OutputBuffer::_circularWrite(size_t tail, const Byte *data, size_t count) {
   size_t rightSize = _capacity - tail;
-
-  if (bytesToWrite <= rightSize) {
-    std::memcpy(_buffer + tail, data, bytesToWrite);
+  if (count <= rightSize || _mirrored) {
+    std::memcpy(_buffer + tail, data, count);
   } else {
     std::memcpy(_buffer + tail, data, rightSize);
-    std::memcpy(_buffer, data + rightSize, bytesToWrite - rightSize);
+    std::memcpy(_buffer, data + rightSize, count - rightSize);
   }
-
-  _size += bytesToWrite;
-  return bytesToWrite;
 }
 
 size_t OutputBuffer::_overwrite(const Byte *data, size_t count) {
-  size_t desiredCapacity = _size + count;
+  size_t desiredCapacity = std::min(_size + count, _capacityLimit);
   if (desiredCapacity > _capacity && _capacity < _maxCapacity) {
     _expandBuffer(desiredCapacity);
   }
 
-  size_t overwrittenLen = 0;
-  if (count >= _capacity) {
-    // When more bytes are to be written than the capacity, we just write the
-    // last `_capacity` bytes into the buffer, starting from the head.
-    overwrittenLen = _size + (count - _capacity);
-    _size = 0;
-    _circularWrite(data + count - _capacity, _capacity);
+  // The ring may retain fewer bytes than its capacity, if the capacity is limited.
+  size_t limit = std::min(_capacityLimit, _capacity);
+  size_t overwrittenLen, keepLen, newHead, newSize, tail;
+  if (count >= limit) {
+    // When more bytes are to be written than the limit, we just write the
+    // last `limit` bytes into the buffer, starting from the tail.
+    overwrittenLen = _size + (count - limit);
+    keepLen = limit;
+    tail = (_head + _size) % _capacity;
+    newHead = tail;
+    newSize = limit;
   } else {
-    // There are fewer bytes than the capacity to be written, so some of
+    // There are fewer bytes than the limit to be written, so some of
     // the bytes already in this buffer will be preserved.  We should calculate
     // how many bytes should be preserved, and how many should be overwritten.
-    size_t preserveLen = _capacity - count;
-    if (preserveLen < _size) {
-      overwrittenLen = _size - preserveLen;
-      _size -= overwrittenLen;
-      _head = (_head + overwrittenLen) % _capacity;
-    }
-    _circularWrite(data, count);
+    size_t preserveLen = limit - count;
+    overwrittenLen = preserveLen < _size ? _size - preserveLen : 0;
+    keepLen = count;
+    newHead = (_head + overwrittenLen) % _capacity;
+    newSize = _size - overwrittenLen + count;
+    tail = (_head + _size) % _capacity;
   }
 
-  _writtenBytes += count;
+  // Move the evicted bytes into the history, then raise the low watermark before touching
+  // any byte, so that optimistic readers copying the evicted region can notice it.
+  size_t newWrittenBytes = _writtenBytes + count;
+  if (_history && overwrittenLen > 0) {
+    size_t ringEvicted = std::min(overwrittenLen, _size);
+    _evictToHistory(_head, ringEvicted);
+    if (overwrittenLen > ringEvicted) {
+      _history->append(data, overwrittenLen - ringEvicted);
+    }
+  }
+  if (overwrittenLen > 0) {
+    _lowWatermark.store(newWrittenBytes - newSize, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    _store->persistValidBegin(newWrittenBytes - newSize);
+  }
+  _circularWrite(tail, data + (count - keepLen), keepLen);
+
+  // Now publish the new contents.
+  _beginUpdate();
+  _head = newHead;
+  _size = newSize;
+  _writtenBytes = newWrittenBytes;
+  _endUpdate();
+  _store->persistPositions(newHead, newSize, newWrittenBytes);
+  if (overwrittenLen > 0 && limit < _capacity) {
+    _releaseEvicted(false);
+  }
   return overwrittenLen;
 }
 
+void OutputBuffer::_releaseEvicted(bool force) {
+  // The slots of the positions in [written - capacity, retained) hold evicted bytes, and
+  // those before `_releasedEnd` have been released already.
+  size_t retained = _writtenBytes - _size;
+  size_t begin = std::max(_releasedEnd, _writtenBytes > _capacity ? _writtenBytes - _capacity : 0);
+  size_t minChunk = std::max((size_t)ML_GRIDENGINE_RELEASE_CHUNK_SIZE, _capacityLimit >> 3);
+  if (begin >= retained || (!force && retained - begin < minChunk)) {
+    return;
+  }
+  size_t length = retained - begin;
+  size_t slot = (_head + _capacity - length) % _capacity;
+  size_t rightSize = _capacity - slot;
+  if (length <= rightSize) {
+    _store->releaseRange(slot, length);
+  } else {
+    _store->releaseRange(slot, rightSize);
+    _store->releaseRange(0, length - rightSize);
+  }
+  _releasedEnd = retained;
+}
+
+void OutputBuffer::_trimIndices() {
+  size_t retained = _writtenBytes - _size;
+  if (_history) {
+    retained = std::min(_history->begin(), retained);
+  }
+  _lineIndex.trim(retained);
+  _streamIndex.trim(retained);
+  _timeIndex.trim(retained);
+  _repeatIndex.trim(retained);
+
+  // the indices of the history are bounded, while those of the circular buffer are bounded by it
+  size_t ringBegin = _writtenBytes - _size;
+  _lineIndex.fit(_indexBudget / 2, ringBegin);
+  _streamIndex.fit(_indexBudget / 4, ringBegin);
+  _repeatIndex.fit(_indexBudget / 4, ringBegin);
+  if (_searchIndex) {
+    _searchIndex->trim(retained);
+  }
+}
+
+void OutputBuffer::_flushHistory() {
+  if (_history) {
+    size_t begin = _history->begin();
+    _history->flush();
+    if (_history->begin() != begin) {
+      // the history may drop its oldest bytes when flushed, and the indices are trimmed with it
+      Poco::Mutex::ScopedLock scopedLock(*_mutex);
+      _trimIndices();
+    }
+  }
+}
+
+void OutputBuffer::_evictToHistory(size_t front, size_t count) {
+  size_t rightSize = _capacity - front;
+  if (count <= rightSize || _mirrored) {
+    _history->append(_buffer + front, count);
+  } else {
+    _history->append(_buffer + front, rightSize);
+    _history->append(_buffer, count - rightSize);
+  }
+}
+
+void OutputBuffer::_copyFromRing(Byte *target, Byte const *buffer, size_t capacity, size_t front,
+                                 size_t count) const {
+  size_t rightSize = capacity - front;
+  if (count <= rightSize || _mirrored) {
+    std::memcpy(target, buffer + front, count);
+  } else {
+    std::memcpy(target, buffer + front, rightSize);
+    std::memcpy(target + rightSize, buffer, count - rightSize);
+  }
+}
+
 size_t OutputBuffer::_circularRead(Byte *target, size_t count, size_t start) {
-  start = std::max(start, (size_t)0);
   size_t readSize;
 
   if (_size > start) {
     readSize = std::min(count, _size - start);
-    size_t front = (_head + start) % _capacity;
-    size_t rightSize = _capacity - front;
-
-    if (readSize <= rightSize) {
-      std::memcpy(target, _buffer + front, readSize);
-    } else {
-      std::memcpy(target, _buffer + front, rightSize);
-      std::memcpy(target + rightSize, _buffer, readSize - rightSize);
-    }
+    _copyFromRing(target, _buffer, _capacity, (_head + start) % _capacity, readSize);
   } else {
     readSize = 0;
   }
@@ -227,27 +287,215 @@ size_t OutputBuffer::_circularRead(Byte *target, size_t count, size_t start) {
   return readSize;
 }
 
-void OutputBuffer::write(const void *data, size_t count) {
-  Poco::Mutex::ScopedLock scopedLock(*_mutex);
-
-  if (_closed) {
-    throw Poco::IllegalStateException("The buffer has been closed.");
+void OutputBuffer::_appendIndexed(const Byte *data, size_t count, ProgramStream stream, int64_t now) {
+  // the head is copied before the bytes are published by the ring
+  size_t headSize = _headSize.load(std::memory_order_relaxed);
+  if (headSize < _headBytes.size() && _writtenBytes == headSize) {
+    size_t n = std::min(count, _headBytes.size() - headSize);
+    std::memcpy(_headBytes.data() + headSize, data, n);
+    _headSize.store(headSize + n, std::memory_order_release);
   }
 
   // write data into the buffer, potentially overwriting the existing contents
-  size_t oldWrittenBytes = _writtenBytes;
-  _overwrite((Byte*)data, count);
+  _overwrite(data, count);
+
+  // index the new lines, streams and time, and forget those which can no longer be read
+  _lineIndex.append(data, count);
+  _streamIndex.append(stream, count);
+  _timeIndex.append(count, now);
+  if (_severityIndexing) {
+    _severityIndex.append(data, count);
+  }
+  if (_searchIndex) {
+    _searchIndex->append(data, count);
+  }
+  _trimIndices();
+}
+
+size_t OutputBuffer::_durableBegin() const {
+  size_t begin = _writtenBytes;
+  for (auto const& it: _backpressure.consumers) {
+    begin = std::min(begin, it.second.begin);
+  }
+  return begin;
+}
+
+bool OutputBuffer::_detachIdleConsumers(int64_t now) {
+  bool detached = false;
+  for (auto it = _backpressure.consumers.begin(); it != _backpressure.consumers.end(); ) {
+    DurableConsumer const& consumer = it->second;
+    if (consumer.idleTimeout > 0 && now - consumer.lastAdvance > consumer.idleTimeout) {
+      Logger::getLogger().warn("Durable consumer %z has been idle at %z for too long, detach it.",
+                               it->first, consumer.begin);
+      it = _backpressure.consumers.erase(it);
+      detached = true;
+    } else {
+      ++it;
+    }
+  }
+  return detached;
+}
+
+size_t OutputBuffer::_waitForRoom() {
+  int64_t blockedSince = -1;
+  for (;;) {
+    if (!_backpressure.enabled || _backpressure.consumers.empty()) {
+      break;
+    }
+    size_t taken = _writtenBytes - _durableBegin();
+    size_t room = taken < _capacityLimit ? _capacityLimit - taken : 0;
+    if (room > 0) {
+      if (blockedSince >= 0) {
+        int64_t blocked = TimeIndex::now() - blockedSince;
+        BackpressureStatistics &stats = _backpressure.statistics;
+        ++stats.blockedWrites;
+        stats.blockedMicros += blocked;
+        stats.maxBlockedMicros = std::max(stats.maxBlockedMicros, blocked);
+      }
+      return room;
+    }
+    int64_t now = TimeIndex::now();
+    if (blockedSince < 0) {
+      blockedSince = now;
+    }
+    if (_detachIdleConsumers(now)) {
+      continue;
+    }
+
+    // The durable consumers cannot advance without the mutex, so the condition is stable
+    // between `prepareWait` and releasing the mutex.  The pieces written so far must be
+    // announced, otherwise the durable consumers may never wake up to take them.  Consumers
+    // with an idle timeout are checked again every second.
+    bool idleTimeout = false;
+    for (auto const& it: _backpressure.consumers) {
+      idleTimeout = idleTimeout || it.second.idleTimeout > 0;
+    }
+    EventCount::Key key = _durableEventCount.prepareWait();
+    _mutex->unlock();
+    _eventCount.notifyAll();
+    _durableEventCount.wait(key, EventCount::Deadline::after(idleTimeout ? 1000 : 0));
+    _mutex->lock();
+  }
+  return SIZE_MAX;
+}
+
+void OutputBuffer::_append(const Byte *data, size_t count, ProgramStream stream, int64_t now) {
+  while (count > 0) {
+    size_t n = std::min(count, _waitForRoom());
+    _appendIndexed(data, n, stream, now);
+    data += n;
+    count -= n;
+  }
+}
+
+void OutputBuffer::_appendDeduplicated(const Byte *data, size_t count, ProgramStream stream, int64_t now) {
+  Deduplication &d = _dedup;
+  const Byte *p = data, *end = data + count;
+  const Byte *unwritten = p;  // beginning of the bytes to be written as-is
+  while (p < end) {
+    if (d.atLineStart && !d.lastLine.empty()) {
+      // compare the held back bytes and the new ones with the last line
+      size_t offset = d.pending.size();
+      size_t n = std::min((size_t)(end - p), d.lastLine.size() - offset);
+      if (stream == d.lastStream && memcmp(p, d.lastLine.data() + offset, n) == 0) {
+        _append(unwritten, p - unwritten, stream, now);
+        d.pending.append((const char*)p, n);
+        if (d.pending.size() == d.lastLine.size()) {
+          ++d.repeats;
+          d.pending.clear();
+        }
+        p += n;
+        unwritten = p;
+        continue;
+      }
+
+      // not a repeat, so the run ends and the held back bytes start the current line
+      d.currentLine = d.pending;
+      d.currentTooLong = false;
+      _endRepeats(now);
+      d.atLineStart = false;
+    }
+
+    // the bytes till the end of the current line are written as-is
+    const Byte *newline = (const Byte*)memchr(p, '\n', end - p);
+    const Byte *lineEnd = newline ? newline + 1 : end;
+    if (!d.currentTooLong) {
+      if (d.currentLine.size() + (lineEnd - p) <= ML_GRIDENGINE_DEDUP_MAX_LINE_BYTES) {
+        d.currentLine.append((const char*)p, lineEnd - p);
+      } else {
+        d.currentLine.clear();
+        d.currentTooLong = true;
+      }
+    }
+    d.atLineStart = newline != nullptr;
+    if (newline) {
+      d.lastLine.swap(d.currentLine);
+      d.lastStream = stream;
+      d.currentLine.clear();
+      d.currentTooLong = false;
+    }
+    p = lineEnd;
+  }
+  _append(unwritten, p - unwritten, stream, now);
+}
+
+void OutputBuffer::_endRepeats(int64_t now) {
+  Deduplication &d = _dedup;
+  if (d.repeats > 0) {
+    _repeatIndex.append(_writtenBytes, d.lastLine, d.repeats);
+    d.repeats = 0;
+  }
+  if (!d.pending.empty()) {
+    _append((const Byte*)d.pending.data(), d.pending.size(), d.lastStream, now);
+    d.pending.clear();
+  }
+}
+
+void OutputBuffer::write(const void *data, size_t count, ProgramStream stream) {
+  int64_t now = TimeIndex::now();
+  {
+    Poco::Mutex::ScopedLock scopedLock(*_mutex);
+
+    if (_closed) {
+      throw Poco::IllegalStateException("The buffer has been closed.");
+    }
+    if (_dedup.enabled) {
+      _appendDeduplicated((const Byte*)data, count, stream, now);
+    } else {
+      _append((const Byte*)data, count, stream, now);
+    }
+  }
 
-  // wake up all waiting readers
-  _readerList->process(_writtenBytes, [&] (ReadRequestPtr const& reader) {
-    assert(reader->begin >= oldWrittenBytes);
-    size_t itmCount = std::min(reader->count, _writtenBytes - reader->begin);
-    reader->result = ReadResult(reader->begin, itmCount);
-    memcpy(reader->target, (Byte*)data + (reader->begin - oldWrittenBytes), itmCount);
-  });
+  // Wake up all waiting readers after leaving the critical section.  Each of them copies its
+  // own contents, so the cost of the writer does not grow with the number of readers.
+  _eventCount.notifyAll();
+
+  // the evicted bytes are stored without blocking the readers, who may read them meanwhile
+  _flushHistory();
+}
+
+ReadResult OutputBuffer::_tryReadHead(size_t begin, void *target, size_t count) const {
+  size_t headSize = _headSize.load(std::memory_order_acquire);
+  if (begin < headSize) {
+    size_t n = std::min(count, headSize - begin);
+    std::memcpy(target, _headBytes.data() + begin, n);
+    return ReadResult(begin, n);
+  }
+  return ReadResult::Timeout();
 }
 
 ReadResult OutputBuffer::_tryRead(size_t begin, void *target, size_t count) {
+  ReadResult headResult = _tryReadHead(begin, target, count);
+  if (!headResult.isTimeout) {
+    return headResult;
+  }
+  if (_history && begin < _writtenBytes - _size) {
+    size_t historyBegin = std::max(begin, _history->begin());
+    size_t historyCount = _history->read(historyBegin, (Byte*)target, count);
+    if (historyCount > 0) {
+      return ReadResult(historyBegin, historyCount);
+    }
+  }
   if (begin < _writtenBytes) {
     // if begin < writtenBytes, return the available bytes immediately
     size_t minBegin = _writtenBytes - _size;
@@ -262,43 +510,485 @@ ReadResult OutputBuffer::_tryRead(size_t begin, void *target, size_t count) {
   }
 }
 
+OutputBuffer::Snapshot OutputBuffer::_snapshotOptimistic() const {
+  for (;;) {
+    size_t sequence = _sequence.load(std::memory_order_acquire);
+    if (sequence & 1) {
+      Poco::Thread::yield();
+      continue;
+    }
+    Snapshot ret = _snapshotLocked();
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (_sequence.load(std::memory_order_relaxed) == sequence) {
+      return ret;
+    }
+  }
+}
+
+ReadResult OutputBuffer::_tryReadOptimistic(ssize_t begin, void *target, size_t count) {
+  for (;;) {
+    Snapshot snapshot = _snapshotOptimistic();
+    size_t positiveBegin = snapshot.positiveBegin(begin);
+    ReadResult headResult = _tryReadHead(positiveBegin, target, count);
+    if (!headResult.isTimeout) {
+      return headResult;
+    }
+    if (_history && positiveBegin < snapshot.writtenBytes - snapshot.size) {
+      // the history covers everything evicted before the snapshot
+      size_t historyBegin = std::max(positiveBegin, _history->begin());
+      size_t historyCount = _history->read(historyBegin, (Byte*)target, count);
+      if (historyCount > 0) {
+        return ReadResult(historyBegin, historyCount);
+      }
+    }
+    size_t actualBegin = snapshot.actualBegin(begin);
+    if (actualBegin >= snapshot.writtenBytes) {
+      return snapshot.closed ? ReadResult::Closed() : ReadResult::Timeout();
+    }
+    size_t readSize = std::min(count, snapshot.writtenBytes - actualBegin);
+    _copyFromRing((Byte*)target, snapshot.buffer, snapshot.capacity, snapshot.ringPosition(actualBegin), readSize);
+
+    // the copy is valid only if none of the bytes have been overwritten during the copy
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (_lowWatermark.load(std::memory_order_relaxed) <= actualBegin) {
+      return ReadResult(actualBegin, readSize);
+    }
+  }
+}
+
 ReadResult OutputBuffer::read(ssize_t begin, void *target, size_t count, long timeout) {
+  // Translate the negative position only once, such that the reader waits for a fixed position.
+  if (begin < 0) {
+    Poco::Mutex::ScopedLock scopedLock(*_mutex);
+    begin = (ssize_t)translateNegativeBegin(begin);
+  }
+
+  EventCount::Deadline deadline = EventCount::Deadline::after(timeout);
+  for (;;) {
+    EventCount::Key key = _eventCount.prepareWait();
+    ReadResult result = tryRead(begin, target, count);
+    if (!result.isTimeout) {
+      _eventCount.cancelWait();
+      return result;
+    }
+    if (!_eventCount.wait(key, deadline)) {
+      return ReadResult::Timeout();
+    }
+  }
+}
+
+ReadResult OutputBuffer::tryRead(ssize_t begin, void *target, size_t count) {
+  if (_readMode == OPTIMISTIC_READ) {
+    return _tryReadOptimistic(begin, target, count);
+  }
   Poco::Mutex::ScopedLock scopedLock(*_mutex);
-  size_t positiveBegin = translateNegativeBegin(begin);
-  ReadResult result = _tryRead(positiveBegin, target, count);
+  return _tryRead(translateNegativeBegin(begin), target, count);
+}
+
+ReadResult OutputBuffer::wait(ssize_t begin, long timeout) {
+  Byte dummy;
+  return read(begin, &dummy, 0, timeout);
+}
 
-  if (!result.isTimeout) {
-    return result;
+OutputView OutputBuffer::peek(ssize_t begin, size_t count) {
+  Snapshot snapshot;
+  if (_readMode == OPTIMISTIC_READ) {
+    snapshot = _snapshotOptimistic();
   } else {
-    std::shared_ptr<ReadRequest> reader(new ReadRequest(positiveBegin, (Byte *) target, count));
-    _readerList->add(reader);
-    if (timeout <= 0) {
-      reader->cond.wait(*_mutex);
-    } else {
-      try {
-        reader->cond.wait(*_mutex, timeout);
-      } catch (Poco::TimeoutException const&) {
-        _readerList->cancel(reader);
-        return ReadResult::Timeout();
-      } catch (...) {
-        _readerList->cancel(reader);
-        throw;
+    Poco::Mutex::ScopedLock scopedLock(*_mutex);
+    snapshot = _snapshotLocked();
+  }
+
+  OutputView view;
+  size_t positiveBegin = snapshot.positiveBegin(begin);
+  size_t headSize = _headSize.load(std::memory_order_acquire);
+  if (positiveBegin < headSize) {
+    view.begin = positiveBegin;
+    view.count = std::min(count, headSize - positiveBegin);
+    view.segments[0].iov_base = _headBytes.data() + positiveBegin;
+    view.segments[0].iov_len = view.count;
+    view.segmentCount = view.count > 0 ? 1 : 0;
+    return view;
+  }
+  size_t ringBegin = snapshot.writtenBytes - snapshot.size;
+  if (_history && positiveBegin < ringBegin) {
+    size_t historyBegin = std::max(positiveBegin, _history->begin());
+    if (historyBegin < ringBegin) {
+      view.isHistory = true;
+      view.begin = historyBegin;
+      view.count = std::min(count, ringBegin - historyBegin);
+      return view;
+    }
+  }
+
+  size_t actualBegin = snapshot.actualBegin(begin);
+  if (actualBegin >= snapshot.writtenBytes) {
+    view.isClosed = snapshot.closed;
+    view.isTimeout = !snapshot.closed;
+    return view;
+  }
+
+  view.begin = actualBegin;
+  view.count = std::min(count, snapshot.writtenBytes - actualBegin);
+  size_t front = snapshot.ringPosition(actualBegin);
+  size_t rightSize = snapshot.capacity - front;
+  view.segments[0].iov_base = snapshot.buffer + front;
+  if (view.count <= rightSize || _mirrored) {
+    view.segments[0].iov_len = view.count;
+    view.segmentCount = view.count > 0 ? 1 : 0;
+  } else {
+    view.segments[0].iov_len = rightSize;
+    view.segments[1].iov_base = snapshot.buffer;
+    view.segments[1].iov_len = view.count - rightSize;
+    view.segmentCount = 2;
+  }
+  return view;
+}
+
+size_t OutputBuffer::retainedBegin() const {
+  Poco::Mutex::ScopedLock scopedLock(*_mutex);
+  size_t ringBegin = _writtenBytes - _size;
+  if (_history) {
+    return std::min(_history->begin(), ringBegin);
+  }
+  return ringBegin;
+}
+
+void OutputBuffer::setHeadRetention(size_t size) {
+  Poco::Mutex::ScopedLock scopedLock(*_mutex);
+  if (_writtenBytes > 0) {
+    throw Poco::IllegalStateException("Head retention must be set before writing.");
+  }
+  _headBytes.resize(size);
+}
+
+size_t OutputBuffer::capacityLimit() const {
+  Poco::Mutex::ScopedLock scopedLock(*_mutex);
+  return _capacityLimit;
+}
+
+size_t OutputBuffer::ringCapacity() const {
+  Poco::Mutex::ScopedLock scopedLock(*_mutex);
+  return _capacity;
+}
+
+size_t OutputBuffer::setCapacityLimit(size_t limit) {
+  bool raised;
+  {
+    Poco::Mutex::ScopedLock scopedLock(*_mutex);
+    limit = std::min(std::max(limit, (size_t)1), _maxCapacity);
+    if (_backpressure.enabled && !_backpressure.consumers.empty()) {
+      // the bytes not yet taken by the durable consumers must never be evicted
+      limit = std::max(limit, _writtenBytes - _durableBegin());
+    }
+    raised = limit > _capacityLimit;
+    _capacityLimit = limit;
+
+    if (_size > limit) {
+      size_t evicted = _size - limit;
+      if (_history) {
+        _evictToHistory(_head, evicted);
       }
+      _lowWatermark.store(_writtenBytes - limit, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      _store->persistValidBegin(_writtenBytes - limit);
+      _beginUpdate();
+      _head = (_head + evicted) % _capacity;
+      _size = limit;
+      _endUpdate();
+      _store->persistPositions(_head, _size, _writtenBytes);
+      _trimIndices();
+    }
+    if (limit < _capacity) {
+      _releaseEvicted(true);
     }
-    return reader->result;
   }
+  if (raised) {
+    // the writer may be waiting for room in the lossless mode
+    _durableEventCount.notifyAll();
+  }
+  _flushHistory();
+  return limit;
 }
 
-ReadResult OutputBuffer::tryRead(ssize_t begin, void *target, size_t count) {
+void OutputBuffer::setLossless(bool enabled) {
   Poco::Mutex::ScopedLock scopedLock(*_mutex);
-  return _tryRead(translateNegativeBegin(begin), target, count);
+  if (_writtenBytes > 0) {
+    throw Poco::IllegalStateException("Lossless mode must be set before writing.");
+  }
+  _backpressure.enabled = enabled;
 }
 
-void OutputBuffer::close() {
+size_t OutputBuffer::attachDurableConsumer(size_t position, long idleTimeoutMillis) {
   Poco::Mutex::ScopedLock scopedLock(*_mutex);
+  DurableConsumer consumer;
+  consumer.begin = std::min(std::max(position, _writtenBytes - _size), _writtenBytes);
+  consumer.lastAdvance = TimeIndex::now();
+  consumer.idleTimeout = idleTimeoutMillis * 1000L;
+  size_t id = _backpressure.nextConsumerId++;
+  _backpressure.consumers[id] = consumer;
+  return id;
+}
 
-  if (!_closed) {
-    _readerList->close();
+bool OutputBuffer::durableConsumerAttached(size_t id) const {
+  Poco::Mutex::ScopedLock scopedLock(*_mutex);
+  return _backpressure.consumers.count(id) > 0;
+}
+
+size_t OutputBuffer::durableBegin() const {
+  Poco::Mutex::ScopedLock scopedLock(*_mutex);
+  return _durableBegin();
+}
+
+void OutputBuffer::advanceDurable(size_t id, size_t position) {
+  {
+    Poco::Mutex::ScopedLock scopedLock(*_mutex);
+    auto it = _backpressure.consumers.find(id);
+    if (it == _backpressure.consumers.end()) {
+      return;
+    }
+    DurableConsumer &consumer = it->second;
+    consumer.lastAdvance = TimeIndex::now();
+    position = std::min(position, _writtenBytes);
+    if (position <= consumer.begin) {
+      return;
+    }
+    consumer.begin = position;
+  }
+  _durableEventCount.notifyAll();
+}
+
+void OutputBuffer::detachDurableConsumer(size_t id) {
+  {
+    Poco::Mutex::ScopedLock scopedLock(*_mutex);
+    _backpressure.consumers.erase(id);
+  }
+  _durableEventCount.notifyAll();
+}
+
+BackpressureStatistics OutputBuffer::backpressureStatistics() const {
+  Poco::Mutex::ScopedLock scopedLock(*_mutex);
+  return _backpressure.statistics;
+}
+
+void OutputBuffer::setDeduplicateLines(bool enabled) {
+  Poco::Mutex::ScopedLock scopedLock(*_mutex);
+  if (_writtenBytes > 0) {
+    throw Poco::IllegalStateException("Line deduplication must be set before writing.");
+  }
+  _dedup.enabled = enabled;
+}
+
+void OutputBuffer::setSeverityIndexing(bool enabled) {
+  Poco::Mutex::ScopedLock scopedLock(*_mutex);
+  if (_writtenBytes > 0) {
+    throw Poco::IllegalStateException("Severity indexing must be set before writing.");
+  }
+  _severityIndexing = enabled;
+}
+
+void OutputBuffer::setIndexBudget(size_t bytes) {
+  Poco::Mutex::ScopedLock scopedLock(*_mutex);
+  _indexBudget = bytes;
+  _trimIndices();
+}
+
+void OutputBuffer::setSearchIndexing(size_t maxSize) {
+  Poco::Mutex::ScopedLock scopedLock(*_mutex);
+  if (_writtenBytes > 0) {
+    throw Poco::IllegalStateException("Search indexing must be set before writing.");
+  }
+  _searchIndex.reset(maxSize > 0 ?
+      new SearchIndex(maxSize, ML_GRIDENGINE_SEARCH_BLOCK_SIZE, ML_GRIDENGINE_SEARCH_FILTER_SIZE) : nullptr);
+}
+
+std::vector<SeverityEntry> OutputBuffer::severityEntries(unsigned mask, size_t limit) const {
+  Poco::Mutex::ScopedLock scopedLock(*_mutex);
+  return _severityIndex.entries(mask, limit);
+}
+
+size_t OutputBuffer::severityCount(Severity severity) const {
+  Poco::Mutex::ScopedLock scopedLock(*_mutex);
+  return _severityIndex.count(severity);
+}
+
+std::vector<LineRange> OutputBuffer::searchCandidates(std::string const &literal, size_t begin, size_t end,
+                                                      size_t span, size_t *next) const {
+  Poco::Mutex::ScopedLock scopedLock(*_mutex);
+  std::vector<LineRange> ret;
+  size_t firstLine = _lineIndex.firstLine();
+  begin = std::max(begin, _lineIndex.lineBegin(firstLine));
+  end = std::min(end, _lineIndex.end());
+  if (begin >= end) {
+    *next = std::max(begin, end);
+    return ret;
+  }
+
+  // look up the whole lines within about `span` bytes, such that the writer is never blocked for long
+  size_t to = end;
+  if (span < end - begin) {
+    size_t line = _lineIndex.lineAt(begin + span);
+    to = _lineIndex.lineBegin(line);
+    if (to <= begin) {
+      to = std::min(_lineIndex.lineBegin(line + 1), end);
+    }
+  }
+  *next = to;
+
+  std::vector<SearchCandidate> candidates;
+  if (_searchIndex) {
+    candidates = _searchIndex->candidates(literal, begin, to);
+  } else {
+    candidates.emplace_back(begin, to);
+  }
+
+  // the candidate ranges are extended to whole lines, which may join some of them
+  for (SearchCandidate const& candidate: candidates) {
+    size_t line = _lineIndex.lineAt(candidate.first);
+    size_t lineEnd = _lineIndex.lineAt(candidate.second - 1) + 1;
+    if (!ret.empty() && line < ret.back().line + ret.back().count) {
+      LineRange &last = ret.back();
+      last.count = lineEnd - last.line;
+      last.end = _lineIndex.lineBegin(lineEnd);
+      continue;
+    }
+    LineRange range;
+    range.line = line;
+    range.count = lineEnd - line;
+    range.begin = _lineIndex.lineBegin(line);
+    range.end = _lineIndex.lineBegin(lineEnd);
+    ret.push_back(range);
+  }
+  return ret;
+}
+
+SearchIndexStatistics OutputBuffer::searchIndexStatistics() const {
+  Poco::Mutex::ScopedLock scopedLock(*_mutex);
+  return _searchIndex ? _searchIndex->statistics() : SearchIndexStatistics();
+}
+
+LineRange OutputBuffer::lines(ssize_t line, size_t count) const {
+  Poco::Mutex::ScopedLock scopedLock(*_mutex);
+  size_t firstLine = _lineIndex.firstLine();
+  size_t lineCount = _lineIndex.lineCount();
+
+  LineRange range;
+  if (line < 0) {
+    range.line = (size_t)-line < lineCount ? lineCount + line : 0;
+  } else {
+    range.line = (size_t)line;
+  }
+  range.line = std::min(std::max(range.line, firstLine), lineCount);
+  size_t lineEnd = lineCount;
+  if (count > 0) {
+    lineEnd = std::min(lineEnd, range.line + count);
+  }
+  range.count = lineEnd - range.line;
+  range.begin = _lineIndex.lineBegin(range.line);
+  range.end = _lineIndex.lineBegin(lineEnd);
+  return range;
+}
+
+size_t OutputBuffer::streamWrittenBytes(ProgramStream stream) const {
+  Poco::Mutex::ScopedLock scopedLock(*_mutex);
+  return _streamIndex.writtenBytes(stream);
+}
+
+StreamSpan OutputBuffer::streamSpan(ProgramStream stream, size_t offset) const {
+  Poco::Mutex::ScopedLock scopedLock(*_mutex);
+  return _streamIndex.locate(stream, offset);
+}
+
+size_t OutputBuffer::positionSince(int64_t time) const {
+  Poco::Mutex::ScopedLock scopedLock(*_mutex);
+  return _timeIndex.positionSince(time);
+}
+
+size_t OutputBuffer::positionUntil(int64_t time) const {
+  Poco::Mutex::ScopedLock scopedLock(*_mutex);
+  return _timeIndex.positionUntil(time);
+}
+
+int64_t OutputBuffer::timeAt(size_t position) const {
+  Poco::Mutex::ScopedLock scopedLock(*_mutex);
+  return _timeIndex.timeAt(position);
+}
+
+size_t OutputBuffer::repeatedLines() const {
+  Poco::Mutex::ScopedLock scopedLock(*_mutex);
+  return _repeatIndex.repeatedLines() + _dedup.repeats;
+}
+
+size_t OutputBuffer::repeatedBytes() const {
+  Poco::Mutex::ScopedLock scopedLock(*_mutex);
+  return _repeatIndex.repeatedBytes() + _dedup.repeats * _dedup.lastLine.size();
+}
+
+size_t OutputBuffer::repeatPosition(RepeatMode mode, size_t position) const {
+  Poco::Mutex::ScopedLock scopedLock(*_mutex);
+  return _repeatIndex.position(mode, position);
+}
+
+size_t OutputBuffer::repeatWrittenBytes(RepeatMode mode) const {
+  Poco::Mutex::ScopedLock scopedLock(*_mutex);
+  return _writtenBytes + _repeatIndex.extraBytes(mode);
+}
+
+RepeatSpan OutputBuffer::repeatSpan(RepeatMode mode, size_t position, size_t maxCount) const {
+  Poco::Mutex::ScopedLock scopedLock(*_mutex);
+  return _repeatIndex.locate(mode, position, maxCount);
+}
+
+void OutputBuffer::releaseMemory() {
+  {
+    Poco::Mutex::ScopedLock scopedLock(*_mutex);
+    // the ring file is kept for the recovery and the local readers, so its contents stay
+    if (_storeType == FILE_STORE) {
+      return;
+    }
+    if (_history && _size > 0) {
+      _evictToHistory(_head, _size);
+    }
+
+    // invalidate the views and optimistic copies before the memory is gone
+    _lowWatermark.store(_writtenBytes, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    _store->persistValidBegin(_writtenBytes);
+    _store->release();
+    for (RingStore *retired: _retiredStores) {
+      retired->release();
+    }
+
+    _beginUpdate();
+    _head = 0;
+    _size = 0;
+    _endUpdate();
+    _store->persistPositions(0, 0, _writtenBytes);
+    _releasedEnd = _writtenBytes;
+    _trimIndices();
+  }
+  _flushHistory();
+}
+
+void OutputBuffer::close() {
+  {
+    Poco::Mutex::ScopedLock scopedLock(*_mutex);
+    if (_closed) {
+      return;
+    }
+    // the durable consumers only stop at the end of the output, so never wait for them here
+    _backpressure.enabled = false;
+    if (_dedup.enabled) {
+      _endRepeats(TimeIndex::now());
+    }
+    if (_severityIndexing) {
+      _severityIndex.finish();
+    }
+    _beginUpdate();
     _closed = true;
+    _endUpdate();
+    _store->persistClosed();
   }
+  _eventCount.notifyAll();
+  _durableEventCount.notifyAll();
 }
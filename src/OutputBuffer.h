@@ -7,12 +7,55 @@
 
 #include <stddef.h>
 #include <sys/types.h>
+#include <sys/uio.h>
+#include <atomic>
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "EventCount.h"
+#include "LineIndex.h"
+#include "StreamIndex.h"
+#include "TimeIndex.h"
+#include "RepeatIndex.h"
+#include "SeverityIndex.h"
+#include "SearchIndex.h"
 
 typedef unsigned char Byte;
 
 namespace Poco {
   class Mutex;
 }
+class RingStore;
+class FileRingStore;
+class OutputHistory;
+
+/** How readers of an {@class OutputBuffer} synchronize with the writer. */
+typedef enum {
+  LOCKED_READ = 0,      // every read takes the buffer mutex
+  OPTIMISTIC_READ = 1   // non-blocking reads copy without the mutex, validated by sequence counters
+} OutputBufferReadMode;
+
+/** Kind of memory backing the circular buffer of an {@class OutputBuffer}. */
+typedef enum {
+  MALLOC_STORE = 0,     // heap memory, re-allocated as the buffer grows
+  MIRRORED_STORE = 1,   // a memory file mapped twice back-to-back, so that every span is contiguous
+  RESERVED_STORE = 2,   // virtual memory reserved for the maximum capacity, allocated as it is written
+  FILE_STORE = 3        // a memory-mapped file, where the output survives the executor process
+} OutputBufferStoreType;
+
+/** Statistics of the writes blocked by the lossless mode of an {@class OutputBuffer}. */
+struct BackpressureStatistics {
+  /** Number of writes which have been blocked. */
+  size_t blockedWrites;
+  /** Total time of the writes being blocked, in microseconds. */
+  int64_t blockedMicros;
+  /** Longest time of a write being blocked, in microseconds. */
+  int64_t maxBlockedMicros;
+
+  BackpressureStatistics() : blockedWrites(0), blockedMicros(0), maxBlockedMicros(0) {}
+};
 
 /** Result of a read request. */
 struct ReadResult {
@@ -41,6 +84,51 @@ struct ReadResult {
   }
 };
 
+/** A range of lines in the output, see {@code OutputBuffer::lines}. */
+struct LineRange {
+  /** The first line in the range, counted from zero since the program started. */
+  size_t line;
+  /** Number of lines in the range, including the last line even if not terminated. */
+  size_t count;
+  /** Beginning position of the first line. */
+  size_t begin;
+  /** Position after the last line. */
+  size_t end;
+
+  LineRange() : line(0), count(0), begin(0), end(0) {}
+};
+
+/**
+ * A view of the buffer contents, pointing directly into the circular buffer.
+ *
+ * The view is not protected against the writer.  After consuming the segments
+ * (e.g., passing them to {@code writev}), the consumer must check
+ * {@code OutputBuffer::isIntact(view)} to confirm the bytes were not overwritten
+ * in the meantime.  The memory of the segments stays mapped until the buffer is
+ * destroyed.
+ */
+struct OutputView {
+  /** Whether or not the buffer has closed. */
+  bool isClosed;
+  /** Whether or not there is no content available. */
+  bool isTimeout;
+  /**
+   * Whether or not the contents are in the history instead of the circular buffer.
+   * Such a view has no segments, and the contents should be copied by {@code read}.
+   */
+  bool isHistory;
+  /** Actual beginning of the contents in this view. */
+  size_t begin;
+  /** Total number of bytes in the segments. */
+  size_t count;
+  /** Number of segments (0, 1, or 2 if the contents wrap around the ring). */
+  int segmentCount;
+  /** The segments of the contents. */
+  struct iovec segments[2];
+
+  OutputView() : isClosed(false), isTimeout(false), isHistory(false), begin(0), count(0), segmentCount(0), segments() {}
+};
+
 /**
  * Class for buffering program outputs in the memory.
  *
@@ -50,33 +138,143 @@ struct ReadResult {
  */
 class OutputBuffer {
 private:
-  Byte* _buffer;        // the circular buffer
+  RingStore *_store;    // memory of the circular buffer
+  Byte* _buffer;        // the circular buffer, i.e., `_store->data()`
+  OutputBufferStoreType _storeType;  // kind of `_store`
+  bool _mirrored;       // whether or not `_store` is mirrored
   size_t _capacity;     // current circular buffer capacity
   size_t _maxCapacity;  // maximum circular buffer capacity
+  size_t _capacityLimit;  // number of bytes the circular buffer may retain, at most `_maxCapacity`
+  size_t _releasedEnd;  // the evicted bytes before this position have had their ring pages released
   size_t _size;         // number of bytes currently stored in the circular buffer
   size_t _head;         // position of the first byte in the circular buffer
   size_t _writtenBytes; // number of bytes ever written into the circular buffer
+  OutputHistory *_history;  // where to put the bytes evicted from the circular buffer (may be NULL)
+  LineIndex _lineIndex; // newlines in the retained output
+  StreamIndex _streamIndex; // streams of the retained output
+  TimeIndex _timeIndex; // arrival time of the retained output
+  RepeatIndex _repeatIndex; // repeated lines omitted from the output
+  size_t _indexBudget;  // memory of the line, stream and repeat indices of the history
+  bool _severityIndexing;   // whether or not `_severityIndex` is maintained
+  SeverityIndex _severityIndex;  // errors, warnings and tracebacks in the output
+  std::unique_ptr<SearchIndex> _searchIndex;  // trigram filters of the retained output (may be NULL)
+
+  // Line deduplication.  A line identical to the previous one is held back while it arrives,
+  // and only counted once it is complete.  The run of repeats is recorded into `_repeatIndex`
+  // when any other output arrives, or when the buffer is closed.
+  struct Deduplication {
+    bool enabled;
+    bool atLineStart;         // whether or not the next byte starts a new line
+    std::string lastLine;     // the last complete line, if not too long
+    ProgramStream lastStream; // the stream of `lastLine`
+    std::string currentLine;  // the incomplete line written so far, if not too long
+    bool currentTooLong;      // whether or not `currentLine` has exceeded the limit
+    std::string pending;      // the beginning of a possible repeat, held back
+    size_t repeats;           // number of repeats in the current run
+
+    Deduplication() : enabled(false), atLineStart(true), lastStream(STDOUT_STREAM), currentTooLong(false),
+                      repeats(0) {}
+  } _dedup;
+
+  // Lossless mode.  Instead of overwriting the bytes not yet taken by every durable consumer,
+  // the writer blocks until the slowest one has advanced, which stalls the program via the pipe.
+  // A consumer idle for longer than its timeout while blocking the writer is detached.
+  struct DurableConsumer {
+    size_t begin;             // the first byte not yet taken by the consumer
+    int64_t lastAdvance;      // monotonic time of attaching or the last advance, in microseconds
+    int64_t idleTimeout;      // idle time before being detached, in microseconds, or 0 if never
+
+    DurableConsumer() : begin(0), lastAdvance(0), idleTimeout(0) {}
+  };
+  struct Backpressure {
+    bool enabled;
+    std::map<size_t, DurableConsumer> consumers;
+    size_t nextConsumerId;
+    BackpressureStatistics statistics;
+
+    Backpressure() : enabled(false), nextConsumerId(1) {}
+  } _backpressure;
+  EventCount _durableEventCount;  // notified when a durable consumer advances or detaches
+
+  // Head retention.  The first bytes of the output are copied into `_headBytes` as they are
+  // written, and never changed afterwards, so readers may read below `_headSize` without the
+  // mutex even if the ring has evicted them.
+  std::vector<Byte> _headBytes;
+  std::atomic<size_t> _headSize;
 
   Poco::Mutex *_mutex;  // Lock of this object.
-  bool _closed;         // whether or not the output buffer has been closed
+  std::atomic<bool> _closed;  // whether or not the output buffer has been closed
 
-  // waiting list for the readers
-  class ReaderList;
-  ReaderList *_readerList;
+  // Optimistic (seqlock) read support.  `_sequence` is odd while the writer is updating the
+  // metadata above, and `_lowWatermark` is raised *before* any byte below it is overwritten.
+  // Stores replaced by `_expandBuffer` are retired instead of freed, since optimistic readers
+  // and views may still point into them.
+  OutputBufferReadMode _readMode;
+  std::atomic<size_t> _sequence;
+  std::atomic<size_t> _lowWatermark;
+  std::vector<RingStore*> _retiredStores;
+
+  /** A consistent copy of the ring metadata. */
+  struct Snapshot {
+    Byte *buffer;
+    size_t capacity;
+    size_t head;
+    size_t size;
+    size_t writtenBytes;
+    bool closed;
+
+    /** Translate a negatively indexed "begin" to its positive index. */
+    inline size_t positiveBegin(ssize_t begin) const {
+      return begin < 0 ? (size_t)std::max(begin + (ssize_t)writtenBytes, (ssize_t)0) : (size_t)begin;
+    }
+
+    /** Translate a possibly negative "begin" into the actual beginning of the contents in the ring. */
+    inline size_t actualBegin(ssize_t begin) const {
+      return std::max(positiveBegin(begin), writtenBytes - size);
+    }
+
+    /** Ring position of the absolute offset {@arg pos}. */
+    inline size_t ringPosition(size_t pos) const {
+      return (head + (pos - (writtenBytes - size))) % capacity;
+    }
+  };
+
+  /** Take a snapshot of the metadata, without holding the mutex. */
+  Snapshot _snapshotOptimistic() const;
+
+  /** Take a snapshot of the metadata, while holding the mutex. */
+  inline Snapshot _snapshotLocked() const {
+    Snapshot ret = {_buffer, _capacity, _head, _size, _writtenBytes, _closed};
+    return ret;
+  }
+
+  // Readers waiting for new output sleep on this event count, which is notified on every
+  // write and on close.  Each reader then checks its own position.
+  EventCount _eventCount;
+
+  /** Take {@arg store} as the memory of the circular buffer. */
+  void _attachStore(RingStore *store);
 
   /** Expand the buffer capacity, keeping all contents. */
   void _expandBuffer(size_t desiredCapacity);
 
+  /** Begin updating the metadata, making the sequence odd. */
+  inline void _beginUpdate() {
+    _sequence.store(_sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+
+  /** Finish updating the metadata, making the sequence even again. */
+  inline void _endUpdate() {
+    _sequence.store(_sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
   /**
-   * Write a number of bytes into the circular buffer.
-   *
-   * This method does not overwrite existing bytes in the buffer.  It will not increase the buffer
-   * capacity.  If there's no room for writing new contents in the buffer, it will just write part
-   * of the data into the buffer, discarding the remaining.
+   * Copy bytes into the circular buffer at position {@arg tail}.
    *
-   * @return The number of bytes successfully written.
+   * This method only moves the bytes, and the caller is responsible for updating the metadata.
    */
-  size_t _circularWrite(const Byte *data, size_t count);
+  void _circularWrite(size_t tail, const Byte *data, size_t count);
 
   /**
    * Write a number of bytes into the output buffer, overwriting existing content if required.
@@ -88,6 +286,16 @@ private:
    */
   size_t _overwrite(const Byte *data, size_t count);
 
+  /**
+   * Release the ring pages of the evicted bytes, if the capacity limit is below the ring capacity,
+   * such that the resident memory stays close to the limit.  The pages are released in chunks,
+   * unless {@arg force} is true.  The caller must hold the mutex.
+   */
+  void _releaseEvicted(bool force);
+
+  /** Forget the indexed positions which can no longer be read.  The caller must hold the mutex. */
+  void _trimIndices();
+
   /**
    * Read a number of bytes from the circular buffer.
    *
@@ -99,6 +307,51 @@ private:
    */
   size_t _circularRead(Byte* target, size_t count, size_t start);
 
+  /** Write the bytes into the ring, and index them.  The caller must hold the mutex. */
+  void _appendIndexed(const Byte *data, size_t count, ProgramStream stream, int64_t now);
+
+  /**
+   * Write the bytes into the ring, and index them.  In the lossless mode, the bytes are written
+   * in pieces as the durable consumer makes room for them.  The caller must hold the mutex once,
+   * which is released while waiting.
+   */
+  void _append(const Byte *data, size_t count, ProgramStream stream, int64_t now);
+
+  /**
+   * Wait until there is room for writing without overwriting the bytes not yet taken by the
+   * durable consumers.  The caller must hold the mutex once, which is released while waiting.
+   *
+   * @return Number of bytes which can be written, or {@code SIZE_MAX} if not in the lossless mode,
+   *         or if there is no durable consumer.
+   */
+  size_t _waitForRoom();
+
+  /** The first byte not yet taken by the slowest durable consumer.  The caller must hold the mutex. */
+  size_t _durableBegin() const;
+
+  /**
+   * Detach the durable consumers which have not advanced for longer than their idle timeout.
+   * The caller must hold the mutex.
+   *
+   * @return Whether or not any consumer has been detached.
+   */
+  bool _detachIdleConsumers(int64_t now);
+
+  /** Write the bytes, holding back and counting the repeated lines.  The caller must hold the mutex. */
+  void _appendDeduplicated(const Byte *data, size_t count, ProgramStream stream, int64_t now);
+
+  /** Write the held back bytes, and record the current run of repeats.  The caller must hold the mutex. */
+  void _endRepeats(int64_t now);
+
+  /** Move {@arg count} bytes starting at ring position {@arg front} into the history. */
+  void _evictToHistory(size_t front, size_t count);
+
+  /** Flush the bytes moved into the history, without holding the lock. */
+  void _flushHistory();
+
+  /** Copy {@arg count} bytes starting at ring position {@arg front} of {@arg buffer}, handling wrap-around. */
+  void _copyFromRing(Byte *target, Byte const *buffer, size_t capacity, size_t front, size_t count) const;
+
   /** Translate a negatively indexed "begin" to its current positive index. */
   inline size_t translateNegativeBegin(ssize_t begin) const {
     if (begin < 0) {
@@ -112,19 +365,138 @@ private:
 
   ReadResult _tryRead(size_t begin, void *target, size_t count);
 
+  /** Try read from the retained head, without holding the mutex.  Returns {@code ReadResult::Timeout()} if not in the head. */
+  ReadResult _tryReadHead(size_t begin, void *target, size_t count) const;
+
+  /**
+   * Try read without holding the mutex.
+   *
+   * The ring metadata is snapshotted under the sequence counter, the bytes are copied, and the
+   * copy is retried if the writer has overwritten any of them in the meantime.
+   */
+  ReadResult _tryReadOptimistic(ssize_t begin, void *target, size_t count);
+
 public:
   inline size_t size() const { return _size; }
   /** Maximum number of bytes which can be stored in this buffer. */
   inline size_t capacity() const { return _maxCapacity; }
+  /** Number of bytes which this buffer may currently retain, see {@code setCapacityLimit}. */
+  size_t capacityLimit() const;
+  /** Number of bytes currently allocated for the circular buffer, at most {@code capacity()}. */
+  size_t ringCapacity() const;
+  /**
+   * Whether or not the ring pages are given back to the system when the limit is lowered, see
+   * {@code setCapacityLimit}.  Otherwise, the memory the ring has grown to is held until destroyed.
+   */
+  inline bool releasesMemory() const { return _storeType == RESERVED_STORE || _storeType == MIRRORED_STORE; }
   inline size_t writtenBytes() const { return _writtenBytes; }
+  inline bool closed() const { return _closed.load(); }
+  inline OutputBufferReadMode readMode() const { return _readMode; }
+  inline OutputBufferStoreType storeType() const { return _storeType; }
+  inline OutputHistory *history() const { return _history; }
+  /** Number of readers currently waiting for new output. */
+  inline size_t waitingReaders() const { return _eventCount.waiters(); }
+
+  /**
+   * Position of the first byte which can still be read, either from the history or the circular buffer.
+   * The retained head (see {@code setHeadRetention}) is not counted.
+   */
+  size_t retainedBegin() const;
+
+  /** Maximum number of bytes at the beginning of the output retained apart from the ring. */
+  inline size_t headRetention() const { return _headBytes.size(); }
+
+  /** Number of bytes at the beginning of the output retained apart from the ring. */
+  inline size_t headSize() const { return _headSize.load(std::memory_order_acquire); }
+
+  /**
+   * Retain the first {@arg size} bytes of the output apart from the ring, such that they are never
+   * evicted.  Reads of the positions between the head and the retained tail skip to the tail, like
+   * any evicted position.  Must be called before anything is written.
+   */
+  void setHeadRetention(size_t size);
+
+  /** Whether or not the consecutive identical lines are stored only once. */
+  inline bool deduplicateLines() const { return _dedup.enabled; }
+
+  /**
+   * Store the consecutive identical lines only once, with the number of repeats.  Readers may
+   * present them by {@code repeatSpan}, either as a marker line or expanded.  Must be called
+   * before anything is written.
+   */
+  void setDeduplicateLines(bool enabled);
+
+  /**
+   * Limit the number of bytes retained by the buffer, within {@code capacity()}, e.g., to share a
+   * memory budget with other buffers.  The oldest bytes beyond the new limit are evicted at once,
+   * and the ring pages no longer needed are released if {@code releasesMemory()}.  The ring never
+   * grows beyond the limit.  In the lossless mode, the limit never goes below the bytes not yet
+   * taken by the durable consumers.
+   *
+   * @return The actual limit.
+   */
+  size_t setCapacityLimit(size_t limit);
+
+  /** Whether or not the notable lines of the output are indexed by their severity. */
+  inline bool severityIndexing() const { return _severityIndexing; }
+
+  /**
+   * Index the notable lines of the output, e.g., errors, warnings and tracebacks, which can
+   * then be listed by {@code severityEntries}.  Must be called before anything is written.
+   */
+  void setSeverityIndexing(bool enabled);
+
+  /**
+   * Bound the memory of the line, stream and repeat indices of the output in the history to about
+   * {@arg bytes}.  Beyond it, the oldest lines in the history can only be read by their positions.
+   * The indices of the circular buffer are always kept.  Defaults to a fraction of the maximum
+   * capacity, see {@code ML_GRIDENGINE_INDEX_BUDGET_RATIO}.
+   */
+  void setIndexBudget(size_t bytes);
+
+  /** Whether or not the output is indexed for {@code searchCandidates}. */
+  inline bool searchIndexing() const { return (bool)_searchIndex; }
+
+  /**
+   * Index the trigrams of the output by blocks, such that a search can skip the blocks which
+   * cannot contain its literal.  The index is trimmed together with the retained output (including
+   * the history), and never exceeds {@arg maxSize}.  Must be called before anything is written.
+   *
+   * @param maxSize Maximum memory used by the index, or zero to disable it.
+   */
+  void setSearchIndexing(size_t maxSize);
 
   /**
    * Construct a new {@class OutputBuffer}.
    *
    * @param maxCapacity The maximum capacity of this output buffer.
    * @param initialCapacity The initial capacity of this output buffer.
+   * @param readMode Whether or not non-blocking reads should take the buffer mutex.
+   *                 With {@code OPTIMISTIC_READ}, only readers that have to wait for new
+   *                 output contend with the writer.
+   * @param storeType The kind of memory backing the buffer.  {@code RESERVED_STORE} and {@code MIRRORED_STORE}
+   *                  start at the maximum capacity (ignoring {@arg initialCapacity}), but only take memory
+   *                  as the contents are written.  {@code MIRRORED_STORE} rounds the capacity up to a multiple
+   *                  of the page size.  Both fall back to {@code MALLOC_STORE} if not supported by the system.
+   * @param history Where to keep the bytes evicted from the buffer, so that they can still be read.
+   *                The output buffer takes the ownership.  If NULL, the evicted bytes are discarded.
    */
-  explicit OutputBuffer(size_t maxCapacity, size_t initialCapacity=64 * 1024);
+  explicit OutputBuffer(size_t maxCapacity, size_t initialCapacity=64 * 1024,
+                        OutputBufferReadMode readMode=LOCKED_READ, OutputBufferStoreType storeType=RESERVED_STORE,
+                        OutputHistory *history=nullptr);
+
+  /**
+   * Construct a new {@class OutputBuffer} on a ring file, whose capacity is fixed.
+   *
+   * The positions of the ring are persisted into the file on every write, such that the latest
+   * output can be recovered by {@code FileRingStore::recover} even if the executor dies.
+   *
+   * @param store The ring file.  The output buffer takes the ownership.
+   * @param readMode Whether or not non-blocking reads should take the buffer mutex.
+   * @param history Where to keep the bytes evicted from the buffer, see the other constructor.
+   */
+  explicit OutputBuffer(FileRingStore *store, OutputBufferReadMode readMode=LOCKED_READ,
+                        OutputHistory *history=nullptr);
 
   /** Destroy the {@class OutputBuffer}. */
   ~OutputBuffer();
@@ -137,16 +509,18 @@ public:
    *
    * @param data Byte data array.
    * @param count Number of bytes to write.
+   * @param stream The stream of the program which produced the bytes.
    *
    * @throws Poco::RuntimeError If the buffer has closed.
    */
-  void write(const void* data, size_t count);
+  void write(const void* data, size_t count, ProgramStream stream = STDOUT_STREAM);
 
   /**
    * Read at most {@arg count} number of bytes from the output buffer.
    *
    * @param begin Beginning position of the output to read, counted from the very beginning when the program started.
    *              If negative, it will be first added by {@code writtenBytes()}, then used as the position.
+   *              Positions evicted from the buffer are read from the history, if retained.
    * @param target Target array, where to put the contents.
    * @param count Maximum number of bytes to read.
    * @param timeout Number of milliseconds to wait before timeout.  Specify <= 0 to wait forever.
@@ -168,6 +542,180 @@ public:
    */
   ReadResult tryRead(ssize_t begin, void* target, size_t count);
 
+  /**
+   * Wait until there are contents at or after {@arg begin}, without reading them.
+   *
+   * @param begin Beginning position, with the same meaning as in {@code read}.
+   * @param timeout Number of milliseconds to wait before timeout.  Specify <= 0 to wait forever.
+   *
+   * @return The result of the request, where {@code count} is always zero.
+   */
+  ReadResult wait(ssize_t begin, long timeout = 0);
+
+  /**
+   * Get a view of at most {@arg count} bytes in the output buffer, without copying them.
+   *
+   * @param begin Beginning position, with the same meaning as in {@code tryRead}.
+   * @param count Maximum number of bytes in the view.
+   *
+   * @return The view.  If there's no more content in the buffer currently, {@code isTimeout} is set.
+   */
+  OutputView peek(ssize_t begin, size_t count);
+
+  /**
+   * Locate at most {@arg count} lines in the output, starting from line {@arg line}.
+   *
+   * @param line The first line, counted from zero since the program started.  If negative, it will
+   *             be first added by the number of lines written so far.  Lines no longer retained are skipped.
+   * @param count Maximum number of lines.  Zero means all the following lines.
+   *
+   * @return The range of the lines.  It is empty if there's no such line currently.
+   */
+  LineRange lines(ssize_t line, size_t count = 0) const;
+
+  /** Number of bytes ever written from {@arg stream}. */
+  size_t streamWrittenBytes(ProgramStream stream) const;
+
+  /**
+   * Locate the bytes of {@arg stream} at position {@arg offset} of the stream.
+   *
+   * @param offset Position in the stream, counted from zero since the program started.
+   * @return The run of bytes of the stream, which are contiguous in this buffer.  See
+   *         {@code StreamIndex::locate}.  Runs no longer retained are skipped.
+   */
+  StreamSpan streamSpan(ProgramStream stream, size_t offset) const;
+
+  /**
+   * The first position of the output which may have arrived at or after {@arg time}.
+   * See {@code TimeIndex::positionSince}.
+   *
+   * @param time Wall-clock microseconds since the epoch.
+   */
+  size_t positionSince(int64_t time) const;
+
+  /**
+   * The position after the output which may have arrived at or before {@arg time}.
+   * See {@code TimeIndex::positionUntil}.
+   */
+  size_t positionUntil(int64_t time) const;
+
+  /**
+   * The arrival time of the output at {@arg position}, in wall-clock microseconds since the epoch.
+   *
+   * @return The time, or -1 if the position is no longer retained or not written yet.
+   */
+  int64_t timeAt(size_t position) const;
+
+  /** Whether or not the writer blocks instead of overwriting the bytes not yet taken by the durable consumers. */
+  inline bool lossless() const { return _backpressure.enabled; }
+
+  /**
+   * Let the writer block instead of overwriting the bytes not yet taken by the durable consumers,
+   * which must then call {@code advanceDurable} as they take the output.  Must be called before
+   * anything is written.
+   */
+  void setLossless(bool enabled);
+
+  /**
+   * Attach a durable consumer, which is going to take the output from {@arg position}.
+   * The consumers also serve as a retention hint when the buffer is not lossless.
+   *
+   * @param position The first byte to be taken, clamped into the bytes retained by the ring.
+   * @param idleTimeoutMillis If the consumer blocks the writer without advancing for this long,
+   *                          it is detached.  Zero means never.
+   * @return The id of the consumer.
+   */
+  size_t attachDurableConsumer(size_t position=0, long idleTimeoutMillis=0);
+
+  /** Whether or not the durable consumer {@arg id} is still attached. */
+  bool durableConsumerAttached(size_t id) const;
+
+  /** The first byte not yet taken by the slowest durable consumer, or {@code writtenBytes} if there is none. */
+  size_t durableBegin() const;
+
+  /** Tell the writer that the durable consumer {@arg id} has taken the output before {@arg position}. */
+  void advanceDurable(size_t id, size_t position);
+
+  /** Detach the durable consumer {@arg id}, e.g., when it fails, such that the writer no longer waits for it. */
+  void detachDurableConsumer(size_t id);
+
+  /** Statistics of the writes blocked by the lossless mode. */
+  BackpressureStatistics backpressureStatistics() const;
+
+  /** Number of lines omitted by the line deduplication. */
+  size_t repeatedLines() const;
+
+  /** Number of bytes omitted by the line deduplication. */
+  size_t repeatedBytes() const;
+
+  /** Position in the presented output of {@arg mode}, of the stored byte at {@arg position}. */
+  size_t repeatPosition(RepeatMode mode, size_t position) const;
+
+  /** Number of bytes in the presented output of {@arg mode}. */
+  size_t repeatWrittenBytes(RepeatMode mode) const;
+
+  /**
+   * Locate the run of the presented output of {@arg mode} at {@arg position}.
+   * See {@code RepeatIndex::locate}.
+   *
+   * @param maxCount Maximum number of bytes to synthesize, if the run is synthesized.
+   */
+  RepeatSpan repeatSpan(RepeatMode mode, size_t position, size_t maxCount) const;
+
+  /**
+   * The notable lines of the classes in {@arg mask} (bit {@code 1 << severity}), at the stored
+   * positions.  See {@code SeverityIndex::entries}.
+   */
+  std::vector<SeverityEntry> severityEntries(unsigned mask, size_t limit=0) const;
+
+  /** Number of notable lines ever indexed of {@arg severity}. */
+  size_t severityCount(Severity severity) const;
+
+  /**
+   * The retained lines within {@code [begin, end)} which may contain {@arg literal}, in the order
+   * of the output and never overlapping.  All the lines are candidates if the output is not
+   * indexed.  See {@code SearchIndex::candidates}.
+   *
+   * Only the lines within about {@arg span} bytes are looked up at a time, such that the writer
+   * is never blocked for long.  The lookup continues at {@arg *next}, until it reaches {@arg end}.
+   *
+   * @param begin Beginning of a line, e.g., {@code lines(0).begin}.
+   * @param end End of a line, e.g., {@code lines(0).end}.
+   */
+  std::vector<LineRange> searchCandidates(std::string const& literal, size_t begin, size_t end, size_t span,
+                                          size_t *next) const;
+
+  /** Get the statistics of the search index, all zeros if the output is not indexed. */
+  SearchIndexStatistics searchIndexStatistics() const;
+
+  /** Whether or not the bytes of {@arg view} are still intact, i.e., not overwritten by the writer. */
+  inline bool isIntact(OutputView const& view) const {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return view.begin < _headSize.load(std::memory_order_relaxed) ||
+           _lowWatermark.load(std::memory_order_relaxed) <= view.begin;
+  }
+
+  /**
+   * Whether or not the bytes of {@arg view} are at least {@arg margin} bytes above the oldest one
+   * which may be overwritten, such that they can be sent directly from the ring with little risk
+   * of being overwritten meanwhile.  Otherwise, they had better be copied out by {@code tryRead}.
+   */
+  inline bool isFarFromEviction(OutputView const& view, size_t margin) const {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return view.begin + view.count <= _headSize.load(std::memory_order_relaxed) ||
+           _lowWatermark.load(std::memory_order_relaxed) + margin <= view.begin;
+  }
+
+  /**
+   * Discard the contents of the circular buffer, and return its memory to the system.
+   *
+   * The contents are moved into the history first, if any, where the readers can still find
+   * them.  Without a history, the readers which have not caught up lose them.  The buffer can
+   * still be written afterwards.  This does nothing for a {@code FILE_STORE}, whose ring file
+   * or shared memory must keep the last output.
+   */
+  void releaseMemory();
+
   /**
    * Close the output buffer.
    *
@@ -0,0 +1,117 @@
+#include <memory>
+#include <Poco/Thread.h>
+#include <Poco/Exception.h>
+#include <Poco/FileStream.h>
+#include "AutoFreePtr.h"
+#include "Logger.h"
+#include "OutputArchive.h"
+#include "OutputFileWriter.h"
+#include "TimeIndex.h"
+#include "macros.h"
+
+OutputFileWriter::OutputFileWriter(OutputBuffer *outputBuffer, std::string const& path, size_t bufferSize,
+                                   bool archive) :
+  _outputBuffer(outputBuffer),
+  _path(path),
+  _bufferSize(bufferSize),
+  _archive(archive),
+  _consumerId(outputBuffer->attachDurableConsumer()),
+  _thread(new Poco::Thread()),
+  _running(false),
+  _failed(false),
+  _savedBytes(0),
+  _discardedBytes(0),
+  _fileSize(0)
+{
+}
+
+OutputFileWriter::~OutputFileWriter() {
+  if (_running) {
+    join();
+  }
+  _outputBuffer->detachDurableConsumer(_consumerId);
+  delete _thread;
+}
+
+void OutputFileWriter::_run() {
+  try {
+    AutoFreePtr<char> buffer((char*)malloc(_bufferSize));
+    std::unique_ptr<Poco::FileOutputStream> outStream;
+    std::unique_ptr<OutputArchiveWriter> archive;
+    if (_archive) {
+      archive.reset(new OutputArchiveWriter(_path, ML_GRIDENGINE_ARCHIVE_BLOCK_SIZE));
+    } else {
+      outStream.reset(new Poco::FileOutputStream(_path, std::ios::out | std::ios::trunc));
+    }
+
+    // the archive seals its pending block once it has been pending for the flush interval,
+    // such that the readers of the archive see the output of a slow or quiet program
+    const int64_t flushInterval = ML_GRIDENGINE_ARCHIVE_FLUSH_MILLIS * 1000L;
+    int64_t pendingSince = 0;
+    size_t begin = 0;
+    ReadResult readResult;
+    while (!(readResult = _outputBuffer->read(begin, buffer.ptr, _bufferSize,
+                                              archive ? ML_GRIDENGINE_ARCHIVE_FLUSH_MILLIS : 0)).isClosed) {
+      if (!readResult.isTimeout) {
+        if (readResult.begin != begin) {
+          Logger::getLogger().warn("%z bytes of output were lost before saved.", readResult.begin - begin);
+          _discardedBytes += readResult.begin - begin;
+        }
+        if (archive) {
+          if (archive->pendingBytes() == 0) {
+            pendingSince = TimeIndex::now();
+          }
+          archive->append(readResult.begin, (const Byte*)buffer.ptr, readResult.count);
+        } else {
+          outStream->write(buffer.ptr, readResult.count);
+          outStream->flush();
+          if (!outStream->good()) {
+            throw Poco::WriteFileException(_path);
+          }
+        }
+        begin = readResult.begin + readResult.count;
+        _savedBytes += readResult.count;
+      }
+      if (archive) {
+        if (archive->pendingBytes() > 0 && TimeIndex::now() - pendingSince >= flushInterval) {
+          archive->flush();
+        }
+        _fileSize = archive->fileSize();
+      } else {
+        _fileSize = _savedBytes;
+      }
+      // the output pending in the archive has been copied, so the writer need not wait for it
+      _outputBuffer->advanceDurable(_consumerId, begin);
+    }
+    if (archive) {
+      archive->finish();
+      _fileSize = archive->fileSize();
+    }
+  } catch (Poco::Exception const& exc) {
+    if (_outputBuffer->lossless()) {
+      Logger::getLogger().error("Failed to save the output to %s, it will no longer be lossless:\n%s",
+          _path, exc.displayText());
+    } else {
+      Logger::getLogger().error("Failed to save the output to %s:\n%s", _path, exc.displayText());
+    }
+    _failed = true;
+    _outputBuffer->detachDurableConsumer(_consumerId);
+  }
+}
+
+void OutputFileWriter::start() {
+  if (_running) {
+    throw Poco::IllegalStateException("The output file writer has already started.");
+  }
+  _thread->startFunc([this] {
+    this->_run();
+  });
+  _running = true;
+}
+
+void OutputFileWriter::join() {
+  if (_running) {
+    _thread->join();
+  }
+  _running = false;
+}
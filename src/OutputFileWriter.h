@@ -0,0 +1,70 @@
+#ifndef ML_GRIDENGINE_EXECUTOR_OUTPUTFILEWRITER_H
+#define ML_GRIDENGINE_EXECUTOR_OUTPUTFILEWRITER_H
+
+#include <string>
+#include "OutputBuffer.h"
+
+namespace Poco {
+  class Thread;
+}
+
+/**
+ * The durable consumer of an {@class OutputBuffer}, which saves the output into a file as it is
+ * written, either as-is, or as an output archive (see {@class OutputArchiveWriter}).
+ *
+ * The writer attaches to the buffer as a durable consumer once constructed, and each chunk is
+ * handed over to the system before its durable position is advanced past it.  If the buffer is
+ * lossless, no output is discarded before saved; otherwise the consumer only serves as a retention
+ * hint, and the discarded output is skipped.  If the file cannot be written, the consumer detaches
+ * from the buffer, such that the program is not stalled forever.
+ */
+class OutputFileWriter {
+private:
+  OutputBuffer *_outputBuffer;
+  std::string _path;
+  size_t _bufferSize;
+  bool _archive;
+  size_t _consumerId;
+  Poco::Thread *_thread;
+  volatile bool _running;
+  volatile bool _failed;
+  size_t _savedBytes;
+  size_t _discardedBytes;
+  size_t _fileSize;
+
+  void _run();
+
+public:
+  /**
+   * Construct a new {@class OutputFileWriter}.
+   *
+   * @param outputBuffer The output buffer.
+   * @param path The file to save the output into, which is truncated.
+   * @param archive Whether to save the output as an output archive, whose blocks are sealed at
+   *                least every {@code ML_GRIDENGINE_ARCHIVE_FLUSH_MILLIS}.
+   */
+  explicit OutputFileWriter(OutputBuffer *outputBuffer, std::string const& path, size_t bufferSize=64 * 1024,
+                            bool archive=false);
+
+  ~OutputFileWriter();
+
+  /** Whether or not the file could not be written. */
+  inline bool failed() const { return _failed; }
+
+  /** Number of bytes saved into the file. */
+  inline size_t savedBytes() const { return _savedBytes; }
+
+  /** Number of bytes discarded by the buffer before saved. */
+  inline size_t discardedBytes() const { return _discardedBytes; }
+
+  /** Size of the file written. */
+  inline size_t fileSize() const { return _fileSize; }
+
+  void start();
+
+  /** Wait until the output buffer has been closed, and all of its contents have been saved. */
+  void join();
+};
+
+
+#endif //ML_GRIDENGINE_EXECUTOR_OUTPUTFILEWRITER_H
@@ -0,0 +1,48 @@
+#ifndef ML_GRIDENGINE_EXECUTOR_OUTPUTHISTORY_H
+#define ML_GRIDENGINE_EXECUTOR_OUTPUTHISTORY_H
+
+#include <stddef.h>
+
+typedef unsigned char Byte;
+
+/**
+ * Storage of the output evicted from the circular buffer of {@class OutputBuffer}.
+ *
+ * The history keeps a contiguous range of output, {@code [begin(), end())}, counted from the
+ * very beginning when the program started.  {@code end()} always equals the beginning of the
+ * contents in the circular buffer.
+ *
+ * {@code append} is only called by the writer of the output buffer (while holding its lock),
+ * while {@code read} may be called concurrently by any number of readers.  {@code append} should
+ * only stage the bytes, and leave the expensive work (e.g., compression or disk I/O) to
+ * {@code flush}, which the output buffer calls after releasing its lock.
+ */
+class OutputHistory {
+public:
+  virtual ~OutputHistory() {}
+
+  /** Position of the first byte retained in the history. */
+  virtual size_t begin() const = 0;
+
+  /** Position after the last byte in the history. */
+  virtual size_t end() const = 0;
+
+  /** Append the bytes at {@code end()} to the history.  They can be read at once. */
+  virtual void append(const Byte *data, size_t count) = 0;
+
+  /**
+   * Store the bytes staged by {@code append}.  Called without the lock of the output buffer,
+   * possibly concurrently with {@code append} and from more than one thread.
+   */
+  virtual void flush() {}
+
+  /**
+   * Read at most {@arg count} bytes starting at {@arg begin}.
+   *
+   * @return Actual number of bytes read, zero if {@arg begin} is not in {@code [begin(), end())}.
+   */
+  virtual size_t read(size_t begin, Byte *target, size_t count) = 0;
+};
+
+
+#endif //ML_GRIDENGINE_EXECUTOR_OUTPUTHISTORY_H
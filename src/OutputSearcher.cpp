@@ -0,0 +1,262 @@
+#include <ctype.h>
+#include <string.h>
+#include <vector>
+#include <Poco/RegularExpression.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "OutputSearcher.h"
+#include "macros.h"
+
+namespace {
+  size_t countNewlines(const char *begin, const char *end) {
+    size_t count = 0;
+    while (begin < end && (begin = (const char*)memchr(begin, '\n', end - begin)) != nullptr) {
+      ++count;
+      ++begin;
+    }
+    return count;
+  }
+
+  const char *reverseFind(const char *begin, const char *end, char c) {
+    while (end > begin) {
+      if (*--end == c)
+        return end;
+    }
+    return nullptr;
+  }
+}
+
+OutputSearcher::OutputSearcher(OutputBuffer *outputBuffer, std::string const &literal, std::string const &pattern,
+                               size_t chunkSize, size_t maxExcerptLength) :
+  _outputBuffer(outputBuffer),
+  _literal(literal),
+  _chunkSize(std::max(chunkSize, (size_t)1)),
+  _maxExcerptLength(maxExcerptLength),
+  _scannedBytes(0)
+{
+  if (!pattern.empty()) {
+    _regex.reset(new Poco::RegularExpression(pattern));
+    if (_literal.empty()) {
+      _literal = requiredLiteral(pattern);
+    }
+  }
+}
+
+const char *OutputSearcher::findLiteral(const char *data, size_t count, std::string const &literal) {
+  size_t k = literal.size();
+  if (k == 0) {
+    return data;
+  }
+  if (k > count) {
+    return nullptr;
+  }
+  if (k == 1) {
+    return (const char*)memchr(data, literal[0], count);
+  }
+
+  size_t i = 0;
+#if defined(__SSE2__)
+  // Compare the first and the last byte of the literal at 16 positions at once, and only
+  // verify the positions where both of them match.
+  const __m128i first = _mm_set1_epi8(literal[0]);
+  const __m128i last = _mm_set1_epi8(literal[k - 1]);
+  for (; i + k - 1 + 16 <= count; i += 16) {
+    __m128i blockFirst = _mm_loadu_si128((const __m128i*)(data + i));
+    __m128i blockLast = _mm_loadu_si128((const __m128i*)(data + i + k - 1));
+    unsigned mask = (unsigned)_mm_movemask_epi8(
+        _mm_and_si128(_mm_cmpeq_epi8(first, blockFirst), _mm_cmpeq_epi8(last, blockLast)));
+    while (mask != 0) {
+      unsigned bit = (unsigned)__builtin_ctz(mask);
+      if (memcmp(data + i + bit + 1, literal.data() + 1, k - 2) == 0) {
+        return data + i + bit;
+      }
+      mask &= mask - 1;
+    }
+  }
+#endif
+  return (const char*)memmem(data + i, count - i, literal.data(), k);
+}
+
+std::string OutputSearcher::requiredLiteral(std::string const &pattern) {
+  // inline options (e.g., case-insensitive) may change what a literal matches
+  if (pattern.find("(?") != std::string::npos) {
+    return std::string();
+  }
+
+  std::string best, run;
+  auto endRun = [&] () {
+    if (run.size() > best.size()) {
+      best = run;
+    }
+    run.clear();
+  };
+  auto addChar = [&] (char c, size_t next) {
+    char quantifier = next < pattern.size() ? pattern[next] : '\0';
+    if (quantifier == '?' || quantifier == '*' || quantifier == '{') {
+      endRun();   // the character is optional
+      return;
+    }
+    run += c;
+    if (quantifier == '+') {
+      endRun();
+    }
+  };
+
+  int depth = 0;
+  bool inClass = false;
+  for (size_t i=0; i<pattern.size(); ++i) {
+    char c = pattern[i];
+    if (inClass) {
+      if (c == '\\') {
+        ++i;
+      } else if (c == ']') {
+        inClass = false;
+      }
+      continue;
+    }
+    switch (c) {
+      case '\\':
+        if (i + 1 < pattern.size() && !isalnum((unsigned char)pattern[i + 1]) && depth == 0) {
+          addChar(pattern[i + 1], i + 2);
+        } else {
+          endRun();
+        }
+        ++i;
+        break;
+      case '|':
+        if (depth == 0) {
+          return std::string();
+        }
+        break;
+      case '[':
+        inClass = true;
+        endRun();
+        break;
+      case '(':
+        ++depth;
+        endRun();
+        break;
+      case ')':
+        --depth;
+        break;
+      case '.': case '^': case '$': case '?': case '*': case '+': case '{': case '}':
+        endRun();
+        break;
+      default:
+        if (depth == 0) {
+          addChar(c, i + 1);
+        }
+    }
+  }
+  endRun();
+  return best;
+}
+
+bool OutputSearcher::_scanBlock(const char *data, size_t count, size_t blockBegin, size_t *line,
+                                MatchCallback const &onMatch, size_t *matchCount, size_t maxMatches) {
+  const char *p = data, *end = data + count;
+  const char *counted = data;   // newlines before `counted` have been added to `*line`
+  std::string lineText;
+  while (p < end) {
+    const char *candidate = findLiteral(p, end - p, _literal);
+    if (!candidate)
+      break;
+    const char *lineStart = reverseFind(p, candidate, '\n');
+    lineStart = lineStart ? lineStart + 1 : p;
+    const char *lineEnd = (const char*)memchr(candidate, '\n', end - candidate);
+    if (!lineEnd) {
+      lineEnd = end;
+    }
+
+    size_t matchOffset = candidate - data;
+    if (_regex) {
+      lineText.assign(lineStart, lineEnd);
+      Poco::RegularExpression::Match match;
+      if (!_regex->match(lineText, 0, match) || match.offset == std::string::npos) {
+        p = lineEnd + 1;
+        continue;
+      }
+      matchOffset = (lineStart - data) + match.offset;
+    }
+
+    *line += countNewlines(counted, lineStart);
+    counted = lineStart;
+    SearchMatch result = {
+      blockBegin + matchOffset,
+      *line,
+      std::string(lineStart, std::min((size_t)(lineEnd - lineStart), _maxExcerptLength))
+    };
+    ++*matchCount;
+    if (!onMatch(result) || (maxMatches > 0 && *matchCount >= maxMatches)) {
+      return false;
+    }
+    p = lineEnd + 1;
+  }
+  *line += countNewlines(counted, end);
+  return true;
+}
+
+bool OutputSearcher::_scanRange(LineRange const &range, MatchCallback const &onMatch, size_t *matchCount,
+                                size_t maxMatches) {
+  size_t end = range.end;
+  size_t pos = range.begin, line = range.line;
+
+  // `window` holds the output in [windowBegin, pos), which does not end with a complete line yet
+  std::vector<char> chunk(_chunkSize);
+  std::string window;
+  size_t windowBegin = pos;
+  while (pos < end) {
+    ReadResult result = _outputBuffer->tryRead(pos, chunk.data(), std::min(_chunkSize, end - pos));
+    if (result.isClosed || result.isTimeout || result.count == 0)
+      return false;
+    if (result.begin != pos) {
+      // the output has been evicted during the scan, so continue at the first retained line
+      LineRange first = _outputBuffer->lines(0);
+      if (first.begin >= end) {
+        return true;
+      }
+      window.clear();
+      windowBegin = pos = first.begin;
+      line = first.line;
+      continue;
+    }
+    window.append(chunk.data(), result.count);
+    pos += result.count;
+
+    // Scan the complete lines, or the whole window if a single line is too long.  In the latter
+    // case, the last bytes which may begin a literal crossing into the next chunk are kept.
+    size_t scanSize = window.size(), keepSize = 0;
+    if (pos < end) {
+      size_t lastNewline = window.rfind('\n');
+      if (lastNewline != std::string::npos) {
+        scanSize = lastNewline + 1;
+      } else if (window.size() < _chunkSize) {
+        continue;
+      } else if (!_literal.empty()) {
+        keepSize = std::min(_literal.size() - 1, window.size());
+      }
+    }
+    if (!_scanBlock(window.data(), scanSize, windowBegin, &line, onMatch, matchCount, maxMatches))
+      return false;
+    window.erase(0, scanSize - keepSize);
+    windowBegin += scanSize - keepSize;
+  }
+  return true;
+}
+
+size_t OutputSearcher::search(MatchCallback const &onMatch, size_t maxMatches) {
+  // only the output written so far is searched, starting from the first complete line, and
+  // skipping the lines which cannot contain the literal if the output is indexed
+  LineRange all = _outputBuffer->lines(0);
+  size_t matchCount = 0;
+  for (size_t pos = all.begin; pos < all.end; ) {
+    for (LineRange const& range: _outputBuffer->searchCandidates(_literal, pos, all.end,
+                                                                 ML_GRIDENGINE_SEARCH_LOOKUP_SPAN, &pos)) {
+      _scannedBytes += range.end - range.begin;
+      if (!_scanRange(range, onMatch, &matchCount, maxMatches))
+        return matchCount;
+    }
+  }
+  return matchCount;
+}
@@ -0,0 +1,96 @@
+#ifndef ML_GRIDENGINE_EXECUTOR_OUTPUTSEARCHER_H
+#define ML_GRIDENGINE_EXECUTOR_OUTPUTSEARCHER_H
+
+#include <functional>
+#include <memory>
+#include <string>
+#include "OutputBuffer.h"
+
+namespace Poco {
+  class RegularExpression;
+}
+
+/** A line of the output matched by {@class OutputSearcher}. */
+struct SearchMatch {
+  /** Position of the match, counted from the very beginning when the program started. */
+  size_t offset;
+  /** The line containing the match, counted from zero. */
+  size_t line;
+  /** Contents of the line, without the newline, truncated if too long. */
+  std::string text;
+};
+
+/**
+ * Searches the output retained by an {@class OutputBuffer}, reporting at most one match per line.
+ *
+ * The output is copied out chunk by chunk with {@code OutputBuffer::tryRead}, so the writer is
+ * never blocked by the scan.  Lines are first located by a vectorized search of a literal string,
+ * either the query itself or a literal required by the regular expression, and only those lines
+ * are matched against the regular expression.  If the output buffer has a search index, only the
+ * lines which may contain the literal are copied out at all.
+ */
+class OutputSearcher {
+public:
+  typedef std::function<bool (SearchMatch const&)> MatchCallback;
+
+private:
+  OutputBuffer *_outputBuffer;
+  std::string _literal;
+  std::shared_ptr<Poco::RegularExpression> _regex;
+  size_t _chunkSize;
+  size_t _maxExcerptLength;
+  size_t _scannedBytes;
+
+  bool _scanBlock(const char *data, size_t count, size_t blockBegin, size_t *line, MatchCallback const& onMatch,
+                  size_t *matchCount, size_t maxMatches);
+
+  /** Scan the lines in {@arg range}, returning false if the search should stop. */
+  bool _scanRange(LineRange const& range, MatchCallback const& onMatch, size_t *matchCount, size_t maxMatches);
+
+public:
+  /**
+   * Construct a new {@class OutputSearcher}.
+   *
+   * @param outputBuffer The output buffer to search.
+   * @param literal Lines must contain this string, if not empty.
+   * @param pattern Lines must match this regular expression, if not empty.
+   * @param chunkSize Number of bytes to copy out of the output buffer at a time.
+   * @param maxExcerptLength Maximum length of the line contents in each match.
+   *
+   * @throw Poco::RegularExpressionException If {@arg pattern} is not a valid regular expression.
+   */
+  OutputSearcher(OutputBuffer *outputBuffer, std::string const& literal, std::string const& pattern,
+                 size_t chunkSize=64 * 1024, size_t maxExcerptLength=1024);
+
+  /**
+   * Search the output written so far.
+   *
+   * @param onMatch Called with each match, in the order of the output.  Return false to stop the search.
+   * @param maxMatches Maximum number of matches to report.  Zero means unlimited.
+   *
+   * @return The number of matches reported.
+   */
+  size_t search(MatchCallback const& onMatch, size_t maxMatches=0);
+
+  /** Number of bytes in the lines to scan, which are fewer than the retained output if indexed. */
+  inline size_t scannedBytes() const { return _scannedBytes; }
+
+  /** The literal used to locate the candidate lines. */
+  inline std::string const& literal() const { return _literal; }
+
+  /**
+   * Find the first occurrence of {@arg literal} in {@arg data}, using SSE2 if available.
+   *
+   * @return Pointer to the occurrence, or NULL if not found.
+   */
+  static const char *findLiteral(const char *data, size_t count, std::string const& literal);
+
+  /**
+   * Get the longest literal string which must appear in any match of the regular expression
+   * {@arg pattern}.  Only simple patterns are understood; otherwise an empty string is returned.
+   */
+  static std::string requiredLiteral(std::string const& pattern);
+};
+
+
+#endif //ML_GRIDENGINE_EXECUTOR_OUTPUTSEARCHER_H
@@ -0,0 +1,212 @@
+#include <algorithm>
+#include <Poco/Exception.h>
+#include <Poco/Thread.h>
+#include "OutputStreamRegistry.h"
+#include "TimeIndex.h"
+
+namespace {
+  /**
+   * Share {@arg remaining} bytes among the allocations by {@arg weights}, without raising any
+   * of them beyond its cap.  The shares of the allocations reaching their caps go to the rest.
+   *
+   * @return The bytes left over once all the caps have been reached.
+   */
+  size_t waterFill(std::vector<size_t> &alloc, std::vector<size_t> const& caps,
+                   std::vector<double> const& weights, size_t remaining) {
+    std::vector<size_t> active;
+    for (size_t i=0; i<alloc.size(); ++i) {
+      if (alloc[i] < caps[i]) {
+        active.push_back(i);
+      }
+    }
+    while (remaining > 0 && !active.empty()) {
+      double totalWeight = 0;
+      for (size_t i: active) {
+        totalWeight += weights[i];
+      }
+      std::vector<size_t> wanting;
+      size_t given = 0;
+      for (size_t i: active) {
+        size_t share = (size_t)(remaining * (weights[i] / totalWeight));
+        if (alloc[i] + share >= caps[i]) {
+          given += caps[i] - alloc[i];
+          alloc[i] = caps[i];
+        } else {
+          wanting.push_back(i);
+        }
+      }
+      if (wanting.size() == active.size()) {
+        // none reached its cap, so everyone takes its full share
+        for (size_t i: active) {
+          size_t share = (size_t)(remaining * (weights[i] / totalWeight));
+          alloc[i] += share;
+          given += share;
+        }
+        return remaining - given;
+      }
+      remaining -= given;
+      active.swap(wanting);
+    }
+    return remaining;
+  }
+}
+
+OutputStreamRegistry::OutputStreamRegistry(size_t budget, size_t minLimit) :
+  _budget(std::max(budget, (size_t)1)),
+  _minLimit(minLimit),
+  _lastRebalance(TimeIndex::now()),
+  _thread(nullptr),
+  _running(false)
+{
+}
+
+OutputStreamRegistry::~OutputStreamRegistry() {
+  stop();
+}
+
+OutputStreamRegistry::Stream *OutputStreamRegistry::_find(std::string const& name) {
+  for (Stream &stream: _streams) {
+    if (stream.name == name) {
+      return &stream;
+    }
+  }
+  return nullptr;
+}
+
+OutputStreamRegistry::Stream const *OutputStreamRegistry::_find(std::string const& name) const {
+  return const_cast<OutputStreamRegistry*>(this)->_find(name);
+}
+
+void OutputStreamRegistry::add(std::string const& name, OutputBuffer *buffer, int priority, size_t reserved) {
+  Poco::Mutex::ScopedLock scopedLock(_mutex);
+  if (_find(name)) {
+    throw Poco::ExistsException("Output stream already registered: " + name);
+  }
+  Stream stream;
+  stream.name = name;
+  stream.buffer = buffer;
+  stream.priority = std::max(priority, 1);
+  stream.reserved = reserved;
+  stream.reads = stream.lastReads = 0;
+  stream.readRate = 0;
+  _streams.push_back(stream);
+  _rebalance(TimeIndex::now());
+}
+
+OutputBuffer *OutputStreamRegistry::get(std::string const& name) const {
+  Poco::Mutex::ScopedLock scopedLock(_mutex);
+  Stream const *stream = _find(name);
+  return stream ? stream->buffer : nullptr;
+}
+
+void OutputStreamRegistry::recordRead(std::string const& name) {
+  Poco::Mutex::ScopedLock scopedLock(_mutex);
+  Stream *stream = _find(name);
+  if (stream) {
+    ++stream->reads;
+  }
+}
+
+std::vector<OutputStreamInfo> OutputStreamRegistry::list() const {
+  Poco::Mutex::ScopedLock scopedLock(_mutex);
+  std::vector<OutputStreamInfo> ret;
+  for (Stream const& stream: _streams) {
+    OutputStreamInfo info;
+    info.name = stream.name;
+    info.priority = stream.priority;
+    info.reserved = stream.reserved > 0 ? stream.reserved : _minLimit;
+    info.capacityLimit = stream.buffer->capacityLimit();
+    info.size = stream.buffer->size();
+    info.writtenBytes = stream.buffer->writtenBytes();
+    info.reads = stream.reads;
+    info.readRate = stream.readRate;
+    info.closed = stream.buffer->closed();
+    ret.push_back(info);
+  }
+  return ret;
+}
+
+void OutputStreamRegistry::_rebalance(int64_t now) {
+  size_t n = _streams.size();
+  if (now > _lastRebalance) {
+    double seconds = (now - _lastRebalance) / 1e6;
+    for (Stream &stream: _streams) {
+      stream.readRate = 0.5 * stream.readRate + 0.5 * ((stream.reads - stream.lastReads) / seconds);
+      stream.lastReads = stream.reads;
+    }
+    _lastRebalance = now;
+  }
+
+  // what each stream has use for, and what it may take at most
+  std::vector<size_t> demands(n), caps(n), floors(n);
+  std::vector<double> weights(n);
+  size_t totalFloor = 0;
+  for (size_t i=0; i<n; ++i) {
+    Stream const& stream = _streams[i];
+    size_t capacity = std::min(stream.buffer->capacity(), _budget);
+    size_t writtenBytes = stream.buffer->writtenBytes();
+    bool closed = stream.buffer->closed();
+    size_t demand = closed ? stream.buffer->size() : std::max(_minLimit, writtenBytes + std::min(writtenBytes, capacity));
+    demands[i] = std::min(demand, capacity);
+    caps[i] = closed ? demands[i] : capacity;
+    floors[i] = std::min(demands[i], stream.reserved > 0 ? stream.reserved : _minLimit);
+    if (!stream.buffer->releasesMemory()) {
+      // the memory is held whatever the limit, so the stream keeps what it holds and never grows
+      // beyond its reservation
+      size_t reserved = stream.reserved > 0 ? stream.reserved : _minLimit;
+      floors[i] = demands[i] = caps[i] = std::min(std::max(reserved, stream.buffer->ringCapacity()), capacity);
+    }
+    weights[i] = stream.priority * (1 + stream.readRate);
+    totalFloor += floors[i];
+  }
+
+  // the reservations first, then the rest by the weights
+  std::vector<size_t> alloc(floors);
+  size_t remaining = _budget;
+  if (totalFloor > _budget) {
+    for (size_t i=0; i<n; ++i) {
+      alloc[i] = (size_t)((double)floors[i] * _budget / totalFloor);
+    }
+    remaining = 0;
+  } else {
+    remaining -= totalFloor;
+  }
+  remaining = waterFill(alloc, demands, weights, remaining);
+  waterFill(alloc, caps, weights, remaining);
+
+  for (size_t i=0; i<n; ++i) {
+    _streams[i].buffer->setCapacityLimit(alloc[i]);
+  }
+}
+
+void OutputStreamRegistry::rebalance() {
+  Poco::Mutex::ScopedLock scopedLock(_mutex);
+  _rebalance(TimeIndex::now());
+}
+
+void OutputStreamRegistry::_run(long intervalMillis) {
+  while (!_stopEvent.tryWait(intervalMillis)) {
+    rebalance();
+  }
+}
+
+void OutputStreamRegistry::start(long intervalMillis) {
+  if (_running) {
+    throw Poco::IllegalStateException("The output stream arbiter has already started.");
+  }
+  _thread = new Poco::Thread();
+  _thread->startFunc([this, intervalMillis] {
+    this->_run(intervalMillis);
+  });
+  _running = true;
+}
+
+void OutputStreamRegistry::stop() {
+  if (_running) {
+    _stopEvent.set();
+    _thread->join();
+    _running = false;
+  }
+  delete _thread;
+  _thread = nullptr;
+}
@@ -0,0 +1,139 @@
+#ifndef ML_GRIDENGINE_EXECUTOR_OUTPUTSTREAMREGISTRY_H
+#define ML_GRIDENGINE_EXECUTOR_OUTPUTSTREAMREGISTRY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <Poco/Event.h>
+#include <Poco/Mutex.h>
+#include "OutputBuffer.h"
+
+namespace Poco {
+  class Thread;
+}
+
+/** State of a named output stream. */
+struct OutputStreamInfo {
+  /** Name of the stream, e.g., "main", "stderr" or "run-after". */
+  std::string name;
+  /** Priority of the stream, a larger one takes a larger share of the spare budget. */
+  int priority;
+  /** Bytes of the budget reserved for the stream, when it has use for them. */
+  size_t reserved;
+  /** Number of bytes the stream may currently retain. */
+  size_t capacityLimit;
+  /** Number of bytes retained in the ring of the stream. */
+  size_t size;
+  /** Number of bytes ever written into the stream. */
+  size_t writtenBytes;
+  /** Number of reads recorded of the stream. */
+  size_t reads;
+  /** Recent number of reads per second, smoothed. */
+  double readRate;
+  /** Whether or not the stream has been closed. */
+  bool closed;
+
+  OutputStreamInfo() : priority(0), reserved(0), capacityLimit(0), size(0), writtenBytes(0), reads(0),
+                       readRate(0), closed(false) {}
+};
+
+/**
+ * Named output streams, e.g., the main program, its stderr, the run-after command and extra
+ * file descriptors, whose buffers draw from a single memory budget.
+ *
+ * Each buffer is created with the whole budget as its capacity, and the registry limits how
+ * much of it each one may retain, see {@code OutputBuffer::setCapacityLimit}.  The arbiter
+ * rebalances the limits as follows:
+ *
+ * 1. Each stream gets its reserved bytes (or {@code minLimit} if none reserved), as far as it
+ *    has use for them, scaled down if the reservations exceed the budget.  A live stream has
+ *    use for twice its written bytes, and a closed one for its retained bytes.
+ * 2. The rest of the budget is shared by the weights of the streams still wanting more,
+ *    first up to their use, then up to their capacity for the live streams.  The weight is
+ *    the priority times one plus the recent read rate, i.e., it goes to the streams which are
+ *    read most or matter most.
+ *
+ * A stream never retains more than its limit.  Shrinking a limit evicts the oldest bytes of that
+ * stream at once, and gives back the ring pages where the store supports it.  A store which does
+ * not (see {@code OutputBuffer::releasesMemory}), e.g., the malloc fallback or a ring file, holds
+ * the memory it has grown to, so its stream is pinned to its reservation, or to the memory it
+ * already holds if more, and takes no share of the spare budget.  Thus the budget is respected as
+ * long as the reservations fit in it, apart from the copies a malloc ring leaves behind while
+ * growing for its optimistic readers.
+ */
+class OutputStreamRegistry {
+private:
+  struct Stream {
+    std::string name;
+    OutputBuffer *buffer;
+    int priority;
+    size_t reserved;
+    size_t reads;       // number of reads ever recorded
+    size_t lastReads;   // number of reads at the last rebalance
+    double readRate;    // smoothed number of reads per second
+  };
+
+  size_t _budget;
+  size_t _minLimit;
+  mutable Poco::Mutex _mutex;
+  std::vector<Stream> _streams;
+  int64_t _lastRebalance;
+
+  Poco::Thread *_thread;
+  Poco::Event _stopEvent;
+  volatile bool _running;
+
+  /** Find the stream {@arg name}.  The caller must hold the mutex. */
+  Stream *_find(std::string const& name);
+  Stream const *_find(std::string const& name) const;
+
+  /** Compute and apply the limits.  The caller must hold the mutex. */
+  void _rebalance(int64_t now);
+
+  void _run(long intervalMillis);
+
+public:
+  /**
+   * Construct a new {@class OutputStreamRegistry}.
+   *
+   * @param budget Total number of bytes which the buffers may retain.
+   * @param minLimit Bytes reserved for a stream without its own reservation.
+   */
+  explicit OutputStreamRegistry(size_t budget, size_t minLimit=64 * 1024);
+
+  ~OutputStreamRegistry();
+
+  /** Total number of bytes which the buffers may retain. */
+  inline size_t budget() const { return _budget; }
+
+  /**
+   * Register a stream, and rebalance the limits.  The registry does not own {@arg buffer}.
+   *
+   * @param priority Weight of the stream in sharing the spare budget, at least 1.
+   * @param reserved Bytes of the budget reserved for the stream.  Zero means {@code minLimit}.
+   * @throws Poco::ExistsException If the name has been registered.
+   */
+  void add(std::string const& name, OutputBuffer *buffer, int priority=1, size_t reserved=0);
+
+  /** The buffer of the stream {@arg name}, or NULL if not registered. */
+  OutputBuffer *get(std::string const& name) const;
+
+  /** Record a read of the stream {@arg name}, which raises its weight. */
+  void recordRead(std::string const& name);
+
+  /** All the streams, in the order of registration. */
+  std::vector<OutputStreamInfo> list() const;
+
+  /** Rebalance the limits at once. */
+  void rebalance();
+
+  /** Start the arbiter, which rebalances every {@arg intervalMillis}. */
+  void start(long intervalMillis);
+
+  /** Stop the arbiter. */
+  void stop();
+};
+
+
+#endif //ML_GRIDENGINE_EXECUTOR_OUTPUTSTREAMREGISTRY_H
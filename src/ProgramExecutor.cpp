@@ -2,9 +2,11 @@
 // Created by 许昊文 on 2018/11/12.
 //
 
+#include <algorithm>
 #include <cstdio>
 #include <errno.h>
 #include <signal.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/wait.h>
@@ -14,6 +16,7 @@
 #include <Poco/RunnableAdapter.h>
 #include <Poco/Thread.h>
 #include <Poco/Environment.h>
+#include <Poco/Format.h>
 #include <Poco/NumberParser.h>
 #include "ProgramExecutor.h"
 #include "Logger.h"
@@ -34,6 +37,26 @@ namespace {
     return std::string(strerror(errno));
   }
 
+  /** Closes the file descriptors when leaving the scope, unless dismissed. */
+  class FdGuard {
+  private:
+    std::vector<int> &_fds;
+    bool _dismissed;
+
+  public:
+    explicit FdGuard(std::vector<int> &fds) : _fds(fds), _dismissed(false) {}
+
+    ~FdGuard() {
+      if (!_dismissed) {
+        for (int fd: _fds) {
+          close(fd);
+        }
+      }
+    }
+
+    void dismiss() { _dismissed = true; }
+  };
+
   EnvironMap& getDefaultEnvironMap() {
     static EnvironMap environMap = {
         {"PYTHONUNBUFFERED", "1"}
@@ -43,8 +66,9 @@ namespace {
 }
 
 ProgramExecutor::ProgramExecutor(ArgList args, EnvironMap environMap, Path workDir, bool captureOutput,
-                                 std::string const& loggingTag) :
+                                 std::string const& loggingTag, bool separateStderr) :
   _captureOutput(captureOutput),
+  _separateStderr(separateStderr),
   _loggingTag(loggingTag),
   _args(std::move(args)),
   _environ(std::move(environMap)),
@@ -56,7 +80,8 @@ ProgramExecutor::ProgramExecutor(ArgList args, EnvironMap environMap, Path workD
   _status(NOT_STARTED),
   _waitStatus(0),
   _processId(-1),
-  _pipeFd(0)
+  _pipeFd(0),
+  _stderrPipeFd(-1)
 {
   if (_args.empty()) {
     throw Poco::InvalidArgumentException("`args` must not be empty.");
@@ -81,21 +106,59 @@ void ProgramExecutor::start() {
     throw Poco::IllegalStateException("Process is already started.");
   }
 
+  std::vector<int> xfds;  // the read and write ends of the extra output pipes, interleaved
+  FdGuard xfdsGuard(xfds);
+  for (size_t i=0; i<_extraOutputs.size(); ++i) {
+    int xfd[2];
+    if (pipe(xfd) != 0) {
+      throw Poco::SystemException("Failed to open pipe: " + errorMessage());
+    }
+    xfds.push_back(xfd[0]);
+    xfds.push_back(xfd[1]);
+  }
+
   int pfd[2] = {0};
+  int efd[2] = {-1, -1};
   if (_captureOutput) {
     if (pipe(pfd) != 0) {
       throw Poco::SystemException("Failed to open pipe: " + errorMessage());
     }
+    if (_separateStderr && pipe(efd) != 0) {
+      close(pfd[0]);
+      close(pfd[1]);
+      throw Poco::SystemException("Failed to open pipe: " + errorMessage());
+    }
   }
 
+  // both processes take over the pipes from here
+  xfdsGuard.dismiss();
   _processId = fork();
   if (_processId == 0) {  // child process
     if (_captureOutput) {
       close(pfd[0]);
       _pipeFd = pfd[1];
-      // redirect stdout and stderr to the pipe
+      // redirect stdout and stderr to the pipe, or stderr to its own pipe if separated
       dup2(_pipeFd, STDOUT_FILENO);
-      dup2(_pipeFd, STDERR_FILENO);
+      if (_separateStderr) {
+        close(efd[0]);
+        dup2(efd[1], STDERR_FILENO);
+      } else {
+        dup2(_pipeFd, STDERR_FILENO);
+      }
+    }
+    if (!_extraOutputs.empty()) {
+      // move the pipes above all the target fds first, so that none is replaced by another
+      int minFd = *std::max_element(_extraOutputs.begin(), _extraOutputs.end()) + 1;
+      for (size_t i=0; i<_extraOutputs.size(); ++i) {
+        close(xfds[i * 2]);
+        int writeFd = fcntl(xfds[i * 2 + 1], F_DUPFD, minFd);
+        close(xfds[i * 2 + 1]);
+        xfds[i * 2 + 1] = writeFd;
+      }
+      for (size_t i=0; i<_extraOutputs.size(); ++i) {
+        dup2(xfds[i * 2 + 1], _extraOutputs[i]);
+        close(xfds[i * 2 + 1]);
+      }
     }
 
     // change the current directory
@@ -141,6 +204,14 @@ void ProgramExecutor::start() {
     if (_captureOutput) {
       close(pfd[1]);
       _pipeFd = pfd[0];
+      if (_separateStderr) {
+        close(efd[1]);
+        _stderrPipeFd = efd[0];
+      }
+    }
+    for (size_t i=0; i<_extraOutputs.size(); ++i) {
+      close(xfds[i * 2 + 1]);
+      _extraPipeFds.push_back(xfds[i * 2]);
     }
     _status = RUNNING;
     _waitThread->startFunc([this] {
@@ -197,6 +268,26 @@ ssize_t ProgramExecutor::readOutput(void *target, size_t count) {
   return read(_pipeFd, target, count);
 }
 
+ssize_t ProgramExecutor::readError(void *target, size_t count) {
+  return read(_stderrPipeFd, target, count);
+}
+
+ssize_t ProgramExecutor::readExtraOutput(size_t index, void *target, size_t count) {
+  return read(_extraPipeFds[index], target, count);
+}
+
+void ProgramExecutor::setExtraOutputs(std::vector<int> const& fds) {
+  if (_status != NOT_STARTED) {
+    throw Poco::IllegalStateException("Extra outputs must be set before the program starts.");
+  }
+  for (int fd: fds) {
+    if (fd <= STDERR_FILENO) {
+      throw Poco::InvalidArgumentException(Poco::format("Extra output must not be a standard fd: %d", fd));
+    }
+  }
+  _extraOutputs = fds;
+}
+
 void ProgramExecutor::_killIfRunning(int signal) {
   Poco::Mutex::ScopedLock scopedLock(*_waitMutex);
   if (_status == RUNNING) {
@@ -232,6 +323,12 @@ void ProgramExecutor::kill(double firstWait, double secondWait, double finalWait
           Poco::Mutex::ScopedLock scopedLock2(*_waitMutex);
           _status = CANNOT_KILL;
           close(_pipeFd);  // force closing the pipe, in order for the IO controller to stop
+          if (_stderrPipeFd >= 0) {
+            close(_stderrPipeFd);
+          }
+          for (int fd: _extraPipeFds) {
+            close(fd);
+          }
           _waitCond->broadcast();  // notify all threads waiting on the process to exit
         }
       }
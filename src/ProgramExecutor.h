@@ -38,6 +38,7 @@ class ProgramExecutor {
 
 private:
   bool _captureOutput;
+  bool _separateStderr;
   std::string _loggingTag;
   Poco::Mutex *_waitMutex;          // mutex for operating on the wait condition
   Poco::Condition *_waitCond;       // the wait conditional variable
@@ -47,6 +48,9 @@ private:
   volatile int _waitStatus;         // waitpid status of the child process.
   int _processId;                   // ID of the child (program) process
   int _pipeFd;                      // pipe fd to read/write from/to the child process
+  int _stderrPipeFd;                // pipe fd of stderr, if separated from stdout
+  std::vector<int> _extraOutputs;   // fds of the program captured by their own pipes
+  std::vector<int> _extraPipeFds;   // pipe fds of the extra outputs, in the same order
 
   void _waitInBackground();
   void _killIfRunning(int signal);
@@ -82,9 +86,39 @@ public:
     if (_status == SIGNALLED) return WTERMSIG(_waitStatus); else return -1;
   }
 
-  /** Construct a new {@class ProgramExecutor}. */
+  /** Whether or not stderr is captured by a separated pipe. */
+  inline bool separateStderr() const { return _captureOutput && _separateStderr; }
+
+  /** The pipe fd of the program output, i.e., where {@code readOutput} reads from. */
+  inline int outputFd() const { return _pipeFd; }
+
+  /** The pipe fd of the program stderr, where {@code readError} reads from, or -1 if not separated. */
+  inline int errorFd() const { return _stderrPipeFd; }
+
+  /** The fds of the program captured by their own pipes, see {@code setExtraOutputs}. */
+  inline std::vector<int> const& extraOutputs() const { return _extraOutputs; }
+
+  /** The pipe fd of the extra output {@arg index}, where {@code readExtraOutput} reads from. */
+  inline int extraOutputFd(size_t index) const { return _extraPipeFds.at(index); }
+
+  /**
+   * Capture the fds {@arg fds} of the program (e.g., 3 for a metrics log written to "/dev/fd/3")
+   * by their own pipes, apart from stdout and stderr.  Must be called before {@code start}.
+   *
+   * @throw Poco::IllegalStateException If the program has started.
+   * @throw Poco::InvalidArgumentException If any of the fds is stdin, stdout or stderr.
+   */
+  void setExtraOutputs(std::vector<int> const& fds);
+
+  /**
+   * Construct a new {@class ProgramExecutor}.
+   *
+   * @param separateStderr If true, stderr is captured by its own pipe and read by {@code readError},
+   *                       instead of being merged into the output.
+   */
   explicit ProgramExecutor(ArgList args, EnvironMap environMap=EnvironMap(), Path workDir=Path(),
-                           bool captureOutput=true, std::string const& loggingTag="Program");
+                           bool captureOutput=true, std::string const& loggingTag="Program",
+                           bool separateStderr=false);
 
   /** Start the user program. */
   void start();
@@ -101,6 +135,24 @@ public:
    */
   ssize_t readOutput(void* target, size_t count);
 
+  /**
+   * Read program stderr from its pipe, if separated.  See {@code readOutput}.
+   *
+   * @param target Target array.
+   * @param count Maximum number of bytes to read.
+   * @return Actual number of bytes read.
+   */
+  ssize_t readError(void* target, size_t count);
+
+  /**
+   * Read the extra output {@arg index} from its pipe.  See {@code readOutput}.
+   *
+   * @param target Target array.
+   * @param count Maximum number of bytes to read.
+   * @return Actual number of bytes read.
+   */
+  ssize_t readExtraOutput(size_t index, void* target, size_t count);
+
   /**
    * Wait the user program to exit.
    *
@@ -0,0 +1,104 @@
+#include <string.h>
+#include "ProgressCompactor.h"
+#include "TimeIndex.h"
+
+ProgressCompactor::ProgressCompactor(Sink sink, int64_t interval, size_t maxPending) :
+  _sink(std::move(sink)),
+  _interval(interval),
+  _maxPending(maxPending),
+  _lastKept(INT64_MIN / 2),
+  _holding(false),
+  _inputBytes(0),
+  _outputBytes(0)
+{
+}
+
+void ProgressCompactor::_release() {
+  _output.insert(_output.end(), _pending.begin(), _pending.end());
+  _pending.clear();
+  _holding = false;
+}
+
+void ProgressCompactor::_emit() {
+  if (!_output.empty()) {
+    _outputBytes += _output.size();
+    _sink(_output.data(), _output.size());
+    _output.clear();
+  }
+}
+
+void ProgressCompactor::write(const Byte *data, size_t count) {
+  write(data, count, TimeIndex::now());
+}
+
+void ProgressCompactor::write(const Byte *data, size_t count, int64_t now) {
+  _inputBytes += count;
+
+  // most output contains no carriage return, which passes through as-is
+  if (!_holding && !memchr(data, '\r', count)) {
+    _outputBytes += count;
+    _sink(data, count);
+    return;
+  }
+
+  const Byte *p = data, *end = data + count;
+  while (p < end) {
+    if (!_holding) {
+      const Byte *cr = (const Byte*)memchr(p, '\r', end - p);
+      if (!cr) {
+        _output.insert(_output.end(), p, end);
+        break;
+      }
+      _output.insert(_output.end(), p, cr);
+      _pending.assign(1, '\r');
+      _holding = true;
+      p = cr + 1;
+      continue;
+    }
+
+    // holding a redraw, until the next carriage return or newline
+    const Byte *q = p;
+    while (q < end && *q != '\r' && *q != '\n') {
+      ++q;
+    }
+    _pending.insert(_pending.end(), p, q);
+    if (_pending.size() >= _maxPending) {
+      // the rest of such a long redraw passes through, until the next carriage return
+      _lastKept = now;
+      _release();
+      p = q;
+      continue;
+    }
+    if (q == end) {
+      break;
+    }
+    if (*q == '\n') {
+      // the final state of the line is always kept ("\r\n" is just a newline)
+      _release();
+      _output.push_back('\n');
+    } else if (_pending.size() > 1 && now - _lastKept >= _interval) {
+      _lastKept = now;
+      _output.insert(_output.end(), _pending.begin(), _pending.end());
+      _pending.assign(1, '\r');
+    } else {
+      // the redraw is overwritten by the next one
+      _pending.assign(1, '\r');
+    }
+    p = q + 1;
+  }
+  _emit();
+}
+
+void ProgressCompactor::flushIfStale(int64_t now) {
+  if (_holding && _pending.size() > 1 && now - _lastKept >= _interval) {
+    _lastKept = now;
+    flush();
+  }
+}
+
+void ProgressCompactor::flush() {
+  if (_holding) {
+    _release();
+    _emit();
+  }
+}
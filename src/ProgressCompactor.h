@@ -0,0 +1,86 @@
+#ifndef ML_GRIDENGINE_EXECUTOR_PROGRESSCOMPACTOR_H
+#define ML_GRIDENGINE_EXECUTOR_PROGRESSCOMPACTOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+#include <vector>
+
+typedef unsigned char Byte;
+
+/**
+ * Ingest stage which collapses the progress bars redrawn by carriage returns.
+ *
+ * Progress bars (e.g., tqdm) redraw a line by writing {@code "\r"} followed by the new state,
+ * many times per second.  A redraw is held back until the next {@code "\r"} or {@code "\n"}
+ * arrives: the final state of a line is always kept, while intermediate redraws are dropped
+ * unless {@code interval} has elapsed since the last one kept, so that live readers still see
+ * the progress.  Other output passes through unchanged, and the bytes already passed on are
+ * never changed, so the positions of the compacted output stay consistent.  A redraw reaching
+ * {@code maxPending} bytes is passed on rather than held, so a long line ending with no newline
+ * is never buffered without bound.
+ *
+ * This class is not thread-safe.  It is driven by the IO thread of {@class IOController}.
+ */
+class ProgressCompactor {
+public:
+  /** Where the compacted output goes. */
+  typedef std::function<void (const Byte *data, size_t count)> Sink;
+
+private:
+  Sink _sink;
+  int64_t _interval;          // minimum time between two kept redraws, in microseconds
+  size_t _maxPending;         // maximum size of the redraw held back
+  int64_t _lastKept;          // time of the last kept redraw
+  bool _holding;              // whether or not a redraw is being held back
+  std::vector<Byte> _pending; // the redraw held back, starting with "\r"
+  std::vector<Byte> _output;  // compacted output of the current chunk
+  size_t _inputBytes;
+  size_t _outputBytes;
+
+  /** Pass the held redraw on, and stop holding the rest of it. */
+  void _release();
+
+  /** Pass {@code _output} on to the sink. */
+  void _emit();
+
+public:
+  /**
+   * Construct a new {@class ProgressCompactor}.
+   *
+   * @param sink Where the compacted output goes.
+   * @param interval Minimum time between two redraws kept in the output, in microseconds.
+   * @param maxPending Maximum number of bytes of a redraw held back, e.g., the size of the IO buffer.
+   */
+  explicit ProgressCompactor(Sink sink, int64_t interval = 1000000, size_t maxPending = 8192);
+
+  /** Number of bytes written into the compactor. */
+  inline size_t inputBytes() const { return _inputBytes; }
+
+  /** Number of bytes passed on to the sink. */
+  inline size_t outputBytes() const { return _outputBytes; }
+
+  /** Number of bytes dropped or still held back. */
+  inline size_t savedBytes() const { return _inputBytes - _outputBytes; }
+
+  /** Minimum time between two kept redraws, in microseconds. */
+  inline int64_t interval() const { return _interval; }
+
+  /** Compact a chunk of output which arrived at {@arg now} (see {@code TimeIndex::now}). */
+  void write(const Byte *data, size_t count, int64_t now);
+
+  /** Compact a chunk of output which arrived just now. */
+  void write(const Byte *data, size_t count);
+
+  /**
+   * Pass the held redraw on, if it has been held for {@code interval} at {@arg now}.  This keeps
+   * the output of a progress bar up-to-date when the program is quiet.
+   */
+  void flushIfStale(int64_t now);
+
+  /** Pass the held redraw on, e.g., when the output has ended. */
+  void flush();
+};
+
+
+#endif //ML_GRIDENGINE_EXECUTOR_PROGRESSCOMPACTOR_H
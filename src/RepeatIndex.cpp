@@ -0,0 +1,88 @@
+#include <algorithm>
+#include <Poco/Format.h>
+#include "RepeatIndex.h"
+
+std::string RepeatIndex::marker(size_t repeats) {
+  return Poco::format("[repeated %z more times]\n", repeats);
+}
+
+size_t RepeatIndex::position(RepeatMode mode, size_t stored) const {
+  // the bytes put back by a record come right after its line, i.e., before `storedEnd`
+  auto it = std::upper_bound(_records.begin(), _records.end(), stored,
+                             [] (size_t value, Record const& r) { return value < r.storedEnd; });
+  if (it == _records.begin()) {
+    return stored + (it == _records.end() ? extraBytes(mode) : it->before(mode));
+  }
+  --it;
+  return stored + it->before(mode) + it->extra(mode);
+}
+
+RepeatSpan RepeatIndex::locate(RepeatMode mode, size_t position, size_t maxCount) const {
+  RepeatSpan ret;
+  ret.position = position;
+  auto it = std::upper_bound(_records.begin(), _records.end(), position,
+                             [mode] (size_t value, Record const& r) { return value < r.position(mode); });
+
+  // stored bytes before the first retained record
+  if (it == _records.begin()) {
+    size_t before = it == _records.end() ? extraBytes(mode) : it->before(mode);
+    ret.storedBegin = position - std::min(position, before);
+    if (it != _records.end()) {
+      ret.length = std::max((size_t)it->storedEnd, ret.storedBegin) - ret.storedBegin;
+    }
+    return ret;
+  }
+
+  auto prev = it - 1;
+  size_t offset = position - prev->position(mode);
+  size_t extra = prev->extra(mode);
+  if (offset < extra) {
+    // bytes put back by the previous record
+    ret.synthesized = true;
+    ret.storedBegin = prev->storedEnd;
+    ret.length = std::min(extra - offset, maxCount);
+    if (mode == REPEATS_MARKER) {
+      ret.content = marker(prev->repeats).substr(offset, ret.length);
+    } else {
+      std::string const& line = prev->line;
+      ret.content.reserve(ret.length);
+      size_t lineOffset = offset % line.size();
+      while (ret.content.size() < ret.length) {
+        size_t n = std::min(line.size() - lineOffset, ret.length - ret.content.size());
+        ret.content.append(line, lineOffset, n);
+        lineOffset = 0;
+      }
+    }
+    return ret;
+  }
+
+  // stored bytes between the previous record and the next one
+  ret.storedBegin = prev->storedEnd + (offset - extra);
+  if (it != _records.end()) {
+    ret.length = it->storedEnd - ret.storedBegin;
+  }
+  return ret;
+}
+
+void RepeatIndex::append(size_t storedEnd, std::string const& line, size_t repeats) {
+  Record r = {storedEnd, repeats, _markerBytes, _expandedBytes, line};
+  _records.push_back(r);
+  _memoryBytes += sizeof(Record) + line.size();
+  _markerBytes += r.extra(REPEATS_MARKER);
+  _expandedBytes += r.extra(REPEATS_EXPANDED);
+  _repeatedLines += repeats;
+}
+
+void RepeatIndex::trim(size_t begin) {
+  while (!_records.empty() && _records.front().storedEnd < begin) {
+    _memoryBytes -= sizeof(Record) + _records.front().line.size();
+    _records.pop_front();
+  }
+}
+
+void RepeatIndex::fit(size_t maxBytes, size_t limit) {
+  while (_memoryBytes > maxBytes && _records.front().storedEnd < limit) {
+    _memoryBytes -= sizeof(Record) + _records.front().line.size();
+    _records.pop_front();
+  }
+}
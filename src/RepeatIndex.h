@@ -0,0 +1,126 @@
+#ifndef ML_GRIDENGINE_EXECUTOR_REPEATINDEX_H
+#define ML_GRIDENGINE_EXECUTOR_REPEATINDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <deque>
+#include <string>
+
+/** How the repeated lines omitted from the stored output are presented to readers. */
+typedef enum {
+  REPEATS_MARKER = 0,   // a "[repeated N more times]" line after the stored line
+  REPEATS_EXPANDED = 1  // the stored line repeated as many times as it was written
+} RepeatMode;
+
+/**
+ * A run of the presented output, starting at some position.  It is either stored as-is in the
+ * output buffer, or synthesized from a run of repeated lines.
+ */
+struct RepeatSpan {
+  /** Beginning position in the presented output. */
+  size_t position;
+  /** Whether or not the run is synthesized, in which case {@code content} holds its bytes. */
+  bool synthesized;
+  /** Beginning position in the stored output, or the end of the repeated line if synthesized. */
+  size_t storedBegin;
+  /** Number of bytes of the run.  Zero means all the stored output till the end. */
+  size_t length;
+  /** The synthesized bytes. */
+  std::string content;
+
+  RepeatSpan() : position(0), synthesized(false), storedBegin(0), length(0) {}
+};
+
+/**
+ * Index of the runs of repeated lines omitted from the stored output.
+ *
+ * Each record is a line stored once, followed by a number of identical lines which were not
+ * stored.  The presented output is the stored output with each record's omitted lines put back,
+ * either as a marker line or expanded, so its positions are the stored positions shifted by the
+ * bytes put back before them.  Records keep a copy of their line, so that they can still be
+ * presented after the stored line has been evicted.  The oldest records may be dropped by
+ * {@code fit} to bound the memory, after which their lines are presented as stored.
+ *
+ * This class is not thread-safe.  {@class OutputBuffer} maintains it under its own lock.
+ */
+class RepeatIndex {
+private:
+  struct Record {
+    uint64_t storedEnd;       // stored position right after the repeated line
+    uint64_t repeats;         // number of omitted lines
+    uint64_t markerBefore;    // marker bytes put back before this record
+    uint64_t expandedBefore;  // expanded bytes put back before this record
+    std::string line;         // the repeated line, including the newline
+
+    /** Number of bytes put back before this record in {@arg mode}. */
+    inline size_t before(RepeatMode mode) const {
+      return mode == REPEATS_MARKER ? markerBefore : expandedBefore;
+    }
+
+    /** Number of bytes put back by this record in {@arg mode}. */
+    inline size_t extra(RepeatMode mode) const {
+      return mode == REPEATS_MARKER ? marker(repeats).size() : repeats * line.size();
+    }
+
+    /** Position where the bytes put back by this record begin, in the presented output. */
+    inline size_t position(RepeatMode mode) const {
+      return storedEnd + before(mode);
+    }
+  };
+
+  std::deque<Record> _records;
+  size_t _memoryBytes;    // memory taken by the records
+  size_t _markerBytes;    // marker bytes ever put back
+  size_t _expandedBytes;  // expanded bytes ever put back
+  size_t _repeatedLines;  // number of lines ever omitted
+
+public:
+  RepeatIndex() : _memoryBytes(0), _markerBytes(0), _expandedBytes(0), _repeatedLines(0) {}
+
+  /** The marker line presented for {@arg repeats} omitted lines. */
+  static std::string marker(size_t repeats);
+
+  /** Number of records in the index. */
+  inline size_t recordCount() const { return _records.size(); }
+
+  /** Memory taken by the records, including their lines. */
+  inline size_t memoryBytes() const { return _memoryBytes; }
+
+  /** Number of lines ever omitted from the stored output. */
+  inline size_t repeatedLines() const { return _repeatedLines; }
+
+  /** Number of bytes ever omitted from the stored output. */
+  inline size_t repeatedBytes() const { return _expandedBytes; }
+
+  /** Number of bytes put back into the presented output of {@arg mode}. */
+  inline size_t extraBytes(RepeatMode mode) const {
+    return mode == REPEATS_MARKER ? _markerBytes : _expandedBytes;
+  }
+
+  /** Position in the presented output of {@arg mode}, of the stored byte at {@arg stored}. */
+  size_t position(RepeatMode mode, size_t stored) const;
+
+  /**
+   * Locate the run of the presented output of {@arg mode} at {@arg position}.
+   *
+   * @param maxCount Maximum number of bytes to synthesize, if the run is synthesized.
+   * @return The run, starting at {@arg position}.  If the stored bytes at {@arg position} have
+   *         been trimmed, the run still starts at the stored position they would have.
+   */
+  RepeatSpan locate(RepeatMode mode, size_t position, size_t maxCount) const;
+
+  /**
+   * Record that {@arg repeats} lines identical to {@arg line} were omitted after the stored
+   * position {@arg storedEnd}, which must be after the previous record.
+   */
+  void append(size_t storedEnd, std::string const& line, size_t repeats);
+
+  /** Drop the records of the lines ending before stored position {@arg begin}. */
+  void trim(size_t begin);
+
+  /** Drop the oldest records of the lines ending before {@arg limit}, until the index takes at most {@arg maxBytes}. */
+  void fit(size_t maxBytes, size_t limit);
+};
+
+
+#endif //ML_GRIDENGINE_EXECUTOR_REPEATINDEX_H
@@ -0,0 +1,420 @@
+#include <algorithm>
+#include <cstdlib>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <Poco/Clock.h>
+#include <Poco/Exception.h>
+#include "RingStore.h"
+#include "client/ml_gridengine_ring.h"
+#include "Logger.h"
+#include "macros.h"
+
+#define RING_FILE_MAGIC MLGE_RING_MAGIC
+#define RING_FILE_VERSION MLGE_RING_VERSION
+
+// the client library reads the header by its own declaration
+static_assert(sizeof(RingFileHeader) == sizeof(mlge_ring_header) &&
+              offsetof(RingFileHeader, sequence) == offsetof(mlge_ring_header, sequence) &&
+              offsetof(RingFileHeader, validBegin) == offsetof(mlge_ring_header, valid_begin) &&
+              offsetof(RingFileHeader, closed) == offsetof(mlge_ring_header, closed),
+              "RingFileHeader must have the same layout as mlge_ring_header.");
+
+namespace {
+  inline std::string errorMessage() {
+    return std::string(strerror(errno));
+  }
+
+  /**
+   * Give back the pages entirely within the {@arg length} bytes at {@arg data}, by {@arg advice}.
+   * The partial pages at both ends are kept, since they may still hold retained bytes.
+   */
+  void releasePages(Byte *data, size_t length, int advice) {
+    uintptr_t pageSize = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t begin = ((uintptr_t)data + pageSize - 1) / pageSize * pageSize;
+    uintptr_t end = ((uintptr_t)data + length) / pageSize * pageSize;
+    if (begin < end) {
+      madvise((void*)begin, end - begin, advice);
+    }
+  }
+
+  int createMemoryFile(char const *name) {
+#ifdef SYS_memfd_create
+    return (int)syscall(SYS_memfd_create, name, 1U /* MFD_CLOEXEC */);
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+  }
+
+  /**
+   * Map {@arg capacity} bytes of the file {@arg fd} at {@arg offset} twice back-to-back.
+   *
+   * @return The address of the first copy, or NULL if failed.
+   */
+  Byte* mapMirrored(int fd, off_t offset, size_t capacity, char const *what) {
+    // reserve the address space for both copies, then map the file onto each half
+    void *addr = mmap(nullptr, capacity << 1, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED) {
+      Logger::getLogger().warn("Cannot reserve memory for the %s: %s", std::string(what), errorMessage());
+      return nullptr;
+    }
+    if (mmap(addr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, offset) == MAP_FAILED ||
+        mmap((Byte*)addr + capacity, capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, offset) == MAP_FAILED) {
+      Logger::getLogger().warn("Cannot map the file of the %s: %s", std::string(what), errorMessage());
+      munmap(addr, capacity << 1);
+      return nullptr;
+    }
+    return (Byte*)addr;
+  }
+
+  /** A copy of the positions in a {@class RingFileHeader}. */
+  struct RingFilePositions {
+    uint64_t head;
+    uint64_t size;
+    uint64_t writtenBytes;
+    bool closed;
+    bool torn;    // the writer died while updating them, so they may mix two updates
+  };
+
+  /** Whether or not the {@arg fileSize} bytes starting at {@arg header} are a valid ring file. */
+  bool isRingFile(RingFileHeader const *header, size_t fileSize) {
+    return fileSize >= sizeof(RingFileHeader) &&
+           memcmp(header->magic, RING_FILE_MAGIC, sizeof(header->magic)) == 0 &&
+           header->version == RING_FILE_VERSION &&
+           header->dataOffset >= sizeof(RingFileHeader) &&
+           header->capacity > 0 &&
+           fileSize >= header->dataOffset + header->capacity;
+  }
+
+  /**
+   * Take a consistent copy of the positions, waiting while the writer is updating them.
+   *
+   * A writer killed amid an update leaves {@code sequence} odd forever, so it is taken as dead
+   * after {@code ML_GRIDENGINE_RING_WRITER_TIMEOUT_MILLIS}, and the positions are copied as they
+   * are, marked as torn.
+   */
+  RingFilePositions loadPositions(RingFileHeader const *header) {
+    Poco::Clock start;
+    for (unsigned spins=0;; ++spins) {
+      uint64_t sequence = header->sequence.load(std::memory_order_acquire);
+      bool torn = (sequence & 1) && start.elapsed() >= ML_GRIDENGINE_RING_WRITER_TIMEOUT_MILLIS * 1000L;
+      if ((sequence & 1) && !torn) {
+        // a live writer holds it for a few stores, unless it has been preempted
+        if (spins < 100) {
+          sched_yield();
+        } else {
+          usleep(1000);
+        }
+        continue;
+      }
+      RingFilePositions ret;
+      ret.head = header->head.load(std::memory_order_relaxed);
+      ret.size = header->size.load(std::memory_order_relaxed);
+      ret.writtenBytes = header->writtenBytes.load(std::memory_order_relaxed);
+      ret.closed = header->closed.load(std::memory_order_relaxed) != 0;
+      ret.torn = torn;
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (torn || header->sequence.load(std::memory_order_relaxed) == sequence) {
+        return ret;
+      }
+    }
+  }
+}
+
+MallocRingStore::MallocRingStore(size_t capacity) :
+  _data((Byte*)malloc(capacity)),
+  _capacity(capacity)
+{
+  if (_data == nullptr && capacity > 0) {
+    throw Poco::OutOfMemoryException("Cannot allocate the output buffer.");
+  }
+}
+
+MallocRingStore::~MallocRingStore() {
+  free(_data);
+}
+
+ReservedRingStore* ReservedRingStore::create(size_t capacity) {
+  capacity = std::max(capacity, (size_t)1);
+  void *addr = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (addr == MAP_FAILED) {
+    Logger::getLogger().warn("Cannot reserve memory for the output buffer: %s", errorMessage());
+    return nullptr;
+  }
+  return new ReservedRingStore((Byte*)addr, capacity);
+}
+
+ReservedRingStore::~ReservedRingStore() {
+  munmap(_data, _capacity);
+}
+
+void ReservedRingStore::release() {
+  madvise(_data, _capacity, MADV_DONTNEED);
+}
+
+void ReservedRingStore::releaseRange(size_t offset, size_t length) {
+  releasePages(_data + offset, length, MADV_DONTNEED);
+}
+
+MirroredRingStore* MirroredRingStore::create(size_t capacity) {
+  size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+  capacity = std::max((capacity + pageSize - 1) / pageSize * pageSize, pageSize);
+
+  int fd = createMemoryFile("ml-gridengine-output");
+  if (fd < 0) {
+    Logger::getLogger().warn("Cannot create memory file for the mirrored output buffer: %s", errorMessage());
+    return nullptr;
+  }
+
+  Byte *data = nullptr;
+  if (ftruncate(fd, capacity) != 0) {
+    Logger::getLogger().warn("Cannot resize memory file for the mirrored output buffer: %s", errorMessage());
+  } else {
+    data = mapMirrored(fd, 0, capacity, "mirrored output buffer");
+  }
+  close(fd);  // the mappings keep the memory file alive
+
+  return data ? new MirroredRingStore(data, capacity) : nullptr;
+}
+
+MirroredRingStore::~MirroredRingStore() {
+  munmap(_data, _capacity << 1);
+}
+
+void MirroredRingStore::release() {
+  // the pages belong to the memory file, which has to be punched rather than just unmapped
+  madvise(_data, _capacity, MADV_REMOVE);
+}
+
+void MirroredRingStore::releaseRange(size_t offset, size_t length) {
+  releasePages(_data + offset, length, MADV_REMOVE);
+}
+
+FileRingStore* FileRingStore::create(std::string const& path, size_t capacity) {
+  static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2,
+                "The ring file header requires lock-free atomics, which can be shared between processes.");
+  size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+  capacity = std::max((capacity + pageSize - 1) / pageSize * pageSize, pageSize);
+
+  // Never overwrite the output of a previous executor which has died while writing.
+  uint64_t generation = 1;
+  try {
+    RingFileContents previous = recover(path);
+    generation = previous.generation + 1;
+    if (!previous.closed && !previous.data.empty()) {
+      std::string keptPath = path + "." + std::to_string(previous.generation);
+      if (rename(path.c_str(), keptPath.c_str()) == 0) {
+        Logger::getLogger().warn("The ring file was not closed by the previous executor, %z bytes of its output "
+                                 "are kept in: %s", previous.data.size(), keptPath);
+      } else {
+        Logger::getLogger().warn("Cannot keep the unclosed ring file %s: %s", path, errorMessage());
+        return nullptr;
+      }
+    }
+  } catch (Poco::Exception const&) {
+    // not exist, or not a ring file, which can be overwritten
+  }
+
+  int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    Logger::getLogger().warn("Cannot create the ring file %s: %s", path, errorMessage());
+    return nullptr;
+  }
+  FileRingStore *store = _map(fd, path, capacity, generation);
+  if (!store) {
+    unlink(path.c_str());
+  }
+  return store;
+}
+
+FileRingStore* FileRingStore::createShared(std::string const& name, size_t capacity, unsigned mode) {
+  std::string shmName = "/" + (name.empty() || name[0] != '/' ? name : name.substr(1));
+  size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+  capacity = std::max((capacity + pageSize - 1) / pageSize * pageSize, pageSize);
+
+  // A previous segment whose lock is held belongs to a live executor, which is never taken over.
+  // Otherwise its executor is gone, and the segment may only be mapped by the readers, which are
+  // not disturbed by unlinking it, while the new readers can tell the new segment by its generation.
+  uint64_t generation = 1;
+  int fd = shm_open(shmName.c_str(), O_RDONLY | O_CLOEXEC, 0);
+  if (fd >= 0) {
+    if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+      Logger::getLogger().warn("The shared memory %s is still owned by a live executor.", shmName);
+      close(fd);
+      return nullptr;
+    }
+    RingFileHeader previous;
+    if (pread(fd, &previous, sizeof(previous), 0) == (ssize_t)sizeof(previous) &&
+        memcmp(previous.magic, RING_FILE_MAGIC, sizeof(previous.magic)) == 0) {
+      generation = previous.generation + 1;
+    }
+    Logger::getLogger().warn("Taking over the shared memory %s left by a dead executor.", shmName);
+    shm_unlink(shmName.c_str());
+    close(fd);
+  }
+
+  // the mode is set explicitly, such that the umask neither widens nor narrows it
+  fd = shm_open(shmName.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+  if (fd < 0) {
+    Logger::getLogger().warn("Cannot create the shared memory %s: %s", shmName, errorMessage());
+    return nullptr;
+  }
+  int ownerFd = -1;
+  if (flock(fd, LOCK_EX | LOCK_NB) != 0 || fchmod(fd, (mode_t)mode) != 0 ||
+      (ownerFd = fcntl(fd, F_DUPFD_CLOEXEC, 0)) < 0) {
+    Logger::getLogger().warn("Cannot set up the shared memory %s: %s", shmName, errorMessage());
+    close(fd);
+    shm_unlink(shmName.c_str());
+    return nullptr;
+  }
+  FileRingStore *store = _map(fd, shmName, capacity, generation);
+  if (!store) {
+    shm_unlink(shmName.c_str());
+    close(ownerFd);
+  } else {
+    store->_sharedName = shmName;
+    store->_ownerFd = ownerFd;
+  }
+  return store;
+}
+
+FileRingStore* FileRingStore::_map(int fd, std::string const& path, size_t capacity, uint64_t generation) {
+  size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+  RingFileHeader *header = nullptr;
+  Byte *data = nullptr;
+  if (ftruncate(fd, pageSize + capacity) != 0) {
+    Logger::getLogger().warn("Cannot resize the ring file %s: %s", path, errorMessage());
+  } else {
+    void *addr = mmap(nullptr, pageSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+      Logger::getLogger().warn("Cannot map the ring file %s: %s", path, errorMessage());
+    } else {
+      header = (RingFileHeader*)addr;
+      data = mapMirrored(fd, pageSize, capacity, "file output buffer");
+      if (!data) {
+        munmap(header, pageSize);
+      }
+    }
+  }
+  close(fd);  // the mappings keep the file open
+  if (!data) {
+    return nullptr;
+  }
+
+  // The file is zero-filled, so only the constant fields need to be set.  The magic comes
+  // last, such that a reader never sees a valid header with a wrong capacity.
+  header->version = RING_FILE_VERSION;
+  header->dataOffset = (uint32_t)pageSize;
+  header->capacity = capacity;
+  header->generation = generation;
+  std::atomic_thread_fence(std::memory_order_release);
+  memcpy(header->magic, RING_FILE_MAGIC, sizeof(header->magic));
+  return new FileRingStore(header, data, capacity);
+}
+
+RingFileContents FileRingStore::recover(std::string const& path) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    throw Poco::FileException("Cannot open the ring file " + path + ": " + errorMessage());
+  }
+  struct stat st;
+  void *addr = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+    addr = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (addr == MAP_FAILED) {
+    throw Poco::FileException("Cannot map the ring file " + path + ": " + errorMessage());
+  }
+
+  size_t fileSize = (size_t)st.st_size;
+  RingFileHeader const *header = (RingFileHeader const*)addr;
+  if (!isRingFile(header, fileSize)) {
+    munmap(addr, fileSize);
+    throw Poco::DataFormatException("Not a ring file: " + path);
+  }
+
+  RingFileContents ret;
+  ret.generation = header->generation;
+  size_t capacity = header->capacity;
+  Byte const *data = (Byte const*)addr + header->dataOffset;
+  for (;;) {
+    RingFilePositions positions = loadPositions(header);
+    if (positions.torn) {
+      // The writer stores the bytes before the positions, and writtenBytes last, so the bytes
+      // up to writtenBytes are there.  The rest is bounded by validBegin below, and the output
+      // is taken as not completed, such that the next executor keeps the file aside.
+      positions.size = std::min(positions.size, positions.writtenBytes);
+      positions.closed = false;
+    }
+    if (positions.size > capacity || positions.head >= capacity || positions.size > positions.writtenBytes) {
+      munmap(addr, fileSize);
+      throw Poco::DataFormatException("Corrupted ring file: " + path);
+    }
+
+    // The executor may have died while overwriting the oldest bytes, which are then skipped.
+    size_t ringBegin = positions.writtenBytes - positions.size;
+    size_t begin = std::min(std::max(ringBegin, (size_t)header->validBegin.load(std::memory_order_acquire)),
+                            (size_t)positions.writtenBytes);
+    size_t count = positions.writtenBytes - begin;
+    size_t front = (positions.head + (begin - ringBegin)) % capacity;
+    size_t rightSize = std::min(count, capacity - front);
+    ret.data.resize(count);
+    memcpy(ret.data.data(), data + front, rightSize);
+    memcpy(ret.data.data() + rightSize, data, count - rightSize);
+
+    // the copy is valid only if none of the bytes have been overwritten by a live writer
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (header->validBegin.load(std::memory_order_relaxed) <= begin) {
+      ret.closed = positions.closed;
+      ret.torn = positions.torn;
+      ret.begin = begin;
+      break;
+    }
+  }
+  munmap(addr, fileSize);
+  return ret;
+}
+
+FileRingStore::~FileRingStore() {
+  munmap(_data, _capacity << 1);
+  munmap(_header, _header->dataOffset);
+  if (!_sharedName.empty()) {
+    // the readers keep their mappings, while no new reader can find the segment
+    shm_unlink(_sharedName.c_str());
+  }
+  if (_ownerFd >= 0) {
+    close(_ownerFd);
+  }
+}
+
+void FileRingStore::persistValidBegin(size_t validBegin) {
+  _header->validBegin.store(validBegin, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+}
+
+void FileRingStore::persistPositions(size_t head, size_t size, size_t writtenBytes) {
+  uint64_t sequence = _header->sequence.load(std::memory_order_relaxed);
+  _header->sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  _header->head.store(head, std::memory_order_relaxed);
+  _header->size.store(size, std::memory_order_relaxed);
+  _header->writtenBytes.store(writtenBytes, std::memory_order_relaxed);
+  _header->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+void FileRingStore::persistClosed() {
+  _header->sequence.store(_header->sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  _header->closed.store(1, std::memory_order_relaxed);
+  _header->sequence.store(_header->sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
@@ -0,0 +1,254 @@
+#ifndef ML_GRIDENGINE_EXECUTOR_RINGSTORE_H
+#define ML_GRIDENGINE_EXECUTOR_RINGSTORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <vector>
+#include "macros.h"
+
+typedef unsigned char Byte;
+
+/**
+ * Backing memory of the circular buffer in {@class OutputBuffer}.
+ *
+ * A store only owns the memory, while the ring positions are maintained by the buffer.
+ */
+class RingStore {
+public:
+  virtual ~RingStore() {}
+
+  /** The first byte of the memory. */
+  virtual Byte* data() const = 0;
+
+  /** Number of bytes in the ring. */
+  virtual size_t capacity() const = 0;
+
+  /**
+   * Whether or not the ring is mapped twice back-to-back, i.e., {@code data()[capacity() + i]}
+   * is the same byte as {@code data()[i]}.  If true, any span of at most {@code capacity()}
+   * bytes starting in the ring is contiguous in the memory.
+   */
+  virtual bool mirrored() const = 0;
+
+  /**
+   * Return the memory to the system, discarding the contents.  The store can still be written
+   * afterwards, and the memory will be allocated again when touched.  Stores which cannot give
+   * the memory back just keep it.
+   */
+  virtual void release() {}
+
+  /**
+   * Like {@code release()}, but only for the pages entirely within the {@arg length} bytes at
+   * {@arg offset} in the ring, i.e., the bytes which the buffer no longer retains.
+   */
+  virtual void releaseRange(size_t offset, size_t length) {}
+
+  /**
+   * Record that the bytes before position {@arg validBegin} are about to be overwritten.
+   * Called by the buffer before it writes into the ring.  Only persistent stores care about it.
+   */
+  virtual void persistValidBegin(size_t validBegin) {}
+
+  /** Record the ring positions after the buffer has published new contents. */
+  virtual void persistPositions(size_t head, size_t size, size_t writtenBytes) {}
+
+  /** Record that the buffer has been closed, i.e., the output is complete. */
+  virtual void persistClosed() {}
+};
+
+/** A {@class RingStore} allocated by malloc. */
+class MallocRingStore : public RingStore {
+private:
+  Byte *_data;
+  size_t _capacity;
+
+public:
+  explicit MallocRingStore(size_t capacity);
+  ~MallocRingStore();
+
+  Byte* data() const override { return _data; }
+  size_t capacity() const override { return _capacity; }
+  bool mirrored() const override { return false; }
+};
+
+/**
+ * A {@class RingStore} reserving the virtual memory of the whole capacity at once.
+ *
+ * Pages are not allocated until they are touched, so the resident memory only grows with
+ * the contents written, and the ring never needs to be re-allocated.
+ */
+class ReservedRingStore : public RingStore {
+private:
+  Byte *_data;
+  size_t _capacity;
+
+  ReservedRingStore(Byte *data, size_t capacity) : _data(data), _capacity(capacity) {}
+
+public:
+  /**
+   * Create a new {@class ReservedRingStore}.
+   *
+   * @param capacity The capacity of the ring.
+   * @return The store, or NULL if the virtual memory cannot be reserved.
+   */
+  static ReservedRingStore* create(size_t capacity);
+
+  ~ReservedRingStore();
+
+  Byte* data() const override { return _data; }
+  size_t capacity() const override { return _capacity; }
+  bool mirrored() const override { return false; }
+  void release() override;
+  void releaseRange(size_t offset, size_t length) override;
+};
+
+/**
+ * A {@class RingStore} backed by an anonymous memory file (memfd), mapped twice
+ * back-to-back in the virtual memory.
+ *
+ * The capacity is rounded up to a multiple of the page size.  Pages of the memory
+ * file are not allocated until they are touched.
+ */
+class MirroredRingStore : public RingStore {
+private:
+  Byte *_data;
+  size_t _capacity;
+
+  MirroredRingStore(Byte *data, size_t capacity) : _data(data), _capacity(capacity) {}
+
+public:
+  /**
+   * Create a new {@class MirroredRingStore}.
+   *
+   * @param capacity The minimum capacity of the ring.
+   * @return The store, or NULL if the system does not support it (e.g., memfd_create or mmap failed).
+   */
+  static MirroredRingStore* create(size_t capacity);
+
+  ~MirroredRingStore();
+
+  Byte* data() const override { return _data; }
+  size_t capacity() const override { return _capacity; }
+  bool mirrored() const override { return true; }
+  void release() override;
+  void releaseRange(size_t offset, size_t length) override;
+};
+
+/**
+ * Header at the beginning of a ring file, see {@class FileRingStore}.
+ *
+ * The positions are updated under {@code sequence}, which is odd while the writer is
+ * updating them, so that a reader of a live file can take a consistent copy.  The layout is
+ * shared with {@code mlge_ring_header} of the client library in "src/client/ml_gridengine_ring.h".
+ */
+struct RingFileHeader {
+  char magic[8];                         // "MLGERING"
+  uint32_t version;
+  uint32_t dataOffset;                   // position of the ring in the file
+  uint64_t capacity;                     // number of bytes in the ring
+  uint64_t generation;                   // incremented each time an executor creates the file
+  std::atomic<uint64_t> sequence;
+  std::atomic<uint64_t> head;
+  std::atomic<uint64_t> size;
+  std::atomic<uint64_t> writtenBytes;
+  std::atomic<uint64_t> validBegin;      // bytes before this position may have been overwritten
+  std::atomic<uint32_t> closed;          // whether or not the output had completed
+};
+
+/** Contents recovered from a ring file, see {@code FileRingStore::recover}. */
+struct RingFileContents {
+  /** The generation of the file. */
+  uint64_t generation;
+  /** Whether or not the output had completed, i.e., the executor did not die while writing. */
+  bool closed;
+  /**
+   * Whether or not the executor died while updating the positions, in which case they may mix
+   * two updates, and the recovered bytes are only the best guess of the last output.
+   */
+  bool torn;
+  /** Position of the first recovered byte, counted from the very beginning when the program started. */
+  size_t begin;
+  /** The recovered bytes, i.e., the last output of the program. */
+  std::vector<Byte> data;
+
+  RingFileContents() : generation(0), closed(false), torn(false), begin(0) {}
+};
+
+/**
+ * A {@class RingStore} backed by a memory-mapped file, mapped twice back-to-back like
+ * {@class MirroredRingStore}.
+ *
+ * The file starts with a {@class RingFileHeader} page, followed by the ring.  The buffer keeps
+ * the header positions up to date on every write, so the last output survives the executor
+ * process: it can be read back by {@code recover}, without the buffer ever writing the output
+ * out.  The kernel flushes the dirty pages to the disk in the background.  The pages are never
+ * released, since the file (or the exported shared memory) is meant to outlive the buffer.
+ */
+class FileRingStore : public RingStore {
+private:
+  RingFileHeader *_header;
+  Byte *_data;
+  size_t _capacity;
+  std::string _sharedName;    // name of the shared memory to unlink, if exported
+  int _ownerFd;               // holds the lock on the shared memory, telling the other executors it is live
+
+  FileRingStore(RingFileHeader *header, Byte *data, size_t capacity) :
+    _header(header), _data(data), _capacity(capacity), _ownerFd(-1) {}
+
+  /** Map the ring file opened as {@arg fd}, which is closed, and initialize its header. */
+  static FileRingStore* _map(int fd, std::string const& path, size_t capacity, uint64_t generation);
+
+public:
+  /**
+   * Create a new {@class FileRingStore} at {@arg path}.
+   *
+   * If the file holds the output of a previous executor which did not close it (e.g., it was
+   * killed), that file is kept as {@code path + "." + generation} instead of being overwritten.
+   *
+   * @param path Path of the ring file.
+   * @param capacity The minimum capacity of the ring.  Rounded up to a multiple of the page size.
+   * @return The store, or NULL if the file cannot be created or mapped.
+   */
+  static FileRingStore* create(std::string const& path, size_t capacity);
+
+  /**
+   * Create a new {@class FileRingStore} in the POSIX shared memory {@code "/" + name}, such that the
+   * processes on the same host can tail the output by mapping it read-only, with the client library
+   * in "src/client/ml_gridengine_ring.h".  The store holds an exclusive lock on the segment while it
+   * lives, and the segment is unlinked when the store is destroyed.  A previous segment of the same
+   * name is taken over only if no live executor holds its lock (e.g., the executor was killed).
+   *
+   * @param name Name of the shared memory, with or without the leading "/".
+   * @param capacity The minimum capacity of the ring.  Rounded up to a multiple of the page size.
+   * @param mode Permission mode of the shared memory, regardless of the umask.
+   * @return The store, or NULL if the shared memory cannot be created or mapped, or is still owned
+   *         by a live executor.
+   */
+  static FileRingStore* createShared(std::string const& name, size_t capacity,
+                                     unsigned mode = ML_GRIDENGINE_SHM_EXPORT_MODE);
+
+  /**
+   * Recover the contents of a ring file.  The file may still be written by a live executor.
+   * If the positions stay locked for {@code ML_GRIDENGINE_RING_WRITER_TIMEOUT_MILLIS}, the
+   * executor is taken as killed amid an update, and the contents are marked as torn.
+   *
+   * @throws Poco::FileException If the file cannot be read.
+   * @throws Poco::DataFormatException If the file is not a ring file.
+   */
+  static RingFileContents recover(std::string const& path);
+
+  ~FileRingStore();
+
+  Byte* data() const override { return _data; }
+  size_t capacity() const override { return _capacity; }
+  bool mirrored() const override { return true; }
+  inline uint64_t generation() const { return _header->generation; }
+  void persistValidBegin(size_t validBegin) override;
+  void persistPositions(size_t head, size_t size, size_t writtenBytes) override;
+  void persistClosed() override;
+};
+
+
+#endif //ML_GRIDENGINE_EXECUTOR_RINGSTORE_H
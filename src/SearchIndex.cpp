@@ -0,0 +1,200 @@
+#include <algorithm>
+#include "SearchIndex.h"
+
+namespace {
+  // Fibonacci hashing, whose upper bits are well mixed even for the trigrams of similar bytes
+  const uint64_t TRIGRAM_HASH = 0x9E3779B97F4A7C15ULL;
+
+  /** Masks of the single bits, which are cheaper to load than to shift by a variable on x86. */
+  struct SingleBits {
+    uint64_t masks[64];
+
+    SingleBits() {
+      for (int i=0; i<64; ++i) {
+        masks[i] = (uint64_t)1 << i;
+      }
+    }
+  };
+  const SingleBits SINGLE_BITS;
+
+  /**
+   * The two bits of a trigram within its word, such that a trigram takes a single memory access.
+   * They are taken from the upper 12 bits of {@arg hash}, and the word from the bits below.
+   */
+  inline uint64_t trigramBits(uint64_t hash) {
+    return SINGLE_BITS.masks[hash >> 58] | SINGLE_BITS.masks[(hash >> 52) & 63];
+  }
+
+  inline size_t saturatingSub(size_t a, size_t b) {
+    return a > b ? a - b : 0;
+  }
+}
+
+const size_t SearchIndex::MAX_LITERAL;
+
+SearchIndex::SearchIndex(size_t maxSize, size_t blockSize, size_t filterSize) :
+  _maxSize(maxSize),
+  _blockSize(std::max(blockSize, (size_t)4096)),
+  _begin(0),
+  _end(0),
+  _trigram(0),
+  _droppedBlocks(0)
+{
+  // the word of a trigram is taken from the bits of its hash below those of its two bits
+  unsigned logWords = 3;
+  while (logWords < 26 && ((size_t)8 << logWords) < filterSize) {
+    ++logWords;
+  }
+  _filterWords = (size_t)1 << logWords;
+  _filterShift = 52 - logWords;
+}
+
+SearchIndexStatistics SearchIndex::statistics() const {
+  SearchIndexStatistics stats;
+  stats.blockCount = _blocks.size();
+  stats.memoryBytes = _blocks.size() * _filterWords * sizeof(uint64_t);
+  stats.droppedBlocks = _droppedBlocks;
+  stats.begin = _begin;
+  return stats;
+}
+
+void SearchIndex::_openBlock() {
+  size_t filterBytes = _filterWords * sizeof(uint64_t);
+  while (!_blocks.empty() && (_blocks.size() + 1) * filterBytes > _maxSize) {
+    _blocks.pop_front();
+    ++_droppedBlocks;
+  }
+  Block block;
+  block.begin = _end - _end % _blockSize;
+  block.bits.resize(_filterWords);
+  _blocks.push_back(std::move(block));
+  _begin = _blocks.front().begin;
+}
+
+void SearchIndex::append(const Byte *data, size_t count) {
+  unsigned shift = _filterShift;
+  uint64_t wordMask = _filterWords - 1;
+  while (count > 0) {
+    if (_blocks.empty() || _end >= _blocks.back().begin + _blockSize) {
+      _openBlock();
+    }
+    size_t n = std::min(count, _blocks.back().begin + _blockSize - _end);
+    uint64_t *bits = _blocks.back().bits.data();
+    // the first two trigrams take the bytes held from the last chunk, and the others are read
+    // directly, such that no iteration waits for the previous one
+    uint32_t trigram = _trigram;
+    size_t i = 0;
+    for (; i<n && i<2; ++i) {
+      trigram = ((trigram << 8) | data[i]) & 0xFFFFFF;
+      uint64_t hash = trigram * TRIGRAM_HASH;
+      bits[(hash >> shift) & wordMask] |= trigramBits(hash);
+    }
+    for (; i<n; ++i) {
+      uint64_t hash = (((uint32_t)data[i - 2] << 16) | ((uint32_t)data[i - 1] << 8) | data[i]) * TRIGRAM_HASH;
+      bits[(hash >> shift) & wordMask] |= trigramBits(hash);
+    }
+    if (n >= 2) {
+      trigram = ((uint32_t)data[n - 2] << 8) | data[n - 1];
+    }
+    _trigram = trigram;
+    _end += n;
+    data += n;
+    count -= n;
+  }
+}
+
+void SearchIndex::trim(size_t begin) {
+  while (!_blocks.empty() && _blocks.front().begin + _blockSize <= begin) {
+    _blocks.pop_front();
+  }
+  _begin = _blocks.empty() ? _end : _blocks.front().begin;
+}
+
+uint32_t SearchIndex::_testTrigrams(Block const& block, std::vector<uint32_t> const& trigrams) const {
+  unsigned shift = _filterShift;
+  uint64_t wordMask = _filterWords - 1;
+  uint64_t const *bits = block.bits.data();
+  uint32_t mask = 0;
+  for (size_t i=0; i<trigrams.size(); ++i) {
+    uint64_t hash = trigrams[i] * TRIGRAM_HASH;
+    uint64_t want = trigramBits(hash);
+    if ((bits[(hash >> shift) & wordMask] & want) == want) {
+      mask |= (uint32_t)1 << i;
+    }
+  }
+  return mask;
+}
+
+std::vector<SearchCandidate> SearchIndex::candidates(std::string const &literal, size_t begin, size_t end) const {
+  std::vector<SearchCandidate> ret;
+  if (begin >= end) {
+    return ret;
+  }
+  size_t m = std::min(literal.size(), MAX_LITERAL);
+  if (m < 3 || _blocks.empty()) {
+    ret.emplace_back(begin, end);
+    return ret;
+  }
+
+  // Only the first `m` bytes of the literal are tested.  `add` takes the range where these bytes
+  // may occur, and extends it by the rest of the literal.
+  size_t rest = literal.size() - m;
+  auto add = [&] (size_t from, size_t to) {
+    from = std::max(from, begin);
+    to = std::min(to + rest, end);
+    if (from < to) {
+      ret.emplace_back(from, to);
+    }
+  };
+  size_t n = m - 2;
+  std::vector<uint32_t> trigrams(n);
+  for (size_t i=0; i<n; ++i) {
+    trigrams[i] = ((uint32_t)(Byte)literal[i] << 16) | ((uint32_t)(Byte)literal[i + 1] << 8) | (Byte)literal[i + 2];
+  }
+  uint32_t all = ((uint32_t)1 << n) - 1;
+
+  // the occurrences with a trigram ending before the first filter are never skipped
+  if (_begin > 0) {
+    add(0, _begin + m - 3);
+  }
+
+  // only the blocks which may hold a trigram of an occurrence within [begin, end) are tested
+  size_t first = saturatingSub(begin, _begin) / _blockSize;
+  size_t last = std::min(_blocks.size(), (saturatingSub(end + m, _begin) + _blockSize - 1) / _blockSize);
+  uint32_t lastMissing = 0;     // the trigrams not in the previous block
+  for (size_t k=first; k<last; ++k) {
+    Block const& block = _blocks[k];
+    uint32_t missing = ~_testTrigrams(block, trigrams) & all;
+
+    // An occurrence crossing the boundary has its trigrams before some `s` in the previous block,
+    // and the others in this one.  So the previous block has no missing trigram before `s`, and
+    // this block has no missing trigram from `s` on.
+    if (k > first && n > 1) {
+      size_t prefix = lastMissing == 0 ? n : (size_t)__builtin_ctz(lastMissing);
+      size_t suffix = missing == 0 ? 0 : (size_t)(32 - __builtin_clz(missing));
+      if (std::max(suffix, (size_t)1) <= std::min(prefix, n - 1)) {
+        add(saturatingSub(block.begin, m - 1), block.begin + m - 3);
+      }
+    }
+    if (missing == 0) {
+      add(saturatingSub(block.begin, 2), block.begin + _blockSize);
+    }
+    lastMissing = missing;
+  }
+
+  // the occurrences with a trigram not indexed yet are never skipped
+  add(saturatingSub(_end, m - 1), end);
+
+  // merge the overlapping ranges, which are almost in order
+  std::sort(ret.begin(), ret.end());
+  size_t count = 0;
+  for (SearchCandidate const& range: ret) {
+    if (count > 0 && range.first <= ret[count - 1].second) {
+      ret[count - 1].second = std::max(ret[count - 1].second, range.second);
+    } else {
+      ret[count++] = range;
+    }
+  }
+  ret.resize(count);
+  return ret;
+}
@@ -0,0 +1,110 @@
+#ifndef ML_GRIDENGINE_EXECUTOR_SEARCHINDEX_H
+#define ML_GRIDENGINE_EXECUTOR_SEARCHINDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+
+typedef unsigned char Byte;
+
+/** A range of the output, {@code [begin, end)}, which may contain a literal. */
+typedef std::pair<size_t, size_t> SearchCandidate;
+
+/** Statistics of a {@class SearchIndex}. */
+struct SearchIndexStatistics {
+  /** Number of blocks having a filter. */
+  size_t blockCount;
+  /** Memory used by the filters, in bytes. */
+  size_t memoryBytes;
+  /** Number of filters dropped to keep within the memory bound, before their output was evicted. */
+  size_t droppedBlocks;
+  /** Position of the first byte covered by the filters. */
+  size_t begin;
+
+  SearchIndexStatistics() : blockCount(0), memoryBytes(0), droppedBlocks(0), begin(0) {}
+};
+
+/**
+ * Block-level Bloom filters of the trigrams in the program output, such that a search for a
+ * literal only needs to scan the blocks which may contain it.
+ *
+ * The output is divided into blocks of {@code blockSize} bytes at fixed positions, each having a
+ * Bloom filter of the trigrams (i.e., every 3 consecutive bytes) ending within it.  A block is
+ * sealed once it is full, and only the last block is still being filled.  A literal may occur in
+ * a block only if all of its trigrams are in the filter, and may cross the boundary of two blocks
+ * only if a prefix of its trigrams is in the former and the rest in the latter.  Only the first
+ * {@code MAX_LITERAL} bytes of a literal are tested, and a literal shorter than 3 bytes matches
+ * every block.  Each trigram sets two bits within a single word of the filter, such that indexing
+ * and testing it take a single memory access.
+ *
+ * The filters are dropped together with the output they cover by {@code trim}.  If the filters
+ * would exceed {@code maxSize}, the oldest ones are dropped earlier, after which their output can
+ * still be searched, just without being skipped.
+ *
+ * This class is not thread-safe.  {@class OutputBuffer} maintains it under its own lock.
+ */
+class SearchIndex {
+public:
+  /** Maximum number of bytes of a literal tested against the filters. */
+  static const size_t MAX_LITERAL = 32;
+
+private:
+  struct Block {
+    size_t begin;
+    std::vector<uint64_t> bits;
+  };
+
+  size_t _maxSize;
+  size_t _blockSize;
+  size_t _filterWords;        // number of 64-bit words in each filter
+  unsigned _filterShift;      // where the bits selecting the word of a trigram begin in its hash
+  std::deque<Block> _blocks;  // the last one is being filled
+  size_t _begin;              // position of the first byte covered by the filters
+  size_t _end;                // number of bytes ever indexed
+  uint32_t _trigram;          // the last 3 bytes indexed
+  size_t _droppedBlocks;
+
+  /** Open a new block at {@code _end}, dropping the oldest filters beyond the memory bound. */
+  void _openBlock();
+
+  /** Bitmask of the trigrams of {@arg literal} which are in the filter of {@arg block}. */
+  uint32_t _testTrigrams(Block const& block, std::vector<uint32_t> const& trigrams) const;
+
+public:
+  /**
+   * Construct a new {@class SearchIndex}.
+   *
+   * @param maxSize Maximum memory used by the filters.  The filter of the last block is always kept.
+   * @param blockSize Number of output bytes covered by each filter, at least 4 KiB.
+   * @param filterSize Number of bytes in each filter, rounded up to a power of 2 within [64, 512M].
+   */
+  explicit SearchIndex(size_t maxSize, size_t blockSize=64 * 1024, size_t filterSize=8 * 1024);
+
+  inline size_t blockSize() const { return _blockSize; }
+
+  /** Number of bytes ever indexed. */
+  inline size_t end() const { return _end; }
+
+  /** Get the statistics of the index. */
+  SearchIndexStatistics statistics() const;
+
+  /** Index {@arg count} bytes following {@code end()}. */
+  void append(const Byte *data, size_t count);
+
+  /** Drop the filters of the blocks ending at or before {@arg begin}. */
+  void trim(size_t begin);
+
+  /**
+   * Get the ranges within {@code [begin, end)} which may contain {@arg literal}, in the order of
+   * the output and never overlapping.  Every occurrence of {@arg literal} which lies within
+   * {@code [begin, end)} lies within one of the ranges.  The output after {@code end()} is never
+   * skipped.
+   */
+  std::vector<SearchCandidate> candidates(std::string const& literal, size_t begin, size_t end) const;
+};
+
+
+#endif //ML_GRIDENGINE_EXECUTOR_SEARCHINDEX_H
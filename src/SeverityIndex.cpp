@@ -0,0 +1,181 @@
+#include <string.h>
+#include <algorithm>
+#include "AhoCorasick.h"
+#include "SeverityIndex.h"
+
+namespace {
+  struct Pattern {
+    const char *text;
+    Severity severity;
+  };
+
+  const Pattern PATTERNS[] = {
+    {"WARNING", SEVERITY_WARNING},
+    {"WARN ", SEVERITY_WARNING},
+    {"Warning:", SEVERITY_WARNING},
+    {"warning:", SEVERITY_WARNING},
+    {"ERROR", SEVERITY_ERROR},
+    {"Error:", SEVERITY_ERROR},
+    {"error:", SEVERITY_ERROR},
+    {"FATAL", SEVERITY_ERROR},
+    {"Fatal", SEVERITY_ERROR},
+    {"CRITICAL", SEVERITY_ERROR},
+    {"Exception:", SEVERITY_ERROR},
+    {"Segmentation fault", SEVERITY_ERROR},
+    {"NaN", SEVERITY_NAN},
+    {"loss: nan", SEVERITY_NAN},
+    {"loss = nan", SEVERITY_NAN},
+    {"loss is nan", SEVERITY_NAN},
+    {"CUDA error", SEVERITY_CUDA},
+    {"CUDA out of memory", SEVERITY_CUDA},
+    {"cudaError", SEVERITY_CUDA},
+    {"CUBLAS_STATUS_", SEVERITY_CUDA},
+    {"CUDNN_STATUS_", SEVERITY_CUDA},
+    {"device-side assert", SEVERITY_CUDA},
+    {"Traceback (most recent call last):", SEVERITY_TRACEBACK},
+  };
+
+  /** The automaton of {@code PATTERNS}, whose output is the most severe class matched. */
+  AhoCorasick const& automaton() {
+    static AhoCorasick instance([] {
+      std::vector<AhoCorasick::Pattern> patterns;
+      for (Pattern const& pattern: PATTERNS) {
+        patterns.emplace_back(pattern.text, (int)pattern.severity);
+      }
+      return patterns;
+    }());
+    return instance;
+  }
+
+  const char *SEVERITY_NAMES[SEVERITY_COUNT] = {"warning", "error", "nan", "cuda", "traceback"};
+}
+
+SeverityIndex::SeverityIndex(size_t maxEntries, size_t maxTextBytes) :
+  _maxEntries(std::max(maxEntries, (size_t)1)),
+  _maxTextBytes(maxTextBytes),
+  _state(0),
+  _end(0),
+  _line(0),
+  _lineBegin(0),
+  _lineSeverity(-1),
+  _inTraceback(false)
+{
+  std::fill(_counts, _counts + SEVERITY_COUNT, 0);
+}
+
+const char *SeverityIndex::name(Severity severity) {
+  return SEVERITY_NAMES[severity];
+}
+
+bool SeverityIndex::parse(std::string const& name, Severity *severity) {
+  for (int i=0; i<SEVERITY_COUNT; ++i) {
+    if (name == SEVERITY_NAMES[i]) {
+      *severity = (Severity)i;
+      return true;
+    }
+  }
+  return false;
+}
+
+void SeverityIndex::_push(SeverityEntry const& entry) {
+  std::deque<SeverityEntry> &entries = _entries[entry.severity];
+  entries.push_back(entry);
+  if (entries.size() > _maxEntries) {
+    entries.pop_front();
+  }
+  ++_counts[entry.severity];
+}
+
+void SeverityIndex::_endLine(size_t end) {
+  while (!_lineText.empty() && (_lineText.back() == '\n' || _lineText.back() == '\r')) {
+    _lineText.pop_back();
+  }
+  bool indented = !_lineText.empty() && (_lineText[0] == ' ' || _lineText[0] == '\t');
+
+  if (_inTraceback) {
+    // the indented lines are the stack frames, and the first other line ends the block
+    _traceback.end = end;
+    if (!indented) {
+      if (!_lineText.empty()) {
+        _traceback.text.swap(_lineText);
+      }
+      _push(_traceback);
+      _inTraceback = false;
+    }
+  } else if (_lineSeverity == SEVERITY_TRACEBACK) {
+    _traceback.severity = SEVERITY_TRACEBACK;
+    _traceback.line = _line;
+    _traceback.begin = _lineBegin;
+    _traceback.end = end;
+    _traceback.text.swap(_lineText);
+    _inTraceback = true;
+  } else if (_lineSeverity >= 0) {
+    SeverityEntry entry;
+    entry.severity = (Severity)_lineSeverity;
+    entry.line = _line;
+    entry.begin = _lineBegin;
+    entry.end = end;
+    entry.text.swap(_lineText);
+    _push(entry);
+  }
+
+  ++_line;
+  _lineBegin = end;
+  _lineSeverity = -1;
+  _lineText.clear();
+  _state = 0;
+}
+
+void SeverityIndex::append(const Byte *data, size_t count) {
+  AhoCorasick const& a = automaton();
+  const Byte *p = data, *end = data + count;
+  while (p < end) {
+    const Byte *newline = (const Byte*)memchr(p, '\n', end - p);
+    const Byte *segmentEnd = newline ? newline + 1 : end;
+    uint32_t state = _state;
+    int severity = _lineSeverity;
+    for (const Byte *q = p; q < segmentEnd; ++q) {
+      state = a.next(state, *q);
+      severity = std::max(severity, a.output(state));
+    }
+    _state = state;
+    _lineSeverity = severity;
+    if (_lineText.size() < _maxTextBytes) {
+      _lineText.append((const char*)p, std::min((size_t)(segmentEnd - p), _maxTextBytes - _lineText.size()));
+    }
+    _end += segmentEnd - p;
+    if (newline) {
+      _endLine(_end);
+    }
+    p = segmentEnd;
+  }
+}
+
+void SeverityIndex::finish() {
+  if (_end > _lineBegin) {
+    _endLine(_end);
+  }
+  if (_inTraceback) {
+    _push(_traceback);
+    _inTraceback = false;
+  }
+}
+
+std::vector<SeverityEntry> SeverityIndex::entries(unsigned mask, size_t limit) const {
+  std::vector<SeverityEntry> ret;
+  for (int i=0; i<SEVERITY_COUNT; ++i) {
+    if (mask & (1U << i)) {
+      ret.insert(ret.end(), _entries[i].begin(), _entries[i].end());
+    }
+  }
+  if (_inTraceback && (mask & (1U << SEVERITY_TRACEBACK))) {
+    ret.push_back(_traceback);
+  }
+  std::sort(ret.begin(), ret.end(), [] (SeverityEntry const& a, SeverityEntry const& b) {
+    return a.begin < b.begin;
+  });
+  if (limit > 0 && ret.size() > limit) {
+    ret.erase(ret.begin(), ret.end() - limit);
+  }
+  return ret;
+}
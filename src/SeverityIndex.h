@@ -0,0 +1,119 @@
+#ifndef ML_GRIDENGINE_EXECUTOR_SEVERITYINDEX_H
+#define ML_GRIDENGINE_EXECUTOR_SEVERITYINDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <deque>
+#include <string>
+#include <vector>
+
+typedef unsigned char Byte;
+
+/** Class of a notable line in the program output, from the least to the most severe. */
+typedef enum {
+  SEVERITY_WARNING = 0,     // "WARNING", "Warning:", ...
+  SEVERITY_ERROR = 1,       // "ERROR", "FATAL", "ValueError:", ...
+  SEVERITY_NAN = 2,         // "NaN", "loss: nan", ...
+  SEVERITY_CUDA = 3,        // "CUDA error", "CUDA out of memory", ...
+  SEVERITY_TRACEBACK = 4    // a Python traceback block
+} Severity;
+
+#define SEVERITY_COUNT 5
+
+/** A notable line, or a traceback block, in the program output. */
+struct SeverityEntry {
+  /** Class of the line. */
+  Severity severity;
+  /** Line number of the first line, counted from zero since the program started. */
+  size_t line;
+  /** Beginning position of the line or block. */
+  size_t begin;
+  /** End position of the line or block, including the last newline. */
+  size_t end;
+  /**
+   * Beginning of the line, truncated.  For a traceback block, this is the exception line
+   * which ends the block (e.g., "ValueError: ..."), or the header line if it never ended.
+   */
+  std::string text;
+
+  SeverityEntry() : severity(SEVERITY_WARNING), line(0), begin(0), end(0) {}
+};
+
+/**
+ * Index of the notable lines in the program output, e.g., errors, warnings and tracebacks,
+ * such that the failure of a program can be located without scanning all of its output.
+ *
+ * The lines are classified by a multi-pattern automaton, which takes a table lookup per byte.
+ * A line matching several patterns takes the most severe class.  A Python traceback block,
+ * i.e., the "Traceback (most recent call last):" line followed by the indented lines and the
+ * exception line, is indexed as a single entry.
+ *
+ * Entries keep a copy of the beginning of their lines, so that they can still be presented
+ * after the output has been evicted.  At most {@code maxEntries} of the latest entries of each
+ * class are kept, while the number of lines ever classified is always exact.
+ *
+ * This class is not thread-safe.  {@class OutputBuffer} maintains it under its own lock.
+ */
+class SeverityIndex {
+private:
+  std::deque<SeverityEntry> _entries[SEVERITY_COUNT];
+  size_t _counts[SEVERITY_COUNT];   // number of entries ever indexed of each class
+  size_t _maxEntries;
+  size_t _maxTextBytes;
+
+  uint32_t _state;            // state of the automaton
+  size_t _end;                // number of bytes ever indexed
+  size_t _line;               // line number of the current line
+  size_t _lineBegin;          // beginning position of the current line
+  int _lineSeverity;          // class of the current line so far, or -1 if none
+  std::string _lineText;      // beginning of the current line
+
+  bool _inTraceback;          // whether or not a traceback block is open
+  SeverityEntry _traceback;   // the open traceback block
+
+  /** Classify the current line, which ends at {@arg end}. */
+  void _endLine(size_t end);
+
+  void _push(SeverityEntry const& entry);
+
+public:
+  /**
+   * Construct a new {@class SeverityIndex}.
+   *
+   * @param maxEntries Maximum number of entries kept of each class.
+   * @param maxTextBytes Maximum number of bytes kept of each line.
+   */
+  explicit SeverityIndex(size_t maxEntries=256, size_t maxTextBytes=256);
+
+  /** Name of {@arg severity}, e.g., "error". */
+  static const char *name(Severity severity);
+
+  /**
+   * Parse the name of a class.
+   *
+   * @return Whether or not {@arg name} is a known class.
+   */
+  static bool parse(std::string const& name, Severity *severity);
+
+  /** Number of bytes ever indexed. */
+  inline size_t end() const { return _end; }
+
+  /** Number of entries ever indexed of {@arg severity}, including those no longer kept. */
+  inline size_t count(Severity severity) const { return _counts[severity]; }
+
+  /**
+   * The kept entries of the classes in {@arg mask} (bit {@code 1 << severity}), ordered by position.
+   *
+   * @param limit Maximum number of entries, the latest ones are returned.  Zero means no limit.
+   */
+  std::vector<SeverityEntry> entries(unsigned mask, size_t limit=0) const;
+
+  /** Index {@arg count} bytes following {@code end()}. */
+  void append(const Byte *data, size_t count);
+
+  /** Classify the last unterminated line, and close the open traceback block, at the end of the output. */
+  void finish();
+};
+
+
+#endif //ML_GRIDENGINE_EXECUTOR_SEVERITYINDEX_H
@@ -0,0 +1,228 @@
+#include <algorithm>
+#include <random>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <Poco/Exception.h>
+#include <Poco/File.h>
+#include <Poco/Format.h>
+#include <Poco/Mutex.h>
+#include <Poco/Path.h>
+#include "SpillFileHistory.h"
+#include "Logger.h"
+
+namespace {
+  inline std::string errorMessage() {
+    return std::string(strerror(errno));
+  }
+}
+
+/** An opened segment file, which is deleted when the last reference is dropped. */
+class SpillFileHistory::SegmentFile {
+private:
+  std::string _path;
+  int _fd;
+
+public:
+  explicit SegmentFile(std::string const& path) :
+    _path(path),
+    _fd(::open(path.c_str(), O_CREAT | O_TRUNC | O_RDWR | O_CLOEXEC, 0600))
+  {
+  }
+
+  ~SegmentFile() {
+    if (_fd >= 0) {
+      ::close(_fd);
+      ::unlink(_path.c_str());
+    }
+  }
+
+  inline int fd() const { return _fd; }
+  inline std::string const& path() const { return _path; }
+};
+
+SpillFileHistory::SpillFileHistory(std::string const &spoolDir, size_t segmentSize, size_t maxSize) :
+  _spoolDir(spoolDir),
+  _segmentSize(std::max(segmentSize, (size_t)1)),
+  _maxSize(maxSize),
+  _mutex(new Poco::Mutex()),
+  _flushMutex(new Poco::Mutex()),
+  _begin(0),
+  _stagedBegin(0),
+  _flushedEnd(0),
+  _end(0),
+  _broken(false)
+{
+  // the random suffix tells apart the executors having the same pid in different containers
+  std::random_device random;
+  _segmentDir = Poco::Path(_spoolDir, Poco::format("executor-%d-%08x", (int)::getpid(), (unsigned)random()))
+      .toString();
+  try {
+    Poco::File(_segmentDir).createDirectories();
+  } catch (Poco::Exception const& e) {
+    _abandon(e.displayText());
+  }
+}
+
+SpillFileHistory::~SpillFileHistory() {
+  _segments.clear();
+  _staged.clear();
+  ::rmdir(_segmentDir.c_str());
+  delete _flushMutex;
+  delete _mutex;
+}
+
+size_t SpillFileHistory::begin() const {
+  Poco::Mutex::ScopedLock scopedLock(*_mutex);
+  return _begin;
+}
+
+size_t SpillFileHistory::end() const {
+  Poco::Mutex::ScopedLock scopedLock(*_mutex);
+  return _end;
+}
+
+size_t SpillFileHistory::segmentCount() const {
+  Poco::Mutex::ScopedLock scopedLock(*_mutex);
+  return _segments.size();
+}
+
+void SpillFileHistory::_abandon(std::string const &reason) {
+  Logger::getLogger().error("Stop spilling output to %s: %s", _segmentDir, reason);
+  _segments.clear();
+  _staged.clear();
+  _begin = _stagedBegin = _flushedEnd = _end;
+  _broken = true;
+}
+
+size_t SpillFileHistory::_writeToSegment(std::string const &chunk, size_t offset) {
+  std::shared_ptr<SegmentFile> file;
+  size_t size = 0;
+  {
+    Poco::Mutex::ScopedLock scopedLock(*_mutex);
+    if (!_segments.empty() && _segments.back().size < _segmentSize) {
+      file = _segments.back().file;
+      size = _segments.back().size;
+    }
+  }
+  if (!file) {
+    std::string path = Poco::Path(_segmentDir, Poco::format("output-%z.seg", _flushedEnd)).toString();
+    file.reset(new SegmentFile(path));
+    Poco::Mutex::ScopedLock scopedLock(*_mutex);
+    if (file->fd() < 0) {
+      _abandon(Poco::format("cannot open %s: %s", path, errorMessage()));
+      return 0;
+    }
+    Segment segment = {_flushedEnd, 0, file};
+    _segments.push_back(segment);
+  }
+
+  // the bytes are published to the readers only after being written
+  size_t n = std::min(chunk.size() - offset, _segmentSize - size);
+  const char *data = chunk.data() + offset;
+  for (size_t written = 0; written < n; ) {
+    ssize_t got = ::write(file->fd(), data + written, n - written);
+    if (got < 0) {
+      if (errno == EINTR)
+        continue;
+      Poco::Mutex::ScopedLock scopedLock(*_mutex);
+      _abandon(Poco::format("cannot write %s: %s", file->path(), errorMessage()));
+      return 0;
+    }
+    written += (size_t)got;
+  }
+  Poco::Mutex::ScopedLock scopedLock(*_mutex);
+  _segments.back().size += n;
+  _flushedEnd += n;
+  _dropOldSegments();
+  return n;
+}
+
+void SpillFileHistory::_dropOldSegments() {
+  while (_maxSize > 0 && _flushedEnd - _begin > _maxSize && _segments.size() > 1) {
+    _segments.pop_front();
+    _begin = _segments.front().begin;
+  }
+}
+
+void SpillFileHistory::append(const Byte *data, size_t count) {
+  Poco::Mutex::ScopedLock scopedLock(*_mutex);
+  _end += count;
+  if (_broken) {
+    // everything not on the disk is discarded
+    _begin = _stagedBegin = _flushedEnd = _end;
+  } else if (count > 0) {
+    _staged.emplace_back((const char*)data, count);
+  }
+}
+
+void SpillFileHistory::flush() {
+  Poco::Mutex::ScopedLock flushLock(*_flushMutex);
+  for (;;) {
+    // Only the flush removes the staged chunks, and `append` never moves them, so the chunk
+    // can be written without `_mutex`.
+    std::string const *chunk;
+    {
+      Poco::Mutex::ScopedLock scopedLock(*_mutex);
+      if (_broken || _staged.empty()) {
+        return;
+      }
+      chunk = &_staged.front();
+    }
+    for (size_t offset = _flushedEnd - _stagedBegin; offset < chunk->size(); ) {
+      size_t n = _writeToSegment(*chunk, offset);
+      if (n == 0) {
+        return;
+      }
+      offset += n;
+    }
+    Poco::Mutex::ScopedLock scopedLock(*_mutex);
+    _stagedBegin += chunk->size();
+    _staged.pop_front();
+  }
+}
+
+size_t SpillFileHistory::read(size_t begin, Byte *target, size_t count) {
+  std::shared_ptr<SegmentFile> file;
+  size_t offset, n;
+  {
+    Poco::Mutex::ScopedLock scopedLock(*_mutex);
+    if (begin < _begin || begin >= _end) {
+      return 0;
+    }
+    if (begin >= _flushedEnd) {
+      size_t pos = _stagedBegin;
+      for (std::string const& chunk: _staged) {
+        if (begin < pos + chunk.size()) {
+          size_t n = std::min(count, pos + chunk.size() - begin);
+          memcpy(target, chunk.data() + (begin - pos), n);
+          return n;
+        }
+        pos += chunk.size();
+      }
+      return 0;
+    }
+    if (_segments.empty()) {
+      return 0;
+    }
+    auto it = std::upper_bound(_segments.begin(), _segments.end(), begin,
+                               [] (size_t pos, Segment const& segment) { return pos < segment.begin; });
+    Segment const& segment = *(it - 1);
+    file = segment.file;
+    offset = begin - segment.begin;
+    n = std::min(count, segment.size - offset);
+  }
+
+  // the segment file is kept open by `file`, even if it is dropped meanwhile
+  size_t total = 0;
+  while (total < n) {
+    ssize_t got = ::pread(file->fd(), target + total, n - total, (off_t)(offset + total));
+    if (got < 0 && errno == EINTR)
+      continue;
+    if (got <= 0)
+      break;
+    total += (size_t)got;
+  }
+  return total;
+}
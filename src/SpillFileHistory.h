@@ -0,0 +1,82 @@
+#ifndef ML_GRIDENGINE_EXECUTOR_SPILLFILEHISTORY_H
+#define ML_GRIDENGINE_EXECUTOR_SPILLFILEHISTORY_H
+
+#include <deque>
+#include <memory>
+#include <string>
+#include "OutputHistory.h"
+
+namespace Poco {
+  class Mutex;
+}
+
+/**
+ * An {@class OutputHistory} which spills the evicted output into segment files on the disk.
+ *
+ * The output is appended to the last segment file, and a new segment is started once it
+ * reaches {@code segmentSize}.  Old segments are read with {@code pread}, and deleted when
+ * the history is destroyed, or when the total size exceeds {@code maxSize} (if not zero).
+ * The segment files are put in a directory of their own under the spool directory, named by
+ * the process id and a random suffix, such that executors can share the spool directory.
+ *
+ * {@code append} only keeps the bytes in memory, where they can be read until {@code flush}
+ * writes them to the segment files, without holding the lock of the output buffer.
+ *
+ * If the spool directory becomes unwritable (e.g., the disk is full), the history stops
+ * spilling, and the output evicted afterwards is discarded.
+ */
+class SpillFileHistory : public OutputHistory {
+private:
+  class SegmentFile;
+  struct Segment {
+    size_t begin;
+    size_t size;
+    std::shared_ptr<SegmentFile> file;
+  };
+
+  std::string _spoolDir;
+  std::string _segmentDir;
+  size_t _segmentSize;
+  size_t _maxSize;
+  Poco::Mutex *_mutex;
+  Poco::Mutex *_flushMutex;       // serializes the flushes, which write without `_mutex`
+  std::deque<Segment> _segments;
+  std::deque<std::string> _staged;  // the bytes not yet fully written, from `_stagedBegin` on
+  size_t _begin;
+  size_t _stagedBegin;
+  size_t _flushedEnd;
+  size_t _end;
+  bool _broken;
+
+  /** Write the front of {@arg chunk} to the last segment, returning the number of bytes written. */
+  size_t _writeToSegment(std::string const& chunk, size_t offset);
+  void _dropOldSegments();
+  void _abandon(std::string const& reason);
+
+public:
+  /**
+   * Construct a new {@class SpillFileHistory}.
+   *
+   * @param spoolDir The directory under which to put the directory of the segment files.
+   * @param segmentSize Maximum size of each segment file.
+   * @param maxSize Maximum size of all the segment files.  Zero means unlimited.
+   */
+  explicit SpillFileHistory(std::string const& spoolDir, size_t segmentSize=64 * 1024 * 1024, size_t maxSize=0);
+
+  ~SpillFileHistory();
+
+  size_t begin() const override;
+  size_t end() const override;
+  void append(const Byte *data, size_t count) override;
+  void flush() override;
+  size_t read(size_t begin, Byte *target, size_t count) override;
+
+  /** The directory of the segment files of this history. */
+  inline std::string const& segmentDir() const { return _segmentDir; }
+
+  /** Number of segment files currently on the disk. */
+  size_t segmentCount() const;
+};
+
+
+#endif //ML_GRIDENGINE_EXECUTOR_SPILLFILEHISTORY_H
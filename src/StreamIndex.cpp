@@ -0,0 +1,60 @@
+#include <algorithm>
+#include "StreamIndex.h"
+
+StreamSpan StreamIndex::locate(ProgramStream stream, size_t offset) const {
+  // The stream positions after each record never decrease, and only grow at the records of the
+  // stream, so the first record ending after `offset` belongs to the stream, unless `offset` has
+  // been trimmed, in which case the first retained record of the stream is taken.
+  auto it = std::upper_bound(_records.begin(), _records.end(), offset,
+                             [stream] (size_t value, Record const& r) { return value < r.after(stream); });
+  while (it != _records.end() && it->stream != stream) {
+    ++it;
+  }
+  StreamSpan ret;
+  if (it == _records.end()) {
+    ret.offset = writtenBytes(stream);
+    ret.mergedBegin = _end;
+    return ret;
+  }
+
+  // skip the bytes before the requested offset, or trimmed from the first record
+  size_t skip = std::max(offset, it->before(stream)) - it->before(stream);
+  skip = std::max(skip, std::max(_begin, (size_t)it->mergedBegin) - it->mergedBegin);
+  skip = std::min(skip, (size_t)it->length);
+  ret.offset = it->before(stream) + skip;
+  ret.mergedBegin = it->mergedBegin + skip;
+  ret.length = it->length - skip;
+  return ret;
+}
+
+void StreamIndex::append(ProgramStream stream, size_t count) {
+  while (count > 0) {
+    if (!_records.empty() && _records.back().stream == stream && _records.back().length < UINT32_MAX) {
+      // extend the last run, up to the maximum length of a record
+      Record &last = _records.back();
+      uint32_t n = (uint32_t)std::min(count, (size_t)(UINT32_MAX - last.length));
+      last.length += n;
+      _end += n;
+      _stdoutBytes += stream == STDOUT_STREAM ? n : 0;
+      count -= n;
+    } else {
+      Record r = {_end, _stdoutBytes, 0, (uint8_t)stream};
+      _records.push_back(r);
+    }
+  }
+}
+
+void StreamIndex::trim(size_t begin) {
+  while (!_records.empty() && _records.front().mergedBegin + _records.front().length <= begin) {
+    _records.pop_front();
+  }
+  _begin = std::max(_begin, begin);
+}
+
+void StreamIndex::fit(size_t maxBytes, size_t limit) {
+  while (_records.size() * sizeof(Record) > maxBytes &&
+         _records.front().mergedBegin + _records.front().length <= limit) {
+    _begin = std::max(_begin, (size_t)(_records.front().mergedBegin + _records.front().length));
+    _records.pop_front();
+  }
+}
@@ -0,0 +1,95 @@
+#ifndef ML_GRIDENGINE_EXECUTOR_STREAMINDEX_H
+#define ML_GRIDENGINE_EXECUTOR_STREAMINDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <deque>
+
+/** Output streams of the program. */
+typedef enum {
+  STDOUT_STREAM = 0,
+  STDERR_STREAM = 1
+} ProgramStream;
+
+/** A run of bytes of one stream, which is contiguous in the merged output. */
+struct StreamSpan {
+  /** Beginning position in the stream, counted from zero since the program started. */
+  size_t offset;
+  /** Beginning position in the merged output. */
+  size_t mergedBegin;
+  /** Number of bytes in the run.  Zero if there is no such run currently. */
+  size_t length;
+
+  StreamSpan() : offset(0), mergedBegin(0), length(0) {}
+};
+
+/**
+ * Index of the streams in the merged program output.
+ *
+ * Each record is a run of bytes from one stream, in the order of arrival.  Consecutive runs
+ * from the same stream are merged into a single record, so the index stays small unless the
+ * program keeps alternating between stdout and stderr.  The index only covers the output at
+ * or after the position given to {@code trim}, and its oldest records may be dropped earlier by
+ * {@code fit} to bound its memory.
+ *
+ * This class is not thread-safe.  {@class OutputBuffer} maintains it under its own lock.
+ */
+class StreamIndex {
+private:
+  struct Record {
+    uint64_t mergedBegin;   // position of the run in the merged output
+    uint64_t stdoutBefore;  // number of stdout bytes before the run
+    uint32_t length;        // number of bytes in the run
+    uint8_t stream;         // the stream of the run
+
+    /** Number of bytes of {@arg s} before this run. */
+    inline size_t before(ProgramStream s) const {
+      return s == STDOUT_STREAM ? stdoutBefore : mergedBegin - stdoutBefore;
+    }
+
+    /** Number of bytes of {@arg s} before the next run. */
+    inline size_t after(ProgramStream s) const {
+      return before(s) + (stream == s ? length : 0);
+    }
+  };
+
+  std::deque<Record> _records;
+  size_t _begin;                // position given to the last `trim`
+  size_t _end;                  // number of merged bytes ever indexed
+  size_t _stdoutBytes;          // number of stdout bytes ever indexed
+
+public:
+  StreamIndex() : _begin(0), _end(0), _stdoutBytes(0) {}
+
+  /** Number of merged bytes ever indexed. */
+  inline size_t end() const { return _end; }
+
+  /** Number of records in the index. */
+  inline size_t recordCount() const { return _records.size(); }
+
+  /** Number of bytes ever written to {@arg stream}. */
+  inline size_t writtenBytes(ProgramStream stream) const {
+    return stream == STDOUT_STREAM ? _stdoutBytes : _end - _stdoutBytes;
+  }
+
+  /**
+   * Locate the run of {@arg stream} containing position {@arg offset} of the stream.
+   *
+   * @return The run, starting at {@arg offset}.  If the bytes at {@arg offset} have been trimmed,
+   *         the first retained run of the stream after it.  If there's no such byte yet, an empty
+   *         run at {@code writtenBytes(stream)} and {@code end()}.
+   */
+  StreamSpan locate(ProgramStream stream, size_t offset) const;
+
+  /** Index {@arg count} bytes of {@arg stream} following {@code end()}. */
+  void append(ProgramStream stream, size_t count);
+
+  /** Drop the records ending at or before merged position {@arg begin}. */
+  void trim(size_t begin);
+
+  /** Drop the oldest records ending at or before {@arg limit}, until the index takes at most {@arg maxBytes}. */
+  void fit(size_t maxBytes, size_t limit);
+};
+
+
+#endif //ML_GRIDENGINE_EXECUTOR_STREAMINDEX_H
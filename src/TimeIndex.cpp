@@ -0,0 +1,73 @@
+#include <algorithm>
+#include <time.h>
+#include "TimeIndex.h"
+
+namespace {
+  inline int64_t clockMicros(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+  }
+}
+
+int64_t TimeIndex::now() {
+  // the offset between the two clocks is taken once, when the first time is measured
+  static const int64_t offset = clockMicros(CLOCK_REALTIME) - clockMicros(CLOCK_MONOTONIC);
+  return clockMicros(CLOCK_MONOTONIC) + offset;
+}
+
+size_t TimeIndex::positionSince(int64_t time) const {
+  auto it = std::lower_bound(_entries.begin(), _entries.end(), time,
+                             [] (Entry const& e, int64_t value) { return e.lastTime < value; });
+  return it == _entries.end() ? _end : it->position;
+}
+
+size_t TimeIndex::positionUntil(int64_t time) const {
+  auto it = std::upper_bound(_entries.begin(), _entries.end(), time,
+                             [] (int64_t value, Entry const& e) { return value < e.time; });
+  return it == _entries.end() ? _end : it->position;
+}
+
+int64_t TimeIndex::timeAt(size_t position) const {
+  if (position >= _end) {
+    return -1;
+  }
+  auto it = std::upper_bound(_entries.begin(), _entries.end(), position,
+                             [] (size_t value, Entry const& e) { return value < e.position; });
+  return it == _entries.begin() ? -1 : (it - 1)->time;
+}
+
+void TimeIndex::append(size_t count, int64_t time) {
+  if (count == 0) {
+    return;
+  }
+  if (!_entries.empty() && time - _entries.back().time < _interval) {
+    _entries.back().lastTime = time;
+  } else {
+    if (_entries.size() >= _maxEntries) {
+      // halve the resolution by merging every two adjacent entries
+      size_t j = 0;
+      for (size_t i = 0; i < _entries.size(); i += 2, ++j) {
+        _entries[j] = _entries[i];
+        if (i + 1 < _entries.size()) {
+          _entries[j].lastTime = _entries[i + 1].lastTime;
+        }
+      }
+      _entries.resize(j);
+      _interval <<= 1;
+    }
+    Entry e = {_end, time, time};
+    _entries.push_back(e);
+  }
+  _end += count;
+}
+
+void TimeIndex::trim(size_t begin) {
+  // an entry covers the bytes up to the next entry
+  while (_entries.size() > 1 && _entries[1].position <= begin) {
+    _entries.pop_front();
+  }
+  if (!_entries.empty() && begin >= _end) {
+    _entries.clear();
+  }
+}
@@ -0,0 +1,87 @@
+#ifndef ML_GRIDENGINE_EXECUTOR_TIMEINDEX_H
+#define ML_GRIDENGINE_EXECUTOR_TIMEINDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <deque>
+
+/**
+ * Sparse index of the arrival time of the program output.
+ *
+ * Each entry is the position of an output chunk and the time it arrived.  A chunk arriving
+ * within {@code interval} after the last entry only extends that entry, so the time of any
+ * byte is known up to the resolution of the index.  When the index grows beyond
+ * {@code maxEntries}, every two adjacent entries are merged and the interval doubles, which
+ * keeps the memory bounded.
+ * The index only covers the positions at or after the position given to {@code trim}.
+ *
+ * Times are wall-clock microseconds since the epoch, derived from the monotonic clock
+ * (see {@code now}), such that they never go backwards even if the system clock is adjusted.
+ *
+ * This class is not thread-safe.  {@class OutputBuffer} maintains it under its own lock.
+ */
+class TimeIndex {
+private:
+  struct Entry {
+    size_t position;    // position of the first chunk of the entry
+    int64_t time;       // arrival time of the first chunk
+    int64_t lastTime;   // arrival time of the last chunk
+  };
+
+  std::deque<Entry> _entries;
+  int64_t _interval;            // minimum time between two entries
+  size_t _maxEntries;           // maximum number of entries
+  size_t _end;                  // position after the last indexed chunk
+
+public:
+  /**
+   * Construct a new {@class TimeIndex}.
+   *
+   * @param interval The initial minimum time between two entries, in microseconds.
+   * @param maxEntries The maximum number of entries.
+   */
+  explicit TimeIndex(int64_t interval = 100000, size_t maxEntries = 65536) :
+    _interval(interval), _maxEntries(std::max(maxEntries, (size_t)4)), _end(0) {}
+
+  /** The current wall-clock time in microseconds, measured by the monotonic clock. */
+  static int64_t now();
+
+  /** Number of entries in the index. */
+  inline size_t entryCount() const { return _entries.size(); }
+
+  /** Current minimum time between two entries, in microseconds. */
+  inline int64_t interval() const { return _interval; }
+
+  /**
+   * The first position which may have arrived at or after {@arg time}.
+   *
+   * Bytes before the returned position are known to have arrived before {@arg time}, while
+   * some bytes after it may have arrived earlier, within the resolution of the index.  Returns
+   * the end of the indexed output if nothing arrived at or after {@arg time}.
+   */
+  size_t positionSince(int64_t time) const;
+
+  /**
+   * The position after all bytes which may have arrived at or before {@arg time}.
+   *
+   * Bytes at or after the returned position are known to have arrived after {@arg time}.
+   */
+  size_t positionUntil(int64_t time) const;
+
+  /**
+   * The arrival time of the chunk containing {@arg position}, within the resolution of the index.
+   *
+   * @return The time, or -1 if the position is not covered by the index.
+   */
+  int64_t timeAt(size_t position) const;
+
+  /** Index a chunk of {@arg count} bytes following the last chunk, which arrived at {@arg time}. */
+  void append(size_t count, int64_t time);
+
+  /** Drop the entries of the chunks ending at or before {@arg begin}. */
+  void trim(size_t begin);
+};
+
+
+#endif //ML_GRIDENGINE_EXECUTOR_TIMEINDEX_H
@@ -3,6 +3,7 @@
 //
 
 #include <unistd.h>
+#include <sys/resource.h>
 #include <Poco/Format.h>
 #include <Poco/Path.h>
 #include <Poco/File.h>
@@ -54,6 +55,14 @@ std::string Utils::formatSize(size_t size) {
   }
 }
 
+std::string Utils::formatDiscarded(size_t size) {
+  std::string formatted = formatSize(size);
+  if (!formatted.empty() && formatted.at(formatted.size() - 1) != 'B') {
+    return Poco::format("[%z (%s) bytes discarded]", size, formatted);
+  }
+  return Poco::format("[%z bytes discarded]", size);
+}
+
 void Utils::makeParents(std::string const &filePath) {
   Poco::Path path(filePath);
   Poco::File parentDir;
@@ -105,3 +114,15 @@ namespace {
 size_t Utils::calculateDirSize(std::string const &path, volatile bool *interrupted, bool ignoreErrors) {
   return getFsSize(Poco::File(path), interrupted, ignoreErrors);
 }
+
+size_t Utils::peakMemoryUsage() {
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+#ifdef __APPLE__
+  return (size_t)usage.ru_maxrss;           // in bytes
+#else
+  return (size_t)usage.ru_maxrss * 1024;    // in kilobytes
+#endif
+}
@@ -12,6 +12,9 @@ class Utils {
 public:
   static std::string formatSize(size_t size);
 
+  /** The marker line of {@arg size} bytes discarded from the saved output, e.g., "[2048 (2K) bytes discarded]". */
+  static std::string formatDiscarded(size_t size);
+
   /** Make parent directories. */
   static void makeParents(std::string const& filePath);
 
@@ -25,6 +28,9 @@ public:
    * @return Size of the directory.
    */
   static size_t calculateDirSize(std::string const& path, volatile bool *interrupted, bool ignoreErrors = true);
+
+  /** Get the peak resident memory size of this process, in bytes. */
+  static size_t peakMemoryUsage();
 };
 
 
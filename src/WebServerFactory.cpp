@@ -2,15 +2,26 @@
 // Created by 许昊文 on 2018/11/14.
 //
 
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
 #include <Poco/URI.h>
 #include <Poco/Net/HTTPServer.h>
+#include <Poco/Net/HTTPRequest.h>
 #include <Poco/Net/HTTPServerRequest.h>
+#include <Poco/Net/HTTPServerRequestImpl.h>
+#include <Poco/Net/StreamSocket.h>
 #include <Poco/Net/HTTPServerResponse.h>
 #include <Poco/Net/HTTPRequestHandler.h>
 #include <Poco/NumberParser.h>
+#include <Poco/RegularExpression.h>
+#include <Poco/StringTokenizer.h>
+#include <Poco/JSON/Object.h>
 #include "macros.h"
 #include "AutoFreePtr.h"
 #include "WebServerFactory.h"
+#include "OutputSearcher.h"
 #include "Logger.h"
 
 using namespace Poco::Net;
@@ -20,15 +31,47 @@ using namespace Poco::Net;
     Poco::URI _uri;                                                                 \
     ProgramExecutor *_executor;                                                     \
     OutputBuffer *_outputBuffer;                                                    \
+    OutputBuffer *_errorBuffer;                                                     \
+    CursorRegistry *_cursors;                                                       \
+    OutputStreamRegistry *_streams;                                                 \
     size_t _requestBufferSize;                                                      \
   public:                                                                           \
     explicit CLASS_NAME(Poco::URI uri, WebServerFactory *factory) :                 \
       _uri(uri),                                                                    \
       _executor(factory->executor()),                                               \
       _outputBuffer(factory->outputBuffer()),                                       \
+      _errorBuffer(factory->errorBuffer()),                                         \
+      _cursors(factory->cursors()),                                                 \
+      _streams(factory->streams()),                                                 \
       _requestBufferSize(factory->requestBufferSize())
 
 namespace {
+  /** Send all the {@arg iov} buffers through the socket {@arg fd}, resuming partial writes. */
+  bool sendAll(int fd, struct iovec *iov, int iovCount) {
+    while (iovCount > 0) {
+      struct msghdr msg;
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_iov = iov;
+      msg.msg_iovlen = (size_t)iovCount;
+      ssize_t sent = sendmsg(fd, &msg, MSG_NOSIGNAL);
+      if (sent < 0) {
+        if (errno == EINTR)
+          continue;
+        return false;
+      }
+      while (iovCount > 0 && (size_t)sent >= iov->iov_len) {
+        sent -= iov->iov_len;
+        ++iov;
+        --iovCount;
+      }
+      if (iovCount > 0) {
+        iov->iov_base = (char*)iov->iov_base + sent;
+        iov->iov_len -= (size_t)sent;
+      }
+    }
+    return true;
+  }
+
   class NotFoundHandler : public HTTPRequestHandler {
   public:
     virtual void handleRequest(HTTPServerRequest& request, HTTPServerResponse& response) {
@@ -41,6 +84,11 @@ namespace {
   class OutputPollHandler : public HTTPRequestHandler {
     HANDLER_CONSTRUCTOR(OutputPollHandler) {}
   private:
+    void _badRequest(HTTPServerResponse& response, std::string const& message) {
+      response.setStatus(HTTPResponse::HTTPStatus::HTTP_BAD_REQUEST);
+      response.send() << "<h1>" << message << "</h1>" << std::endl;
+    }
+
     template <typename Function, typename T>
     bool _tryParseQuery(HTTPServerResponse& response, Function const& f, std::string const& s, T *dst) {
       if (!f(s, *dst, ',')) {
@@ -58,6 +106,13 @@ namespace {
       long maxTimeout = (long)(ML_GRIDENGINE_CLIENT_READ_MAX_TIMEOUT_SECONDS * 1000L);
       long timeout = (long)(ML_GRIDENGINE_CLIENT_READ_DEFAULT_TIMEOUT_SECONDS * 1000L);
       size_t readCount = 0;
+      bool lineSpecified = false;
+      ssize_t line = 0;
+      size_t lineCount = 0;
+      std::string stream = "merged";
+      double since = -1, until = -1;
+      std::string repeats = "marker";
+      std::string cursorId;
 
       for (auto const& it: _uri.getQueryParameters()) {
         if (it.first == "begin") {
@@ -78,13 +133,181 @@ namespace {
             return;
           }
           readCount = countValue;
+        } else if (it.first == "line") {
+          Poco::Int64 lineValue;
+          if (!_tryParseQuery(response, Poco::NumberParser::tryParse64, it.second, &lineValue)) {
+            return;
+          }
+          line = lineValue;
+          lineSpecified = true;
+        } else if (it.first == "lines") {
+          Poco::UInt32 linesValue;
+          if (!_tryParseQuery(response, Poco::NumberParser::tryParseUnsigned, it.second, &linesValue)) {
+            return;
+          }
+          lineCount = linesValue;
+        } else if (it.first == "stream") {
+          stream = it.second;
+        } else if (it.first == "repeats") {
+          repeats = it.second;
+        } else if (it.first == "cursor") {
+          cursorId = it.second;
+        } else if (it.first == "since" || it.first == "until") {
+          double timeValue;
+          if (!Poco::NumberParser::tryParseFloat(it.second, timeValue) || timeValue < 0) {
+            _badRequest(response, "Invalid time: " + it.second);
+            return;
+          }
+          (it.first == "since" ? since : until) = timeValue;
+        }
+      }
+
+      // The merged output, the separated stderr and the other named streams are polled from
+      // their own buffers, while stdout is located within the merged output by the stream index.
+      OutputBuffer *buffer = _outputBuffer;
+      std::string streamName = "main";
+      bool stdoutOnly = false;
+      if ((stream == "stderr" || stream == "stdout") && !_errorBuffer) {
+        // the merged output would pass for either of them
+        _badRequest(response, "The stderr is not separated from the output.");
+        return;
+      }
+      if (stream == "stderr") {
+        buffer = _errorBuffer;
+        streamName = stream;
+      } else if (stream == "stdout") {
+        stdoutOnly = true;
+      } else if (stream != "merged") {
+        buffer = _streams ? _streams->get(stream) : nullptr;
+        if (!buffer) {
+          _badRequest(response, "Unknown stream: " + stream);
+          return;
+        }
+        streamName = stream;
+      }
+      if (_streams) {
+        // the streams being read take a larger share of the memory budget
+        _streams->recordRead(streamName);
+      }
+      bool timeSpecified = since >= 0 || until >= 0;
+      if (stdoutOnly && (lineSpecified || lineCount > 0 || timeSpecified)) {
+        _badRequest(response, "Lines or times cannot be polled from the stdout stream.");
+        return;
+      }
+      if (timeSpecified && (lineSpecified || lineCount > 0)) {
+        _badRequest(response, "Lines and times cannot be polled together.");
+        return;
+      }
+
+      // The repeated lines omitted from the buffer are presented either as a marker line or
+      // expanded, and the positions are those of the presented output.  The stdout stream is
+      // always presented as stored.
+      RepeatMode repeatMode;
+      if (repeats == "marker") {
+        repeatMode = REPEATS_MARKER;
+      } else if (repeats == "expand") {
+        repeatMode = REPEATS_EXPANDED;
+      } else {
+        _badRequest(response, "Unknown repeats: " + repeats);
+        return;
+      }
+      bool presentRepeats = buffer->deduplicateLines() && !stdoutOnly;
+
+      // A cursor keeps the position of the reader in the merged output, which overrides `begin`
+      // and `repeats`.  It is advanced past the chunks sent by this request.
+      if (!cursorId.empty()) {
+        if (!_cursors) {
+          _badRequest(response, "Cursors are not supported.");
+          return;
+        }
+        if (buffer != _outputBuffer || stdoutOnly || lineSpecified || lineCount > 0 || timeSpecified) {
+          _badRequest(response, "Cursors can only poll the merged output by position.");
+          return;
+        }
+        CursorInfo cursor;
+        if (!_cursors->poll(cursorId, &cursor)) {
+          response.setStatus(HTTPResponse::HTTPStatus::HTTP_NOT_FOUND);
+          response.send() << "<h1>Cursor not found.</h1>" << std::endl;
+          return;
+        }
+        begin = cursor.position;
+        repeatMode = cursor.repeatMode;
+      }
+
+      // Lines are mapped to the byte range, which overrides `begin` and `count`.  Without `line`,
+      // `lines=N` means the last N lines.
+      if (lineSpecified || lineCount > 0) {
+        LineRange range = buffer->lines(lineSpecified ? line : -(ssize_t)lineCount, lineCount);
+        if (presentRepeats) {
+          range.begin = buffer->repeatPosition(repeatMode, range.begin);
+          range.end = buffer->repeatPosition(repeatMode, range.end);
+        }
+        begin = range.begin;
+        if (lineCount > 0) {
+          if (range.count == 0) {
+            response.setStatus(HTTPResponse::HTTPStatus::HTTP_NO_CONTENT);
+            response.send();
+            return;
+          }
+          readCount = range.end - range.begin;
+        }
+      }
+
+      // Times (seconds since the epoch) are mapped to the byte range by the time index, which
+      // overrides `begin`.  `until` limits `count` to the output arrived by then.
+      if (timeSpecified) {
+        if (since >= 0) {
+          begin = buffer->positionSince((int64_t)(since * 1e6));
+          if (presentRepeats) {
+            begin = buffer->repeatPosition(repeatMode, (size_t)begin);
+          }
+        }
+        if (until >= 0) {
+          size_t end = buffer->positionUntil((int64_t)(until * 1e6));
+          if (presentRepeats) {
+            end = buffer->repeatPosition(repeatMode, end);
+          }
+          if (begin < 0) {
+            size_t writtenBytes = presentRepeats ? buffer->repeatWrittenBytes(repeatMode) : buffer->writtenBytes();
+            begin = std::max(begin + (ssize_t)writtenBytes, (ssize_t)0);
+          }
+          size_t positiveBegin = (size_t)begin;
+          if (end <= positiveBegin) {
+            response.setStatus(HTTPResponse::HTTPStatus::HTTP_NO_CONTENT);
+            response.send();
+            return;
+          }
+          readCount = readCount > 0 ? std::min(readCount, end - positiveBegin) : end - positiveBegin;
         }
       }
 
-      size_t bufferSize = readCount > 0 ? std::min(_requestBufferSize, readCount) : _requestBufferSize;
       size_t writtenBytes = 0;
-      AutoFreePtr<char> buffer((char*)malloc(bufferSize));
-      ReadResult result = _outputBuffer->read(begin, buffer.ptr, bufferSize, timeout);
+      ReadResult result;
+      if (stdoutOnly) {
+        if (begin < 0) {
+          begin = std::max(begin + (ssize_t)buffer->streamWrittenBytes(STDOUT_STREAM), (ssize_t)0);
+        }
+        // wait until the merged output has any stdout byte at or after `begin`
+        EventCount::Deadline deadline = EventCount::Deadline::after(timeout);
+        StreamSpan span;
+        while ((span = buffer->streamSpan(STDOUT_STREAM, (size_t)begin)).length == 0) {
+          long remaining = deadline.infinite ? 0 : std::max(deadline.remainingNanos() / 1000000L, 1L);
+          result = buffer->wait(span.mergedBegin, remaining);
+          if (result.isClosed || result.isTimeout)
+            break;
+        }
+      } else if (presentRepeats) {
+        if (begin < 0) {
+          begin = std::max(begin + (ssize_t)buffer->repeatWrittenBytes(repeatMode), (ssize_t)0);
+        }
+        // the synthesized bytes are there already, otherwise wait for the stored ones
+        RepeatSpan span = buffer->repeatSpan(repeatMode, (size_t)begin, 1);
+        if (!span.synthesized) {
+          result = buffer->wait(span.storedBegin, timeout);
+        }
+      } else {
+        result = buffer->wait(begin, timeout);
+      }
 
       // If the buffer has closed, stop the connection immediately.
       if (result.isClosed) {
@@ -102,41 +325,424 @@ namespace {
       else {
         response.setStatus(HTTPResponse::HTTPStatus::HTTP_OK);
         response.setChunkedTransferEncoding(true);
-        auto &r = response.send();
-
-        // send the header (begin position in hex)
-        std::string beginStr = Poco::format("%?x\n", result.begin);
-        r.write(beginStr.c_str(), beginStr.length());
-
-        // send the first piece of output
-        r.write(buffer.ptr, result.count);
-        r.flush();
-        begin = result.begin + result.count;
-        writtenBytes += result.count;
-
-        // send the remaining output if immediately fetchable
-        if (readCount > 0) {
-          while (writtenBytes < readCount && r.good()) {
-            size_t newReadCount = std::min(readCount - writtenBytes, bufferSize);
-            result = _outputBuffer->tryRead(begin, buffer.ptr, newReadCount);
-            if (result.isTimeout || result.isClosed || begin != result.begin)
+        response.send().flush();
+
+        // The chunks are written straight from the output buffer to the socket, unless they are
+        // close to being overwritten (e.g., a slow client tailing a fast writer), in which case
+        // they are copied out first like the history.  Each chunk sent from the ring is checked
+        // after having been sent, and as a last resort, the connection is aborted before the
+        // chunk is terminated if the writer has overwritten it, so the client never accepts torn
+        // data.
+        int fd = static_cast<HTTPServerRequestImpl&>(request).socket().impl()->sockfd();
+        std::string beginStr;
+        size_t sentBegin = 0;  // position of the first chunk sent
+        AutoFreePtr<Byte> copyBuffer(nullptr);
+        for (;;) {
+          size_t chunkSize = _requestBufferSize;
+          if (readCount > 0) {
+            if (writtenBytes >= readCount)
               break;
-            r.write(buffer.ptr, result.count);
-            r.flush();
-            begin = result.begin + result.count;
-            writtenBytes += result.count;
+            chunkSize = std::min(readCount - writtenBytes, chunkSize);
           }
-        } else {
-          while (r.good()) {
-            result = _outputBuffer->tryRead(begin, buffer.ptr, bufferSize);
-            if (result.isTimeout || result.isClosed || begin != result.begin)
+          OutputView view;
+          size_t viewBegin;  // position of the view in the polled stream
+          std::string synthesized;
+          if (presentRepeats) {
+            RepeatSpan span = buffer->repeatSpan(repeatMode, (size_t)begin, chunkSize);
+            if (span.synthesized) {
+              // the synthesized bytes are sent like the history, which is never overwritten
+              synthesized.swap(span.content);
+              view.isHistory = true;
+              view.begin = span.storedBegin;
+              view.count = synthesized.size();
+              view.segmentCount = 1;
+              view.segments[0].iov_base = (void*)synthesized.data();
+              view.segments[0].iov_len = synthesized.size();
+              viewBegin = span.position;
+            } else {
+              view = buffer->peek(span.storedBegin, span.length > 0 ? std::min(chunkSize, span.length) : chunkSize);
+              if (!view.isTimeout && !view.isClosed && view.begin != span.storedBegin) {
+                // the stored bytes have been evicted, so locate the first retained ones again
+                if (writtenBytes > 0)
+                  break;
+                begin = buffer->repeatPosition(repeatMode, view.begin);
+                continue;
+              }
+              viewBegin = span.position;
+            }
+          } else if (stdoutOnly) {
+            StreamSpan span = buffer->streamSpan(STDOUT_STREAM, (size_t)begin);
+            if (span.length == 0)
+              break;
+            view = buffer->peek(span.mergedBegin, std::min(chunkSize, span.length));
+            if (view.begin != span.mergedBegin)
+              break;
+            viewBegin = span.offset;
+          } else {
+            view = buffer->peek(begin, chunkSize);
+            viewBegin = view.begin;
+          }
+          if (view.isTimeout || view.isClosed || (writtenBytes > 0 && (size_t)begin != viewBegin))
+            break;
+
+          // contents evicted into the history, or about to be overwritten, have to be copied out
+          bool copied = false;
+          if (synthesized.empty() && (view.isHistory || !buffer->isFarFromEviction(view, _requestBufferSize))) {
+            if (!copyBuffer.ptr) {
+              copyBuffer.ptr = (Byte*)malloc(_requestBufferSize);
+            }
+            ReadResult result = buffer->tryRead(view.begin, copyBuffer.ptr, view.count);
+            if (result.isTimeout || result.isClosed || result.begin != view.begin)
               break;
-            r.write(buffer.ptr, result.count);
-            r.flush();
-            begin = result.begin + result.count;
-            writtenBytes += result.count;
+            view.count = result.count;
+            view.segmentCount = 1;
+            view.segments[0].iov_base = copyBuffer.ptr;
+            view.segments[0].iov_len = result.count;
+            copied = true;
+          }
+
+          // the first chunk starts with the header (begin position in hex)
+          if (writtenBytes == 0) {
+            beginStr = Poco::format("%?x\n", viewBegin);
+          }
+          // the arrival time of the chunk is sent as a chunk extension, which is ignored by
+          // the clients not interested in it
+          std::string chunkHeader;
+          int64_t time = buffer->timeAt(view.begin);
+          if (time >= 0) {
+            chunkHeader = Poco::format("%?x;time=%?d.%06?d\r\n", beginStr.length() + view.count,
+                                       time / 1000000, time % 1000000);
+          } else {
+            chunkHeader = Poco::format("%?x\r\n", beginStr.length() + view.count);
+          }
+          struct iovec iov[4];
+          int iovCount = 0;
+          iov[iovCount].iov_base = (void*)chunkHeader.data();
+          iov[iovCount++].iov_len = chunkHeader.length();
+          if (!beginStr.empty()) {
+            iov[iovCount].iov_base = (void*)beginStr.data();
+            iov[iovCount++].iov_len = beginStr.length();
+          }
+          for (int i=0; i<view.segmentCount; ++i) {
+            iov[iovCount++] = view.segments[i];
+          }
+          if (!sendAll(fd, iov, iovCount))
+            break;
+          if (!view.isHistory && !copied && !buffer->isIntact(view)) {
+            Logger::getLogger().warn("Output at %z was overwritten while being sent, abort the connection.", view.begin);
+            ::shutdown(fd, SHUT_RDWR);
+            break;
+          }
+          struct iovec trailer = {(void*)"\r\n", 2};
+          if (!sendAll(fd, &trailer, 1))
+            break;
+
+          if (writtenBytes == 0) {
+            sentBegin = viewBegin;
+          }
+          beginStr.clear();
+          begin = viewBegin + view.count;
+          writtenBytes += view.count;
+        }
+        if (!cursorId.empty() && writtenBytes > 0) {
+          _cursors->advance(cursorId, sentBegin, (size_t)begin);
+        }
+      }
+    }
+  };
+
+  class OutputCursorsHandler : public HTTPRequestHandler {
+    HANDLER_CONSTRUCTOR(OutputCursorsHandler) {}
+  private:
+    void _badRequest(HTTPServerResponse& response, std::string const& message) {
+      response.setStatus(HTTPResponse::HTTPStatus::HTTP_BAD_REQUEST);
+      response.send() << "<h1>" << message << "</h1>" << std::endl;
+    }
+
+    void _cursorNotFound(HTTPServerResponse& response) {
+      response.setStatus(HTTPResponse::HTTPStatus::HTTP_NOT_FOUND);
+      response.send() << "<h1>Cursor not found.</h1>" << std::endl;
+    }
+
+    static void _stringify(CursorInfo const& cursor, std::ostream &out) {
+      Poco::JSON::Object doc;
+      doc.set("id", cursor.id);
+      doc.set("position", cursor.position);
+      doc.set("lag", cursor.lag);
+      doc.set("deliveredBytes", cursor.deliveredBytes);
+      doc.set("droppedBytes", cursor.droppedBytes);
+      doc.set("durable", cursor.durable);
+      doc.set("repeats", std::string(cursor.repeatMode == REPEATS_EXPANDED ? "expand" : "marker"));
+      doc.set("created", cursor.createdTime / 1e6);
+      doc.set("lastPoll", cursor.lastPollTime / 1e6);
+      doc.stringify(out);
+      out << '\n';
+    }
+
+    void _create(HTTPServerResponse& response) {
+      bool durable = false;
+      ssize_t begin = 0;
+      RepeatMode repeatMode = REPEATS_MARKER;
+      for (auto const& it: _uri.getQueryParameters()) {
+        if (it.first == "durable") {
+          if (!Poco::NumberParser::tryParseBool(it.second, durable)) {
+            _badRequest(response, "Invalid durable: " + it.second);
+            return;
+          }
+        } else if (it.first == "begin") {
+          Poco::Int64 beginValue;
+          if (!Poco::NumberParser::tryParse64(it.second, beginValue)) {
+            _badRequest(response, "Invalid begin: " + it.second);
+            return;
+          }
+          begin = beginValue;
+        } else if (it.first == "repeats") {
+          if (it.second == "marker") {
+            repeatMode = REPEATS_MARKER;
+          } else if (it.second == "expand") {
+            repeatMode = REPEATS_EXPANDED;
+          } else {
+            _badRequest(response, "Unknown repeats: " + it.second);
+            return;
+          }
+        }
+      }
+      CursorInfo cursor = _cursors->create(durable, repeatMode, begin);
+      response.setStatus(HTTPResponse::HTTPStatus::HTTP_OK);
+      response.setContentType("text/json");
+      _stringify(cursor, response.send());
+    }
+
+  public:
+    virtual void handleRequest(HTTPServerRequest& request, HTTPServerResponse& response) {
+      if (!_cursors) {
+        _badRequest(response, "Cursors are not supported.");
+        return;
+      }
+      std::string id;
+      for (auto const& it: _uri.getQueryParameters()) {
+        if (it.first == "id") {
+          id = it.second;
+        }
+      }
+
+      // POST creates a cursor, DELETE removes it, and GET describes it, or all of the cursors
+      // (one JSON object per line) if no id is given.
+      if (request.getMethod() == HTTPRequest::HTTP_POST) {
+        _create(response);
+      } else if (request.getMethod() == HTTPRequest::HTTP_DELETE) {
+        if (!_cursors->remove(id)) {
+          _cursorNotFound(response);
+          return;
+        }
+        response.setStatus(HTTPResponse::HTTPStatus::HTTP_OK);
+        response.setContentType("text/json");
+        response.send() << "{}";
+      } else if (!id.empty()) {
+        CursorInfo cursor;
+        if (!_cursors->poll(id, &cursor)) {
+          _cursorNotFound(response);
+          return;
+        }
+        response.setStatus(HTTPResponse::HTTPStatus::HTTP_OK);
+        response.setContentType("text/json");
+        _stringify(cursor, response.send());
+      } else {
+        response.setStatus(HTTPResponse::HTTPStatus::HTTP_OK);
+        response.setContentType("text/json");
+        auto &out = response.send();
+        for (CursorInfo const& cursor: _cursors->list()) {
+          _stringify(cursor, out);
+        }
+      }
+    }
+  };
+
+  class OutputSearchHandler : public HTTPRequestHandler {
+    HANDLER_CONSTRUCTOR(OutputSearchHandler) {}
+  public:
+    virtual void handleRequest(HTTPServerRequest& request, HTTPServerResponse& response) {
+      std::string query, pattern;
+      size_t limit = 0;
+      for (auto const& it: _uri.getQueryParameters()) {
+        if (it.first == "q") {
+          query = it.second;
+        } else if (it.first == "regex") {
+          pattern = it.second;
+        } else if (it.first == "limit") {
+          Poco::UInt32 limitValue;
+          if (!Poco::NumberParser::tryParseUnsigned(it.second, limitValue)) {
+            response.setStatus(HTTPResponse::HTTPStatus::HTTP_BAD_REQUEST);
+            response.send() << "<h1>Bad Request</h1>" << std::endl;
+            return;
+          }
+          limit = limitValue;
+        }
+      }
+      if (query.empty() && pattern.empty()) {
+        response.setStatus(HTTPResponse::HTTPStatus::HTTP_BAD_REQUEST);
+        response.send() << "<h1>Either `q` or `regex` is required.</h1>" << std::endl;
+        return;
+      }
+
+      std::shared_ptr<OutputSearcher> searcher;
+      try {
+        searcher = std::make_shared<OutputSearcher>(_outputBuffer, query, pattern, _requestBufferSize);
+      } catch (Poco::RegularExpressionException const& exc) {
+        response.setStatus(HTTPResponse::HTTPStatus::HTTP_BAD_REQUEST);
+        response.send() << "<h1>Invalid regex: " << exc.message() << "</h1>" << std::endl;
+        return;
+      }
+
+      // Each match is sent as a JSON object in its own line, as soon as it is found.
+      response.setStatus(HTTPResponse::HTTPStatus::HTTP_OK);
+      response.setContentType("text/json");
+      response.setChunkedTransferEncoding(true);
+      auto &out = response.send();
+      out.flush();
+      searcher->search([&out] (SearchMatch const& match) {
+        Poco::JSON::Object doc;
+        doc.set("offset", match.offset);
+        doc.set("line", match.line);
+        doc.set("text", match.text);
+        doc.stringify(out);
+        out << '\n';
+        out.flush();
+        return out.good();
+      }, limit);
+    }
+  };
+
+  class OutputErrorsHandler : public HTTPRequestHandler {
+    HANDLER_CONSTRUCTOR(OutputErrorsHandler) {}
+  private:
+    void _badRequest(HTTPServerResponse& response, std::string const& message) {
+      response.setStatus(HTTPResponse::HTTPStatus::HTTP_BAD_REQUEST);
+      response.send() << "<h1>" << message << "</h1>" << std::endl;
+    }
+
+  public:
+    virtual void handleRequest(HTTPServerRequest& request, HTTPServerResponse& response) {
+      unsigned mask = (1U << SEVERITY_COUNT) - 1;
+      size_t limit = 0;
+      std::string stream = "merged";
+      std::string repeats = "marker";
+      for (auto const& it: _uri.getQueryParameters()) {
+        if (it.first == "severity") {
+          mask = 0;
+          Poco::StringTokenizer tokens(it.second, ",",
+                                       Poco::StringTokenizer::TOK_TRIM | Poco::StringTokenizer::TOK_IGNORE_EMPTY);
+          for (auto const& token: tokens) {
+            Severity severity;
+            if (!SeverityIndex::parse(token, &severity)) {
+              _badRequest(response, "Unknown severity: " + token);
+              return;
+            }
+            mask |= 1U << severity;
           }
+        } else if (it.first == "limit") {
+          Poco::UInt32 limitValue;
+          if (!Poco::NumberParser::tryParseUnsigned(it.second, limitValue)) {
+            _badRequest(response, "Invalid limit: " + it.second);
+            return;
+          }
+          limit = limitValue;
+        } else if (it.first == "stream") {
+          stream = it.second;
+        } else if (it.first == "repeats") {
+          repeats = it.second;
+        }
+      }
+
+      OutputBuffer *buffer = _outputBuffer;
+      if (stream == "stderr") {
+        if (!_errorBuffer) {
+          _badRequest(response, "The stderr is not separated from the output.");
+          return;
+        }
+        buffer = _errorBuffer;
+      } else if (stream != "merged") {
+        buffer = _streams ? _streams->get(stream) : nullptr;
+        if (!buffer) {
+          _badRequest(response, "Unknown stream: " + stream);
+          return;
+        }
+      }
+      if (_streams) {
+        _streams->recordRead(stream == "merged" ? "main" : stream);
+      }
+      if (!buffer->severityIndexing()) {
+        _badRequest(response, "The severity index is not enabled.");
+        return;
+      }
+      RepeatMode repeatMode;
+      if (repeats == "marker") {
+        repeatMode = REPEATS_MARKER;
+      } else if (repeats == "expand") {
+        repeatMode = REPEATS_EXPANDED;
+      } else {
+        _badRequest(response, "Unknown repeats: " + repeats);
+        return;
+      }
+
+      // Each entry is sent as a JSON object in its own line, ordered by position.  The positions
+      // are those polled by `/output/_poll` with the same `stream` and `repeats`, and `retained`
+      // tells whether or not the output there can still be polled.
+      response.setStatus(HTTPResponse::HTTPStatus::HTTP_OK);
+      response.setContentType("text/json");
+      auto &out = response.send();
+      size_t retainedBegin = buffer->retainedBegin();
+      size_t headSize = buffer->headSize();
+      for (SeverityEntry const& entry: buffer->severityEntries(mask, limit)) {
+        Poco::JSON::Object doc;
+        doc.set("severity", std::string(SeverityIndex::name(entry.severity)));
+        doc.set("line", entry.line);
+        if (buffer->deduplicateLines()) {
+          doc.set("begin", buffer->repeatPosition(repeatMode, entry.begin));
+          doc.set("end", buffer->repeatPosition(repeatMode, entry.end));
+        } else {
+          doc.set("begin", entry.begin);
+          doc.set("end", entry.end);
+        }
+        doc.set("retained", entry.begin >= retainedBegin || entry.end <= headSize);
+        int64_t time = buffer->timeAt(entry.begin);
+        if (time >= 0) {
+          doc.set("time", time / 1e6);
         }
+        doc.set("text", entry.text);
+        doc.stringify(out);
+        out << '\n';
+      }
+    }
+  };
+
+  class OutputStreamsHandler : public HTTPRequestHandler {
+    HANDLER_CONSTRUCTOR(OutputStreamsHandler) {}
+  public:
+    virtual void handleRequest(HTTPServerRequest& request, HTTPServerResponse& response) {
+      if (!_streams) {
+        response.setStatus(HTTPResponse::HTTPStatus::HTTP_NOT_FOUND);
+        response.send() << "<h1>Named streams are not supported.</h1>" << std::endl;
+        return;
+      }
+
+      // Each stream is sent as a JSON object in its own line, in the order of registration.
+      response.setStatus(HTTPResponse::HTTPStatus::HTTP_OK);
+      response.setContentType("text/json");
+      auto &out = response.send();
+      for (OutputStreamInfo const& info: _streams->list()) {
+        Poco::JSON::Object doc;
+        doc.set("name", info.name);
+        doc.set("priority", info.priority);
+        doc.set("reserved", info.reserved);
+        doc.set("capacityLimit", info.capacityLimit);
+        doc.set("size", info.size);
+        doc.set("writtenBytes", info.writtenBytes);
+        doc.set("reads", info.reads);
+        doc.set("readRate", info.readRate);
+        doc.set("closed", info.closed);
+        doc.stringify(out);
+        out << '\n';
       }
     }
   };
@@ -165,9 +771,13 @@ namespace {
   };
 }
 
-WebServerFactory::WebServerFactory(ProgramExecutor *executor, OutputBuffer *outputBuffer, size_t requestBufferSize) :
+WebServerFactory::WebServerFactory(ProgramExecutor *executor, OutputBuffer *outputBuffer, OutputBuffer *errorBuffer,
+                                   CursorRegistry *cursors, OutputStreamRegistry *streams, size_t requestBufferSize) :
     _executor(executor),
     _outputBuffer(outputBuffer),
+    _errorBuffer(errorBuffer),
+    _cursors(cursors),
+    _streams(streams),
     _requestBufferSize(requestBufferSize)
 {
 
@@ -177,6 +787,14 @@ HTTPRequestHandler *WebServerFactory::createRequestHandler(HTTPServerRequest con
   Poco::URI uri(request.getURI());
   if (uri.getPath() == "/output/_poll") {
     return new OutputPollHandler(uri, this);
+  } else if (uri.getPath() == "/output/_cursors") {
+    return new OutputCursorsHandler(uri, this);
+  } else if (uri.getPath() == "/output/_errors") {
+    return new OutputErrorsHandler(uri, this);
+  } else if (uri.getPath() == "/output/_streams") {
+    return new OutputStreamsHandler(uri, this);
+  } else if (uri.getPath() == "/output/_search") {
+    return new OutputSearchHandler(uri, this);
   } else if (uri.getPath() == "/_kill") {
     return new KillHandler(uri, this);
   } else {
@@ -8,21 +8,39 @@
 #include <Poco/Net/HTTPRequestHandlerFactory.h>
 #include "ProgramExecutor.h"
 #include "OutputBuffer.h"
+#include "CursorRegistry.h"
+#include "OutputStreamRegistry.h"
 
 
 class WebServerFactory : public Poco::Net::HTTPRequestHandlerFactory {
 private:
   ProgramExecutor *_executor;
   OutputBuffer *_outputBuffer;
+  OutputBuffer *_errorBuffer;
+  CursorRegistry *_cursors;
+  OutputStreamRegistry *_streams;
   size_t _requestBufferSize;
 
 public:
-  explicit WebServerFactory(ProgramExecutor *executor, OutputBuffer *outputBuffer, size_t requestBufferSize=65536);
+  /**
+   * Construct a new {@class WebServerFactory}.
+   *
+   * @param outputBuffer The merged program output.
+   * @param errorBuffer The separated stderr of the program, or NULL if not separated.
+   * @param cursors The reader cursors of the merged output, or NULL if not supported.
+   * @param streams The named output streams, e.g., "run-after", or NULL if none.
+   */
+  explicit WebServerFactory(ProgramExecutor *executor, OutputBuffer *outputBuffer, OutputBuffer *errorBuffer=nullptr,
+                            CursorRegistry *cursors=nullptr, OutputStreamRegistry *streams=nullptr,
+                            size_t requestBufferSize=65536);
 
   virtual Poco::Net::HTTPRequestHandler* createRequestHandler(Poco::Net::HTTPServerRequest const& request);
 
   ProgramExecutor *executor() const { return _executor; }
   OutputBuffer *outputBuffer() const { return _outputBuffer; }
+  OutputBuffer *errorBuffer() const { return _errorBuffer; }
+  CursorRegistry *cursors() const { return _cursors; }
+  OutputStreamRegistry *streams() const { return _streams; }
   size_t requestBufferSize() const { return _requestBufferSize; }
 };
 
@@ -0,0 +1,72 @@
+#include "WriteCoalescer.h"
+#include "TimeIndex.h"
+
+WriteCoalescer::WriteCoalescer(Sink sink, size_t maxBytes, int64_t window) :
+  _sink(std::move(sink)),
+  _maxBytes(maxBytes),
+  _window(maxBytes > 0 && window > 0 ? window : 0),
+  _batching(false),
+  _lastArrival(-1),
+  _pendingSince(0),
+  _pendingStream(STDOUT_STREAM),
+  _writes(0),
+  _flushes(0)
+{
+}
+
+void WriteCoalescer::_emit(ProgramStream stream, const Byte *data, size_t count) {
+  _flushes.store(_flushes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  _sink(stream, data, count);
+}
+
+void WriteCoalescer::write(ProgramStream stream, const Byte *data, size_t count) {
+  write(stream, data, count, TimeIndex::now());
+}
+
+void WriteCoalescer::write(ProgramStream stream, const Byte *data, size_t count, int64_t now) {
+  _writes.store(_writes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  bool dense = _lastArrival >= 0 && now - _lastArrival < _window;
+  _lastArrival = now;
+
+  // the sparse output passes through at once, and stops the batching
+  if (!dense) {
+    flush();
+    _batching = false;
+    _emit(stream, data, count);
+    return;
+  }
+  _batching = true;
+  if (!_pending.empty() && stream != _pendingStream) {
+    flush();
+  }
+
+  // a large chunk needs no batching, nor copying
+  if (_pending.empty() && count >= _maxBytes) {
+    _emit(stream, data, count);
+    return;
+  }
+  if (_pending.empty()) {
+    _pendingSince = now;
+    _pendingStream = stream;
+  }
+  _pending.insert(_pending.end(), data, data + count);
+  if (_pending.size() >= _maxBytes) {
+    flush();
+  }
+}
+
+void WriteCoalescer::flushIfDue(int64_t now) {
+  if (!_pending.empty() && now >= _pendingSince + _window) {
+    flush();
+  }
+  if (_batching && now - _lastArrival >= _window) {
+    _batching = false;
+  }
+}
+
+void WriteCoalescer::flush() {
+  if (!_pending.empty()) {
+    _emit(_pendingStream, _pending.data(), _pending.size());
+    _pending.clear();
+  }
+}
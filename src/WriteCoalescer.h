@@ -0,0 +1,96 @@
+#ifndef ML_GRIDENGINE_EXECUTOR_WRITECOALESCER_H
+#define ML_GRIDENGINE_EXECUTOR_WRITECOALESCER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <vector>
+#include "StreamIndex.h"
+
+typedef unsigned char Byte;
+
+/**
+ * Ingest stage which batches the small chunks of output arriving at a high rate.
+ *
+ * Programs printing a short line per step make the IO thread write into the output buffer
+ * thousands of times per second, each write taking its lock and waking up all the readers.
+ * Once two chunks arrive within {@code window} of each other, the coalescer starts batching:
+ * the chunks are held back until {@code window} has elapsed since the first one held, or
+ * {@code maxBytes} have been held, and then passed on as a single write.  As soon as the gap
+ * between two chunks reaches {@code window} again, i.e., the output has become sparse, the
+ * batching stops and each chunk passes through at once, so interactive output is not delayed.
+ *
+ * Only the chunks of the same stream are batched together, such that the order of stdout and
+ * stderr is kept.
+ *
+ * This class is not thread-safe.  It is driven by the IO thread of {@class IOController}.
+ */
+class WriteCoalescer {
+public:
+  /** Where the batched output goes. */
+  typedef std::function<void (ProgramStream stream, const Byte *data, size_t count)> Sink;
+
+private:
+  Sink _sink;
+  size_t _maxBytes;
+  int64_t _window;              // in microseconds, zero for no batching
+  bool _batching;
+  int64_t _lastArrival;         // time of the last chunk, or -1 if none yet
+  int64_t _pendingSince;        // time of the first chunk held back
+  ProgramStream _pendingStream;
+  std::vector<Byte> _pending;
+  // counted by the IO thread alone, and may be read by other threads
+  std::atomic<size_t> _writes;
+  std::atomic<size_t> _flushes;
+
+  /** Pass a chunk on to the sink. */
+  void _emit(ProgramStream stream, const Byte *data, size_t count);
+
+public:
+  /**
+   * Construct a new {@class WriteCoalescer}.
+   *
+   * @param sink Where the batched output goes.
+   * @param maxBytes Maximum number of bytes held back.
+   * @param window Maximum time of a chunk being held back, in microseconds.  Zero disables
+   *               the batching, and every chunk passes through at once.
+   */
+  explicit WriteCoalescer(Sink sink, size_t maxBytes = 64 * 1024, int64_t window = 0);
+
+  /** Maximum number of bytes held back. */
+  inline size_t maxBytes() const { return _maxBytes; }
+
+  /** Maximum time of a chunk being held back, in microseconds. */
+  inline int64_t window() const { return _window; }
+
+  /** Whether or not the chunks are being batched, i.e., the output is dense. */
+  inline bool batching() const { return _batching; }
+
+  /** Number of chunks written into the coalescer. */
+  inline size_t writes() const { return _writes.load(std::memory_order_relaxed); }
+
+  /** Number of writes passed on to the sink. */
+  inline size_t flushes() const { return _flushes.load(std::memory_order_relaxed); }
+
+  /** Number of bytes being held back. */
+  inline size_t pendingBytes() const { return _pending.size(); }
+
+  /** When the bytes held back must be passed on, or -1 if nothing is held back. */
+  inline int64_t deadline() const { return _pending.empty() ? -1 : _pendingSince + _window; }
+
+  /** Write a chunk of {@arg stream} which arrived at {@arg now} (see {@code TimeIndex::now}). */
+  void write(ProgramStream stream, const Byte *data, size_t count, int64_t now);
+
+  /** Write a chunk of {@arg stream} which arrived just now. */
+  void write(ProgramStream stream, const Byte *data, size_t count);
+
+  /** Pass the bytes held back on, if they have been held for {@code window} at {@arg now}. */
+  void flushIfDue(int64_t now);
+
+  /** Pass the bytes held back on, e.g., when the output has ended. */
+  void flush();
+};
+
+
+#endif //ML_GRIDENGINE_EXECUTOR_WRITECOALESCER_H
@@ -0,0 +1,191 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "ml_gridengine_ring.h"
+
+#define LOAD(field) __atomic_load_n(&(field), __ATOMIC_RELAXED)
+#define LOAD_ACQUIRE(field) __atomic_load_n(&(field), __ATOMIC_ACQUIRE)
+#define ACQUIRE_FENCE() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+
+// spins before yielding the CPU to a writer preempted while updating the positions
+#define MAX_SPINS 1000
+
+typedef struct {
+  uint64_t head;
+  uint64_t size;
+  uint64_t written_bytes;
+  int closed;
+} ring_positions;
+
+static int64_t monotonic_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* Returns 0, or -1 with errno set to ESTALE if the writer has held the lock for too long. */
+static int load_positions(const mlge_ring_header *header, ring_positions *positions) {
+  int spins = 0;
+  int64_t deadline = -1;
+  for (;;) {
+    uint64_t sequence = LOAD_ACQUIRE(header->sequence);
+    int stale = 0;
+    if (sequence & 1) {
+      if (deadline < 0) {
+        deadline = monotonic_ms() + MLGE_RING_WRITER_TIMEOUT_MS;
+      } else if (spins == 0 && monotonic_ms() >= deadline) {
+        stale = 1;
+      }
+    }
+    if ((sequence & 1) == 0 || stale) {
+      positions->head = LOAD(header->head);
+      positions->size = LOAD(header->size);
+      positions->written_bytes = LOAD(header->written_bytes);
+      positions->closed = LOAD(header->closed) != 0;
+      ACQUIRE_FENCE();
+      if (stale) {
+        errno = ESTALE;
+        return -1;
+      }
+      if (LOAD(header->sequence) == sequence) {
+        return 0;
+      }
+    }
+    if (++spins >= MAX_SPINS) {
+      sched_yield();
+      spins = 0;
+    }
+  }
+}
+
+static int map_fd(mlge_ring *ring, int fd) {
+  struct stat st;
+  void *addr = MAP_FAILED;
+  if (fstat(fd, &st) == 0) {
+    if ((size_t)st.st_size < sizeof(mlge_ring_header)) {
+      errno = EINVAL;
+    } else {
+      addr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+  }
+  int error = errno;
+  close(fd);
+  if (addr == MAP_FAILED) {
+    errno = error;
+    return -1;
+  }
+
+  const mlge_ring_header *header = (const mlge_ring_header*)addr;
+  size_t map_size = (size_t)st.st_size;
+  if (memcmp(header->magic, MLGE_RING_MAGIC, sizeof(header->magic)) != 0 || header->version != MLGE_RING_VERSION ||
+      header->data_offset < sizeof(mlge_ring_header) || header->capacity == 0 ||
+      map_size < header->data_offset + header->capacity) {
+    munmap(addr, map_size);
+    errno = EINVAL;
+    return -1;
+  }
+  ring->header = header;
+  ring->data = (const unsigned char*)addr + header->data_offset;
+  ring->map_size = map_size;
+  return 0;
+}
+
+int mlge_ring_open(mlge_ring *ring, const char *name) {
+  char path[256];
+  if (snprintf(path, sizeof(path), "/%s", name[0] == '/' ? name + 1 : name) >= (int)sizeof(path)) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+  int fd = shm_open(path, O_RDONLY, 0);
+  return fd < 0 ? -1 : map_fd(ring, fd);
+}
+
+int mlge_ring_open_file(mlge_ring *ring, const char *path) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  return fd < 0 ? -1 : map_fd(ring, fd);
+}
+
+void mlge_ring_close(mlge_ring *ring) {
+  if (ring->header) {
+    munmap((void*)ring->header, ring->map_size);
+    ring->header = NULL;
+    ring->data = NULL;
+    ring->map_size = 0;
+  }
+}
+
+uint64_t mlge_ring_generation(const mlge_ring *ring) {
+  return ring->header->generation;
+}
+
+int mlge_ring_get_positions(const mlge_ring *ring, mlge_ring_positions *positions) {
+  ring_positions p;
+  int ret = load_positions(ring->header, &p);
+  if (p.size > p.written_bytes) {
+    p.size = p.written_bytes;
+  }
+  uint64_t begin = p.written_bytes - p.size;
+  uint64_t valid_begin = LOAD_ACQUIRE(ring->header->valid_begin);
+  positions->begin = valid_begin > begin ? (valid_begin < p.written_bytes ? valid_begin : p.written_bytes) : begin;
+  positions->end = p.written_bytes;
+  positions->closed = p.closed;
+  return ret;
+}
+
+ssize_t mlge_ring_read(const mlge_ring *ring, uint64_t begin, void *target, size_t count, uint64_t *actual_begin) {
+  const mlge_ring_header *header = ring->header;
+  uint64_t capacity = header->capacity;
+  for (;;) {
+    ring_positions p;
+    if (load_positions(header, &p) != 0) {
+      if (actual_begin) {
+        *actual_begin = begin;
+      }
+      return -1;
+    }
+    if (p.size > capacity || p.head >= capacity || p.size > p.written_bytes) {
+      // never happens unless the segment is corrupted
+      if (actual_begin) {
+        *actual_begin = begin;
+      }
+      return 0;
+    }
+
+    // the oldest bytes may be being overwritten, and are then skipped
+    uint64_t ring_begin = p.written_bytes - p.size;
+    uint64_t valid_begin = LOAD_ACQUIRE(header->valid_begin);
+    uint64_t from = begin;
+    if (from < ring_begin) {
+      from = ring_begin;
+    }
+    if (from < valid_begin) {
+      from = valid_begin;
+    }
+    if (from >= p.written_bytes) {
+      if (actual_begin) {
+        *actual_begin = begin > p.written_bytes ? begin : p.written_bytes;
+      }
+      return 0;
+    }
+    size_t n = (size_t)(p.written_bytes - from) < count ? (size_t)(p.written_bytes - from) : count;
+    size_t front = (size_t)((p.head + (from - ring_begin)) % capacity);
+    size_t right = n < capacity - front ? n : (size_t)(capacity - front);
+    memcpy(target, ring->data + front, right);
+    memcpy((unsigned char*)target + right, ring->data, n - right);
+
+    // the copy is valid only if none of the bytes have been overwritten meanwhile
+    ACQUIRE_FENCE();
+    if (LOAD(header->valid_begin) <= from) {
+      if (actual_begin) {
+        *actual_begin = from;
+      }
+      return (ssize_t)n;
+    }
+  }
+}
@@ -0,0 +1,115 @@
+#ifndef ML_GRIDENGINE_EXECUTOR_ML_GRIDENGINE_RING_H
+#define ML_GRIDENGINE_EXECUTOR_ML_GRIDENGINE_RING_H
+
+/*
+ * Read-only access to the output ring of a live executor on the same host, exported by
+ * "--shm-export NAME" into the POSIX shared memory "/NAME" (or written into a "--ring-file").
+ *
+ * The executor is the only writer.  A reader maps the segment read-only, takes the positions
+ * under the sequence lock of the header, copies the bytes, and then checks that none of them have
+ * been overwritten meanwhile.  Tailing the output thus takes no system call per read, although
+ * the reader has to poll (or sleep) while there is no new output.
+ *
+ * This is a C library with no dependency, so that it can be linked into any agent.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MLGE_RING_MAGIC "MLGERING"
+#define MLGE_RING_VERSION 1
+
+/*
+ * Milliseconds to wait for the executor updating the positions, after which it is taken as killed
+ * amid the update, and the positions as stale.
+ */
+#ifndef MLGE_RING_WRITER_TIMEOUT_MS
+# define MLGE_RING_WRITER_TIMEOUT_MS 100
+#endif
+
+/**
+ * Header at the beginning of the segment, which has the same layout as {@code RingFileHeader}.
+ * The ring starts at {@code data_offset}.  The fields after {@code generation} are updated by the
+ * executor, and must be read by the functions below.
+ */
+typedef struct mlge_ring_header {
+  char magic[8];                 /* MLGE_RING_MAGIC */
+  uint32_t version;              /* MLGE_RING_VERSION */
+  uint32_t data_offset;
+  uint64_t capacity;             /* number of bytes in the ring */
+  uint64_t generation;           /* incremented each time an executor creates the segment */
+  uint64_t sequence;             /* odd while the executor is updating the positions */
+  uint64_t head;                 /* offset of the oldest byte in the ring */
+  uint64_t size;                 /* number of bytes in the ring */
+  uint64_t written_bytes;        /* number of bytes ever written */
+  uint64_t valid_begin;          /* bytes before this position may have been overwritten */
+  uint32_t closed;               /* whether or not the output has completed */
+} mlge_ring_header;
+
+/** A mapped segment. */
+typedef struct mlge_ring {
+  const mlge_ring_header *header;
+  const unsigned char *data;
+  size_t map_size;
+} mlge_ring;
+
+/** A consistent copy of the positions. */
+typedef struct mlge_ring_positions {
+  /** Position of the oldest byte retained, counted from the very beginning when the program started. */
+  uint64_t begin;
+  /** Position after the last byte written. */
+  uint64_t end;
+  /** Whether or not the output has completed, i.e., {@code end} is final. */
+  int closed;
+} mlge_ring_positions;
+
+/**
+ * Map the shared memory segment exported by "--shm-export NAME".
+ *
+ * The segment is only readable by the user of the executor, unless "--shm-export-mode" grants
+ * the group (e.g., "0640").
+ *
+ * @param name The NAME of the segment, with or without the leading "/".
+ * @return 0 on success, or -1 with errno set (EINVAL if the segment is not an output ring).
+ */
+int mlge_ring_open(mlge_ring *ring, const char *name);
+
+/** Map a ring file written by "--ring-file PATH", like {@code mlge_ring_open}. */
+int mlge_ring_open_file(mlge_ring *ring, const char *path);
+
+/** Unmap the segment. */
+void mlge_ring_close(mlge_ring *ring);
+
+/** The generation of the segment, which changes if another executor has re-created it. */
+uint64_t mlge_ring_generation(const mlge_ring *ring);
+
+/**
+ * Take a consistent copy of the positions.
+ *
+ * @return 0 on success, or -1 with errno set to ESTALE if the executor has been updating the
+ *         positions for {@code MLGE_RING_WRITER_TIMEOUT_MS}, i.e., it was killed amid the update.
+ *         The positions are then copied as they are, and may mix two updates.
+ */
+int mlge_ring_get_positions(const mlge_ring *ring, mlge_ring_positions *positions);
+
+/**
+ * Copy at most {@code count} bytes of the output starting at {@code begin}.  If the bytes at
+ * {@code begin} are no longer retained, the copy starts at the oldest byte retained.
+ *
+ * @param actual_begin If not NULL, gets the position of the first byte copied, or of the next
+ *        byte to be written if there is no output at or after {@code begin} yet.
+ * @return Number of bytes copied, which is 0 if there is no output at or after {@code begin} yet,
+ *         or -1 with errno set to ESTALE like {@code mlge_ring_get_positions}.
+ */
+ssize_t mlge_ring_read(const mlge_ring *ring, uint64_t begin, void *target, size_t count, uint64_t *actual_begin);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //ML_GRIDENGINE_EXECUTOR_ML_GRIDENGINE_RING_H
@@ -19,6 +19,78 @@
 #define ML_GRIDENGINE_CLIENT_READ_DEFAULT_TIMEOUT_SECONDS (60)
 #define ML_GRIDENGINE_RUN_AFTER_TIMEOUT_SECONDS (30)
 
+#ifndef ML_GRIDENGINE_DEDUP_MAX_LINE_BYTES
+# define ML_GRIDENGINE_DEDUP_MAX_LINE_BYTES (4096)
+#endif
+
+#ifndef ML_GRIDENGINE_CURSOR_IDLE_TIMEOUT_SECONDS
+# define ML_GRIDENGINE_CURSOR_IDLE_TIMEOUT_SECONDS (60)
+#endif
+
+#ifndef ML_GRIDENGINE_MAX_CURSORS
+# define ML_GRIDENGINE_MAX_CURSORS (1024)
+#endif
+
+#ifndef ML_GRIDENGINE_MIN_STREAM_BUFFER_SIZE
+# define ML_GRIDENGINE_MIN_STREAM_BUFFER_SIZE (64UL * 1024)
+#endif
+
+#ifndef ML_GRIDENGINE_STREAM_REBALANCE_INTERVAL_MILLIS
+# define ML_GRIDENGINE_STREAM_REBALANCE_INTERVAL_MILLIS (1000)
+#endif
+
+#ifndef ML_GRIDENGINE_SPOOL_SEGMENT_SIZE
+# define ML_GRIDENGINE_SPOOL_SEGMENT_SIZE (64UL * 1024 * 1024)
+#endif
+
+#ifndef ML_GRIDENGINE_INDEX_BUDGET_RATIO
+# define ML_GRIDENGINE_INDEX_BUDGET_RATIO (4)
+#endif
+
+#ifndef ML_GRIDENGINE_MIN_INDEX_BUDGET
+# define ML_GRIDENGINE_MIN_INDEX_BUDGET (1UL * 1024 * 1024)
+#endif
+
+#ifndef ML_GRIDENGINE_RELEASE_CHUNK_SIZE
+# define ML_GRIDENGINE_RELEASE_CHUNK_SIZE (64UL * 1024)
+#endif
+
+#ifndef ML_GRIDENGINE_COALESCE_MAX_BYTES
+# define ML_GRIDENGINE_COALESCE_MAX_BYTES (64UL * 1024)
+#endif
+
+#ifndef ML_GRIDENGINE_COALESCE_WINDOW_MICROS
+# define ML_GRIDENGINE_COALESCE_WINDOW_MICROS (2000)
+#endif
+
+#ifndef ML_GRIDENGINE_SEARCH_BLOCK_SIZE
+# define ML_GRIDENGINE_SEARCH_BLOCK_SIZE (64UL * 1024)
+#endif
+
+#ifndef ML_GRIDENGINE_SEARCH_FILTER_SIZE
+# define ML_GRIDENGINE_SEARCH_FILTER_SIZE (8UL * 1024)
+#endif
+
+#ifndef ML_GRIDENGINE_SEARCH_LOOKUP_SPAN
+# define ML_GRIDENGINE_SEARCH_LOOKUP_SPAN (64UL * 1024 * 1024)
+#endif
+
+#ifndef ML_GRIDENGINE_ARCHIVE_BLOCK_SIZE
+# define ML_GRIDENGINE_ARCHIVE_BLOCK_SIZE (1024UL * 1024)
+#endif
+
+#ifndef ML_GRIDENGINE_ARCHIVE_FLUSH_MILLIS
+# define ML_GRIDENGINE_ARCHIVE_FLUSH_MILLIS (5000)
+#endif
+
+#ifndef ML_GRIDENGINE_RING_WRITER_TIMEOUT_MILLIS
+# define ML_GRIDENGINE_RING_WRITER_TIMEOUT_MILLIS (100)
+#endif
+
+#ifndef ML_GRIDENGINE_SHM_EXPORT_MODE
+# define ML_GRIDENGINE_SHM_EXPORT_MODE (0600)
+#endif
+
 #ifndef ML_GRIDENGINE_CALLBACK_MAX_RETRY
 # define ML_GRIDENGINE_CALLBACK_MAX_RETRY (5)
 #endif
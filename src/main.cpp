@@ -1,4 +1,6 @@
+#include <algorithm>
 #include <memory>
+#include <set>
 #include <iostream>
 #include <signal.h>
 #include <Poco/ErrorHandler.h>
@@ -17,8 +19,14 @@
 #include "BaseApp.h"
 #include "ProgramExecutor.h"
 #include "OutputBuffer.h"
+#include "RingStore.h"
+#include "SpillFileHistory.h"
+#include "CompressedHistory.h"
 #include "WebServerFactory.h"
+#include "CursorRegistry.h"
+#include "OutputStreamRegistry.h"
 #include "IOController.h"
+#include "OutputFileWriter.h"
 #include "AutoFreePtr.h"
 #include "GeneratedFilesWatcher.h"
 #include "PersistAndCallbackManager.h"
@@ -82,6 +90,47 @@ protected:
       return Application::EXIT_SOFTWARE;
     }
 
+    // The evicted output can either be spilled to the disk, or compressed in memory
+    if (_compressedHistory && !_spoolDir.empty()) {
+      Logger::getLogger().error("--compressed-history cannot be used with --spool-dir.");
+      return Application::EXIT_USAGE;
+    }
+    if (_spoolMaxSize > 0 && _spoolDir.empty()) {
+      Logger::getLogger().error("--spool-max-size requires --spool-dir.");
+      return Application::EXIT_USAGE;
+    }
+
+    // The output ring can be backed by either a file, or the shared memory
+    if (!_ringFile.empty() && !_shmExport.empty()) {
+      Logger::getLogger().error("--shm-export cannot be used with --ring-file.");
+      return Application::EXIT_USAGE;
+    }
+
+    // The lossless mode needs the output file or archive as its durable consumer
+    if (_lossless && _outputFile.empty() && _outputArchive.empty()) {
+      Logger::getLogger().error("--lossless requires --output-file or --output-archive.");
+      return Application::EXIT_USAGE;
+    }
+
+    // The retained head is a part of the buffer size
+    if (_headSize >= _bufferSize) {
+      Logger::getLogger().error("--head-size must be smaller than --buffer-size.");
+      return Application::EXIT_USAGE;
+    }
+
+    // The extra streams are named apart from the built-in ones, and captured from their own fds
+    std::set<std::string> streamNames = {"main", "merged", "stdout", "stderr", "run-after"};
+    for (auto const& it: _extraStreams) {
+      if (!streamNames.insert(it.first).second) {
+        Logger::getLogger().error("--extra-stream name is reserved or duplicated: %s", it.first);
+        return Application::EXIT_USAGE;
+      }
+      if (it.second <= 2) {
+        Logger::getLogger().error("--extra-stream must not capture stdin, stdout or stderr: %d", it.second);
+        return Application::EXIT_USAGE;
+      }
+    }
+
     // Get the server hostname
     std::string hostName = Poco::Net::DNS::hostName();
 
@@ -93,6 +142,27 @@ protected:
     logger.info("Wait termination: %s", std::string(_noExit ? "yes" : "no"));
     logger.info("Watch generated files: %s", std::string(_watchGenerated ? "yes" : "no"));
     logger.info("Memory buffer size: %z (%s)", _bufferSize, Utils::formatSize(_bufferSize));
+    if (_headSize > 0) {
+      logger.info("Retained head size: %z (%s)", _headSize, Utils::formatSize(_headSize));
+    }
+    if (_stderrBufferSize > 0) {
+      logger.info("Stderr buffer size: %z (%s)", _stderrBufferSize, Utils::formatSize(_stderrBufferSize));
+    }
+    logger.info("Optimistic read: %s", std::string(_optimisticRead ? "yes" : "no"));
+    logger.info("Mirrored buffer: %s", std::string(_mirroredBuffer ? "yes" : "no"));
+    logger.info("Compressed history: %s", std::string(_compressedHistory ? "yes" : "no"));
+    logger.info("Compact progress bars: %s", std::string(_compactProgress ? "yes" : "no"));
+    logger.info("Strip ANSI: %s, repair UTF-8: %s", std::string(_filterOptions.stripAnsi ? "yes" : "no"),
+                std::string(_filterOptions.repairUtf8 ? "yes" : "no"));
+    logger.info("Redact secrets: %s, %z extra keys", std::string(_filterOptions.redactSecrets ? "yes" : "no"),
+                _filterOptions.redactPatterns.size());
+    logger.info("Coalesce window: %?d us, at most %s", _coalesceWindow, Utils::formatSize(_coalesceBytes));
+    logger.info("Deduplicate lines: %s", std::string(_dedupLines ? "yes" : "no"));
+    logger.info("Index severity: %s", std::string(_indexSeverity ? "yes" : "no"));
+    if (_searchIndexSize > 0) {
+      logger.info("Search index: at most %s", Utils::formatSize(_searchIndexSize));
+    }
+    logger.info("Lossless: %s", std::string(_lossless ? "yes" : "no"));
     logger.info("Working dir: %s", _workDir);
     if (!_callbackAPI.empty()) {
       logger.info("Callback API: %s", _callbackAPI);
@@ -100,15 +170,37 @@ protected:
     if (!_callbackToken.empty()) {
       logger.info("Callback Token: %s", _callbackToken);
     }
+    if (!_spoolDir.empty()) {
+      logger.info("Spool dir: %s", _spoolDir);
+      if (_spoolMaxSize > 0) {
+        logger.info("Spool max size: %z (%s)", _spoolMaxSize, Utils::formatSize(_spoolMaxSize));
+      }
+    }
+    if (!_ringFile.empty()) {
+      logger.info("Ring file: %s", _ringFile);
+    }
+    if (!_shmExport.empty()) {
+      logger.info("Shared memory export: /%s (mode %04o)", _shmExport, _shmExportMode);
+    }
     if (!_outputFile.empty()) {
       logger.info("Output file: %s", _outputFile);
     }
+    if (!_outputArchive.empty()) {
+      logger.info("Output archive: %s", _outputArchive);
+    }
     if (!_statusFile.empty()) {
       logger.info("Status file: %s", _statusFile);
     }
     if (!_runAfter.empty()) {
       logger.info("Run-after command: %s", _runAfter);
     }
+    if (!_extraStreams.empty()) {
+      std::vector<std::string> streamList;
+      for (auto const& it: _extraStreams) {
+        streamList.push_back(Poco::format("%s=%d", it.first, it.second));
+      }
+      logger.info("Extra streams: %s", Poco::cat(std::string(", "), streamList.begin(), streamList.end()));
+    }
     logger.info("Program arguments:\n  %s",
         Poco::cat(std::string("\n  "), _args.begin(), _args.end()));
     if (!_environ.empty()) {
@@ -128,15 +220,110 @@ protected:
     if (!_outputFile.empty()) {
       Utils::makeParents(_outputFile);
     }
+    if (!_outputArchive.empty()) {
+      Utils::makeParents(_outputArchive);
+    }
     if (!_statusFile.empty()) {
       Utils::makeParents(_statusFile);
     }
 
     // Initialize all related objects.
     PersistAndCallbackManager persistAndCallback(_statusFile, _callbackAPI, _callbackToken);
-    ProgramExecutor executor(_args, _environ, _workDir);
-    OutputBuffer outputBuffer(_bufferSize);
-    IOController ioController(&executor, &outputBuffer);
+    ProgramExecutor executor(_args, _environ, _workDir, true, "Program", _stderrBufferSize > 0);
+    // the retained head takes its share of the budget first, and the rest goes to the tail
+    size_t tailBudget = _bufferSize - _headSize;
+    size_t ringSize = tailBudget;
+    OutputHistory *history = nullptr;
+    CompressedHistory *compressedHistory = nullptr;
+    if (!_spoolDir.empty()) {
+      history = new SpillFileHistory(_spoolDir, ML_GRIDENGINE_SPOOL_SEGMENT_SIZE, _spoolMaxSize);
+    } else if (_compressedHistory) {
+      // the ring only keeps a small hot window, and the rest of the budget goes to the history
+      ringSize = std::max(tailBudget / 4, (size_t)(64 * 1024));
+      history = compressedHistory = new CompressedHistory(tailBudget - std::min(ringSize, tailBudget));
+    }
+    OutputBufferReadMode readMode = _optimisticRead ? OPTIMISTIC_READ : LOCKED_READ;
+    OutputBufferStoreType storeType = _mirroredBuffer ? MIRRORED_STORE : RESERVED_STORE;
+    // All the streams share the budget of the ring and the stderr buffer.  Each buffer reserves
+    // the virtual memory of the whole budget, and the arbiter limits how much it retains.
+    size_t streamBudget = ringSize + _stderrBufferSize;
+    std::unique_ptr<OutputBuffer> outputBuffer;
+    if (!_ringFile.empty() || !_shmExport.empty()) {
+      FileRingStore *ringStore = !_ringFile.empty() ?
+          FileRingStore::create(_ringFile, ringSize) :
+          FileRingStore::createShared(_shmExport, ringSize, _shmExportMode);
+      if (!ringStore) {
+        delete history;
+        Logger::getLogger().error("Cannot create the ring file: %s", !_ringFile.empty() ? _ringFile : "/" + _shmExport);
+        return Application::EXIT_CANTCREAT;
+      }
+      Logger::getLogger().info("Ring file generation: %?d", ringStore->generation());
+      outputBuffer.reset(new OutputBuffer(ringStore, readMode, history));
+    } else {
+      outputBuffer.reset(new OutputBuffer(streamBudget, 64 * 1024, readMode, storeType, history));
+    }
+    std::unique_ptr<OutputBuffer> errorBuffer;
+    if (_stderrBufferSize > 0) {
+      // the stderr keeps its own reservation, so that it is never evicted by the stdout
+      errorBuffer.reset(new OutputBuffer(streamBudget, 64 * 1024, readMode, storeType));
+    }
+    std::vector<std::unique_ptr<OutputBuffer>> extraBuffers;
+    std::vector<OutputBuffer*> extraBufferList;
+    std::vector<int> extraFds;
+    for (auto const& it: _extraStreams) {
+      extraBuffers.emplace_back(new OutputBuffer(streamBudget, 64 * 1024, readMode, storeType));
+      extraBufferList.push_back(extraBuffers.back().get());
+      extraFds.push_back(it.second);
+    }
+    std::unique_ptr<OutputBuffer> runAfterBuffer;
+    OutputStreamRegistry streams(streamBudget, ML_GRIDENGINE_MIN_STREAM_BUFFER_SIZE);
+    streams.add("main", outputBuffer.get(), 1, ringSize);
+    if (errorBuffer) {
+      streams.add("stderr", errorBuffer.get(), 2, _stderrBufferSize);
+    }
+    for (size_t i=0; i<extraBuffers.size(); ++i) {
+      streams.add(_extraStreams[i].first, extraBuffers[i].get());
+    }
+    if (_headSize > 0) {
+      outputBuffer->setHeadRetention(_headSize);
+    }
+    if (_dedupLines) {
+      outputBuffer->setDeduplicateLines(true);
+      if (errorBuffer) {
+        errorBuffer->setDeduplicateLines(true);
+      }
+    }
+    if (_indexSeverity) {
+      outputBuffer->setSeverityIndexing(true);
+      if (errorBuffer) {
+        errorBuffer->setSeverityIndexing(true);
+      }
+    }
+    if (_searchIndexSize > 0) {
+      // only the main output can be searched
+      outputBuffer->setSearchIndexing(_searchIndexSize);
+    }
+    std::unique_ptr<OutputFileWriter> outputFileWriter, outputArchiveWriter;
+    if (_lossless) {
+      // the output file is written as the output arrives, and the writer waits for it
+      outputBuffer->setLossless(true);
+      if (!_outputFile.empty()) {
+        outputFileWriter.reset(new OutputFileWriter(outputBuffer.get(), _outputFile));
+        outputFileWriter->start();
+      }
+    }
+    if (!_outputArchive.empty()) {
+      // the archive is always written as the output arrives
+      outputArchiveWriter.reset(new OutputFileWriter(outputBuffer.get(), _outputArchive, 64 * 1024, true));
+      outputArchiveWriter->start();
+    }
+    executor.setExtraOutputs(extraFds);
+    IOController ioController(&executor, outputBuffer.get(), errorBuffer.get(), _compactProgress);
+    ioController.setExtraBuffers(extraBufferList);
+    ioController.setCoalescing(_coalesceBytes, _coalesceWindow);
+    ioController.setFilters(_filterOptions);
+    CursorRegistry cursors(outputBuffer.get(), ML_GRIDENGINE_CURSOR_IDLE_TIMEOUT_SECONDS * 1000L,
+                           ML_GRIDENGINE_MAX_CURSORS);
     SocketAddress serverAddr;
     if (!_serverHost.empty()) {
       serverAddr = SocketAddress(_serverHost, _serverPort);
@@ -144,7 +331,7 @@ protected:
       serverAddr = SocketAddress(_serverPort);
     }
     HTTPServer server(
-        new WebServerFactory(&executor, &outputBuffer),
+        new WebServerFactory(&executor, outputBuffer.get(), errorBuffer.get(), &cursors, &streams),
         ServerSocket(serverAddr),
         new HTTPServerParams());
     server.start();
@@ -165,6 +352,7 @@ protected:
         ExecutorScope mainExecutorScope(&executor);
         executor.start();
         ioController.start();
+        streams.start(ML_GRIDENGINE_STREAM_REBALANCE_INTERVAL_MILLIS);
 
         // Notify the server that we've started the program.
         if (persistAndCallback.enabled()) {
@@ -188,12 +376,76 @@ protected:
 
     // Wait for the IO controller to stop.
     ioController.join();
-    outputBuffer.close();
+    outputBuffer->close();
+    if (errorBuffer) {
+      errorBuffer->close();
+    }
+    for (auto const& buffer: extraBuffers) {
+      buffer->close();
+    }
     Logger::getLogger().info("Total number of bytes output by the program: %z (%s)",
-        outputBuffer.writtenBytes(), Utils::formatSize(outputBuffer.writtenBytes()));
+        outputBuffer->writtenBytes(), Utils::formatSize(outputBuffer->writtenBytes()));
+    if (_compactProgress) {
+      Logger::getLogger().info("Bytes saved by compacting progress bars: %z (%s)",
+          ioController.compactedBytes(), Utils::formatSize(ioController.compactedBytes()));
+    }
+    if (_filterOptions.enabled()) {
+      Logger::getLogger().info("Bytes removed by the ingest filters: %?d", ioController.filteredBytes());
+    }
+    IngestStatistics ingestStats = ioController.ingestStatistics();
+    Logger::getLogger().info("Ingest: %.1f writes/s, %.1f wakeups/s",
+        ingestStats.writesPerSecond(), ingestStats.wakeupsPerSecond());
+    bool outputSaved = false;
+    if (outputFileWriter) {
+      outputFileWriter->join();
+      outputSaved = !outputFileWriter->failed();
+      if (outputSaved) {
+        Logger::getLogger().info("All output saved to: %s", _outputFile);
+      }
+    }
+    if (outputArchiveWriter) {
+      outputArchiveWriter->join();
+      if (!outputArchiveWriter->failed()) {
+        Logger::getLogger().info("Output archived to %s: %s compressed into %s",
+            _outputArchive, Utils::formatSize(outputArchiveWriter->savedBytes()),
+            Utils::formatSize(outputArchiveWriter->fileSize()));
+      }
+    }
+    if (_lossless) {
+      BackpressureStatistics stats = outputBuffer->backpressureStatistics();
+      Logger::getLogger().info("Lossless: %z writes blocked for %.3f s in total, %.3f s at most",
+          stats.blockedWrites, stats.blockedMicros / 1e6, stats.maxBlockedMicros / 1e6);
+    }
+    for (CursorInfo const& cursor: cursors.list()) {
+      Logger::getLogger().info("Cursor %s: %z bytes delivered, %z bytes dropped",
+          cursor.id, cursor.deliveredBytes, cursor.droppedBytes);
+    }
+    if (_indexSeverity) {
+      Logger::getLogger().info("Severity index: %z tracebacks, %z errors, %z warnings",
+          outputBuffer->severityCount(SEVERITY_TRACEBACK), outputBuffer->severityCount(SEVERITY_ERROR),
+          outputBuffer->severityCount(SEVERITY_WARNING));
+      Logger::getLogger().info("Severity index: %z CUDA failures, %z NaN values",
+          outputBuffer->severityCount(SEVERITY_CUDA), outputBuffer->severityCount(SEVERITY_NAN));
+    }
+    if (_searchIndexSize > 0) {
+      SearchIndexStatistics stats = outputBuffer->searchIndexStatistics();
+      Logger::getLogger().info("Search index: %z blocks in %s, %z dropped early",
+          stats.blockCount, Utils::formatSize(stats.memoryBytes), stats.droppedBlocks);
+    }
+    if (_dedupLines) {
+      Logger::getLogger().info("Repeated lines omitted: %z (%s)",
+          outputBuffer->repeatedLines(), Utils::formatSize(outputBuffer->repeatedBytes()));
+    }
+    if (compressedHistory) {
+      CompressedHistory::Statistics stats = compressedHistory->statistics();
+      Logger::getLogger().info("Compressed history: %s compressed to %s (ratio %.2f)",
+          Utils::formatSize(stats.sealedBytes), Utils::formatSize(stats.compressedBytes), stats.compressionRatio());
+      Logger::getLogger().info("Compressed history: %z reads, %z decompressions, %.1f us decompression per read",
+          stats.reads, stats.decompressions, stats.decompressMicrosPerRead());
+    }
 
-    // Save the output if required
-    if (!_outputFile.empty()) {
+    // Save the output if required, unless it has been saved by the lossless mode
+    if (!_outputFile.empty() && !outputFileWriter) {
       try {
         const size_t bufferSize = 8192;
         size_t begin = 0;
@@ -201,32 +453,48 @@ protected:
         AutoFreePtr<char> buffer((char*)malloc(bufferSize));
         Poco::FileStream outStream(_outputFile, std::ios::out | std::ios::trunc);
 
-        if (outputBuffer.writtenBytes() > outputBuffer.size()) {
-          size_t dSize = outputBuffer.writtenBytes() - outputBuffer.size();
-          std::string dSizeFormatted = Utils::formatSize(dSize);
-          if (!dSizeFormatted.empty() && dSizeFormatted.at(dSizeFormatted.size() - 1) != 'B') {
-            outStream << Poco::format("[%z (%s) bytes discarded]", dSize, dSizeFormatted) << std::endl;
-          } else {
-            outStream << Poco::format("[%z bytes discarded]", dSize) << std::endl;
+        size_t headSize = outputBuffer->headSize();
+        size_t retainedBegin = outputBuffer->retainedBegin();
+        bool lineEnded = true;
+        while (!(readResult = outputBuffer->read(begin, buffer.ptr, bufferSize)).isClosed) {
+          // the skipped positions have been discarded, either before the tail, or between the
+          // retained head and the tail
+          if (readResult.begin > begin) {
+            if (!lineEnded) {
+              outStream << std::endl;
+            }
+            outStream << Utils::formatDiscarded(readResult.begin - begin) << std::endl;
           }
-        }
-
-        while (!(readResult = outputBuffer.read(begin, buffer.ptr, bufferSize)).isClosed) {
           outStream.write(buffer.ptr, readResult.count);
+          if (readResult.count > 0) {
+            lineEnded = buffer.ptr[readResult.count - 1] == '\n';
+          }
           begin = readResult.begin + readResult.count;
         }
 
-        if (outputBuffer.writtenBytes() > outputBuffer.size()) {
-          Logger::getLogger().info("The last %s output saved to: %s",
-              Utils::formatSize(outputBuffer.size()), _outputFile);
-        } else {
+        if (retainedBegin <= headSize) {
           Logger::getLogger().info("All output saved to: %s", _outputFile);
+        } else if (headSize > 0) {
+          Logger::getLogger().info("The first %s and the last %s output saved to: %s",
+              Utils::formatSize(headSize), Utils::formatSize(outputBuffer->writtenBytes() - retainedBegin),
+              _outputFile);
+        } else {
+          Logger::getLogger().info("The last %s output saved to: %s",
+              Utils::formatSize(outputBuffer->writtenBytes() - retainedBegin), _outputFile);
         }
+        outputSaved = true;
       } catch (Poco::Exception const& exc) {
         Logger::getLogger().error("Failed to save the output to %s:\n%s", _outputFile, exc.displayText());
       }
     }
 
+    // The buffer has been drained into the output file, and will not be served for long if we
+    // are not waiting for termination, so give its memory back during the remaining steps.  Only
+    // do so with a history, which keeps serving the tail to the pollers which have not caught up.
+    if (outputSaved && !_noExit && history) {
+      outputBuffer->releaseMemory();
+    }
+
     // Compute the size of the working directory
     volatile bool interrupted = false;
     ssize_t workDirSize = -1;
@@ -271,14 +539,24 @@ protected:
           break;
       }
 
-      // run the command
-      ProgramExecutor runAfterExecutor(runAfterArgs, environ, std::string(), false, "Run-after command");
+      // run the command, with its output captured as a named stream
+      ProgramExecutor runAfterExecutor(runAfterArgs, environ, std::string(), true, "Run-after command");
+      runAfterBuffer.reset(new OutputBuffer(streamBudget, 64 * 1024, readMode, storeType));
+      streams.add("run-after", runAfterBuffer.get());
+      IOController runAfterIOController(&runAfterExecutor, runAfterBuffer.get());
       runAfterExecutor.start();
+      runAfterIOController.start();
       if (!runAfterExecutor.wait(ML_GRIDENGINE_RUN_AFTER_TIMEOUT_SECONDS * 1000)) {
         Logger::getLogger().error(
             "Run-after command did not finish in %d seconds.", ML_GRIDENGINE_RUN_AFTER_TIMEOUT_SECONDS);
         runAfterExecutor.kill();
       }
+      runAfterIOController.join();
+      runAfterBuffer->close();
+    }
+    for (OutputStreamInfo const& info: streams.list()) {
+      Logger::getLogger().info("Output stream %s: %z bytes written, %s retained",
+          info.name, info.writtenBytes, Utils::formatSize(info.size));
     }
 
     // wait for the persist and callback manager to finish
@@ -309,6 +587,7 @@ protected:
     }
 
     // Stop the server
+    Logger::getLogger().info("Peak memory usage: %s", Utils::formatSize(Utils::peakMemoryUsage()));
     Logger::getLogger().info("HTTP server shutdown ...");
     server.stop();
 
@@ -0,0 +1,89 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+#include <string>
+#include <Poco/Exception.h>
+#include "src/OutputArchive.h"
+#include "src/Utils.h"
+
+namespace {
+  /** Parse "FIRST:LAST" (LAST excluded, either may be omitted) into {@arg first} and {@arg last}. */
+  bool parseRange(char const *s, size_t *first, size_t *last) {
+    char const *colon = strchr(s, ':');
+    if (!colon) {
+      return false;
+    }
+    char *end;
+    *first = colon == s ? 0 : (size_t)strtoull(s, &end, 10);
+    if (colon != s && end != colon) {
+      return false;
+    }
+    *last = colon[1] == '\0' ? (size_t)-1 : (size_t)strtoull(colon + 1, &end, 10);
+    return (colon[1] == '\0' || *end == '\0') && *first <= *last;
+  }
+}
+
+/**
+ * Read a byte or line range from an output archive written by the executor with "--output-archive",
+ * decompressing only the blocks of the range.
+ *
+ * Usage: ml-gridengine-archive-read ARCHIVE [--bytes FIRST:LAST | --lines FIRST:LAST]
+ *
+ * The positions and lines are counted from zero, and LAST is excluded.  Without a range, the whole
+ * output is written to stdout.  The output discarded before archived is marked like in the
+ * "--output-file", and is not counted by the lines.  The archive may still be written by a live
+ * executor.
+ */
+int main(int argc, char **argv) {
+  bool lines = false;
+  size_t first = 0, last = (size_t)-1;
+  if (argc == 4 && (strcmp(argv[2], "--bytes") == 0 || strcmp(argv[2], "--lines") == 0)) {
+    lines = strcmp(argv[2], "--lines") == 0;
+    if (!parseRange(argv[3], &first, &last)) {
+      fprintf(stderr, "Invalid range: %s\n", argv[3]);
+      return 1;
+    }
+  } else if (argc != 2 || strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0) {
+    fprintf(stderr, "Usage: %s ARCHIVE [--bytes FIRST:LAST | --lines FIRST:LAST]\n", argv[0]);
+    return 1;
+  }
+
+  try {
+    OutputArchiveReader reader(argv[1]);
+    // the output is written block by block, with a marker for each gap of discarded positions
+    size_t expected = lines ? (size_t)-1 : first;
+    bool lineEnded = true;
+    auto consumer = [&expected, &lineEnded] (size_t position, const Byte *data, size_t count) {
+      if (expected != (size_t)-1 && position > expected) {
+        if (!lineEnded) {
+          std::cout << '\n';
+        }
+        std::cout << Utils::formatDiscarded(position - expected) << '\n';
+      }
+      std::cout.write((const char*)data, count);
+      if (count > 0) {
+        lineEnded = data[count - 1] == '\n';
+      }
+      expected = position + count;
+      return (bool)std::cout;
+    };
+    if (lines) {
+      reader.scanLines(first, last - first, consumer);
+    } else {
+      reader.scan(first, last - first, consumer);
+    }
+    std::cout.flush();
+    size_t archivedBytes = 0;
+    for (ArchiveBlock const& block: reader.blocks()) {
+      archivedBytes += block.rawSize;
+    }
+    fprintf(stderr, "%s, %zu bytes of output archived in %zu blocks, %zu blocks decompressed.\n",
+            reader.complete() ? "Completed" : "Not completed", archivedBytes, reader.blocks().size(),
+            reader.blocksRead());
+  } catch (Poco::Exception const& exc) {
+    fprintf(stderr, "Error: %s\n", exc.displayText().c_str());
+    return 1;
+  }
+  return 0;
+}
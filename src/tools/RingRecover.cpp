@@ -0,0 +1,47 @@
+#include <stdio.h>
+#include <string.h>
+#include <iostream>
+#include <fstream>
+#include <Poco/Exception.h>
+#include "src/RingStore.h"
+
+/**
+ * Recover the last output from a ring file written by the executor with "--ring-file".
+ *
+ * Usage: ml-gridengine-ring-recover RING-FILE [OUTPUT-FILE]
+ *
+ * The recovered output is written to OUTPUT-FILE, or to stdout if not specified.
+ */
+int main(int argc, char **argv) {
+  if (argc < 2 || argc > 3 || strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0) {
+    fprintf(stderr, "Usage: %s RING-FILE [OUTPUT-FILE]\n", argv[0]);
+    return 1;
+  }
+
+  RingFileContents contents;
+  try {
+    contents = FileRingStore::recover(argv[1]);
+  } catch (Poco::Exception const& exc) {
+    fprintf(stderr, "Error: %s\n", exc.what());
+    return 1;
+  }
+  fprintf(stderr, "Generation %llu, %s, recovered %zu bytes of output starting at %zu.\n",
+          (unsigned long long)contents.generation, contents.closed ? "completed" : "not completed",
+          contents.data.size(), contents.begin);
+  if (contents.torn) {
+    fprintf(stderr, "Warning: the executor died while updating the positions, the output may be off by the last write.\n");
+  }
+
+  if (argc == 3) {
+    std::ofstream out(argv[2], std::ios::out | std::ios::binary | std::ios::trunc);
+    out.write((char const*)contents.data.data(), contents.data.size());
+    if (!out) {
+      fprintf(stderr, "Error: cannot write the output file: %s\n", argv[2]);
+      return 1;
+    }
+  } else {
+    std::cout.write((char const*)contents.data.data(), contents.data.size());
+    std::cout.flush();
+  }
+  return 0;
+}
@@ -0,0 +1,94 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "src/client/ml_gridengine_ring.h"
+
+/*
+ * Follow the output of a live executor exported by "--shm-export NAME", until the output completes.
+ *
+ * Usage: ml-gridengine-ring-tail [-f] [-t SECONDS] NAME
+ *
+ * The output retained in the ring is written to stdout.  With "-f", NAME is a ring file written by
+ * "--ring-file" instead.  The output lost while the ring has been overwritten is skipped with a
+ * notice on stderr.  An executor killed before completing the output never closes the ring, so
+ * the tail gives up after no new output for SECONDS (600 by default, 0 to wait forever), or at
+ * once if the executor was killed amid updating the positions.
+ */
+int main(int argc, char **argv) {
+  int isFile = 0, usage = 0;
+  long timeout = 600;
+  char *end;
+  int opt;
+  opterr = 0;
+  while ((opt = getopt(argc, argv, "ft:")) != -1) {
+    switch (opt) {
+      case 'f':
+        isFile = 1;
+        break;
+      case 't':
+        timeout = strtol(optarg, &end, 10);
+        usage = usage || *optarg == '\0' || *end != '\0' || timeout < 0;
+        break;
+      default:
+        usage = 1;
+    }
+  }
+  if (usage || optind != argc - 1) {
+    fprintf(stderr, "Usage: %s [-f] [-t SECONDS] NAME\n", argv[0]);
+    return 1;
+  }
+
+  const char *name = argv[optind];
+  mlge_ring ring;
+  if ((isFile ? mlge_ring_open_file(&ring, name) : mlge_ring_open(&ring, name)) != 0) {
+    fprintf(stderr, "Error: cannot open the ring %s: %s\n", name, strerror(errno));
+    return 1;
+  }
+
+  static char buffer[64 * 1024];
+  mlge_ring_positions positions;
+  int ret = 0;
+  mlge_ring_get_positions(&ring, &positions);
+  uint64_t position = positions.begin;
+  long idleMillis = 0;
+  for (;;) {
+    uint64_t begin;
+    ssize_t count = mlge_ring_read(&ring, position, buffer, sizeof(buffer), &begin);
+    if (count < 0) {
+      fprintf(stderr, "Error: the executor was killed while updating the ring.\n");
+      ret = 1;
+      break;
+    }
+    // the bytes before `begin` are gone, e.g., overwritten or released, even if nothing is read
+    if (begin > position) {
+      fprintf(stderr, "[%llu bytes lost]\n", (unsigned long long)(begin - position));
+      position = begin;
+    }
+    if (count > 0) {
+      if (fwrite(buffer, 1, (size_t)count, stdout) != (size_t)count) {
+        break;
+      }
+      position += (uint64_t)count;
+      idleMillis = 0;
+      continue;
+    }
+    fflush(stdout);
+    // the positions are taken after the read, so that no output written before closing is missed
+    mlge_ring_get_positions(&ring, &positions);
+    if (positions.closed && position >= positions.end) {
+      break;
+    }
+    if (timeout > 0 && idleMillis >= timeout * 1000) {
+      fprintf(stderr, "Error: no output for %ld seconds, the executor may have died.\n", timeout);
+      ret = 1;
+      break;
+    }
+    usleep(10000);
+    idleMillis += 10;
+  }
+  fflush(stdout);
+  mlge_ring_close(&ring);
+  return ret;
+}
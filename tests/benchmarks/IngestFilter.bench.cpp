@@ -0,0 +1,80 @@
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <Poco/Clock.h>
+#include <catch2/catch.hpp>
+#include "src/IngestFilter.h"
+
+namespace {
+  /** About {@arg size} bytes of training log lines, every {@arg secretEvery}-th of them holding a token. */
+  std::string makeLog(size_t size, bool coloured, bool unicode, int secretEvery) {
+    std::string ret;
+    char line[256];
+    for (int i=0; ret.size() < size; ++i) {
+      snprintf(line, sizeof(line), "2018-12-24 10:%02d:%02d %s epoch %d step %d loss=%.4f lr=0.001 %s\n",
+               i / 60 % 60, i % 60, coloured ? "\x1b[32mINFO\x1b[0m" : "INFO", i / 1000, i,
+               1.0 / (i + 1), unicode ? "训练速度 1234.5 样本/秒" : "throughput 1234.5 samples/s");
+      ret += line;
+      if (secretEvery > 0 && i % secretEvery == 0) {
+        ret += "Downloading with token=ghp_0123456789abcdef from the cache\n";
+      }
+    }
+    return ret;
+  }
+
+  /** Pass {@arg input} through the chain of {@arg options} {@arg rounds} times in 64K chunks, in MB/s. */
+  double runChain(IngestFilterOptions const& options, std::string const& input, int rounds, size_t *outputBytes) {
+    static const size_t CHUNK_SIZE = 64 * 1024;   // the capacity of a pipe
+    size_t received = 0;
+    IngestFilterChain chain([&received] (const Byte *data, size_t count) {
+      received += count;
+    }, options);
+    Poco::Clock start;
+    for (int r=0; r<rounds; ++r) {
+      for (size_t i=0; i<input.size(); i+=CHUNK_SIZE) {
+        chain.write((const Byte*)input.data() + i, std::min(CHUNK_SIZE, input.size() - i));
+      }
+    }
+    chain.finish();
+    double seconds = start.elapsed() / 1e6;
+    *outputBytes = received;
+    return input.size() * (double)rounds / seconds / (1024 * 1024);
+  }
+}
+
+TEST_CASE("Ingest filter throughput", "[IngestFilter][benchmark]") {
+  static const size_t INPUT_SIZE = 16 * 1024 * 1024;
+  static const int ROUNDS = 16;
+  struct Input {
+    const char *name;
+    std::string data;
+  } inputs[] = {
+    {"plain", makeLog(INPUT_SIZE, false, false, 0)},
+    {"secrets", makeLog(INPUT_SIZE, false, false, 100)},
+    {"coloured", makeLog(INPUT_SIZE, true, false, 0)},
+    {"unicode", makeLog(INPUT_SIZE, false, true, 0)},
+  };
+  struct Chain {
+    const char *name;
+    IngestFilterOptions options;
+  } chains[4];
+  chains[0].name = "strip-ansi";
+  chains[0].options.stripAnsi = true;
+  chains[1].name = "repair-utf8";
+  chains[1].options.repairUtf8 = true;
+  chains[2].name = "redact-secrets";
+  chains[2].options.redactSecrets = true;
+  chains[3].name = "all";
+  chains[3].options.stripAnsi = chains[3].options.repairUtf8 = chains[3].options.redactSecrets = true;
+
+  // the program can write at most as fast as a pipe, i.e., about 1 GB/s
+  std::printf("%-10s %-16s %12s %14s %12s\n", "input", "chain", "MB/s", "output bytes", "1 GB/s pipe");
+  for (Input const& input: inputs) {
+    for (Chain const& chain: chains) {
+      size_t outputBytes;
+      double throughput = runChain(chain.options, input.data, ROUNDS, &outputBytes);
+      std::printf("%-10s %-16s %12.1f %14zu %12s\n", input.name, chain.name, throughput, outputBytes,
+                  throughput >= 1024 ? "keeps up" : "behind");
+    }
+  }
+}
@@ -0,0 +1,138 @@
+#include <atomic>
+#include <cstdio>
+#include <vector>
+#include <Poco/Clock.h>
+#include <Poco/Thread.h>
+#include <catch2/catch.hpp>
+#include "src/OutputBuffer.h"
+
+namespace {
+  struct ContentionResult {
+    double writeSeconds;
+    size_t reads;
+  };
+
+  /**
+   * Let one writer push {@arg totalBytes} bytes in 8K chunks (like the IO controller),
+   * while {@arg nReaders} threads keep polling the tail of the buffer.
+   */
+  ContentionResult runContention(OutputBufferReadMode readMode, int nReaders, size_t totalBytes) {
+    static const size_t CHUNK_SIZE = 8192;
+    static const size_t READ_SIZE = 65536;
+
+    OutputBuffer buffer(4 * 1024 * 1024, 64 * 1024, readMode);
+    std::atomic<bool> stopped(false);
+    std::atomic<size_t> reads(0);
+    std::vector<Poco::Thread*> readers;
+
+    for (int i=0; i<nReaders; ++i) {
+      readers.push_back(new Poco::Thread());
+      readers.back()->startFunc([&] () {
+        std::vector<Byte> target(READ_SIZE);
+        while (!stopped) {
+          buffer.tryRead(-(ssize_t)READ_SIZE, target.data(), target.size());
+          ++reads;
+        }
+      });
+    }
+
+    std::vector<Byte> chunk(CHUNK_SIZE, 'x');
+    Poco::Clock start;
+    for (size_t written=0; written<totalBytes; written+=chunk.size()) {
+      buffer.write(chunk.data(), chunk.size());
+    }
+    ContentionResult result;
+    result.writeSeconds = start.elapsed() / 1e6;
+    stopped = true;
+
+    for (auto *th: readers) {
+      th->join();
+      delete th;
+    }
+    result.reads = reads;
+    return result;
+  }
+}
+
+TEST_CASE("Writer throughput with polling readers", "[OutputBuffer][benchmark]") {
+  static const size_t TOTAL_BYTES = 256 * 1024 * 1024;
+  int readerCounts[] = {0, 1, 8, 32, 64};
+
+  std::printf("%-8s %-18s %14s %14s\n", "readers", "mode", "write MB/s", "reads/s");
+  for (int nReaders: readerCounts) {
+    for (auto readMode: {LOCKED_READ, OPTIMISTIC_READ}) {
+      ContentionResult r = runContention(readMode, nReaders, TOTAL_BYTES);
+      std::printf("%-8d %-18s %14.1f %14.0f\n",
+                  nReaders,
+                  readMode == LOCKED_READ ? "LOCKED_READ" : "OPTIMISTIC_READ",
+                  TOTAL_BYTES / r.writeSeconds / (1024 * 1024),
+                  r.reads / r.writeSeconds);
+    }
+  }
+}
+
+namespace {
+  struct WakeupResult {
+    double writeMicros;
+    size_t wokenReads;
+  };
+
+  /**
+   * Let {@arg nReaders} threads block on the tail of the buffer, and measure how long it takes
+   * the writer to push each chunk while all of them are waiting.
+   */
+  WakeupResult runWakeup(int nReaders, int rounds) {
+    static const size_t CHUNK_SIZE = 8192;
+
+    OutputBuffer buffer(4 * 1024 * 1024);
+    std::atomic<size_t> wokenReads(0);
+    std::vector<Poco::Thread*> readers;
+    for (int i=0; i<nReaders; ++i) {
+      readers.push_back(new Poco::Thread());
+      readers.back()->startFunc([&] () {
+        std::vector<Byte> target(CHUNK_SIZE);
+        size_t begin = 0;
+        for (;;) {
+          ReadResult result = buffer.read(begin, target.data(), target.size());
+          if (result.isClosed)
+            break;
+          begin = result.begin + result.count;
+          ++wokenReads;
+        }
+      });
+    }
+
+    std::vector<Byte> chunk(CHUNK_SIZE, 'x');
+    double totalMicros = 0;
+    for (int i=0; i<rounds; ++i) {
+      // wait until every reader has consumed the previous chunk and blocked again
+      while (buffer.waitingReaders() < (size_t)nReaders || wokenReads < (size_t)nReaders * i) {
+        Poco::Thread::yield();
+      }
+      Poco::Clock start;
+      buffer.write(chunk.data(), chunk.size());
+      totalMicros += start.elapsed();
+    }
+    buffer.close();
+
+    for (auto *th: readers) {
+      th->join();
+      delete th;
+    }
+    WakeupResult result;
+    result.writeMicros = totalMicros / rounds;
+    result.wokenReads = wokenReads;
+    return result;
+  }
+}
+
+TEST_CASE("Write latency with blocked readers", "[OutputBuffer][benchmark]") {
+  static const int ROUNDS = 200;
+  int readerCounts[] = {1, 100, 1000};
+
+  std::printf("%-8s %18s %14s\n", "readers", "write latency (us)", "woken reads");
+  for (int nReaders: readerCounts) {
+    WakeupResult r = runWakeup(nReaders, ROUNDS);
+    std::printf("%-8d %18.1f %14zu\n", nReaders, r.writeMicros, r.wokenReads);
+  }
+}
@@ -0,0 +1,95 @@
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <string>
+#include <Poco/Clock.h>
+#include <catch2/catch.hpp>
+#include "src/OutputSearcher.h"
+
+namespace {
+  /**
+   * Append about {@arg size} bytes of training log lines to {@arg buffers}.  Each line has a random
+   * request id, and the rare lines (a CUDA failure and a traceback) are planted at a few places.
+   *
+   * @return Number of seconds spent writing into each of the buffers.
+   */
+  std::vector<double> writeLogs(std::vector<OutputBuffer*> const& buffers, size_t size) {
+    static const size_t CHUNK_SIZE = 64 * 1024;
+    std::mt19937 rng(1234);
+    std::vector<double> seconds(buffers.size());
+    std::string chunk;
+    char line[256];
+    size_t written = 0;
+    for (size_t i=0; written < size; ++i) {
+      snprintf(line, sizeof(line), "2018-12-24 10:%02d:%02d INFO [worker-%d] epoch %d step %zu loss=%.4f "
+               "req=%08x throughput %.1f samples/s\n", (int)(i / 60 % 60), (int)(i % 60), (int)(i % 8),
+               (int)(i / 100000), i, 1.0 / (i + 1), (unsigned)rng(), 1000.0 + i % 1000);
+      chunk += line;
+      if (i == 4000000) {
+        chunk += "RuntimeError: CUDA out of memory. Tried to allocate 2.00 GiB\n";
+      }
+      if (i % 3000000 == 1234567) {
+        chunk += "Traceback (most recent call last):\n  File \"train.py\", line 42, in <module>\n";
+      }
+      if (chunk.size() >= CHUNK_SIZE) {
+        for (size_t k=0; k<buffers.size(); ++k) {
+          Poco::Clock start;
+          buffers[k]->write(chunk.data(), chunk.size());
+          seconds[k] += start.elapsed() / 1e6;
+        }
+        written += chunk.size();
+        chunk.clear();
+      }
+    }
+    return seconds;
+  }
+
+  /** Search {@arg buffer} for the literal or the pattern, returning the latency in milliseconds. */
+  double searchMillis(OutputBuffer *buffer, std::string const& literal, std::string const& pattern,
+                      size_t *matches, size_t *scannedBytes) {
+    OutputSearcher searcher(buffer, literal, pattern);
+    Poco::Clock start;
+    *matches = searcher.search([] (SearchMatch const&) { return true; }, 1000);
+    double millis = start.elapsed() / 1e3;
+    *scannedBytes = searcher.scannedBytes();
+    return millis;
+  }
+}
+
+TEST_CASE("Search latency with the search index", "[SearchIndex][benchmark]") {
+  static const size_t OUTPUT_SIZE = 1024UL * 1024 * 1024;
+  static const size_t INDEX_SIZE = 132UL * 1024 * 1024;
+
+  // the same output is written into an indexed buffer and a plain one
+  std::unique_ptr<OutputBuffer> indexed(new OutputBuffer(OUTPUT_SIZE + 1024 * 1024, 64 * 1024, LOCKED_READ, RESERVED_STORE));
+  std::unique_ptr<OutputBuffer> plain(new OutputBuffer(OUTPUT_SIZE + 1024 * 1024, 64 * 1024, LOCKED_READ, RESERVED_STORE));
+  indexed->setSearchIndexing(INDEX_SIZE);
+  std::vector<double> writeSeconds = writeLogs({indexed.get(), plain.get()}, OUTPUT_SIZE);
+  SearchIndexStatistics stats = indexed->searchIndexStatistics();
+  std::printf("output: %.1f MB, index: %zu blocks in %.1f MB, %zu dropped\n",
+              OUTPUT_SIZE / 1048576.0, stats.blockCount, stats.memoryBytes / 1048576.0, stats.droppedBlocks);
+  std::printf("write MB/s: %.1f indexed, %.1f plain\n\n",
+              OUTPUT_SIZE / 1048576.0 / writeSeconds[0], OUTPUT_SIZE / 1048576.0 / writeSeconds[1]);
+
+  struct Query {
+    const char *literal;
+    const char *pattern;
+  } queries[] = {
+    {"CUDA out of memory", ""},     // a single line
+    {"job-7f3a9c21", ""},           // never appears
+    {"req=7f3a9c21", ""},           // never appears, but most of its trigrams do
+    {"", "^Traceback \\(most recent call last\\):$"},
+    {"epoch 42 ", ""},              // a run of 100000 lines
+    {"INFO", ""},                   // every line, only the first 1000 matches are taken
+  };
+  std::printf("%-40s %8s %13s %12s %12s %8s\n", "query", "matches", "candidate MB", "indexed ms", "plain ms",
+              "speedup");
+  for (Query const& query: queries) {
+    size_t matches, plainMatches, scannedBytes, plainScannedBytes;
+    double millis = searchMillis(indexed.get(), query.literal, query.pattern, &matches, &scannedBytes);
+    double plainMillis = searchMillis(plain.get(), query.literal, query.pattern, &plainMatches, &plainScannedBytes);
+    REQUIRE(matches == plainMatches);
+    std::printf("%-40s %8zu %13.1f %12.2f %12.2f %7.1fx\n", *query.literal ? query.literal : query.pattern,
+                matches, scannedBytes / 1048576.0, millis, plainMillis, plainMillis / millis);
+  }
+}
@@ -16,3 +16,27 @@ class LargeOutputsTestCase(TestCase):
             run_executor([get_count_exe(), str(N)], buffer_size=save_length)[0],
             expected_output
         )
+
+    def test_save_all_outputs_losslessly(self):
+        N = 1000000
+        total_output = get_count_output(N)
+        program_output, executor_output = run_executor([get_count_exe(), str(N)], buffer_size=65536, lossless=True)
+        self.assertEqual(program_output, total_output)
+        self.assertIn(b'writes blocked', executor_output)
+
+    def test_save_head_and_tail_outputs(self):
+        N = 1000000
+        head_length = 100000
+        tail_length = 1048576 - head_length
+        total_output = get_count_output(N)
+        discarded_length = len(total_output) - head_length - tail_length
+        head = total_output[:head_length]
+        if not head.endswith(b'\n'):
+            head += b'\n'
+        expected_output = head + '[{} ({:.2f}M) bytes discarded]\n'.format(
+            discarded_length, discarded_length / 1048576.).encode('utf-8') + total_output[-tail_length:]
+
+        self.assertEqual(
+            run_executor([get_count_exe(), str(N)], buffer_size=1048576, head_size=head_length)[0],
+            expected_output
+        )
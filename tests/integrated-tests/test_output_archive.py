@@ -0,0 +1,36 @@
+import subprocess
+
+from utils import *
+
+
+def read_archive(archive, *args):
+    proc = subprocess.Popen(['./ml-gridengine-archive-read', archive] + list(args),
+                            stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    output, info = proc.communicate()
+    return proc.returncode, output, info
+
+
+class OutputArchiveTestCase(TestCase):
+
+    def test_read_ranges_of_archive(self):
+        expected = b''.join('{}\n'.format(i).encode('utf-8') for i in range(300000))
+        args = ['python', '-c', 'for i in range(300000): print(i)']
+        with TemporaryDirectory() as tmpdir:
+            archive = os.path.join(tmpdir, 'output.archive')
+            program_output, executor_output = run_executor(args, output_archive=archive, lossless=True,
+                                                           buffer_size=64 * 1024)
+            self.assertEqual(program_output, expected)
+            self.assertLess(os.path.getsize(archive), len(expected))
+
+            code, output, info = read_archive(archive)
+            self.assertEqual(code, 0)
+            self.assertEqual(output, expected)
+            self.assertIn(b'Completed', info)
+
+            # only the blocks of the range are decompressed
+            code, output, info = read_archive(archive, '--lines', '123456:123459')
+            self.assertEqual(output, b'123456\n123457\n123458\n')
+            self.assertIn(b'1 blocks decompressed', info)
+            code, output, info = read_archive(archive, '--bytes', '{}:'.format(len(expected) - 7))
+            self.assertEqual(output, b'299999\n')
+            self.assertEqual(read_archive(archive, '--lines', 'x')[0], 1)
@@ -3,7 +3,7 @@ import requests
 from utils import *
 
 
-def poll_output(server_uri, on_data):
+def poll_output(server_uri, on_data, stream=None, repeats=None):
     def yield_content(response, buffer_size=8192):
         # buffer of the first chunk
         first_chunk_buffer = b''
@@ -24,11 +24,15 @@ def poll_output(server_uri, on_data):
         for chunk in content_iter:
             yield chunk
 
-    poll_uri = server_uri.rstrip('/') + '/output/_poll'
+    poll_uri = server_uri.rstrip('/') + '/output/_poll?'
+    if stream:
+        poll_uri += 'stream={}&'.format(stream)
+    if repeats:
+        poll_uri += 'repeats={}&'.format(repeats)
     begin = 0
     closed = False
     while not closed:
-        r = requests.get('{}?begin={}&timeout=3'.format(poll_uri, begin), stream=True)
+        r = requests.get('{}begin={}&timeout=3'.format(poll_uri, begin), stream=True)
         if r.status_code == 410:
             closed = True
         elif r.status_code == 204:
@@ -82,3 +86,212 @@ class PollingTestCase(TestCase):
             received_count += len(chunk)
         self.assertLessEqual(received_count, len(total_output))
         self.assertGreater(received_count, 0)
+
+    def test_polling_slow_reader(self):
+        # a slow reader tailing a writer which overruns the small ring gets consistent output,
+        # ended cleanly where it has been overwritten, instead of a broken connection
+        args = ['python', '-c', 'import sys\n'
+                                'for i in range(3000000):\n'
+                                '  sys.stdout.write("%08d\\n" % i)\n']
+
+        def check(begin, data):
+            first = begin // 9
+            lines = b''.join(b'%08d\n' % i for i in range(first, (begin + len(data)) // 9 + 1))
+            self.assertEqual(data, lines[begin - first * 9: begin - first * 9 + len(data)])
+
+        with run_executor_context(args, no_exit=True, buffer_size=16384) as (proc, ctx):
+            poll_uri = ctx['uri'].rstrip('/') + '/output/_poll?begin={}&timeout=3'
+            begin = 0
+            for _ in range(5):
+                r = requests.get(poll_uri.format(begin), stream=True)
+                if r.status_code != 200:
+                    break
+                content = b''
+                for chunk in r.iter_content(chunk_size=1024):
+                    content += chunk
+                    time.sleep(.01)
+                header, data = content.split(b'\n', 1)
+                r_begin = int(header, 16)
+                self.assertGreaterEqual(r_begin, begin)
+                check(r_begin, data)
+                begin = r_begin + len(data)
+
+    def test_polling_lines(self):
+        args = ['python', '-c', 'for i in range(100):\n'
+                                '  print(i)']
+        with run_executor_context(args, no_exit=True) as (proc, ctx):
+            poll_output(ctx['uri'], lambda begin, data: None)
+            poll_uri = ctx['uri'].rstrip('/') + '/output/_poll'
+
+            def get_lines(query):
+                r = requests.get('{}?{}'.format(poll_uri, query))
+                self.assertEqual(r.status_code, 200)
+                begin, content = r.content.split(b'\n', 1)
+                return int(begin, 16), content
+
+            # lines counted from the beginning
+            self.assertEqual(get_lines('line=10&lines=3'), (20, b'10\n11\n12\n'))
+            # lines counted from the end
+            self.assertEqual(get_lines('line=-2'), (284, b'98\n99\n'))
+            self.assertEqual(get_lines('lines=3'), (281, b'97\n98\n99\n'))
+            # no such lines
+            r = requests.get('{}?line=100&lines=1'.format(poll_uri))
+            self.assertEqual(r.status_code, 204)
+
+    def test_polling_streams(self):
+        # the stdout floods the merged buffer, while the stderr is kept in its own buffer
+        args = ['python', '-u', '-c', 'import sys\n'
+                                      'sys.stderr.write("Traceback: error\\n")\n'
+                                      'for i in range(10000):\n'
+                                      '  print(i)\n'
+                                      '  if i % 1000 == 0:\n'
+                                      '    sys.stderr.write("progress {}\\n".format(i))']
+        stdout = b''.join('{}\n'.format(i).encode('utf-8') for i in range(10000))
+        stderr = b'Traceback: error\n' + b''.join('progress {}\n'.format(i).encode('utf-8')
+                                                  for i in range(0, 10000, 1000))
+        with run_executor_context(args, no_exit=True, buffer_size=8192, stderr_buffer_size=4096) as (proc, ctx):
+            outputs = {}
+            for stream in ('merged', 'stdout', 'stderr'):
+                chunks = []
+                poll_output(ctx['uri'], lambda begin, data: chunks.append((begin, data)), stream=stream)
+                outputs[stream] = chunks
+
+        # the stderr survives the stdout
+        self.assertEqual(outputs['stderr'][0][0], 0)
+        self.assertEqual(b''.join(c[1] for c in outputs['stderr']), stderr)
+
+        # only the latest stdout is retained, at its own positions
+        self.assertGreater(outputs['stdout'][0][0], 0)
+        for begin, data in outputs['stdout']:
+            self.assertEqual(data, stdout[begin: begin + len(data)])
+        self.assertEqual(outputs['stdout'][-1][0] + len(outputs['stdout'][-1][1]), len(stdout))
+
+        # the merged output has both
+        merged = b''.join(c[1] for c in outputs['merged'])
+        self.assertIn(b'progress 9000\n', merged)
+        self.assertTrue(merged.endswith(b'9999\n'))
+
+    def test_polling_named_streams(self):
+        # the extra fd and the run-after command are captured as their own streams
+        args = ['python', '-u', '-c', 'import os\n'
+                                      'print("main")\n'
+                                      'os.write(3, b"metric 1\\nmetric 2\\n")']
+        with run_executor_context(args, no_exit=True, buffer_size=8192, run_after='echo after',
+                                  extra_streams={'metrics': 3}) as (proc, ctx):
+            streams_uri = ctx['uri'].rstrip('/') + '/output/_streams'
+            deadline = time.time() + 10
+            while True:
+                r = requests.get(streams_uri)
+                self.assertEqual(r.status_code, 200)
+                streams = {s['name']: s for s in map(json.loads, r.content.splitlines())}
+                if 'run-after' in streams and streams['run-after']['closed'] or time.time() > deadline:
+                    break
+                time.sleep(.1)
+
+            outputs = {}
+            for stream in ('merged', 'metrics', 'run-after'):
+                chunks = []
+                poll_output(ctx['uri'], lambda begin, data: chunks.append((begin, data)), stream=stream)
+                outputs[stream] = b''.join(c[1] for c in chunks)
+            r = requests.get('{}/output/_poll?stream=unknown'.format(ctx['uri'].rstrip('/')))
+            self.assertEqual(r.status_code, 400)
+
+            # neither stdout nor stderr can be told apart without --stderr-buffer-size
+            for stream in ('stdout', 'stderr'):
+                r = requests.get('{}/output/_poll?stream={}'.format(ctx['uri'].rstrip('/'), stream))
+                self.assertEqual(r.status_code, 400)
+                self.assertIn(b'The stderr is not separated from the output.', r.content)
+
+        self.assertEqual(outputs, {'merged': b'main\n', 'metrics': b'metric 1\nmetric 2\n', 'run-after': b'after\n'})
+
+        # all the streams share the budget of the buffer size
+        self.assertEqual(list(streams), ['main', 'metrics', 'run-after'])
+        self.assertLessEqual(sum(s['capacityLimit'] for s in streams.values()), 8192)
+        self.assertEqual(streams['metrics']['writtenBytes'], 18)
+
+    def test_polling_times(self):
+        args = ['python', '-u', '-c', 'import time\n'
+                                      'print("first")\n'
+                                      'time.sleep(2)\n'
+                                      'print("second")']
+        with run_executor_context(args, no_exit=True) as (proc, ctx):
+            outputs = []
+            poll_output(ctx['uri'], lambda begin, data: outputs.append((time.time(), begin, data)))
+            self.assertEqual(len(outputs), 2)
+            middle = (outputs[0][0] + outputs[1][0]) / 2.
+            poll_uri = ctx['uri'].rstrip('/') + '/output/_poll'
+
+            def get_output(query):
+                r = requests.get('{}?{}'.format(poll_uri, query))
+                if r.status_code == 204:
+                    return None
+                self.assertEqual(r.status_code, 200)
+                begin, content = r.content.split(b'\n', 1)
+                return int(begin, 16), content
+
+            self.assertEqual(get_output('since={}'.format(middle)), (6, b'second\n'))
+            self.assertEqual(get_output('until={}'.format(middle)), (0, b'first\n'))
+            self.assertEqual(get_output('since={}&until={}'.format(middle - 10, middle + 10)),
+                             (0, b'first\nsecond\n'))
+            self.assertIsNone(get_output('until={}'.format(outputs[0][0] - 10)))
+
+    def test_polling_repeats(self):
+        args = ['python', '-u', '-c', 'print("begin")\n'
+                                      'for i in range(10000):\n'
+                                      '  print("warning: deprecated")\n'
+                                      'print("end")']
+        with run_executor_context(args, no_exit=True, buffer_size=1024, dedup_lines=True) as (proc, ctx):
+            outputs = {}
+            for repeats in ('marker', 'expand'):
+                chunks = []
+                poll_output(ctx['uri'], lambda begin, data: chunks.append((begin, data)),
+                            repeats=repeats)
+                outputs[repeats] = chunks
+
+        # the repeated lines fit in the small buffer, and are presented at consistent positions
+        for repeats, chunks in outputs.items():
+            self.assertEqual(chunks[0][0], 0)
+            for (begin, data), (next_begin, _) in zip(chunks, chunks[1:]):
+                self.assertEqual(begin + len(data), next_begin)
+        self.assertEqual(b''.join(c[1] for c in outputs['marker']),
+                         b'begin\nwarning: deprecated\n[repeated 9999 more times]\nend\n')
+        self.assertEqual(b''.join(c[1] for c in outputs['expand']),
+                         b'begin\n' + b'warning: deprecated\n' * 10000 + b'end\n')
+
+    def test_polling_cursors(self):
+        args = ['python', '-u', '-c', 'for i in range(10000):\n'
+                                      '  print(i)']
+        output = b''.join('{}\n'.format(i).encode('utf-8') for i in range(10000))
+        with run_executor_context(args, no_exit=True, buffer_size=8192) as (proc, ctx):
+            cursors_uri = ctx['uri'].rstrip('/') + '/output/_cursors'
+            poll_uri = ctx['uri'].rstrip('/') + '/output/_poll'
+            r = requests.post(cursors_uri)
+            self.assertEqual(r.status_code, 200)
+            cursor = r.json()
+            self.assertEqual(cursor['position'], 0)
+
+            # the cursor keeps the position, after the bytes evicted before the first poll
+            poll_output(ctx['uri'], lambda begin, data: None)
+            chunks = []
+            while True:
+                r = requests.get('{}?cursor={}&timeout=3'.format(poll_uri, cursor['id']))
+                if r.status_code == 410:
+                    break
+                self.assertEqual(r.status_code, 200)
+                begin, content = r.content.split(b'\n', 1)
+                chunks.append((int(begin, 16), content))
+            first_begin = chunks[0][0]
+            self.assertGreater(first_begin, 0)
+            self.assertEqual(b''.join(c[1] for c in chunks), output[first_begin:])
+
+            # the dropped and delivered bytes are exact
+            r = requests.get('{}?id={}'.format(cursors_uri, cursor['id']))
+            self.assertEqual(r.status_code, 200)
+            cursor = r.json()
+            self.assertEqual(cursor['droppedBytes'], first_begin)
+            self.assertEqual(cursor['deliveredBytes'], len(output) - first_begin)
+            self.assertEqual(cursor['lag'], 0)
+
+            # removed cursors
+            self.assertEqual(requests.delete('{}?id={}'.format(cursors_uri, cursor['id'])).status_code, 200)
+            self.assertEqual(requests.get('{}?cursor={}'.format(poll_uri, cursor['id'])).status_code, 404)
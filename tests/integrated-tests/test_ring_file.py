@@ -0,0 +1,40 @@
+import subprocess
+
+from utils import *
+
+
+def recover_ring_file(ring_file):
+    proc = subprocess.Popen(['./ml-gridengine-ring-recover', ring_file],
+                            stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    output, info = proc.communicate()
+    return proc.returncode, output, info
+
+
+class RingFileTestCase(TestCase):
+
+    def test_recover_after_executor_killed(self):
+        expected = b''.join('{}\n'.format(i).encode('utf-8') for i in range(100))
+        args = ['python', '-u', '-c', 'import time\n'
+                                      'for i in range(100):\n'
+                                      '  print(i)\n'
+                                      'time.sleep(10)']
+        with TemporaryDirectory() as tmpdir:
+            ring_file = os.path.join(tmpdir, 'output.ring')
+            with run_executor_context(args, ring_file=ring_file) as (proc, ctx):
+                poll_uri = ctx['uri'].rstrip('/') + '/output/_poll'
+                while True:
+                    r = requests.get('{}?begin={}&timeout=3'.format(poll_uri, len(expected) - 1))
+                    if r.status_code == 200:
+                        break
+            # the executor has been killed, so only the ring file has the output
+            code, output, info = recover_ring_file(ring_file)
+            self.assertEqual(code, 0)
+            self.assertEqual(output, expected)
+            self.assertIn(b'not completed', info)
+
+            # the next executor keeps the unclosed ring file aside
+            program_output, executor_output = run_executor(['echo', 'hello'], ring_file=ring_file)
+            self.assertEqual(program_output, b'hello\n')
+            self.assertEqual(recover_ring_file(ring_file + '.1')[1], expected)
+            code, output, info = recover_ring_file(ring_file)
+            self.assertIn(b'Generation 2, completed', info)
@@ -0,0 +1,69 @@
+import json
+
+import requests
+
+from utils import *
+
+
+class SearchTestCase(TestCase):
+
+    def test_search(self):
+        args = ['python', '-c', 'for i in range(100):\n'
+                                '  print("step {}, loss = {}".format(i, "nan" if i % 30 == 7 else 0.5))']
+        with run_executor_context(args, no_exit=True) as (proc, ctx):
+            time.sleep(.5)
+            search_uri = ctx['uri'].rstrip('/') + '/output/_search'
+
+            def search(**params):
+                r = requests.get(search_uri, params=params)
+                self.assertEqual(r.status_code, 200)
+                return [json.loads(line) for line in r.content.split(b'\n') if line]
+
+            matches = search(q='nan')
+            self.assertEqual([m['line'] for m in matches], [7, 37, 67, 97])
+            self.assertEqual(matches[0]['text'], 'step 7, loss = nan')
+            self.assertEqual(matches[0]['offset'], len(''.join(
+                'step {}, loss = 0.5\n'.format(i) for i in range(7))) + len('step 7, loss = '))
+
+            matches = search(regex='^step [0-9]7, loss = nan', limit=1)
+            self.assertEqual([m['line'] for m in matches], [37])
+
+            # bad requests
+            self.assertEqual(requests.get(search_uri).status_code, 400)
+            self.assertEqual(requests.get(search_uri, params={'regex': '('}).status_code, 400)
+
+    def test_errors(self):
+        args = ['python', '-u', '-c', 'print("WARNING: slow start")\n'
+                                      'for i in range(10000):\n'
+                                      '  print("step {}, loss = {}".format(i, "nan" if i == 5000 else 0.5))\n'
+                                      'raise ValueError("diverged")']
+        with run_executor_context(args, no_exit=True, buffer_size=8192, index_severity=True) as (proc, ctx):
+            time.sleep(.5)
+            errors_uri = ctx['uri'].rstrip('/') + '/output/_errors'
+
+            def errors(**params):
+                r = requests.get(errors_uri, params=params)
+                self.assertEqual(r.status_code, 200)
+                return [json.loads(line) for line in r.content.split(b'\n') if line]
+
+            # the entries are kept even if the output has been evicted
+            entries = errors()
+            self.assertEqual([e['severity'] for e in entries], ['warning', 'nan', 'traceback'])
+            self.assertEqual(entries[0]['line'], 0)
+            self.assertFalse(entries[0]['retained'])
+            self.assertEqual(entries[1]['text'], 'step 5000, loss = nan')
+            self.assertEqual(entries[2]['text'], 'ValueError: diverged')
+            self.assertTrue(entries[2]['retained'])
+
+            # the traceback can be polled from its position
+            poll_uri = ctx['uri'].rstrip('/') + '/output/_poll'
+            r = requests.get(poll_uri, params={'begin': entries[2]['begin'],
+                                               'count': entries[2]['end'] - entries[2]['begin']})
+            begin, content = r.content.split(b'\n', 1)
+            self.assertTrue(content.startswith(b'Traceback (most recent call last):\n'))
+            self.assertTrue(content.endswith(b'ValueError: diverged\n'))
+
+            # filtered by the severity
+            self.assertEqual(len(errors(severity='traceback,nan')), 2)
+            self.assertEqual(len(errors(limit=1)), 1)
+            self.assertEqual(requests.get(errors_uri, params={'severity': 'debug'}).status_code, 400)
@@ -37,7 +37,9 @@ def get_after_log(after_log):
 
 def start_executor(args, output_file=None, status_file=None, port=None, callback=None, token=None, env=None,
                    work_dir=None, run_after=None, no_exit=False, watch_generated=False,
-                   buffer_size=4 * 1024 * 1024, subprocess_kwargs=None):
+                   buffer_size=4 * 1024 * 1024, stderr_buffer_size=None, ring_file=None,
+                   dedup_lines=False, lossless=False, head_size=None, index_severity=False,
+                   extra_streams=None, output_archive=None, subprocess_kwargs=None):
     S = lambda s: s.decode('utf-8') if isinstance(s, bytes) else s
     executor_args = [
         './ml-gridengine-executor',
@@ -65,6 +67,23 @@ def start_executor(args, output_file=None, status_file=None, port=None, callback
         executor_args.append('--no-exit')
     if watch_generated:
         executor_args.append('--watch-generated')
+    if stderr_buffer_size:
+        executor_args.append('--stderr-buffer-size={}'.format(stderr_buffer_size))
+    if ring_file:
+        executor_args.append('--ring-file={}'.format(ring_file))
+    if dedup_lines:
+        executor_args.append('--dedup-lines')
+    if lossless:
+        executor_args.append('--lossless')
+    if head_size:
+        executor_args.append('--head-size={}'.format(head_size))
+    if index_severity:
+        executor_args.append('--index-severity')
+    if extra_streams:
+        for name, fd in extra_streams.items():
+            executor_args.append('--extra-stream={}={}'.format(name, fd))
+    if output_archive:
+        executor_args.append('--output-archive={}'.format(output_archive))
     executor_args.append('--')
     executor_args.extend(args)
     print('Start executor: {}'.format(executor_args))
@@ -0,0 +1,21 @@
+#ifndef ML_GRIDENGINE_EXECUTOR_TESTS_BYTEPATTERN_H
+#define ML_GRIDENGINE_EXECUTOR_TESTS_BYTEPATTERN_H
+
+#include <stddef.h>
+#include <vector>
+
+typedef unsigned char Byte;
+
+/**
+ * The {@arg n} bytes of a test output starting at the position {@arg begin}.  The byte at each
+ * position is fixed, and the period is a prime, such that a misplaced copy is always detected.
+ */
+inline std::vector<Byte> pattern(size_t begin, size_t n) {
+  std::vector<Byte> dst(n);
+  for (size_t i=0; i<n; ++i) {
+    dst[i] = (Byte)((begin + i) % 251);
+  }
+  return dst;
+}
+
+#endif //ML_GRIDENGINE_EXECUTOR_TESTS_BYTEPATTERN_H
@@ -0,0 +1,129 @@
+#include <string.h>
+#include <vector>
+#include <Poco/Format.h>
+#include <Poco/Thread.h>
+#include <catch2/catch.hpp>
+#include "src/CompressedHistory.h"
+#include "src/Compression.h"
+#include "src/OutputBuffer.h"
+#include "macros.h"
+
+namespace {
+  std::vector<Byte> logLines(size_t begin, size_t n) {
+    std::string text;
+    for (size_t i=0; text.size() < begin + n; ++i) {
+      text += Poco::format("epoch %z, step %z, loss = 0.%z\n", i / 100, i % 100, (i * 7919) % 1000);
+    }
+    return std::vector<Byte>(text.begin() + begin, text.begin() + begin + n);
+  }
+}
+
+TEST_CASE("Test compression", "[CompressedHistory]") {
+  std::vector<Byte> raw = logLines(0, 10000);
+  std::string compressed = Compression::compress(raw.data(), raw.size());
+  REQUIRE(compressed.size() < raw.size() / 4);
+
+  std::vector<Byte> restored(raw.size());
+  Compression::decompress(compressed.data(), compressed.size(), restored.data(), restored.size());
+  REQUIRE(restored == raw);
+  REQUIRE_THROWS(Compression::decompress(compressed.data(), compressed.size() / 2, restored.data(), restored.size()));
+}
+
+TEST_CASE("Test compressed output history", "[CompressedHistory]") {
+  std::vector<Byte> buf(100);
+  CompressedHistory history(4000, 100);
+  REQUIRE_EQUALS(history.begin(), 0);
+  REQUIRE_EQUALS(history.end(), 0);
+  REQUIRE_EQUALS(history.read(0, buf.data(), buf.size()), 0);
+
+  // the first two blocks are sealed, and can be read before they are compressed
+  history.append(logLines(0, 250).data(), 250);
+  REQUIRE_EQUALS(history.end(), 250);
+  CompressedHistory::Statistics stats = history.statistics();
+  REQUIRE_EQUALS(stats.blockCount, 0);
+  REQUIRE_EQUALS(history.read(130, buf.data(), buf.size()), 70);
+  REQUIRE(memcmp(buf.data(), logLines(130, 70).data(), 70) == 0);
+
+  // the sealed blocks are compressed by the flush, and the rest is still raw
+  history.flush();
+  stats = history.statistics();
+  REQUIRE_EQUALS(stats.blockCount, 2);
+  REQUIRE_EQUALS(stats.sealedBytes, 200);
+  REQUIRE_EQUALS(stats.retainedBytes, 250);
+
+  // reads stop at the end of each block
+  REQUIRE_EQUALS(history.read(30, buf.data(), buf.size()), 70);
+  REQUIRE(memcmp(buf.data(), logLines(30, 70).data(), 70) == 0);
+  REQUIRE_EQUALS(history.read(60, buf.data(), 20), 20);
+  REQUIRE(memcmp(buf.data(), logLines(60, 20).data(), 20) == 0);
+  REQUIRE_EQUALS(history.read(220, buf.data(), buf.size()), 30);
+  REQUIRE(memcmp(buf.data(), logLines(220, 30).data(), 30) == 0);
+  REQUIRE_EQUALS(history.read(250, buf.data(), buf.size()), 0);
+
+  // the second read hits the decompressed block, and the third one reads the raw block
+  stats = history.statistics();
+  REQUIRE_EQUALS(stats.reads, 4);
+  REQUIRE_EQUALS(stats.decompressions, 1);
+
+  // old blocks are dropped when exceeding the maximum size
+  for (size_t i=250; i<50000; i+=250) {
+    history.append(logLines(i, 250).data(), 250);
+    history.flush();
+  }
+  stats = history.statistics();
+  REQUIRE_EQUALS(history.end(), 50000);
+  REQUIRE(history.begin() > 0);
+  REQUIRE(stats.compressedBytes + 200 <= 4000);
+  REQUIRE(stats.compressionRatio() > 1.0);
+  REQUIRE_EQUALS(history.read(history.begin() - 1, buf.data(), buf.size()), 0);
+  REQUIRE_EQUALS(history.read(history.begin(), buf.data(), buf.size()), 100);
+  REQUIRE(memcmp(buf.data(), logLines(history.begin(), 100).data(), 100) == 0);
+}
+
+TEST_CASE("Test output buffer with compressed history", "[CompressedHistory]") {
+  std::vector<Byte> buf(200);
+  OutputBuffer outputBuffer(64, 64, LOCKED_READ, MALLOC_STORE, new CompressedHistory(64 * 1024, 1024));
+  std::vector<Byte> data = logLines(0, 5000);
+  for (size_t i=0; i<data.size(); i+=50) {
+    outputBuffer.write(data.data() + i, 50);
+  }
+  REQUIRE_EQUALS(outputBuffer.retainedBegin(), 0);
+
+  // read everything back, from both the history and the circular buffer
+  std::vector<Byte> output;
+  size_t begin = 0;
+  while (begin < data.size()) {
+    ReadResult readResult = outputBuffer.tryRead(begin, buf.data(), buf.size());
+    REQUIRE(readResult.count > 0);
+    REQUIRE_EQUALS(readResult.begin, begin);
+    output.insert(output.end(), buf.data(), buf.data() + readResult.count);
+    begin += readResult.count;
+  }
+  REQUIRE(output == data);
+}
+
+TEST_CASE("Test reading the compressed history while it is written", "[CompressedHistory]") {
+  OutputBuffer outputBuffer(256, 256, LOCKED_READ, MALLOC_STORE, new CompressedHistory(1024 * 1024, 1024));
+  std::vector<Byte> data = logLines(0, 200000);
+
+  // the blocks are compressed by the writer outside of the lock, while the reader follows
+  Poco::Thread writerThread;
+  writerThread.startFunc([&outputBuffer, &data] () {
+    for (size_t i=0; i<data.size(); i+=100) {
+      outputBuffer.write(data.data() + i, 100);
+    }
+    outputBuffer.close();
+  });
+  std::vector<Byte> output, buf(300);
+  size_t begin = 0;
+  for (;;) {
+    ReadResult readResult = outputBuffer.read(begin, buf.data(), buf.size(), 1000);
+    if (readResult.isClosed || readResult.isTimeout)
+      break;
+    REQUIRE_EQUALS(readResult.begin, begin);
+    output.insert(output.end(), buf.data(), buf.data() + readResult.count);
+    begin += readResult.count;
+  }
+  writerThread.join();
+  REQUIRE(output == data);
+}
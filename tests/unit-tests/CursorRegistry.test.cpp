@@ -0,0 +1,124 @@
+#include <string>
+#include <vector>
+#include <Poco/Thread.h>
+#include <catch2/catch.hpp>
+#include "src/CursorRegistry.h"
+#include "macros.h"
+
+namespace {
+  void write(OutputBuffer &buffer, std::string const& s) {
+    buffer.write(s.data(), s.size());
+  }
+}
+
+TEST_CASE("Test tracking the reader cursors", "[CursorRegistry]") {
+  OutputBuffer buffer(100, 10);
+  CursorRegistry cursors(&buffer);
+  write(buffer, std::string(50, 'x'));
+
+  // a new cursor starts from the beginning, or counted from the end
+  CursorInfo first = cursors.create(false, REPEATS_MARKER);
+  REQUIRE_EQUALS(first.position, 0);
+  REQUIRE_EQUALS(first.lag, 50);
+  REQUIRE_FALSE(first.durable);
+  CursorInfo second = cursors.create(false, REPEATS_MARKER, -10);
+  REQUIRE_EQUALS(second.position, 40);
+  REQUIRE(first.id != second.id);
+  REQUIRE_EQUALS(cursors.size(), 2);
+
+  // the cursor advances with the delivered bytes
+  REQUIRE(cursors.advance(first.id, 0, 30));
+  CursorInfo info;
+  REQUIRE(cursors.poll(first.id, &info));
+  REQUIRE_EQUALS(info.position, 30);
+  REQUIRE_EQUALS(info.deliveredBytes, 30);
+  REQUIRE_EQUALS(info.lag, 20);
+
+  // the bytes evicted before being delivered are counted as dropped
+  write(buffer, std::string(100, 'y'));
+  REQUIRE_EQUALS(buffer.retainedBegin(), 50);
+  REQUIRE(cursors.advance(first.id, 50, 150));
+  REQUIRE(cursors.poll(first.id, &info));
+  REQUIRE_EQUALS(info.droppedBytes, 20);
+  REQUIRE_EQUALS(info.deliveredBytes, 130);
+  REQUIRE_EQUALS(info.lag, 0);
+
+  // a stale range never moves the cursor back
+  REQUIRE(cursors.advance(first.id, 100, 120));
+  REQUIRE(cursors.poll(first.id, &info));
+  REQUIRE_EQUALS(info.position, 150);
+  REQUIRE_EQUALS(info.deliveredBytes, 130);
+
+  std::vector<CursorInfo> list = cursors.list();
+  REQUIRE_EQUALS(list.size(), 2);
+  REQUIRE_EQUALS(list[0].id, first.id);
+  REQUIRE_EQUALS(list[1].id, second.id);
+  REQUIRE_EQUALS(list[1].lag, 110);
+
+  // removed or unknown cursors
+  REQUIRE(cursors.remove(first.id));
+  REQUIRE_FALSE(cursors.remove(first.id));
+  REQUIRE_FALSE(cursors.poll(first.id, &info));
+  REQUIRE_FALSE(cursors.advance(first.id, 150, 160));
+  REQUIRE_FALSE(cursors.poll("not-a-cursor", &info));
+  REQUIRE_EQUALS(cursors.size(), 1);
+}
+
+TEST_CASE("Test durable reader cursors", "[CursorRegistry]") {
+  OutputBuffer buffer(100, 10);
+  buffer.setLossless(true);
+  CursorRegistry cursors(&buffer);
+  CursorInfo cursor = cursors.create(true, REPEATS_MARKER);
+  REQUIRE(cursor.durable);
+
+  // the writer waits for the durable cursor
+  Poco::Thread writerThread;
+  writerThread.startFunc([&buffer] () {
+    write(buffer, std::string(150, 'x'));
+  });
+  Poco::Thread::sleep(50);
+  REQUIRE_EQUALS(buffer.writtenBytes(), 100);
+  REQUIRE_EQUALS(buffer.durableBegin(), 0);
+  REQUIRE(cursors.advance(cursor.id, 0, 60));
+  writerThread.join();
+  REQUIRE_EQUALS(buffer.writtenBytes(), 150);
+  REQUIRE_EQUALS(buffer.durableBegin(), 60);
+
+  // removing the cursor detaches it from the buffer
+  REQUIRE(cursors.remove(cursor.id));
+  REQUIRE_EQUALS(buffer.durableBegin(), 150);
+}
+
+TEST_CASE("Test durable reader cursors on deduplicated lines", "[CursorRegistry]") {
+  OutputBuffer buffer(1024);
+  buffer.setDeduplicateLines(true);
+  CursorRegistry cursors(&buffer);
+  CursorInfo cursor = cursors.create(true, REPEATS_EXPANDED);
+  write(buffer, "a\nwarn\nwarn\nwarn\nb\n");
+  REQUIRE(cursors.poll(cursor.id, &cursor));
+  REQUIRE_EQUALS(cursor.lag, 19);
+
+  // the durable position is that of the stored output
+  REQUIRE(cursors.advance(cursor.id, 0, 17));
+  REQUIRE_EQUALS(buffer.durableBegin(), 7);
+  REQUIRE(cursors.advance(cursor.id, 17, 19));
+  REQUIRE_EQUALS(buffer.durableBegin(), 9);
+}
+
+TEST_CASE("Test limiting the number of reader cursors", "[CursorRegistry]") {
+  OutputBuffer buffer(100, 10);
+  CursorRegistry cursors(&buffer, 0, 2);
+  CursorInfo first = cursors.create(false, REPEATS_MARKER);
+  Poco::Thread::sleep(2);
+  CursorInfo second = cursors.create(false, REPEATS_MARKER);
+  Poco::Thread::sleep(2);
+  CursorInfo info;
+  REQUIRE(cursors.poll(first.id, &info));
+
+  // the least recently polled cursor makes room for the new one
+  CursorInfo third = cursors.create(false, REPEATS_MARKER);
+  REQUIRE_EQUALS(cursors.size(), 2);
+  REQUIRE(cursors.poll(first.id, &info));
+  REQUIRE_FALSE(cursors.poll(second.id, &info));
+  REQUIRE(cursors.poll(third.id, &info));
+}
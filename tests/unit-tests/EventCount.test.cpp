@@ -0,0 +1,58 @@
+#include <unistd.h>
+#include <atomic>
+#include <Poco/Clock.h>
+#include <Poco/Thread.h>
+#include <catch2/catch.hpp>
+#include "src/EventCount.h"
+#include "macros.h"
+
+TEST_CASE("Test event count", "[EventCount]") {
+  EventCount eventCount;
+  std::atomic<int> value(0);
+
+  // the condition already holds
+  eventCount.prepareWait();
+  REQUIRE_EQUALS(eventCount.waiters(), 1);
+  eventCount.cancelWait();
+  REQUIRE_EQUALS(eventCount.waiters(), 0);
+
+  // a notification issued after `prepareWait` is never missed
+  EventCount::Key key = eventCount.prepareWait();
+  eventCount.notifyAll();
+  REQUIRE(eventCount.wait(key, EventCount::Deadline::after(0)));
+  REQUIRE_EQUALS(eventCount.waiters(), 0);
+
+  // timeout
+  Poco::Clock start;
+  key = eventCount.prepareWait();
+  REQUIRE_FALSE(eventCount.wait(key, EventCount::Deadline::after(100)));
+  REQUIRE(start.elapsed() >= 100 * 1000);
+  REQUIRE_EQUALS(eventCount.waiters(), 0);
+
+  // wake up many waiters at once
+  static const int N_THREADS = 100;
+  Poco::Thread threads[N_THREADS];
+  std::atomic<int> woken(0);
+  for (int i=0; i<N_THREADS; ++i) {
+    threads[i].startFunc([&] () {
+      for (;;) {
+        EventCount::Key key = eventCount.prepareWait();
+        if (value.load() > 0) {
+          eventCount.cancelWait();
+          break;
+        }
+        eventCount.wait(key, EventCount::Deadline::after(0));
+      }
+      ++woken;
+    });
+  }
+  usleep(200 * 1000);
+  REQUIRE_EQUALS(woken.load(), 0);
+  value = 1;
+  eventCount.notifyAll();
+  for (int i=0; i<N_THREADS; ++i) {
+    threads[i].join();
+  }
+  REQUIRE_EQUALS(woken.load(), N_THREADS);
+  REQUIRE_EQUALS(eventCount.waiters(), 0);
+}
@@ -0,0 +1,103 @@
+#include <string>
+#include <catch2/catch.hpp>
+#include "src/LineIndex.h"
+#include "src/OutputBuffer.h"
+#include "src/CompressedHistory.h"
+#include "macros.h"
+
+namespace {
+  void appendString(LineIndex &index, std::string const& s) {
+    index.append((const Byte*)s.data(), s.size());
+  }
+}
+
+TEST_CASE("Test line index", "[LineIndex]") {
+  LineIndex index;
+  REQUIRE_EQUALS(index.firstLine(), 0);
+  REQUIRE_EQUALS(index.lineCount(), 0);
+  REQUIRE_EQUALS(index.lineBegin(0), 0);
+
+  // the last line is counted even if not terminated
+  appendString(index, "abc\nd");
+  REQUIRE_EQUALS(index.lineCount(), 2);
+  REQUIRE_EQUALS(index.lineBegin(1), 4);
+  REQUIRE_EQUALS(index.lineBegin(2), 5);
+  appendString(index, "e\n\nfg\n");
+  REQUIRE_EQUALS(index.end(), 11);
+  REQUIRE_EQUALS(index.lineCount(), 4);
+  REQUIRE_EQUALS(index.lineBegin(2), 7);
+  REQUIRE_EQUALS(index.lineBegin(3), 8);
+  REQUIRE_EQUALS(index.lineBegin(4), 11);
+
+  // positions to lines
+  REQUIRE_EQUALS(index.lineAt(0), 0);
+  REQUIRE_EQUALS(index.lineAt(3), 0);
+  REQUIRE_EQUALS(index.lineAt(4), 1);
+  REQUIRE_EQUALS(index.lineAt(6), 1);
+  REQUIRE_EQUALS(index.lineAt(7), 2);
+  REQUIRE_EQUALS(index.lineAt(10), 3);
+  REQUIRE_EQUALS(index.lineAt(11), 4);
+
+  // trimming at the beginning of a line keeps that line
+  index.trim(4);
+  REQUIRE_EQUALS(index.firstLine(), 1);
+  REQUIRE_EQUALS(index.lineBegin(1), 4);
+  REQUIRE_EQUALS(index.lineCount(), 4);
+
+  // trimming in the middle of a line drops that line
+  index.trim(9);
+  REQUIRE_EQUALS(index.firstLine(), 4);
+  REQUIRE_EQUALS(index.lineCount(), 4);
+  REQUIRE_EQUALS(index.lineBegin(4), 11);
+
+  // the trimmed lines are still counted
+  appendString(index, "hij");
+  REQUIRE_EQUALS(index.lineCount(), 5);
+  REQUIRE_EQUALS(index.lineBegin(4), 11);
+  REQUIRE_EQUALS(index.lineAt(13), 4);
+  index.trim(12);
+  REQUIRE_EQUALS(index.firstLine(), 5);
+  REQUIRE_EQUALS(index.lineCount(), 5);
+  REQUIRE_EQUALS(index.lineBegin(5), 14);
+}
+
+TEST_CASE("Test bounding the line index", "[LineIndex]") {
+  LineIndex index;
+  appendString(index, "a\nb\nc\nd\ne\n");
+  REQUIRE_EQUALS(index.lineCount(), 5);
+
+  // the oldest lines are dropped to fit, but never those beginning at or after the limit
+  index.fit(2 * sizeof(size_t), 4);
+  REQUIRE_EQUALS(index.firstLine(), 2);
+  REQUIRE_EQUALS(index.lineBegin(2), 4);
+  index.fit(0, 4);
+  REQUIRE_EQUALS(index.firstLine(), 2);
+  index.fit(0, 9);
+  REQUIRE_EQUALS(index.firstLine(), 5);
+  REQUIRE_EQUALS(index.lineCount(), 5);
+  REQUIRE_EQUALS(index.lineBegin(5), 10);
+}
+
+TEST_CASE("Test bounding the line index of the history", "[LineIndex]") {
+  OutputBuffer buffer(200, 200, LOCKED_READ, MALLOC_STORE, new CompressedHistory(1024 * 1024, 1024));
+  buffer.setIndexBudget(400 * sizeof(size_t));
+  std::string text;
+  for (int i=0; i<10000; ++i) {
+    text += std::to_string(i % 10) + "\n";
+  }
+  buffer.write(text.data(), text.size());
+
+  // the history retains all of the output, but only the latest lines of it are indexed
+  REQUIRE_EQUALS(buffer.retainedBegin(), 0);
+  LineRange all = buffer.lines(0);
+  REQUIRE_EQUALS(all.line + all.count, 10000);
+  REQUIRE(all.count <= 200);
+  REQUIRE(all.count > 100);
+  REQUIRE(all.begin < buffer.writtenBytes() - buffer.size());
+
+  // the lines of the circular buffer are always indexed
+  buffer.setIndexBudget(0);
+  all = buffer.lines(0);
+  REQUIRE_EQUALS(all.count, 100);
+  REQUIRE_EQUALS(all.begin, buffer.writtenBytes() - buffer.size());
+}
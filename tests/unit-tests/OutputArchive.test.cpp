@@ -0,0 +1,117 @@
+#include <unistd.h>
+#include <string>
+#include <Poco/Exception.h>
+#include <Poco/File.h>
+#include <Poco/FileStream.h>
+#include <Poco/TemporaryFile.h>
+#include <catch2/catch.hpp>
+#include "src/OutputArchive.h"
+#include "macros.h"
+
+namespace {
+  void append(OutputArchiveWriter &writer, size_t begin, std::string const& s) {
+    writer.append(begin, (const Byte*)s.data(), s.size());
+  }
+
+  std::string numberLines(int first, int last) {
+    std::string ret;
+    for (int i=first; i<last; ++i) {
+      ret += std::to_string(i) + "\n";
+    }
+    return ret;
+  }
+}
+
+TEST_CASE("Test reading ranges of output archive", "[OutputArchive]") {
+  Poco::TemporaryFile file;
+  std::string output = numberLines(0, 1000);
+  {
+    OutputArchiveWriter writer(file.path(), 100);
+    for (size_t i=0; i<output.size(); i+=37) {
+      append(writer, i, output.substr(i, 37));
+    }
+    REQUIRE_EQUALS(writer.end(), output.size());
+    REQUIRE_EQUALS(writer.blockCount(), output.size() / 100);
+    REQUIRE(writer.pendingBytes() > 0);
+    writer.finish();
+    REQUIRE_EQUALS(writer.pendingBytes(), 0);
+    REQUIRE_THROWS_AS(append(writer, output.size(), "x"), Poco::IllegalStateException);
+  }
+
+  OutputArchiveReader reader(file.path());
+  REQUIRE(reader.complete());
+  REQUIRE_EQUALS(reader.begin(), 0);
+  REQUIRE_EQUALS(reader.end(), output.size());
+  REQUIRE_EQUALS(reader.blocks().size(), (output.size() + 99) / 100);
+
+  // only the blocks of the range are decompressed
+  REQUIRE_EQUALS(reader.read(2500, 150), output.substr(2500, 150));
+  REQUIRE_EQUALS(reader.blocksRead(), 2);
+  REQUIRE_EQUALS(reader.read(output.size() - 10, 100), output.substr(output.size() - 10));
+  REQUIRE_EQUALS(reader.blocksRead(), 3);
+  size_t actualBegin;
+  REQUIRE(reader.read(output.size(), 100, &actualBegin).empty());
+  REQUIRE_EQUALS(actualBegin, output.size());
+
+  // the lines are found by the line counts of the blocks
+  REQUIRE_EQUALS(reader.readLines(500, 3), "500\n501\n502\n");
+  REQUIRE_EQUALS(reader.readLines(0, 2), "0\n1\n");
+  REQUIRE_EQUALS(reader.readLines(998, 10), "998\n999\n");
+  REQUIRE(reader.readLines(1000, 1).empty());
+  REQUIRE_EQUALS(reader.lineCount(), 1000);
+}
+
+TEST_CASE("Test reading unfinished output archive", "[OutputArchive]") {
+  Poco::TemporaryFile file;
+  {
+    OutputArchiveWriter writer(file.path(), 1024);
+    append(writer, 0, "hello\n");
+    // the discarded positions start a new block
+    append(writer, 100, "world\nno newline");
+    // the positions already appended are skipped
+    append(writer, 106, "no newline, yet");
+    writer.flush();
+    append(writer, 200, "partial");
+    writer.flush();
+  }
+
+  // the blocks are scanned, while the last partial block is ignored
+  truncate(file.path().c_str(), Poco::File(file.path()).getSize() - 1);
+  OutputArchiveReader reader(file.path());
+  REQUIRE_FALSE(reader.complete());
+  REQUIRE_EQUALS(reader.blocks().size(), 2);
+  REQUIRE_EQUALS(reader.blocks()[1].begin, 100);
+  REQUIRE_EQUALS(reader.end(), 121);
+  REQUIRE_EQUALS(reader.lineCount(), 3);
+
+  size_t actualBegin;
+  REQUIRE_EQUALS(reader.read(0, 200, &actualBegin), "hello\nworld\nno newline, yet");
+  REQUIRE_EQUALS(actualBegin, 0);
+  REQUIRE_EQUALS(reader.read(50, 56, &actualBegin), "world\n");
+  REQUIRE_EQUALS(actualBegin, 100);
+  REQUIRE_EQUALS(reader.readLines(1, 5), "world\nno newline, yet");
+
+  // the gaps of the discarded positions are seen by the positions of the scanned bytes
+  std::vector<size_t> positions;
+  std::string scanned;
+  reader.scan(0, 200, [&positions, &scanned] (size_t position, const Byte *data, size_t count) {
+    positions.push_back(position);
+    scanned.append((const char*)data, count);
+    return true;
+  });
+  REQUIRE_EQUALS(positions.size(), 2);
+  REQUIRE_EQUALS(positions[0], 0);
+  REQUIRE_EQUALS(positions[1], 100);
+  REQUIRE_EQUALS(scanned, "hello\nworld\nno newline, yet");
+  positions.clear();
+  reader.scanLines(0, 2, [&positions] (size_t position, const Byte *data, size_t count) {
+    positions.push_back(position);
+    return false;
+  });
+  REQUIRE_EQUALS(positions.size(), 1);
+
+  // not an archive
+  Poco::TemporaryFile other;
+  Poco::FileOutputStream(other.path()) << "plain output\n";
+  REQUIRE_THROWS_AS(OutputArchiveReader(other.path()), Poco::DataFormatException);
+}
@@ -4,6 +4,7 @@
 
 #include <unistd.h>
 #include <string.h>
+#include <atomic>
 #include <vector>
 #include <Poco/Exception.h>
 #include <Poco/Thread.h>
@@ -12,6 +13,7 @@
 #include <src/Logger.h>
 #include "src/OutputBuffer.h"
 #include "src/Utils.h"
+#include "BytePattern.h"
 #include "macros.h"
 #include "CapturingLogger.h"
 
@@ -208,16 +210,17 @@ TEST_CASE("Test read with negative position", "[OutputBuffer]") {
 }
 
 TEST_CASE("Test blocking read", "[OutputBuffer]") {
-  std::vector<Byte> content1, content2, content3, content4, content;
+  std::vector<Byte> content1, content2, content3, content4, content5, content;
+  ReadResult result1, result3, result5;
   OutputBuffer buffer(31, 11);
 
   // test to read on the tail with potentially larger count than capacity,
   // and potentially further than the tail.
-  Poco::Thread th1, th2, th3, th4;
+  Poco::Thread th1, th2, th3, th4, th5;
   bool timeout4[1];
   th1.startFunc([&] () {
     content1.resize(31);
-    buffer.read(0, content1.data(), 31);
+    result1 = buffer.read(0, content1.data(), 31);
   });
   th2.startFunc([&] () {
     content2.resize(50);
@@ -225,25 +228,37 @@ TEST_CASE("Test blocking read", "[OutputBuffer]") {
   });
   th3.startFunc([&] () {
     content3 = zeros(200);
-    buffer.read(0, content3.data(), 200);
+    result3 = buffer.read(0, content3.data(), 200);
   });
   th4.startFunc([&] () {
     content4.resize(1);
     timeout4[0] = buffer.read(5, content4.data(), 1, 100).isTimeout;
   });
+  th5.startFunc([&] () {
+    content5.resize(10);
+    result5 = buffer.read(90, content5.data(), 10);
+  });
   usleep(500 * 1000); // sleep for 500 ms
   buffer.write(bytesRange(0, 100).data(), 100);
   th1.join();
   th2.join();
   th3.join();
   th4.join();
-
-  // the read request should capture anything they want (and available)
-  REQUIRE(bytesEqual(content1, bytesRange(0, 31)));
-  REQUIRE(bytesEqual(content2, bytesRange(5, 50)));
-  REQUIRE(bytesEqual(content3, bytesConcat(bytesRange(0, 100), zeros(100))));
+  th5.join();
+
+  // the woken readers copy by themselves, so they get what is still in the buffer
+  REQUIRE_EQUALS(result1.begin, 69);
+  REQUIRE_EQUALS(result1.count, 31);
+  REQUIRE(bytesEqual(content1, bytesRange(69, 31)));
+  REQUIRE(bytesEqual(content2, bytesConcat(bytesRange(69, 31), std::vector<Byte>(content2.begin() + 31, content2.end()))));
+  REQUIRE_EQUALS(result3.begin, 69);
+  REQUIRE_EQUALS(result3.count, 31);
+  REQUIRE(bytesEqual(content3, bytesConcat(bytesRange(69, 31), zeros(169))));
   REQUIRE(timeout4[0]);
   REQUIRE_EQUALS(content4.at(0), 0);  // a timeout request should not modify the buffer
+  REQUIRE_EQUALS(result5.begin, 90);
+  REQUIRE_EQUALS(result5.count, 10);
+  REQUIRE(bytesEqual(content5, bytesRange(90, 10)));
 
   // the buffer should now carry the last 31 bytes
   REQUIRE_EQUALS(buffer.size(), 31);
@@ -320,7 +335,7 @@ TEST_CASE("Random test on read and write", "[OutputBuffer]") {
   delete [] threads;
 }
 
-TEST_CASE("Test re-allocate reader list", "[OutputBuffer]") {
+TEST_CASE("Test many waiting readers with timeouts", "[OutputBuffer]") {
   CapturingLogger capturingLogger;
   Logger::ScopedRootLogger scopedRootLogger(&capturingLogger);
   static const int N_THREADS = 1002;
@@ -353,11 +368,7 @@ TEST_CASE("Test re-allocate reader list", "[OutputBuffer]") {
   for (int i=0; i<1002; ++i) {
     threads[i].join();
   }
-  REQUIRE_EQUALS(capturingLogger.capturedLogs().size(), 1);
-  REQUIRE(
-    Catch::startsWith(
-      capturingLogger.capturedLogs().at(0).message,
-      "Waiting queue for output buffer readers has been re-allocated"));
+  REQUIRE(capturingLogger.capturedLogs().empty());
 
   for (int i=0; i<1002; ++i) {
     if (i != 500) {
@@ -378,3 +389,433 @@ TEST_CASE("Test re-allocate reader list", "[OutputBuffer]") {
   delete [] targets;
   delete [] threads;
 }
+
+TEST_CASE("Test optimistic read", "[OutputBuffer]") {
+  char buf[1024] = {0};
+  std::vector<Byte> content;
+  OutputBuffer buffer(31, 11, OPTIMISTIC_READ);
+  REQUIRE_EQUALS(buffer.readMode(), OPTIMISTIC_READ);
+
+  // read before and after expanding / overwriting
+  buffer.write(bytesRange(0, 10).data(), 10);
+  readAllBytes(0, buffer, &content);
+  REQUIRE(bytesEqual(content, bytesRange(0, 10)));
+  buffer.write(bytesRange(10, 30).data(), 30);
+  readAllBytes(0, buffer, &content);
+  REQUIRE(bytesEqual(content, bytesRange(9, 31)));
+  readAllBytes(-5, buffer, &content);
+  REQUIRE(bytesEqual(content, bytesRange(35, 5)));
+
+  // blocking read should still wait for the writer
+  REQUIRE(buffer.read(40, buf, sizeof(buf), 1).isTimeout);
+  Poco::Thread th;
+  ReadResult result;
+  th.startFunc([&] () {
+    result = buffer.read(40, buf, sizeof(buf));
+  });
+  usleep(100 * 1000);
+  buffer.write(bytesRange(40, 3).data(), 3);
+  th.join();
+  REQUIRE_EQUALS(result.begin, 40);
+  REQUIRE_EQUALS(result.count, 3);
+  REQUIRE(strncmp(buf, (char*)bytesRange(40, 3).data(), 3) == 0);
+
+  // read on closed buffer
+  buffer.close();
+  REQUIRE(buffer.tryRead(43, buf, sizeof(buf)).isClosed);
+  REQUIRE(buffer.read(43, buf, sizeof(buf), 1).isClosed);
+  readAllBytes(0, buffer, &content);
+  REQUIRE(bytesEqual(content, bytesRange(12, 31)));
+}
+
+TEST_CASE("Test optimistic read never returns overwritten bytes", "[OutputBuffer]") {
+  static const int N_READERS = 8;
+  static const size_t BYTES_TO_WRITE = 4 * 1024 * 1024;
+  static const size_t PERIOD = 251;  // prime period, so a torn copy is very unlikely to look valid
+
+  OutputBuffer buffer(256, 16, OPTIMISTIC_READ);
+  std::atomic<bool> stopped(false);
+  std::atomic<size_t> mismatches(0), reads(0);
+  Poco::Thread readers[N_READERS];
+
+  for (int i=0; i<N_READERS; ++i) {
+    readers[i].startFunc([&] () {
+      Byte buf[256];
+      while (!stopped) {
+        ssize_t begin = -(ssize_t)(randDouble() * 300);
+        ReadResult rr = buffer.tryRead(begin, buf, sizeof(buf));
+        if (rr.isTimeout || rr.isClosed)
+          continue;
+        for (size_t j=0; j<rr.count; ++j) {
+          if (buf[j] != (Byte)((rr.begin + j) % PERIOD)) {
+            ++mismatches;
+            break;
+          }
+        }
+        ++reads;
+      }
+    });
+  }
+
+  std::vector<Byte> chunk(200);
+  size_t written = 0;
+  while (written < BYTES_TO_WRITE) {
+    size_t n = 1 + (size_t)(randDouble() * chunk.size());
+    for (size_t j=0; j<n; ++j) {
+      chunk[j] = (Byte)((written + j) % PERIOD);
+    }
+    buffer.write(chunk.data(), n);
+    written += n;
+  }
+  stopped = true;
+  for (int i=0; i<N_READERS; ++i) {
+    readers[i].join();
+  }
+
+  REQUIRE(reads > 0);
+  REQUIRE_EQUALS(mismatches, 0);
+}
+
+namespace {
+  std::vector<Byte> viewBytes(OutputView const& view) {
+    std::vector<Byte> dst;
+    for (int i=0; i<view.segmentCount; ++i) {
+      Byte *base = (Byte*)view.segments[i].iov_base;
+      dst.insert(dst.end(), base, base + view.segments[i].iov_len);
+    }
+    return std::move(dst);
+  }
+}
+
+TEST_CASE("Test output views", "[OutputBuffer]") {
+  for (auto readMode: {LOCKED_READ, OPTIMISTIC_READ}) {
+    OutputBuffer buffer(31, 11, readMode);
+    REQUIRE(buffer.peek(0, 100).isTimeout);
+
+    // a single segment
+    buffer.write(bytesRange(0, 10).data(), 10);
+    OutputView view = buffer.peek(2, 100);
+    REQUIRE_EQUALS(view.begin, 2);
+    REQUIRE_EQUALS(view.count, 8);
+    REQUIRE_EQUALS(view.segmentCount, 1);
+    REQUIRE(bytesEqual(viewBytes(view), bytesRange(2, 8)));
+    REQUIRE(buffer.isIntact(view));
+
+    // the contents wrap around the ring, giving two segments
+    buffer.write(bytesRange(10, 30).data(), 30);
+    view = buffer.peek(0, 100);
+    REQUIRE_EQUALS(view.begin, 9);
+    REQUIRE_EQUALS(view.count, 31);
+    REQUIRE_EQUALS(view.segmentCount, 2);
+    REQUIRE(bytesEqual(viewBytes(view), bytesRange(9, 31)));
+    view = buffer.peek(-5, 3);
+    REQUIRE_EQUALS(view.begin, 35);
+    REQUIRE(bytesEqual(viewBytes(view), bytesRange(35, 3)));
+    REQUIRE(buffer.isIntact(view));
+
+    // overwriting the viewed bytes invalidates the view
+    view = buffer.peek(9, 5);
+    buffer.write(bytesRange(40, 3).data(), 3);
+    REQUIRE_FALSE(buffer.isIntact(view));
+    REQUIRE(buffer.isIntact(buffer.peek(12, 5)));
+
+    // only the views well above the eviction are far from it
+    REQUIRE(buffer.isFarFromEviction(buffer.peek(12, 5), 0));
+    REQUIRE_FALSE(buffer.isFarFromEviction(buffer.peek(12, 5), 10));
+    REQUIRE(buffer.isFarFromEviction(buffer.peek(30, 5), 10));
+
+    // wait without reading
+    REQUIRE(buffer.wait(43, 1).isTimeout);
+    ReadResult rr = buffer.wait(42, 1);
+    REQUIRE_EQUALS(rr.begin, 42);
+    REQUIRE_EQUALS(rr.count, 0);
+
+    buffer.close();
+    REQUIRE(buffer.peek(43, 100).isClosed);
+    REQUIRE(buffer.wait(43).isClosed);
+  }
+}
+
+TEST_CASE("Test mirrored output buffer", "[OutputBuffer]") {
+  size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+  OutputBuffer buffer(pageSize - 10, 11, LOCKED_READ, MIRRORED_STORE);
+  if (buffer.storeType() != MIRRORED_STORE) {
+    WARN("Mirrored output buffer is not supported on this system.");
+    return;
+  }
+  REQUIRE_EQUALS(buffer.capacity(), pageSize);
+
+  // write so that the contents wrap around the end of the ring
+  std::vector<Byte> payload = pattern(0, pageSize + 100);
+  buffer.write(payload.data(), pageSize - 50);
+  buffer.write(payload.data() + pageSize - 50, 150);
+  REQUIRE_EQUALS(buffer.size(), pageSize);
+
+  // a view is always a single contiguous segment
+  OutputView view = buffer.peek(0, pageSize);
+  REQUIRE_EQUALS(view.begin, 100);
+  REQUIRE_EQUALS(view.count, pageSize);
+  REQUIRE_EQUALS(view.segmentCount, 1);
+  REQUIRE(memcmp(view.segments[0].iov_base, payload.data() + 100, pageSize) == 0);
+
+  // and so are the reads
+  std::vector<Byte> content;
+  readAllBytes(0, buffer, &content);
+  REQUIRE_EQUALS(content.size(), pageSize);
+  REQUIRE(memcmp(content.data(), payload.data() + 100, pageSize) == 0);
+}
+
+TEST_CASE("Test locating lines", "[OutputBuffer]") {
+  OutputBuffer buffer(20, 20);
+  LineRange range = buffer.lines(0);
+  REQUIRE_EQUALS(range.count, 0);
+
+  // lines: "0\n", "11\n", "222\n", "33"
+  std::string s = "0\n11\n222\n33";
+  buffer.write(s.data(), s.size());
+  range = buffer.lines(1, 2);
+  REQUIRE_EQUALS(range.line, 1);
+  REQUIRE_EQUALS(range.count, 2);
+  REQUIRE_EQUALS(range.begin, 2);
+  REQUIRE_EQUALS(range.end, 9);
+  range = buffer.lines(-1);
+  REQUIRE_EQUALS(range.line, 3);
+  REQUIRE_EQUALS(range.count, 1);
+  REQUIRE_EQUALS(range.begin, 9);
+  REQUIRE_EQUALS(range.end, 11);
+  range = buffer.lines(-100, 2);
+  REQUIRE_EQUALS(range.line, 0);
+  REQUIRE_EQUALS(range.end, 5);
+  range = buffer.lines(10, 2);
+  REQUIRE_EQUALS(range.count, 0);
+  REQUIRE_EQUALS(range.begin, 11);
+
+  // lines partially evicted from the circular buffer are skipped
+  s = "3\n4444\n55555\n";
+  buffer.write(s.data(), s.size());
+  REQUIRE_EQUALS(buffer.writtenBytes(), 24);
+  range = buffer.lines(0);
+  REQUIRE_EQUALS(range.line, 2);
+  REQUIRE_EQUALS(range.count, 4);
+  REQUIRE_EQUALS(range.begin, 5);
+  REQUIRE_EQUALS(range.end, 24);
+  range = buffer.lines(-2, 1);
+  REQUIRE_EQUALS(range.line, 4);
+  REQUIRE_EQUALS(range.begin, 13);
+  REQUIRE_EQUALS(range.end, 18);
+
+  buffer.write("x", 1);
+  REQUIRE_EQUALS(buffer.lines(0).line, 2);
+  buffer.write("y", 1);
+  range = buffer.lines(0);
+  REQUIRE_EQUALS(range.line, 3);
+  REQUIRE_EQUALS(range.count, 4);
+  REQUIRE_EQUALS(range.begin, 9);
+  REQUIRE_EQUALS(range.end, 26);
+}
+
+TEST_CASE("Test releasing the memory of output buffer", "[OutputBuffer]") {
+  std::vector<Byte> content;
+  OutputBuffer buffer(100, 10);
+  REQUIRE_EQUALS(buffer.storeType(), RESERVED_STORE);
+  REQUIRE_EQUALS(buffer.capacity(), 100);
+  buffer.write(bytesRange(0, 150).data(), 150);
+  OutputView view = buffer.peek(100, 10);
+  REQUIRE(buffer.isIntact(view));
+
+  // the contents are discarded, but the positions are kept
+  buffer.releaseMemory();
+  REQUIRE_EQUALS(buffer.size(), 0);
+  REQUIRE_EQUALS(buffer.writtenBytes(), 150);
+  REQUIRE_EQUALS(buffer.retainedBegin(), 150);
+  REQUIRE_FALSE(buffer.isIntact(view));
+  readAllBytes(0, buffer, &content);
+  REQUIRE(content.empty());
+  REQUIRE_EQUALS(buffer.lines(0).begin, 150);
+
+  // the buffer can still be written
+  buffer.write(bytesRange(150, 20).data(), 20);
+  readAllBytes(0, buffer, &content);
+  REQUIRE(bytesEqual(content, bytesRange(150, 20)));
+}
+
+TEST_CASE("Test limiting the capacity of output buffer", "[OutputBuffer]") {
+  for (OutputBufferStoreType storeType: {MALLOC_STORE, RESERVED_STORE, MIRRORED_STORE}) {
+    std::vector<Byte> content;
+    OutputBuffer buffer(4096, 10, LOCKED_READ, storeType);
+    size_t capacity = buffer.capacity();
+    REQUIRE_EQUALS(buffer.capacityLimit(), capacity);
+    buffer.write(bytesRange(0, 100).data(), 100);
+
+    // the oldest bytes beyond the limit are evicted at once
+    REQUIRE_EQUALS(buffer.setCapacityLimit(60), 60);
+    REQUIRE_EQUALS(buffer.size(), 60);
+    REQUIRE_EQUALS(buffer.retainedBegin(), 40);
+    readAllBytes(0, buffer, &content);
+    REQUIRE(bytesEqual(content, bytesRange(40, 60)));
+
+    // the ring then retains no more than the limit, wherever the head is
+    for (int i=0; i<100; ++i) {
+      buffer.write(bytesRange((Byte)(100 + i * 7), 7).data(), 7);
+    }
+    buffer.write(bytesRange(0, 200).data(), 200);
+    REQUIRE_EQUALS(buffer.size(), 60);
+    readAllBytes(0, buffer, &content);
+    REQUIRE(bytesEqual(content, bytesRange(140, 60)));
+    REQUIRE_EQUALS(buffer.retainedBegin(), buffer.writtenBytes() - 60);
+
+    // the limit can be raised again, but never beyond the capacity
+    REQUIRE_EQUALS(buffer.setCapacityLimit(capacity * 2), capacity);
+    buffer.write(bytesRange(0, 100).data(), 100);
+    REQUIRE_EQUALS(buffer.size(), 160);
+  }
+}
+
+TEST_CASE("Test limiting the capacity of lossless output buffer", "[OutputBuffer]") {
+  OutputBuffer buffer(100, 10);
+  buffer.setLossless(true);
+  size_t consumer = buffer.attachDurableConsumer();
+  buffer.write(bytesRange(0, 80).data(), 80);
+  buffer.advanceDurable(consumer, 30);
+
+  // the bytes not yet taken are never evicted
+  REQUIRE_EQUALS(buffer.setCapacityLimit(20), 50);
+  REQUIRE_EQUALS(buffer.retainedBegin(), 30);
+  Poco::Thread writerThread;
+  writerThread.startFunc([&buffer] () {
+    buffer.write(bytesRange(80, 20).data(), 20);
+  });
+  Poco::Thread::sleep(50);
+  REQUIRE_EQUALS(buffer.writtenBytes(), 80);
+
+  // raising the limit wakes up the writer
+  buffer.setCapacityLimit(100);
+  writerThread.join();
+  REQUIRE_EQUALS(buffer.writtenBytes(), 100);
+}
+
+TEST_CASE("Test lossless output buffer", "[OutputBuffer]") {
+  OutputBuffer buffer(100, 10);
+  buffer.setLossless(true);
+  REQUIRE(buffer.lossless());
+  size_t consumer = buffer.attachDurableConsumer();
+  std::vector<Byte> payload = pattern(0, 1000);
+
+  // the writer blocks until the durable consumer takes the output
+  Poco::Thread writerThread;
+  writerThread.startFunc([&buffer, &payload] () {
+    for (size_t i=0; i<payload.size(); i+=70) {
+      buffer.write(payload.data() + i, std::min((size_t)70, payload.size() - i));
+    }
+    buffer.close();
+  });
+  std::vector<Byte> consumed;
+  Byte chunk[30];
+  size_t begin = 0;
+  ReadResult result;
+  while (!(result = buffer.read(begin, chunk, sizeof(chunk))).isClosed) {
+    REQUIRE_EQUALS(result.begin, begin);
+    consumed.insert(consumed.end(), chunk, chunk + result.count);
+    begin += result.count;
+    if (begin == 30) {
+      // the writer stays blocked for a while
+      Poco::Thread::sleep(50);
+      REQUIRE_EQUALS(buffer.writtenBytes(), 100);
+    }
+    buffer.advanceDurable(consumer, begin);
+  }
+  writerThread.join();
+  REQUIRE(consumed == payload);
+  REQUIRE_EQUALS(buffer.durableBegin(), 1000);
+  BackpressureStatistics stats = buffer.backpressureStatistics();
+  REQUIRE(stats.blockedWrites > 0);
+  REQUIRE(stats.maxBlockedMicros >= 50000);
+  REQUIRE(stats.blockedMicros >= stats.maxBlockedMicros);
+}
+
+TEST_CASE("Test detaching the durable consumer", "[OutputBuffer]") {
+  OutputBuffer buffer(100, 10);
+  buffer.setLossless(true);
+  size_t consumer = buffer.attachDurableConsumer();
+  REQUIRE(buffer.durableConsumerAttached(consumer));
+  std::vector<Byte> payload = bytesRange(0, 150);
+  Poco::Thread writerThread;
+  writerThread.startFunc([&buffer, &payload] () {
+    buffer.write(payload.data(), payload.size());
+  });
+  Poco::Thread::sleep(50);
+  REQUIRE_EQUALS(buffer.writtenBytes(), 100);
+
+  // the writer overwrites the output as usual once the durable consumer has gone
+  buffer.detachDurableConsumer(consumer);
+  writerThread.join();
+  REQUIRE_FALSE(buffer.durableConsumerAttached(consumer));
+  REQUIRE_EQUALS(buffer.writtenBytes(), 150);
+  REQUIRE_EQUALS(buffer.retainedBegin(), 50);
+  REQUIRE_THROWS_AS(buffer.setLossless(true), Poco::IllegalStateException);
+}
+
+TEST_CASE("Test multiple durable consumers", "[OutputBuffer]") {
+  CapturingLogger logger; Logger::ScopedRootLogger scopedRootLogger(&logger);
+  OutputBuffer buffer(100, 10);
+  buffer.setLossless(true);
+  size_t fast = buffer.attachDurableConsumer();
+  size_t slow = buffer.attachDurableConsumer(0, 200);
+  REQUIRE(fast != slow);
+  std::vector<Byte> payload = bytesRange(0, 150);
+  buffer.write(payload.data(), 80);
+
+  // the writer waits for the slowest consumer
+  buffer.advanceDurable(fast, 80);
+  buffer.advanceDurable(slow, 30);
+  REQUIRE_EQUALS(buffer.durableBegin(), 30);
+  Poco::Thread writerThread;
+  writerThread.startFunc([&buffer, &payload] () {
+    buffer.write(payload.data() + 80, 70);
+  });
+  Poco::Thread::sleep(50);
+  REQUIRE_EQUALS(buffer.writtenBytes(), 130);
+
+  // the slow consumer is detached once idle for longer than its timeout
+  writerThread.join();
+  REQUIRE_EQUALS(buffer.writtenBytes(), 150);
+  REQUIRE_FALSE(buffer.durableConsumerAttached(slow));
+  REQUIRE(buffer.durableConsumerAttached(fast));
+  REQUIRE_EQUALS(buffer.durableBegin(), 80);
+  REQUIRE_EQUALS(logger.capturedLogs().size(), 1);
+  REQUIRE_EQUALS(logger.capturedLogs()[0].level, "WARN");
+}
+
+TEST_CASE("Test retaining the head of output buffer", "[OutputBuffer]") {
+  for (OutputBufferReadMode readMode: {LOCKED_READ, OPTIMISTIC_READ}) {
+    OutputBuffer buffer(100, 10, readMode);
+    buffer.setHeadRetention(30);
+    REQUIRE_EQUALS(buffer.headRetention(), 30);
+    std::vector<Byte> payload = bytesRange(0, 250);
+    buffer.write(payload.data(), 20);
+    REQUIRE_EQUALS(buffer.headSize(), 20);
+    buffer.write(payload.data() + 20, 230);
+    REQUIRE_EQUALS(buffer.headSize(), 30);
+    REQUIRE_EQUALS(buffer.retainedBegin(), 150);
+
+    // the head is read as-is, and then the gap is skipped to the tail
+    Byte target[200];
+    ReadResult result = buffer.tryRead(10, target, 200);
+    REQUIRE_EQUALS(result.begin, 10);
+    REQUIRE_EQUALS(result.count, 20);
+    REQUIRE(memcmp(target, payload.data() + 10, 20) == 0);
+    result = buffer.tryRead(30, target, 200);
+    REQUIRE_EQUALS(result.begin, 150);
+    REQUIRE_EQUALS(result.count, 100);
+    REQUIRE(memcmp(target, payload.data() + 150, 100) == 0);
+
+    // views of the head are never overwritten
+    OutputView view = buffer.peek(0, 100);
+    REQUIRE_EQUALS(view.begin, 0);
+    REQUIRE_EQUALS(view.count, 30);
+    buffer.write(payload.data(), 200);
+    REQUIRE(buffer.isIntact(view));
+    REQUIRE(memcmp(view.segments[0].iov_base, payload.data(), 30) == 0);
+    REQUIRE_THROWS_AS(buffer.setHeadRetention(10), Poco::IllegalStateException);
+  }
+}
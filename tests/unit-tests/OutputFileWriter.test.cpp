@@ -0,0 +1,85 @@
+#include <sstream>
+#include <string>
+#include <Poco/FileStream.h>
+#include <Poco/TemporaryFile.h>
+#include <catch2/catch.hpp>
+#include "src/OutputArchive.h"
+#include "src/OutputFileWriter.h"
+#include "macros.h"
+#include "CapturingLogger.h"
+
+TEST_CASE("Test saving the output of a lossless buffer", "[OutputFileWriter]") {
+  Poco::TemporaryFile file;
+  OutputBuffer buffer(100, 10);
+  buffer.setLossless(true);
+  std::string expected;
+  {
+    OutputFileWriter writer(&buffer, file.path(), 16);
+    writer.start();
+
+    // far more output than the buffer capacity
+    for (int i=0; i<1000; ++i) {
+      std::string line = std::to_string(i) + "\n";
+      buffer.write(line.data(), line.size());
+      expected += line;
+    }
+    buffer.close();
+    writer.join();
+    REQUIRE_FALSE(writer.failed());
+    REQUIRE_EQUALS(writer.savedBytes(), expected.size());
+  }
+  REQUIRE_EQUALS(buffer.durableBegin(), expected.size());
+
+  std::ostringstream content;
+  Poco::FileInputStream in(file.path());
+  content << in.rdbuf();
+  REQUIRE_EQUALS(content.str(), expected);
+}
+
+TEST_CASE("Test failing to save the output of a lossless buffer", "[OutputFileWriter]") {
+  CapturingLogger logger; Logger::ScopedRootLogger scopedRootLogger(&logger);
+  Poco::TemporaryFile dir;
+  dir.createDirectories();
+  OutputBuffer buffer(100, 10);
+  buffer.setLossless(true);
+
+  // the writer detaches from the buffer, so that the output is no longer blocked
+  OutputFileWriter writer(&buffer, dir.path() + "/not-exist/output.log");
+  writer.start();
+  std::string payload(1000, 'x');
+  buffer.write(payload.data(), payload.size());
+  buffer.close();
+  writer.join();
+  REQUIRE(writer.failed());
+  REQUIRE_EQUALS(buffer.durableBegin(), buffer.writtenBytes());
+  REQUIRE_EQUALS(logger.capturedLogs().size(), 1);
+  REQUIRE_EQUALS(logger.capturedLogs()[0].level, "ERROR");
+}
+
+TEST_CASE("Test saving the output into an archive", "[OutputFileWriter]") {
+  CapturingLogger logger; Logger::ScopedRootLogger scopedRootLogger(&logger);
+  Poco::TemporaryFile file;
+  OutputBuffer buffer(100, 10);
+  std::string expected;
+  {
+    OutputFileWriter writer(&buffer, file.path(), 16, true);
+    writer.start();
+
+    // the writer holds the buffer back as a retention hint, but does not block it
+    for (int i=0; i<1000; ++i) {
+      std::string line = std::to_string(i) + "\n";
+      buffer.write(line.data(), line.size());
+      expected += line;
+    }
+    buffer.close();
+    writer.join();
+    REQUIRE_FALSE(writer.failed());
+    REQUIRE_EQUALS(writer.savedBytes() + writer.discardedBytes(), expected.size());
+    REQUIRE(writer.fileSize() > 0);
+  }
+
+  OutputArchiveReader reader(file.path());
+  REQUIRE(reader.complete());
+  REQUIRE_EQUALS(reader.end(), expected.size());
+  REQUIRE_EQUALS(reader.read(expected.size() - 8, 8), "998\n999\n");
+}
@@ -0,0 +1,160 @@
+#include <string.h>
+#include <random>
+#include <string>
+#include <vector>
+#include <Poco/Format.h>
+#include <Poco/RegularExpression.h>
+#include <catch2/catch.hpp>
+#include "src/OutputSearcher.h"
+#include "macros.h"
+
+namespace {
+  std::vector<SearchMatch> searchAll(OutputSearcher &searcher, size_t maxMatches=0) {
+    std::vector<SearchMatch> matches;
+    searcher.search([&matches] (SearchMatch const& match) {
+      matches.push_back(match);
+      return true;
+    }, maxMatches);
+    return matches;
+  }
+
+  void writeString(OutputBuffer &buffer, std::string const& s) {
+    buffer.write(s.data(), s.size());
+  }
+}
+
+TEST_CASE("Test finding literals", "[OutputSearcher]") {
+  std::mt19937 rng(1234);
+  std::uniform_int_distribution<int> dist('a', 'c');
+  for (size_t n: {0, 1, 15, 16, 17, 100, 1000}) {
+    std::string data;
+    for (size_t i=0; i<n; ++i) {
+      data += (char)dist(rng);
+    }
+    for (std::string literal: {"a", "ab", "abc", "cabac", "abcabcabcabcabcabcab"}) {
+      const char *found = OutputSearcher::findLiteral(data.data(), data.size(), literal);
+      size_t expected = data.find(literal);
+      if (expected == std::string::npos) {
+        REQUIRE(found == nullptr);
+      } else {
+        REQUIRE_EQUALS((size_t)(found - data.data()), expected);
+      }
+    }
+  }
+}
+
+TEST_CASE("Test extracting required literals", "[OutputSearcher]") {
+  REQUIRE_EQUALS(OutputSearcher::requiredLiteral("Traceback"), "Traceback");
+  REQUIRE_EQUALS(OutputSearcher::requiredLiteral("loss = nan"), "loss = nan");
+  REQUIRE_EQUALS(OutputSearcher::requiredLiteral("^epoch \\d+: loss = "), ": loss = ");
+  REQUIRE_EQUALS(OutputSearcher::requiredLiteral("errors?: [0-9]+ failed"), " failed");
+  REQUIRE_EQUALS(OutputSearcher::requiredLiteral("a\\.b\\.c*"), "a.b.");
+  REQUIRE_EQUALS(OutputSearcher::requiredLiteral("(Error|Warning): disk"), ": disk");
+  REQUIRE_EQUALS(OutputSearcher::requiredLiteral("Error|Warning"), "");
+  REQUIRE_EQUALS(OutputSearcher::requiredLiteral("(?i)error"), "");
+}
+
+TEST_CASE("Test searching the output", "[OutputSearcher]") {
+  OutputBuffer buffer(1024 * 1024);
+  for (int i=0; i<1000; ++i) {
+    writeString(buffer, Poco::format("step %d, loss = %s\n", i, std::string(i % 100 == 7 ? "nan" : "0.5")));
+  }
+  writeString(buffer, "Traceback (most recent call last):");
+
+  // literal search, with chunks smaller than the output
+  OutputSearcher literalSearcher(&buffer, "nan", "", 100);
+  std::vector<SearchMatch> matches = searchAll(literalSearcher);
+  REQUIRE_EQUALS(matches.size(), 10);
+  for (size_t i=0; i<matches.size(); ++i) {
+    REQUIRE_EQUALS(matches[i].line, i * 100 + 7);
+    REQUIRE_EQUALS(matches[i].text, Poco::format("step %z, loss = nan", i * 100 + 7));
+    REQUIRE_EQUALS(matches[i].offset, buffer.lines(matches[i].line).begin + matches[i].text.size() - 3);
+  }
+  REQUIRE_EQUALS(searchAll(literalSearcher, 3).size(), 3);
+
+  // the last line is searched even if not terminated
+  OutputSearcher tracebackSearcher(&buffer, "Traceback", "");
+  matches = searchAll(tracebackSearcher);
+  REQUIRE_EQUALS(matches.size(), 1);
+  REQUIRE_EQUALS(matches[0].line, 1000);
+  REQUIRE_EQUALS(matches[0].offset, buffer.writtenBytes() - 34);
+
+  // regex search, prefiltered by the required literal
+  OutputSearcher regexSearcher(&buffer, "", "step 9\\d7, loss");
+  REQUIRE_EQUALS(regexSearcher.literal(), "7, loss");
+  matches = searchAll(regexSearcher);
+  REQUIRE_EQUALS(matches.size(), 10);
+  REQUIRE_EQUALS(matches[0].text, "step 907, loss = nan");
+  REQUIRE_EQUALS(matches[1].text, "step 917, loss = 0.5");
+  REQUIRE_EQUALS(matches[0].offset, buffer.lines(907).begin);
+
+  // regex search with alternatives
+  OutputSearcher alternativeSearcher(&buffer, "", "^step (5|6)00,");
+  REQUIRE_EQUALS(alternativeSearcher.literal(), "step ");
+  matches = searchAll(alternativeSearcher);
+  REQUIRE_EQUALS(matches.size(), 2);
+  REQUIRE_EQUALS(matches[0].line, 500);
+  REQUIRE_EQUALS(matches[1].line, 600);
+
+  // regex search without any literal
+  OutputSearcher noLiteralSearcher(&buffer, "", "5,|^T");
+  REQUIRE(noLiteralSearcher.literal().empty());
+  REQUIRE_EQUALS(searchAll(noLiteralSearcher).size(), 101);
+
+  // both literal and regex
+  OutputSearcher bothSearcher(&buffer, "nan", "step [0-4]");
+  REQUIRE_EQUALS(searchAll(bothSearcher).size(), 4);
+
+  REQUIRE_THROWS_AS(OutputSearcher(&buffer, "", "(unclosed"), Poco::RegularExpressionException);
+}
+
+TEST_CASE("Test searching a line longer than the chunks", "[OutputSearcher]") {
+  OutputBuffer buffer(1024 * 1024);
+  std::string longLine(1000, 'x');
+  for (size_t offset: {191, 292, 396, 593}) {
+    longLine.replace(offset, 6, "needle");
+  }
+  writeString(buffer, "first\n" + longLine + "\nlast needle\n");
+
+  // the literals crossing the boundaries of the chunks are found exactly once
+  OutputSearcher searcher(&buffer, "needle", "", 100);
+  std::vector<SearchMatch> matches = searchAll(searcher);
+  REQUIRE_EQUALS(matches.size(), 5);
+  size_t expected[] = {6 + 191, 6 + 292, 6 + 396, 6 + 593, 6 + 1001 + 5};
+  for (size_t i=0; i<matches.size(); ++i) {
+    REQUIRE_EQUALS(matches[i].offset, expected[i]);
+    REQUIRE_EQUALS(matches[i].line, i < 4 ? 1 : 2);
+  }
+}
+
+TEST_CASE("Test searching the output with evicted lines", "[OutputSearcher]") {
+  OutputBuffer buffer(100, 100);
+  for (int i=0; i<20; ++i) {
+    writeString(buffer, Poco::format("line %d\n", i));
+  }
+
+  // the first retained line is 8, since the beginning of line 7 has been evicted
+  OutputSearcher searcher(&buffer, "line", "", 16);
+  std::vector<SearchMatch> matches = searchAll(searcher);
+  REQUIRE_EQUALS(buffer.lines(0).line, 8);
+  REQUIRE_EQUALS(matches.size(), 12);
+  for (size_t i=0; i<matches.size(); ++i) {
+    REQUIRE_EQUALS(matches[i].line, i + 8);
+    REQUIRE_EQUALS(matches[i].text, Poco::format("line %z", i + 8));
+  }
+
+  // output written during the scan evicts the lines not yet searched
+  std::vector<SearchMatch> partial;
+  searcher.search([&] (SearchMatch const& match) {
+    partial.push_back(match);
+    if (partial.size() == 1) {
+      writeString(buffer, "line 20\nline 21\nline 22\nline 23\nline 24\nline 25\n");
+    }
+    return true;
+  });
+  REQUIRE(partial.size() < 12);
+  for (size_t i=1; i<partial.size(); ++i) {
+    REQUIRE(partial[i].line > partial[i - 1].line);
+    REQUIRE_EQUALS(partial[i].text, Poco::format("line %z", partial[i].line));
+  }
+}
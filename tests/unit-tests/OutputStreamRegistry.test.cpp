@@ -0,0 +1,135 @@
+#include <string>
+#include <vector>
+#include <Poco/Exception.h>
+#include <Poco/Thread.h>
+#include <catch2/catch.hpp>
+#include "src/OutputStreamRegistry.h"
+#include "macros.h"
+
+namespace {
+  void write(OutputBuffer &buffer, size_t count) {
+    std::string s(count, 'x');
+    buffer.write(s.data(), s.size());
+  }
+}
+
+TEST_CASE("Test sharing the budget by reservations", "[OutputStreamRegistry]") {
+  OutputBuffer main(1000, 10), error(1000, 10);
+  OutputStreamRegistry streams(1000, 100);
+  streams.add("main", &main, 1, 800);
+  REQUIRE_EQUALS(streams.get("main"), &main);
+  REQUIRE(streams.get("stderr") == nullptr);
+
+  // the only stream takes the whole budget
+  REQUIRE_EQUALS(main.capacityLimit(), 1000);
+  REQUIRE_THROWS_AS(streams.add("main", &error), Poco::ExistsException);
+
+  // busy streams keep their reservations
+  streams.add("stderr", &error, 1, 200);
+  write(main, 2000);
+  write(error, 2000);
+  streams.rebalance();
+  REQUIRE_EQUALS(main.capacityLimit(), 800);
+  REQUIRE_EQUALS(error.capacityLimit(), 200);
+  write(main, 2000);
+  write(error, 2000);
+  REQUIRE_EQUALS(main.size(), 800);
+  REQUIRE_EQUALS(error.size(), 200);
+
+  std::vector<OutputStreamInfo> list = streams.list();
+  REQUIRE_EQUALS(list.size(), 2);
+  REQUIRE_EQUALS(list[0].name, "main");
+  REQUIRE_EQUALS(list[1].name, "stderr");
+  REQUIRE_EQUALS(list[1].reserved, 200);
+  REQUIRE_EQUALS(list[1].writtenBytes, 4000);
+  REQUIRE_FALSE(list[1].closed);
+}
+
+TEST_CASE("Test lending the unused budget", "[OutputStreamRegistry]") {
+  OutputBuffer main(1000, 10), error(1000, 10);
+  OutputStreamRegistry streams(1000, 50);
+  streams.add("main", &main, 1, 500);
+  streams.add("stderr", &error, 1, 500);
+
+  // a quiet stream only keeps room for its growth, and lends the rest
+  write(main, 2000);
+  write(error, 30);
+  streams.rebalance();
+  REQUIRE_EQUALS(error.capacityLimit(), 60);
+  REQUIRE_EQUALS(main.capacityLimit(), 940);
+
+  // a closed stream only keeps what it has retained
+  error.close();
+  streams.rebalance();
+  REQUIRE_EQUALS(error.capacityLimit(), 30);
+  REQUIRE_EQUALS(error.size(), 30);
+  REQUIRE_EQUALS(main.capacityLimit(), 970);
+}
+
+TEST_CASE("Test pinning the streams which hold their memory", "[OutputStreamRegistry]") {
+  OutputBuffer main(1000, 10, LOCKED_READ, MALLOC_STORE), error(1000, 10);
+  REQUIRE_FALSE(main.releasesMemory());
+  REQUIRE(error.releasesMemory());
+  OutputStreamRegistry streams(1000, 100);
+  streams.add("main", &main, 1, 300);
+  streams.add("stderr", &error, 1, 200);
+
+  // the malloc ring never grows beyond its reservation, and the rest goes to the other stream
+  write(main, 2000);
+  write(error, 2000);
+  for (int i=0; i<10; ++i) {
+    streams.recordRead("main");
+  }
+  streams.rebalance();
+  REQUIRE_EQUALS(main.capacityLimit(), 300);
+  REQUIRE_EQUALS(main.ringCapacity(), 300);
+  REQUIRE_EQUALS(main.size(), 300);
+  REQUIRE_EQUALS(error.capacityLimit(), 700);
+}
+
+TEST_CASE("Test sharing the spare budget by priority and reads", "[OutputStreamRegistry]") {
+  OutputBuffer first(1000, 10), second(1000, 10), third(1000, 10);
+  OutputStreamRegistry streams(1000, 100);
+  streams.add("first", &first, 1);
+  streams.add("second", &second, 3);
+  write(first, 2000);
+  write(second, 2000);
+  streams.rebalance();
+  REQUIRE_EQUALS(first.capacityLimit(), 300);
+  REQUIRE_EQUALS(second.capacityLimit(), 700);
+
+  // the streams being read take a larger share
+  streams.add("third", &third, 1);
+  write(third, 2000);
+  Poco::Thread::sleep(100);
+  for (int i=0; i<100; ++i) {
+    streams.recordRead("third");
+  }
+  streams.recordRead("unknown");
+  streams.rebalance();
+  REQUIRE(third.capacityLimit() > second.capacityLimit());
+  REQUIRE(second.capacityLimit() > first.capacityLimit());
+  REQUIRE(first.capacityLimit() + second.capacityLimit() + third.capacityLimit() <= 1000);
+  REQUIRE_EQUALS(streams.list()[2].reads, 100);
+}
+
+TEST_CASE("Test the output stream arbiter", "[OutputStreamRegistry]") {
+  OutputBuffer main(1000, 10), runAfter(1000, 10);
+  OutputStreamRegistry streams(1000, 100);
+  streams.add("main", &main, 1, 600);
+  write(main, 2000);
+  main.close();
+  streams.start(10);
+  REQUIRE_THROWS_AS(streams.start(10), Poco::IllegalStateException);
+
+  // a late stream takes the spare budget, while the closed stream keeps its reservation
+  streams.add("run-after", &runAfter);
+  REQUIRE_EQUALS(runAfter.capacityLimit(), 100);
+  REQUIRE_EQUALS(main.capacityLimit(), 900);
+  write(runAfter, 500);
+  Poco::Thread::sleep(100);
+  REQUIRE_EQUALS(runAfter.capacityLimit(), 250);
+  REQUIRE_EQUALS(main.capacityLimit(), 750);
+  REQUIRE_EQUALS(main.size(), 750);
+  streams.stop();
+}
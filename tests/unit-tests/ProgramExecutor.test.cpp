@@ -5,12 +5,14 @@
 #include <unistd.h>
 #include <signal.h>
 #include <string>
+#include <Poco/Exception.h>
 #include <Poco/Thread.h>
 #include <catch2/catch.hpp>
 #include <src/Logger.h>
 #include <src/AutoFreePtr.h>
 #include "src/OutputBuffer.h"
 #include "src/ProgramExecutor.h"
+#include "src/IOController.h"
 #include "CapturingLogger.h"
 #include "macros.h"
 
@@ -74,6 +76,52 @@ TEST_CASE("Test capturing stderr.", "[ProgramExecutor]") {
   REQUIRE_OUTPUT_EQUALS(output, "stdout\nstderr\n");
 }
 
+TEST_CASE("Test capturing stderr by a separated pipe.", "[ProgramExecutor]") {
+  CAPTURE_LOGGING();
+  std::vector<Byte> output, error;
+  ProgramExecutor executor({"sh", "-c", "echo stdout; (>&2 echo \"stderr\")"}, {}, "", true, "Program", true);
+  REQUIRE(executor.separateStderr());
+  executor.start();
+  Poco::Thread errorThread;
+  errorThread.startFunc([&executor, &error] () {
+    Byte buffer[256];
+    ssize_t bytesRead;
+    while ((bytesRead = executor.readError(buffer, sizeof(buffer))) > 0) {
+      error.insert(error.end(), buffer, buffer + bytesRead);
+    }
+  });
+  runExecutor(&executor, &output);
+  errorThread.join();
+  REQUIRE_EQUALS(executor.status(), EXITED);
+  REQUIRE_OUTPUT_EQUALS(output, "stdout\n");
+  REQUIRE_OUTPUT_EQUALS(error, "stderr\n");
+}
+
+TEST_CASE("Test capturing extra outputs by their own pipes.", "[ProgramExecutor]") {
+  CAPTURE_LOGGING();
+  ProgramExecutor executor({"sh", "-c", "echo stdout; echo metrics >&3; echo events >&5"});
+  REQUIRE_THROWS_AS(executor.setExtraOutputs({2}), Poco::InvalidArgumentException);
+  executor.setExtraOutputs({5, 3});
+  REQUIRE_EQUALS(executor.extraOutputs().size(), 2);
+  OutputBuffer output(1024), events(1024), metrics(1024);
+  IOController ioController(&executor, &output);
+  ioController.setExtraBuffers({&events, &metrics});
+  executor.start();
+  ioController.start();
+  REQUIRE(executor.wait());
+  ioController.join();
+  REQUIRE_EQUALS(executor.status(), EXITED);
+  REQUIRE_THROWS_AS(executor.setExtraOutputs({3}), Poco::IllegalStateException);
+
+  Byte buffer[256];
+  ReadResult result = output.tryRead(0, buffer, sizeof(buffer));
+  REQUIRE_EQUALS(std::string((char*)buffer, result.count), "stdout\n");
+  result = events.tryRead(0, buffer, sizeof(buffer));
+  REQUIRE_EQUALS(std::string((char*)buffer, result.count), "events\n");
+  result = metrics.tryRead(0, buffer, sizeof(buffer));
+  REQUIRE_EQUALS(std::string((char*)buffer, result.count), "metrics\n");
+}
+
 TEST_CASE("Test exit with non-zero code.", "[ProgramExecutor]") {
   CAPTURE_LOGGING();
   std::vector<Byte> output;
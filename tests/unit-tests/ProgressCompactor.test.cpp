@@ -0,0 +1,129 @@
+#include <string>
+#include <catch2/catch.hpp>
+#include "src/ProgressCompactor.h"
+#include "src/IOController.h"
+#include "CapturingLogger.h"
+#include "macros.h"
+
+namespace {
+  class StringSink {
+  public:
+    std::string output;
+    size_t callCount = 0;
+
+    ProgressCompactor::Sink sink() {
+      return [this] (const Byte *data, size_t count) {
+        output.append((const char*)data, count);
+        ++callCount;
+      };
+    }
+  };
+
+  void write(ProgressCompactor &compactor, std::string const& s, int64_t now) {
+    compactor.write((const Byte*)s.data(), s.size(), now);
+  }
+}
+
+TEST_CASE("Test compacting progress bars", "[ProgressCompactor]") {
+  StringSink sink;
+  ProgressCompactor compactor(sink.sink(), 1000);
+
+  // ordinary output passes through as-is
+  write(compactor, "hello\n", 0);
+  REQUIRE_EQUALS(sink.output, "hello\n");
+
+  // the first redraw is kept, the others within the interval are dropped
+  write(compactor, "epoch 1\r10%\r20%", 100);
+  REQUIRE_EQUALS(sink.output, "hello\nepoch 1\r10%");
+  write(compactor, "\r30%\r40%\r", 500);
+  REQUIRE_EQUALS(sink.output, "hello\nepoch 1\r10%");
+
+  // a redraw completed after the interval is kept
+  write(compactor, "50%\r", 1100);
+  REQUIRE_EQUALS(sink.output, "hello\nepoch 1\r10%\r50%");
+
+  // the final state of the line is always kept
+  write(compactor, "60%\r100%\ndone\n", 1200);
+  REQUIRE_EQUALS(sink.output, "hello\nepoch 1\r10%\r50%\r100%\ndone\n");
+  REQUIRE_EQUALS(compactor.inputBytes(), 48);
+  REQUIRE_EQUALS(compactor.outputBytes(), sink.output.size());
+  REQUIRE_EQUALS(compactor.savedBytes(), 48 - sink.output.size());
+
+  // "\r\n" is just a newline, even across chunks
+  write(compactor, "windows\r", 1300);
+  write(compactor, "\nline\r\n", 1300);
+  REQUIRE_EQUALS(sink.output, "hello\nepoch 1\r10%\r50%\r100%\ndone\nwindows\r\nline\r\n");
+}
+
+TEST_CASE("Test flushing the compacted progress bar", "[ProgressCompactor]") {
+  StringSink sink;
+  ProgressCompactor compactor(sink.sink(), 1000);
+  write(compactor, "\r10%\r20%", 0);
+  REQUIRE_EQUALS(sink.output, "\r10%");
+
+  // the held redraw is not stale yet
+  compactor.flushIfStale(500);
+  REQUIRE_EQUALS(sink.output, "\r10%");
+
+  // the stale redraw is passed on, and the rest of it passes through
+  compactor.flushIfStale(1000);
+  REQUIRE_EQUALS(sink.output, "\r10%\r20%");
+  write(compactor, "|###", 1100);
+  REQUIRE_EQUALS(sink.output, "\r10%\r20%|###");
+
+  // the next redraw within the interval is dropped, and flushed at the end
+  write(compactor, "\r30%\r40%", 1200);
+  REQUIRE_EQUALS(sink.output, "\r10%\r20%|###");
+  compactor.flush();
+  REQUIRE_EQUALS(sink.output, "\r10%\r20%|###\r40%");
+  REQUIRE_EQUALS(compactor.savedBytes(), 4);
+
+  // nothing is held any more
+  size_t callCount = sink.callCount;
+  compactor.flush();
+  REQUIRE_EQUALS(sink.callCount, callCount);
+}
+
+TEST_CASE("Test capping the held redraw", "[ProgressCompactor]") {
+  StringSink sink;
+  ProgressCompactor compactor(sink.sink(), 1000, 16);
+  write(compactor, "\r10%\r", 0);
+  REQUIRE_EQUALS(sink.output, "\r10%");
+
+  // a long line with no newline is held only up to the cap, even if the program never goes quiet
+  std::string line(10, 'x');
+  write(compactor, line, 100);
+  REQUIRE_EQUALS(sink.output, "\r10%");
+  write(compactor, line, 200);
+  REQUIRE_EQUALS(sink.output, "\r10%\r" + line + line);
+
+  // the rest of it passes through, until the next carriage return
+  write(compactor, line + "\r20%", 300);
+  REQUIRE_EQUALS(sink.output, "\r10%\r" + line + line + line);
+  compactor.flush();
+  REQUIRE_EQUALS(sink.output, "\r10%\r" + line + line + line + "\r20%");
+  REQUIRE_EQUALS(compactor.savedBytes(), 0);
+}
+
+TEST_CASE("Test compacting the program output", "[ProgressCompactor]") {
+  CapturingLogger logger; Logger::ScopedRootLogger scopedRootLogger(&logger);
+  ProgramExecutor executor({"sh", "-c", "for i in 1 2 3 4 5 6 7 8 9; do printf '\\r%s0%%' $i; done; echo; echo ok"});
+  OutputBuffer buffer(1024);
+  {
+    IOController ioController(&executor, &buffer, nullptr, true);
+    executor.start();
+    ioController.start();
+    REQUIRE(executor.wait());
+    ioController.join();
+    REQUIRE(ioController.compactedBytes() > 0);
+  }
+  buffer.close();
+
+  // the latest state of the progress bar must be kept
+  char output[1024];
+  ReadResult result = buffer.read(0, output, sizeof(output));
+  std::string s(output, result.count);
+  REQUIRE(s.size() < 33);
+  REQUIRE(s.find("\r90%\nok\n") != std::string::npos);
+  REQUIRE_EQUALS(s.substr(0, 4), "\r10%");
+}
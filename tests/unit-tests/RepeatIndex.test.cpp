@@ -0,0 +1,141 @@
+#include <string>
+#include <catch2/catch.hpp>
+#include "src/RepeatIndex.h"
+#include "src/OutputBuffer.h"
+#include "macros.h"
+
+TEST_CASE("Test repeat index", "[RepeatIndex]") {
+  RepeatIndex index;
+  std::string marker = RepeatIndex::marker(3);
+  REQUIRE_EQUALS(marker, "[repeated 3 more times]\n");
+  REQUIRE_EQUALS(index.position(REPEATS_MARKER, 10), 10);
+
+  // stored: "a\nxy\nb\n", with 3 more "a\n" after position 2, and 1 more "b\n" after position 7
+  index.append(2, "a\n", 3);
+  index.append(7, "b\n", 1);
+  REQUIRE_EQUALS(index.recordCount(), 2);
+  REQUIRE_EQUALS(index.repeatedLines(), 4);
+  REQUIRE_EQUALS(index.repeatedBytes(), 8);
+  REQUIRE_EQUALS(index.extraBytes(REPEATS_EXPANDED), 8);
+  REQUIRE_EQUALS(index.extraBytes(REPEATS_MARKER), marker.size() + RepeatIndex::marker(1).size());
+
+  // expanded: "a\n" "a\na\na\n" "xy\nb\n" "b\n"
+  REQUIRE_EQUALS(index.position(REPEATS_EXPANDED, 0), 0);
+  REQUIRE_EQUALS(index.position(REPEATS_EXPANDED, 1), 1);
+  REQUIRE_EQUALS(index.position(REPEATS_EXPANDED, 2), 8);
+  REQUIRE_EQUALS(index.position(REPEATS_EXPANDED, 7), 15);
+  RepeatSpan span = index.locate(REPEATS_EXPANDED, 0, 100);
+  REQUIRE_FALSE(span.synthesized);
+  REQUIRE_EQUALS(span.storedBegin, 0);
+  REQUIRE_EQUALS(span.length, 2);
+  span = index.locate(REPEATS_EXPANDED, 3, 100);
+  REQUIRE(span.synthesized);
+  REQUIRE_EQUALS(span.storedBegin, 2);
+  REQUIRE_EQUALS(span.content, "\na\na\n");
+  span = index.locate(REPEATS_EXPANDED, 3, 2);
+  REQUIRE_EQUALS(span.content, "\na");
+  span = index.locate(REPEATS_EXPANDED, 9, 100);
+  REQUIRE_FALSE(span.synthesized);
+  REQUIRE_EQUALS(span.storedBegin, 3);
+  REQUIRE_EQUALS(span.length, 4);
+  span = index.locate(REPEATS_EXPANDED, 14, 100);
+  REQUIRE_EQUALS(span.content, "\n");
+  span = index.locate(REPEATS_EXPANDED, 15, 100);
+  REQUIRE_FALSE(span.synthesized);
+  REQUIRE_EQUALS(span.storedBegin, 7);
+  REQUIRE_EQUALS(span.length, 0);
+
+  // marker: "a\n" marker "xy\nb\n" marker
+  size_t afterMarker = 2 + marker.size();
+  span = index.locate(REPEATS_MARKER, 2, 100);
+  REQUIRE(span.synthesized);
+  REQUIRE_EQUALS(span.content, marker);
+  span = index.locate(REPEATS_MARKER, afterMarker, 100);
+  REQUIRE_EQUALS(span.storedBegin, 2);
+  REQUIRE_EQUALS(span.length, 5);
+  REQUIRE_EQUALS(index.position(REPEATS_MARKER, 7), afterMarker + 5 + RepeatIndex::marker(1).size());
+
+  // trimmed records are still counted in the positions
+  index.trim(3);
+  REQUIRE_EQUALS(index.recordCount(), 1);
+  REQUIRE_EQUALS(index.position(REPEATS_EXPANDED, 3), 9);
+  span = index.locate(REPEATS_EXPANDED, 9, 100);
+  REQUIRE_EQUALS(span.storedBegin, 3);
+  REQUIRE_EQUALS(span.length, 4);
+
+  // records are dropped to fit in the memory, but never those after the limit
+  size_t memoryBytes = index.memoryBytes();
+  index.append(20, "c\n", 2);
+  REQUIRE(index.memoryBytes() > memoryBytes);
+  index.fit(0, 10);
+  REQUIRE_EQUALS(index.recordCount(), 1);
+  REQUIRE_EQUALS(index.memoryBytes(), memoryBytes);
+  REQUIRE_EQUALS(index.position(REPEATS_EXPANDED, 20), 20 + 8 + 4);
+}
+
+namespace {
+  std::string readAll(OutputBuffer &buffer) {
+    std::string ret(buffer.writtenBytes(), '\0');
+    ReadResult result = buffer.tryRead(0, &ret[0], ret.size());
+    ret.resize(result.count);
+    return ret;
+  }
+
+  std::string readRepeats(OutputBuffer &buffer, RepeatMode mode) {
+    std::string ret;
+    size_t position = 0, end = buffer.repeatWrittenBytes(mode);
+    while (position < end) {
+      RepeatSpan span = buffer.repeatSpan(mode, position, 3);
+      if (span.synthesized) {
+        ret += span.content;
+        position += span.content.size();
+      } else {
+        std::string stored(span.length > 0 ? span.length : buffer.writtenBytes() - span.storedBegin, '\0');
+        ReadResult result = buffer.tryRead(span.storedBegin, &stored[0], stored.size());
+        ret += stored.substr(0, result.count);
+        position += result.count;
+      }
+    }
+    return ret;
+  }
+
+  void write(OutputBuffer &buffer, std::string const& s, ProgramStream stream = STDOUT_STREAM) {
+    buffer.write(s.data(), s.size(), stream);
+  }
+}
+
+TEST_CASE("Test deduplicating lines in output buffer", "[RepeatIndex]") {
+  OutputBuffer buffer(1024);
+  buffer.setDeduplicateLines(true);
+  REQUIRE(buffer.deduplicateLines());
+
+  // repeats are held back, even if split across writes
+  write(buffer, "hello\nwarn\nwarn\nwa");
+  REQUIRE_EQUALS(readAll(buffer), "hello\nwarn\n");
+  write(buffer, "rn\nwarn\n");
+  REQUIRE_EQUALS(readAll(buffer), "hello\nwarn\n");
+  REQUIRE_EQUALS(buffer.repeatedLines(), 3);
+  REQUIRE_EQUALS(buffer.repeatWrittenBytes(REPEATS_EXPANDED), 11);
+
+  // a different line ends the run, and a partial match is not a repeat
+  write(buffer, "war");
+  write(buffer, "ning\n");
+  REQUIRE_EQUALS(readAll(buffer), "hello\nwarn\nwarning\n");
+  REQUIRE_EQUALS(readRepeats(buffer, REPEATS_EXPANDED), "hello\nwarn\nwarn\nwarn\nwarn\nwarning\n");
+  REQUIRE_EQUALS(readRepeats(buffer, REPEATS_MARKER), "hello\nwarn\n[repeated 3 more times]\nwarning\n");
+  REQUIRE_EQUALS(buffer.repeatPosition(REPEATS_EXPANDED, 11), 26);
+
+  // identical lines from another stream are not repeats
+  write(buffer, "warning\n", STDERR_STREAM);
+  REQUIRE_EQUALS(readAll(buffer), "hello\nwarn\nwarning\nwarning\n");
+  REQUIRE_EQUALS(buffer.streamWrittenBytes(STDERR_STREAM), 8);
+
+  // the run at the end is recorded on close
+  write(buffer, "warning\nwarning\nwarn", STDERR_STREAM);
+  buffer.close();
+  REQUIRE_EQUALS(readAll(buffer), "hello\nwarn\nwarning\nwarning\nwarn");
+  REQUIRE_EQUALS(readRepeats(buffer, REPEATS_MARKER),
+                 "hello\nwarn\n[repeated 3 more times]\nwarning\nwarning\n[repeated 2 more times]\nwarn");
+  REQUIRE_EQUALS(buffer.repeatedLines(), 5);
+  REQUIRE_EQUALS(buffer.repeatedBytes(), 15 + 16);
+}
@@ -0,0 +1,222 @@
+#include <fcntl.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <string.h>
+#include <memory>
+#include <vector>
+#include <Poco/Exception.h>
+#include <Poco/File.h>
+#include <Poco/FileStream.h>
+#include <Poco/TemporaryFile.h>
+#include <catch2/catch.hpp>
+#include "src/RingStore.h"
+#include "src/OutputBuffer.h"
+#include "BytePattern.h"
+#include "macros.h"
+#include "CapturingLogger.h"
+
+TEST_CASE("Test malloc ring store", "[RingStore]") {
+  MallocRingStore store(123);
+  REQUIRE(store.data() != nullptr);
+  REQUIRE_EQUALS(store.capacity(), 123);
+  REQUIRE_FALSE(store.mirrored());
+}
+
+namespace {
+  /** Number of resident pages in the memory range. */
+  size_t residentPages(void *data, size_t size) {
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    std::vector<unsigned char> vec((size + pageSize - 1) / pageSize);
+    REQUIRE(mincore(data, size, vec.data()) == 0);
+    size_t count = 0;
+    for (unsigned char c: vec) {
+      count += c & 1;
+    }
+    return count;
+  }
+}
+
+TEST_CASE("Test reserved ring store", "[RingStore]") {
+  size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+  std::unique_ptr<ReservedRingStore> store(ReservedRingStore::create(256 * 1024 * 1024 + 1));
+  REQUIRE(store != nullptr);
+  REQUIRE_EQUALS(store->capacity(), 256 * 1024 * 1024 + 1);
+  REQUIRE_FALSE(store->mirrored());
+
+  // only the touched pages are allocated
+  Byte *data = store->data();
+  REQUIRE_EQUALS(residentPages(data, store->capacity()), 0);
+  memset(data + pageSize * 10, 'x', pageSize * 2);
+  data[store->capacity() - 1] = 'y';
+  REQUIRE_EQUALS(residentPages(data, store->capacity()), 3);
+
+  // the released pages read as zeros, and can be written again
+  store->release();
+  REQUIRE_EQUALS(residentPages(data, store->capacity()), 0);
+  REQUIRE_EQUALS(data[pageSize * 10], 0);
+  data[0] = 'z';
+  REQUIRE_EQUALS(data[0], 'z');
+
+  // only the pages entirely within the released range are given back
+  memset(data + pageSize * 10, 'x', pageSize * 3);
+  store->releaseRange(pageSize * 10 + 1, pageSize * 2);
+  REQUIRE_EQUALS(residentPages(data + pageSize * 10, pageSize * 3), 2);
+  REQUIRE_EQUALS(data[pageSize * 10], 'x');
+  REQUIRE_EQUALS(data[pageSize * 11], 0);
+  REQUIRE_EQUALS(data[pageSize * 12], 'x');
+}
+
+TEST_CASE("Test mirrored ring store", "[RingStore]") {
+  size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+  std::unique_ptr<MirroredRingStore> store(MirroredRingStore::create(pageSize + 1));
+  if (!store) {
+    WARN("Mirrored ring store is not supported on this system.");
+    return;
+  }
+
+  // the capacity should be rounded up to the page size
+  REQUIRE_EQUALS(store->capacity(), pageSize * 2);
+  REQUIRE(store->mirrored());
+
+  // writing across the end of the ring should be visible at the beginning
+  Byte *data = store->data();
+  size_t capacity = store->capacity();
+  memcpy(data + capacity - 3, "abcdef", 6);
+  REQUIRE(memcmp(data, "def", 3) == 0);
+  REQUIRE(memcmp(data + capacity - 3, "abcdef", 6) == 0);
+  data[1] = 'x';
+  REQUIRE_EQUALS(data[capacity + 1], 'x');
+
+  // the memory file is punched on release
+  store->release();
+  REQUIRE_EQUALS(residentPages(data, capacity), 0);
+  REQUIRE_EQUALS(data[1], 0);
+}
+
+TEST_CASE("Test file ring store", "[RingStore]") {
+  size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+  Poco::TemporaryFile dir;
+  dir.createDirectories();
+  std::string path = dir.path() + "/output.ring";
+
+  {
+    FileRingStore *store = FileRingStore::create(path, pageSize + 1);
+    REQUIRE(store != nullptr);
+    REQUIRE_EQUALS(store->capacity(), pageSize * 2);
+    REQUIRE_EQUALS(store->generation(), 1);
+    REQUIRE(store->mirrored());
+
+    // the file keeps up with the buffer on every write
+    OutputBuffer buffer(store);
+    REQUIRE_EQUALS(buffer.storeType(), FILE_STORE);
+    RingFileContents contents = FileRingStore::recover(path);
+    REQUIRE_EQUALS(contents.data.size(), 0);
+    size_t total = pageSize * 3 + 100;
+    std::vector<Byte> payload = pattern(0, total);
+    for (size_t i=0; i<total; i+=1000) {
+      buffer.write(payload.data() + i, std::min((size_t)1000, total - i));
+    }
+    contents = FileRingStore::recover(path);
+    REQUIRE_EQUALS(contents.generation, 1);
+    REQUIRE_FALSE(contents.closed);
+    REQUIRE_EQUALS(contents.begin, total - pageSize * 2);
+    REQUIRE(contents.data == pattern(contents.begin, pageSize * 2));
+
+    // the last output is kept in the file even when the buffer gives its memory back
+    buffer.releaseMemory();
+    contents = FileRingStore::recover(path);
+    REQUIRE_EQUALS(contents.begin, total - pageSize * 2);
+    REQUIRE(contents.data == pattern(contents.begin, pageSize * 2));
+  }
+
+  // the buffer has been closed, so the file can be overwritten by the next executor
+  RingFileContents contents = FileRingStore::recover(path);
+  REQUIRE(contents.closed);
+  REQUIRE_EQUALS(contents.data.size(), pageSize * 2);
+  std::unique_ptr<FileRingStore> store(FileRingStore::create(path, pageSize));
+  REQUIRE(store != nullptr);
+  REQUIRE_EQUALS(store->generation(), 2);
+  REQUIRE_FALSE(Poco::File(path + ".1").exists());
+  REQUIRE_EQUALS(FileRingStore::recover(path).data.size(), 0);
+}
+
+TEST_CASE("Test recovering an unclosed ring file", "[RingStore]") {
+  size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+  Poco::TemporaryFile dir;
+  dir.createDirectories();
+  std::string path = dir.path() + "/output.ring";
+
+  // the store is dropped without closing, as if the executor has died
+  {
+    std::unique_ptr<FileRingStore> store(FileRingStore::create(path, pageSize));
+    REQUIRE(store != nullptr);
+    memcpy(store->data() + pageSize - 2, "abcdef", 6);
+    store->persistPositions(pageSize - 2, 6, 106);
+
+    // the executor died while overwriting "ab"
+    store->persistValidBegin(102);
+  }
+  RingFileContents contents = FileRingStore::recover(path);
+  REQUIRE_FALSE(contents.closed);
+  REQUIRE_EQUALS(contents.begin, 102);
+  REQUIRE(std::string(contents.data.begin(), contents.data.end()) == "cdef");
+
+  // the next executor keeps the unclosed file aside
+  CapturingLogger logger; Logger::ScopedRootLogger scopedRootLogger(&logger);
+  std::unique_ptr<FileRingStore> store(FileRingStore::create(path, pageSize));
+  REQUIRE(store != nullptr);
+  REQUIRE_EQUALS(store->generation(), 2);
+  REQUIRE_EQUALS(logger.capturedLogs().size(), 1);
+  REQUIRE_EQUALS(logger.capturedLogs()[0].level, "WARN");
+  contents = FileRingStore::recover(path + ".1");
+  REQUIRE_EQUALS(contents.generation, 1);
+  REQUIRE(std::string(contents.data.begin(), contents.data.end()) == "cdef");
+
+  // files which are not ring files
+  REQUIRE_THROWS_AS(FileRingStore::recover(dir.path() + "/not-exist"), Poco::FileException);
+  {
+    Poco::FileOutputStream out(dir.path() + "/not-ring");
+    out << "hello, world!";
+  }
+  REQUIRE_THROWS_AS(FileRingStore::recover(dir.path() + "/not-ring"), Poco::DataFormatException);
+}
+
+TEST_CASE("Test recovering a ring file torn by a killed executor", "[RingStore]") {
+  size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+  Poco::TemporaryFile dir;
+  dir.createDirectories();
+  std::string path = dir.path() + "/output.ring";
+  {
+    std::unique_ptr<FileRingStore> store(FileRingStore::create(path, pageSize));
+    REQUIRE(store != nullptr);
+    memcpy(store->data(), "abcdef", 6);
+    store->persistPositions(0, 6, 6);
+    store->persistClosed();
+  }
+
+  // the executor was killed amid an update, leaving the sequence odd
+  int fd = open(path.c_str(), O_RDWR);
+  REQUIRE(fd >= 0);
+  uint64_t sequence;
+  REQUIRE_EQUALS(pread(fd, &sequence, sizeof(sequence), offsetof(RingFileHeader, sequence)), sizeof(sequence));
+  ++sequence;
+  REQUIRE_EQUALS(pwrite(fd, &sequence, sizeof(sequence), offsetof(RingFileHeader, sequence)), sizeof(sequence));
+  close(fd);
+
+  RingFileContents contents = FileRingStore::recover(path);
+  REQUIRE(contents.torn);
+  REQUIRE_FALSE(contents.closed);
+  REQUIRE_EQUALS(contents.begin, 0);
+  REQUIRE(std::string(contents.data.begin(), contents.data.end()) == "abcdef");
+
+  // the next executor starts, and keeps the torn file aside
+  CapturingLogger logger; Logger::ScopedRootLogger scopedRootLogger(&logger);
+  std::unique_ptr<FileRingStore> store(FileRingStore::create(path, pageSize));
+  REQUIRE(store != nullptr);
+  REQUIRE_EQUALS(store->generation(), 2);
+  REQUIRE(Poco::File(path + ".1").exists());
+  contents = FileRingStore::recover(path);
+  REQUIRE_FALSE(contents.torn);
+  REQUIRE_EQUALS(contents.data.size(), 0);
+}
@@ -0,0 +1,202 @@
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+#include <Poco/Exception.h>
+#include <catch2/catch.hpp>
+#include "src/SearchIndex.h"
+#include "src/OutputSearcher.h"
+#include "src/CompressedHistory.h"
+#include "src/macros.h"
+#include "macros.h"
+
+namespace {
+  /** Lines of random words over a small alphabet, such that many trigrams never occur. */
+  std::string randomLines(std::mt19937 &rng, size_t size) {
+    std::uniform_int_distribution<int> letter('a', 'h'), length(1, 8);
+    std::string ret;
+    while (ret.size() < size) {
+      for (int w=length(rng); w>0; --w) {
+        for (int n=length(rng); n>0; --n) {
+          ret += (char)letter(rng);
+        }
+        ret += ' ';
+      }
+      ret += '\n';
+    }
+    return ret;
+  }
+
+  /** Require every occurrence of {@arg literal} in {@code [begin, end)} to lie within a candidate. */
+  size_t requireCovered(SearchIndex const& index, std::string const& data, std::string const& literal,
+                        size_t begin, size_t end) {
+    std::vector<SearchCandidate> candidates = index.candidates(literal, begin, end);
+    size_t candidateBytes = 0;
+    for (size_t i=0; i<candidates.size(); ++i) {
+      REQUIRE(candidates[i].first >= begin);
+      REQUIRE(candidates[i].first < candidates[i].second);
+      REQUIRE(candidates[i].second <= end);
+      if (i > 0) {
+        REQUIRE(candidates[i - 1].second < candidates[i].first);
+      }
+      candidateBytes += candidates[i].second - candidates[i].first;
+    }
+    for (size_t p=data.find(literal, begin); p != std::string::npos && p + literal.size() <= end;
+         p=data.find(literal, p + 1)) {
+      bool covered = false;
+      for (SearchCandidate const& candidate: candidates) {
+        covered = covered || (candidate.first <= p && p + literal.size() <= candidate.second);
+      }
+      INFO("literal " << literal << " at " << p);
+      REQUIRE(covered);
+    }
+    return candidateBytes;
+  }
+}
+
+TEST_CASE("Test skipping blocks by the search index", "[SearchIndex]") {
+  std::mt19937 rng(1234);
+  std::string data = randomLines(rng, 64 * 4096);
+  data.resize(64 * 4096);
+  // plant the rare literals within the blocks, and across their boundaries
+  std::vector<std::string> literals = {"xyz", "needle-xyz", "a long needle which exceeds the tested prefix!"};
+  std::vector<size_t> offsets = {4096 * 3 + 100, 4096 * 10 - 5, 4096 * 20 - 1, 4096 * 30 - 30, 4096 * 40 + 4090};
+  for (size_t i=0; i<offsets.size(); ++i) {
+    std::string const& literal = literals[i % literals.size()];
+    data.replace(offsets[i], literal.size(), literal);
+  }
+
+  // index in chunks of all sizes
+  SearchIndex index(1024 * 1024, 4096, 1024);
+  std::uniform_int_distribution<size_t> chunkSize(1, 10000);
+  for (size_t i=0; i<data.size(); ) {
+    size_t n = std::min(chunkSize(rng), data.size() - i);
+    index.append((const Byte*)data.data() + i, n);
+    i += n;
+  }
+  REQUIRE_EQUALS(index.end(), data.size());
+  REQUIRE_EQUALS(index.statistics().blockCount, 64);
+  REQUIRE_EQUALS(index.statistics().memoryBytes, 64 * 1024);
+
+  for (std::string const& literal: literals) {
+    size_t candidateBytes = requireCovered(index, data, literal, 0, data.size());
+    REQUIRE(candidateBytes < data.size() / 8);
+  }
+  for (std::string literal: {"xy", "abc", "needle", "h\na", "zzzz"}) {
+    requireCovered(index, data, literal, 0, data.size());
+  }
+  requireCovered(index, data, "needle-xyz", 4096 * 10 - 3, 4096 * 20);
+  REQUIRE(index.candidates("xyz", 100, 100).empty());
+
+  // the output not indexed yet is never skipped
+  std::vector<SearchCandidate> candidates = index.candidates("needle", 0, data.size() + 100);
+  REQUIRE_EQUALS(candidates.back().second, data.size() + 100);
+  REQUIRE(candidates.back().first <= data.size() - 5);
+}
+
+TEST_CASE("Test bounding the search index", "[SearchIndex]") {
+  std::mt19937 rng(1234);
+  std::string data = randomLines(rng, 16 * 4096);
+  data.resize(16 * 4096);
+  data += "needle\n";
+  SearchIndex index(4 * 1024, 4096, 1024);
+  index.append((const Byte*)data.data(), data.size());
+
+  // the oldest filters are dropped beyond the memory bound, and their output is never skipped
+  SearchIndexStatistics stats = index.statistics();
+  REQUIRE_EQUALS(stats.blockCount, 4);
+  REQUIRE_EQUALS(stats.droppedBlocks, 13);
+  REQUIRE_EQUALS(stats.begin, 13 * 4096);
+  std::vector<SearchCandidate> candidates = index.candidates("needle", 0, data.size());
+  REQUIRE(candidates.front().first == 0);
+  REQUIRE(candidates.front().second >= 13 * 4096);
+  requireCovered(index, data, "needle", 0, data.size());
+
+  // the filters are dropped together with the output
+  index.trim(14 * 4096 + 1);
+  stats = index.statistics();
+  REQUIRE_EQUALS(stats.blockCount, 3);
+  REQUIRE_EQUALS(stats.droppedBlocks, 13);
+  REQUIRE_EQUALS(stats.begin, 14 * 4096);
+  index.trim(data.size());
+  REQUIRE_EQUALS(index.statistics().blockCount, 1);
+}
+
+TEST_CASE("Test searching the indexed output", "[SearchIndex]") {
+  std::mt19937 rng(1234);
+  CompressedHistory *history = new CompressedHistory(1024 * 1024);
+  OutputBuffer buffer(64 * 1024, 64 * 1024, LOCKED_READ, MALLOC_STORE, history);
+  OutputBuffer plainBuffer(64 * 1024, 64 * 1024, LOCKED_READ, MALLOC_STORE, new CompressedHistory(1024 * 1024));
+  buffer.setSearchIndexing(1024 * 1024);
+  REQUIRE(buffer.searchIndexing());
+  REQUIRE_FALSE(plainBuffer.searchIndexing());
+  for (int i=0; i<100; ++i) {
+    std::string chunk = randomLines(rng, 40000);
+    if (i % 17 == 5) {
+      chunk += "found the needle " + std::to_string(i) + "\n";
+    }
+    buffer.write(chunk.data(), chunk.size());
+    plainBuffer.write(chunk.data(), chunk.size());
+  }
+  REQUIRE_THROWS_AS(buffer.setSearchIndexing(1024), Poco::IllegalStateException);
+
+  // the index covers the history, and is trimmed with it
+  SearchIndexStatistics stats = buffer.searchIndexStatistics();
+  REQUIRE(stats.blockCount < 100 * 40000 / ML_GRIDENGINE_SEARCH_BLOCK_SIZE);
+  REQUIRE(stats.begin <= history->begin());
+  REQUIRE(stats.begin + ML_GRIDENGINE_SEARCH_BLOCK_SIZE > history->begin());
+  REQUIRE_EQUALS(stats.droppedBlocks, 0);
+
+  for (std::string query: {"needle", "needle 9", "the needle 56", "abc", "ha"}) {
+    OutputSearcher searcher(&buffer, query, "");
+    OutputSearcher plainSearcher(&plainBuffer, query, "");
+    std::vector<SearchMatch> matches, expected;
+    searcher.search([&matches] (SearchMatch const& match) { matches.push_back(match); return true; });
+    plainSearcher.search([&expected] (SearchMatch const& match) { expected.push_back(match); return true; });
+    INFO("query " << query);
+    REQUIRE_EQUALS(matches.size(), expected.size());
+    for (size_t i=0; i<matches.size(); ++i) {
+      REQUIRE_EQUALS(matches[i].offset, expected[i].offset);
+      REQUIRE_EQUALS(matches[i].line, expected[i].line);
+      REQUIRE_EQUALS(matches[i].text, expected[i].text);
+    }
+    if (query[0] == 'n') {
+      REQUIRE(matches.size() > 0);
+      REQUIRE(searcher.scannedBytes() < plainSearcher.scannedBytes() / 4);
+    }
+  }
+
+  // the lookup in small spans takes the same lines
+  LineRange all = buffer.lines(0);
+  size_t next;
+  std::vector<LineRange> ranges = buffer.searchCandidates("needle", all.begin, all.end, all.end, &next);
+  REQUIRE_EQUALS(next, all.end);
+  std::vector<size_t> lines, spanLines;
+  for (LineRange const& range: ranges) {
+    for (size_t i=0; i<range.count; ++i) {
+      lines.push_back(range.line + i);
+    }
+  }
+  for (size_t pos=all.begin; pos<all.end; ) {
+    size_t last = pos;
+    for (LineRange const& range: buffer.searchCandidates("needle", pos, all.end, 1000, &pos)) {
+      REQUIRE(range.begin >= last);
+      REQUIRE(range.end <= pos);
+      for (size_t i=0; i<range.count; ++i) {
+        if (spanLines.empty() || spanLines.back() < range.line + i) {
+          spanLines.push_back(range.line + i);
+        }
+      }
+    }
+    REQUIRE(pos > last);
+  }
+  for (size_t line: lines) {
+    REQUIRE(std::find(spanLines.begin(), spanLines.end(), line) != spanLines.end());
+  }
+
+  // the regular expressions are indexed by their required literals
+  OutputSearcher searcher(&buffer, "", "needle [0-9]+$");
+  size_t count = searcher.search([] (SearchMatch const& match) { return true; });
+  REQUIRE(count > 0);
+  REQUIRE(searcher.scannedBytes() < buffer.searchIndexStatistics().blockCount * ML_GRIDENGINE_SEARCH_BLOCK_SIZE / 4);
+}
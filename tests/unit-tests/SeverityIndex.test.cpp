@@ -0,0 +1,122 @@
+#include <string>
+#include <vector>
+#include <Poco/Exception.h>
+#include <catch2/catch.hpp>
+#include "src/SeverityIndex.h"
+#include "src/OutputBuffer.h"
+#include "macros.h"
+
+namespace {
+  void append(SeverityIndex &index, std::string const& s) {
+    index.append((const Byte*)s.data(), s.size());
+  }
+
+  const unsigned ALL = (1U << SEVERITY_COUNT) - 1;
+}
+
+TEST_CASE("Test classifying lines by severity", "[SeverityIndex]") {
+  SeverityIndex index;
+  append(index, "epoch 1\n"
+                "[12:00:00] WARNING: deprecated\n"
+                "ERROR: cannot open file\n"
+                "step 3, loss: nan\n"
+                "RuntimeError: CUDA error: out of memory\n"
+                "done\n");
+  std::vector<SeverityEntry> entries = index.entries(ALL);
+  REQUIRE_EQUALS(entries.size(), 4);
+  REQUIRE_EQUALS(entries[0].severity, SEVERITY_WARNING);
+  REQUIRE_EQUALS(entries[0].line, 1);
+  REQUIRE_EQUALS(entries[0].begin, 8);
+  REQUIRE_EQUALS(entries[0].end, 39);
+  REQUIRE_EQUALS(entries[0].text, "[12:00:00] WARNING: deprecated");
+  REQUIRE_EQUALS(entries[1].severity, SEVERITY_ERROR);
+  REQUIRE_EQUALS(entries[1].line, 2);
+  REQUIRE_EQUALS(entries[2].severity, SEVERITY_NAN);
+  // the most severe class of the line is taken
+  REQUIRE_EQUALS(entries[3].severity, SEVERITY_CUDA);
+  REQUIRE_EQUALS(entries[3].line, 4);
+
+  // filtered by the classes, and limited to the latest entries
+  entries = index.entries((1U << SEVERITY_ERROR) | (1U << SEVERITY_WARNING));
+  REQUIRE_EQUALS(entries.size(), 2);
+  entries = index.entries(ALL, 1);
+  REQUIRE_EQUALS(entries.size(), 1);
+  REQUIRE_EQUALS(entries[0].severity, SEVERITY_CUDA);
+  REQUIRE_EQUALS(index.count(SEVERITY_ERROR), 1);
+  REQUIRE_EQUALS(index.count(SEVERITY_TRACEBACK), 0);
+}
+
+TEST_CASE("Test indexing traceback blocks", "[SeverityIndex]") {
+  SeverityIndex index;
+  std::string traceback = "Traceback (most recent call last):\n"
+                          "  File \"train.py\", line 3, in <module>\n"
+                          "    raise ValueError('bad')\n"
+                          "ValueError: bad\n";
+
+  // the lines may be split anywhere
+  std::string output = "hello\n" + traceback + "bye\n";
+  for (size_t i=0; i<output.size(); i+=7) {
+    append(index, output.substr(i, 7));
+  }
+  std::vector<SeverityEntry> entries = index.entries(ALL);
+  REQUIRE_EQUALS(entries.size(), 1);
+  REQUIRE_EQUALS(entries[0].severity, SEVERITY_TRACEBACK);
+  REQUIRE_EQUALS(entries[0].line, 1);
+  REQUIRE_EQUALS(entries[0].begin, 6);
+  REQUIRE_EQUALS(entries[0].end, 6 + traceback.size());
+  REQUIRE_EQUALS(entries[0].text, "ValueError: bad");
+  REQUIRE_EQUALS(index.end(), output.size());
+
+  // an unfinished block is listed as it goes, and closed at the end of the output
+  append(index, traceback.substr(0, 60));
+  entries = index.entries(1U << SEVERITY_TRACEBACK);
+  REQUIRE_EQUALS(entries.size(), 2);
+  REQUIRE_EQUALS(entries[1].text, "Traceback (most recent call last):");
+  REQUIRE_EQUALS(index.count(SEVERITY_TRACEBACK), 1);
+  index.finish();
+  entries = index.entries(1U << SEVERITY_TRACEBACK);
+  REQUIRE_EQUALS(entries.size(), 2);
+  REQUIRE_EQUALS(entries[1].end, index.end());
+  REQUIRE_EQUALS(index.count(SEVERITY_TRACEBACK), 2);
+}
+
+TEST_CASE("Test bounding the severity index", "[SeverityIndex]") {
+  SeverityIndex index(3, 10);
+  for (int i=0; i<10; ++i) {
+    append(index, "WARNING " + std::to_string(i) + " is a long line\n");
+  }
+  append(index, "FATAL\n");
+
+  // the latest entries of each class are kept, with the counts still exact
+  std::vector<SeverityEntry> entries = index.entries(ALL);
+  REQUIRE_EQUALS(entries.size(), 4);
+  REQUIRE_EQUALS(entries[0].line, 7);
+  REQUIRE_EQUALS(entries[0].text, "WARNING 7 ");
+  REQUIRE_EQUALS(entries[3].severity, SEVERITY_ERROR);
+  REQUIRE_EQUALS(index.count(SEVERITY_WARNING), 10);
+
+  Severity severity;
+  REQUIRE(SeverityIndex::parse("cuda", &severity));
+  REQUIRE_EQUALS(severity, SEVERITY_CUDA);
+  REQUIRE_FALSE(SeverityIndex::parse("debug", &severity));
+  REQUIRE_EQUALS(std::string(SeverityIndex::name(SEVERITY_TRACEBACK)), "traceback");
+}
+
+TEST_CASE("Test indexing the severity in output buffer", "[SeverityIndex]") {
+  OutputBuffer buffer(20);
+  buffer.setSeverityIndexing(true);
+  REQUIRE(buffer.severityIndexing());
+  std::string output = "ERROR: first\n" + std::string(100, '.') + "\nlast Error: x";
+  buffer.write(output.data(), output.size());
+
+  // the entries outlive the evicted output, and the last line is indexed on close
+  std::vector<SeverityEntry> entries = buffer.severityEntries(ALL);
+  REQUIRE_EQUALS(entries.size(), 1);
+  REQUIRE_EQUALS(entries[0].text, "ERROR: first");
+  buffer.close();
+  entries = buffer.severityEntries(ALL);
+  REQUIRE_EQUALS(entries.size(), 2);
+  REQUIRE_EQUALS(entries[1].begin, 114);
+  REQUIRE_EQUALS(buffer.severityCount(SEVERITY_ERROR), 2);
+  REQUIRE_THROWS_AS(buffer.setSeverityIndexing(false), Poco::IllegalStateException);
+}
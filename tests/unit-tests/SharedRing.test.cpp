@@ -0,0 +1,199 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include <Poco/TemporaryFile.h>
+#include <catch2/catch.hpp>
+#include "src/RingStore.h"
+#include "src/OutputBuffer.h"
+#include "src/client/ml_gridengine_ring.h"
+#include "BytePattern.h"
+#include "macros.h"
+
+namespace {
+  /** A name unique to this process, such that the tests never collide. */
+  std::string shmName() {
+    return "ml-gridengine-test-" + std::to_string(getpid());
+  }
+
+  bool shmExists(std::string const& name) {
+    int fd = shm_open(("/" + name).c_str(), O_RDONLY, 0);
+    if (fd >= 0) {
+      close(fd);
+    }
+    return fd >= 0;
+  }
+}
+
+TEST_CASE("Test reading the shared ring", "[SharedRing]") {
+  size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+  std::string name = shmName();
+  mlge_ring ring;
+  {
+    FileRingStore *store = FileRingStore::createShared(name, pageSize + 1);
+    REQUIRE(store != nullptr);
+    REQUIRE_EQUALS(store->capacity(), pageSize * 2);
+    OutputBuffer buffer(store);
+    REQUIRE(shmExists(name));
+
+    REQUIRE_EQUALS(mlge_ring_open(&ring, ("/" + name).c_str()), 0);
+    REQUIRE_EQUALS(mlge_ring_generation(&ring), store->generation());
+    mlge_ring_positions positions;
+    mlge_ring_get_positions(&ring, &positions);
+    REQUIRE_EQUALS(positions.begin, 0);
+    REQUIRE_EQUALS(positions.end, 0);
+    REQUIRE_FALSE(positions.closed);
+    std::vector<Byte> target(pageSize * 4);
+    uint64_t begin = 123;
+    REQUIRE_EQUALS(mlge_ring_read(&ring, 0, target.data(), target.size(), &begin), 0);
+    REQUIRE_EQUALS(begin, 0);
+
+    // the writes are visible without any system call
+    std::vector<Byte> payload = pattern(0, pageSize * 3 + 100);
+    buffer.write(payload.data(), 1000);
+    mlge_ring_get_positions(&ring, &positions);
+    REQUIRE_EQUALS(positions.end, 1000);
+    REQUIRE_EQUALS(mlge_ring_read(&ring, 10, target.data(), 100, &begin), 100);
+    REQUIRE_EQUALS(begin, 10);
+    REQUIRE(std::vector<Byte>(target.begin(), target.begin() + 100) == pattern(10, 100));
+
+    // the overwritten output is skipped, and the copy wraps around the end of the ring
+    for (size_t i=1000; i<payload.size(); i+=1000) {
+      buffer.write(payload.data() + i, std::min((size_t)1000, payload.size() - i));
+    }
+    mlge_ring_get_positions(&ring, &positions);
+    REQUIRE_EQUALS(positions.begin, payload.size() - pageSize * 2);
+    REQUIRE_EQUALS(positions.end, payload.size());
+    size_t count = mlge_ring_read(&ring, 0, target.data(), target.size(), &begin);
+    REQUIRE_EQUALS(begin, positions.begin);
+    REQUIRE_EQUALS(count, pageSize * 2);
+    REQUIRE(std::vector<Byte>(target.begin(), target.begin() + count) == pattern(begin, count));
+    REQUIRE_EQUALS(mlge_ring_read(&ring, payload.size() + 5, target.data(), target.size(), &begin), 0);
+    REQUIRE_EQUALS(begin, payload.size() + 5);
+
+    buffer.close();
+    mlge_ring_get_positions(&ring, &positions);
+    REQUIRE(positions.closed);
+  }
+
+  // the segment is unlinked with the store, while the mapped readers can still read it
+  REQUIRE_FALSE(shmExists(name));
+  mlge_ring_positions positions;
+  mlge_ring_get_positions(&ring, &positions);
+  REQUIRE(positions.closed);
+  mlge_ring_close(&ring);
+  REQUIRE(ring.header == nullptr);
+  REQUIRE_EQUALS(mlge_ring_open(&ring, name.c_str()), -1);
+  REQUIRE_EQUALS(errno, ENOENT);
+}
+
+TEST_CASE("Test re-creating the shared ring", "[SharedRing]") {
+  size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+  std::string name = shmName();
+  std::unique_ptr<FileRingStore> first(FileRingStore::createShared(name, pageSize));
+  REQUIRE(first != nullptr);
+  uint64_t firstGeneration = first->generation();
+  mlge_ring ring;
+  REQUIRE_EQUALS(mlge_ring_open(&ring, name.c_str()), 0);
+
+  // the segment of a live executor is never taken over
+  REQUIRE(FileRingStore::createShared(name, pageSize) == nullptr);
+  REQUIRE(shmExists(name));
+  REQUIRE_EQUALS(first->generation(), firstGeneration);
+
+  // the segment left by a dead executor, i.e., whose lock is released, is taken over with a new
+  // generation, while the old readers are not disturbed
+  int fd = shm_open(("/" + name).c_str(), O_RDONLY, 0);
+  REQUIRE(fd >= 0);
+  first.reset();
+  REQUIRE_FALSE(shmExists(name));
+  int linked = shm_open(("/" + name).c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  REQUIRE(linked >= 0);
+  std::vector<Byte> header(pageSize);
+  REQUIRE_EQUALS(pread(fd, header.data(), header.size(), 0), (ssize_t)header.size());
+  REQUIRE_EQUALS(pwrite(linked, header.data(), header.size(), 0), (ssize_t)header.size());
+  close(linked);
+  close(fd);
+
+  std::unique_ptr<FileRingStore> second(FileRingStore::createShared(name, pageSize));
+  REQUIRE(second != nullptr);
+  REQUIRE_EQUALS(second->generation(), firstGeneration + 1);
+  REQUIRE_EQUALS(mlge_ring_generation(&ring), firstGeneration);
+  mlge_ring_close(&ring);
+  REQUIRE_EQUALS(mlge_ring_open(&ring, name.c_str()), 0);
+  REQUIRE_EQUALS(mlge_ring_generation(&ring), second->generation());
+  mlge_ring_close(&ring);
+}
+
+TEST_CASE("Test the mode of the shared ring", "[SharedRing]") {
+  size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+  std::string name = shmName();
+  mode_t mask = umask(0);
+  std::unique_ptr<FileRingStore> store(FileRingStore::createShared(name, pageSize));
+  REQUIRE(store != nullptr);
+  int fd = shm_open(("/" + name).c_str(), O_RDONLY, 0);
+  REQUIRE(fd >= 0);
+  struct stat st;
+  REQUIRE_EQUALS(fstat(fd, &st), 0);
+  close(fd);
+  REQUIRE_EQUALS(st.st_mode & 0777, 0600);
+
+  // the mode for the group is not narrowed by the umask
+  store.reset();
+  umask(0077);
+  store.reset(FileRingStore::createShared(name, pageSize, 0640));
+  umask(mask);
+  REQUIRE(store != nullptr);
+  fd = shm_open(("/" + name).c_str(), O_RDONLY, 0);
+  REQUIRE(fd >= 0);
+  REQUIRE_EQUALS(fstat(fd, &st), 0);
+  close(fd);
+  REQUIRE_EQUALS(st.st_mode & 0777, 0640);
+}
+
+TEST_CASE("Test reading a ring file by the client library", "[SharedRing]") {
+  size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+  Poco::TemporaryFile dir;
+  dir.createDirectories();
+  std::string path = dir.path() + "/output.ring";
+  OutputBuffer buffer(FileRingStore::create(path, pageSize));
+  std::string text = "hello, ring\n";
+  buffer.write(text.data(), text.size());
+
+  mlge_ring ring;
+  REQUIRE_EQUALS(mlge_ring_open_file(&ring, path.c_str()), 0);
+  char target[64];
+  uint64_t begin;
+  size_t count = mlge_ring_read(&ring, 0, target, sizeof(target), &begin);
+  REQUIRE_EQUALS(std::string(target, count), text);
+
+  // the executor was killed amid an update, leaving the sequence odd
+  int fd = open(path.c_str(), O_RDWR);
+  REQUIRE(fd >= 0);
+  uint64_t sequence;
+  REQUIRE(pread(fd, &sequence, sizeof(sequence), offsetof(mlge_ring_header, sequence)) == sizeof(sequence));
+  ++sequence;
+  REQUIRE(pwrite(fd, &sequence, sizeof(sequence), offsetof(mlge_ring_header, sequence)) == sizeof(sequence));
+  close(fd);
+  REQUIRE_EQUALS(mlge_ring_read(&ring, 0, target, sizeof(target), &begin), -1);
+  REQUIRE_EQUALS(errno, ESTALE);
+  mlge_ring_positions positions;
+  REQUIRE_EQUALS(mlge_ring_get_positions(&ring, &positions), -1);
+  REQUIRE_EQUALS(errno, ESTALE);
+  REQUIRE_EQUALS(positions.end, text.size());
+  mlge_ring_close(&ring);
+
+  // not a ring
+  std::string other = dir.path() + "/not-ring";
+  std::string garbage(pageSize * 2, 'x');
+  fd = open(other.c_str(), O_WRONLY | O_CREAT, 0644);
+  REQUIRE(write(fd, garbage.data(), garbage.size()) == (ssize_t)garbage.size());
+  close(fd);
+  REQUIRE_EQUALS(mlge_ring_open_file(&ring, other.c_str()), -1);
+  REQUIRE_EQUALS(errno, EINVAL);
+}
@@ -0,0 +1,133 @@
+#include <string.h>
+#include <vector>
+#include <Poco/File.h>
+#include <Poco/Path.h>
+#include <Poco/TemporaryFile.h>
+#include <catch2/catch.hpp>
+#include "src/SpillFileHistory.h"
+#include "src/OutputBuffer.h"
+#include "BytePattern.h"
+#include "macros.h"
+
+TEST_CASE("Test spilling output into segment files", "[SpillFileHistory]") {
+  Poco::TemporaryFile spoolDir;
+  std::vector<Byte> buf(100);
+  {
+    SpillFileHistory history(spoolDir.path(), 10, 25);
+    REQUIRE(Poco::File(spoolDir.path()).isDirectory());
+    REQUIRE_EQUALS(history.begin(), 0);
+    REQUIRE_EQUALS(history.end(), 0);
+    REQUIRE_EQUALS(history.read(0, buf.data(), buf.size()), 0);
+
+    // the appended bytes can be read before they are flushed into three segments
+    history.append(pattern(0, 23).data(), 23);
+    REQUIRE_EQUALS(history.end(), 23);
+    REQUIRE_EQUALS(history.segmentCount(), 0);
+    REQUIRE_EQUALS(history.read(3, buf.data(), buf.size()), 20);
+    REQUIRE(memcmp(buf.data(), pattern(3, 20).data(), 20) == 0);
+    history.flush();
+    REQUIRE_EQUALS(history.segmentCount(), 3);
+
+    // reads stop at the end of each segment
+    REQUIRE_EQUALS(history.read(3, buf.data(), buf.size()), 7);
+    REQUIRE(memcmp(buf.data(), pattern(3, 7).data(), 7) == 0);
+    REQUIRE_EQUALS(history.read(10, buf.data(), 4), 4);
+    REQUIRE(memcmp(buf.data(), pattern(10, 4).data(), 4) == 0);
+    REQUIRE_EQUALS(history.read(20, buf.data(), buf.size()), 3);
+    REQUIRE(memcmp(buf.data(), pattern(20, 3).data(), 3) == 0);
+    REQUIRE_EQUALS(history.read(23, buf.data(), buf.size()), 0);
+
+    // old segments are dropped when exceeding the maximum size
+    history.append(pattern(23, 10).data(), 10);
+    history.flush();
+    REQUIRE_EQUALS(history.begin(), 10);
+    REQUIRE_EQUALS(history.end(), 33);
+    REQUIRE_EQUALS(history.read(5, buf.data(), buf.size()), 0);
+    REQUIRE_EQUALS(history.read(25, buf.data(), buf.size()), 5);
+    REQUIRE(memcmp(buf.data(), pattern(25, 5).data(), 5) == 0);
+  }
+
+  // the segment files are deleted with the history
+  std::vector<std::string> files;
+  Poco::File(spoolDir.path()).list(files);
+  REQUIRE(files.empty());
+}
+
+TEST_CASE("Test sharing the spool directory", "[SpillFileHistory]") {
+  Poco::TemporaryFile spoolDir;
+  std::vector<Byte> buf(100);
+  {
+    // each history has a directory of its own, so the segments of the same offset never clash
+    SpillFileHistory first(spoolDir.path(), 10), second(spoolDir.path(), 10);
+    REQUIRE(first.segmentDir() != second.segmentDir());
+    REQUIRE(Poco::File(first.segmentDir()).isDirectory());
+    first.append(pattern(0, 15).data(), 15);
+    second.append(pattern(100, 15).data(), 15);
+    first.flush();
+    second.flush();
+    REQUIRE_EQUALS(first.read(0, buf.data(), buf.size()), 10);
+    REQUIRE(memcmp(buf.data(), pattern(0, 10).data(), 10) == 0);
+    REQUIRE_EQUALS(second.read(0, buf.data(), buf.size()), 10);
+    REQUIRE(memcmp(buf.data(), pattern(100, 10).data(), 10) == 0);
+  }
+  std::vector<std::string> files;
+  Poco::File(spoolDir.path()).list(files);
+  REQUIRE(files.empty());
+}
+
+TEST_CASE("Test reading spilled output from the output buffer", "[SpillFileHistory]") {
+  Poco::TemporaryFile spoolDir;
+  std::vector<Byte> payload = pattern(0, 1000);
+
+  for (auto readMode: {LOCKED_READ, OPTIMISTIC_READ}) {
+    OutputBuffer buffer(31, 11, readMode, MALLOC_STORE, new SpillFileHistory(spoolDir.path(), 64));
+    buffer.write(payload.data(), 100);
+    buffer.write(payload.data() + 100, 5);
+    buffer.write(payload.data() + 105, 300);
+    REQUIRE_EQUALS(buffer.size(), 31);
+    REQUIRE_EQUALS(buffer.retainedBegin(), 0);
+    REQUIRE_EQUALS(buffer.history()->end(), 405 - 31);
+
+    // read everything from the history and the ring
+    std::vector<Byte> content, buf(50);
+    size_t begin = 0;
+    for (;;) {
+      ReadResult rr = buffer.tryRead(begin, buf.data(), buf.size());
+      if (rr.isTimeout || rr.isClosed)
+        break;
+      REQUIRE_EQUALS(rr.begin, begin);
+      content.insert(content.end(), buf.begin(), buf.begin() + rr.count);
+      begin += rr.count;
+    }
+    REQUIRE_EQUALS(content.size(), 405);
+    REQUIRE(memcmp(content.data(), payload.data(), 405) == 0);
+
+    // views of historical positions should ask for copying
+    OutputView view = buffer.peek(10, 100);
+    REQUIRE(view.isHistory);
+    REQUIRE_EQUALS(view.begin, 10);
+    REQUIRE_EQUALS(view.segmentCount, 0);
+    REQUIRE_FALSE(buffer.peek(-5, 100).isHistory);
+  }
+}
+
+TEST_CASE("Test reading before the retained history", "[SpillFileHistory]") {
+  Poco::TemporaryFile spoolDir;
+  std::vector<Byte> payload = pattern(0, 200), buf(100);
+
+  for (auto readMode: {LOCKED_READ, OPTIMISTIC_READ}) {
+    OutputBuffer buffer(31, 31, readMode, MALLOC_STORE, new SpillFileHistory(spoolDir.path(), 50, 60));
+    buffer.write(payload.data(), 200);
+    REQUIRE_EQUALS(buffer.history()->begin(), 150);
+    REQUIRE_EQUALS(buffer.retainedBegin(), 150);
+
+    // reading from the very beginning should start from the retained history
+    ReadResult rr = buffer.tryRead(0, buf.data(), buf.size());
+    REQUIRE_EQUALS(rr.begin, 150);
+    REQUIRE_EQUALS(rr.count, 19);
+    REQUIRE(memcmp(buf.data(), payload.data() + 150, 19) == 0);
+    OutputView view = buffer.peek(0, 100);
+    REQUIRE(view.isHistory);
+    REQUIRE_EQUALS(view.begin, 150);
+  }
+}
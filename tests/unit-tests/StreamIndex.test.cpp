@@ -0,0 +1,69 @@
+#include <string>
+#include <catch2/catch.hpp>
+#include "src/StreamIndex.h"
+#include "src/OutputBuffer.h"
+#include "macros.h"
+
+#define REQUIRE_SPAN(span, OFFSET, MERGED_BEGIN, LENGTH) \
+  do { \
+    StreamSpan s_ = (span); \
+    REQUIRE_EQUALS(s_.offset, (OFFSET)); \
+    REQUIRE_EQUALS(s_.mergedBegin, (MERGED_BEGIN)); \
+    REQUIRE_EQUALS(s_.length, (LENGTH)); \
+  } while (0)
+
+TEST_CASE("Test stream index", "[StreamIndex]") {
+  StreamIndex index;
+  REQUIRE_SPAN(index.locate(STDOUT_STREAM, 0), 0, 0, 0);
+  REQUIRE_SPAN(index.locate(STDERR_STREAM, 0), 0, 0, 0);
+
+  // consecutive runs of the same stream are merged into one record
+  index.append(STDOUT_STREAM, 10);
+  index.append(STDOUT_STREAM, 5);
+  index.append(STDERR_STREAM, 3);
+  index.append(STDOUT_STREAM, 7);
+  index.append(STDERR_STREAM, 4);
+  REQUIRE_EQUALS(index.recordCount(), 4);
+  REQUIRE_EQUALS(index.end(), 29);
+  REQUIRE_EQUALS(index.writtenBytes(STDOUT_STREAM), 22);
+  REQUIRE_EQUALS(index.writtenBytes(STDERR_STREAM), 7);
+
+  // stream positions are mapped to the merged output
+  REQUIRE_SPAN(index.locate(STDOUT_STREAM, 0), 0, 0, 15);
+  REQUIRE_SPAN(index.locate(STDOUT_STREAM, 14), 14, 14, 1);
+  REQUIRE_SPAN(index.locate(STDOUT_STREAM, 15), 15, 18, 7);
+  REQUIRE_SPAN(index.locate(STDOUT_STREAM, 21), 21, 24, 1);
+  REQUIRE_SPAN(index.locate(STDOUT_STREAM, 22), 22, 29, 0);
+  REQUIRE_SPAN(index.locate(STDERR_STREAM, 0), 0, 15, 3);
+  REQUIRE_SPAN(index.locate(STDERR_STREAM, 3), 3, 25, 4);
+  REQUIRE_SPAN(index.locate(STDERR_STREAM, 5), 5, 27, 2);
+  REQUIRE_SPAN(index.locate(STDERR_STREAM, 7), 7, 29, 0);
+
+  // trimmed positions are skipped to the first retained byte of the stream
+  index.trim(16);
+  REQUIRE_EQUALS(index.recordCount(), 3);
+  REQUIRE_SPAN(index.locate(STDOUT_STREAM, 0), 15, 18, 7);
+  REQUIRE_SPAN(index.locate(STDERR_STREAM, 0), 1, 16, 2);
+  index.trim(20);
+  REQUIRE_EQUALS(index.recordCount(), 2);
+  REQUIRE_SPAN(index.locate(STDOUT_STREAM, 0), 17, 20, 5);
+  REQUIRE_SPAN(index.locate(STDERR_STREAM, 0), 3, 25, 4);
+}
+
+TEST_CASE("Test locating streams in the output buffer", "[StreamIndex]") {
+  OutputBuffer buffer(20, 20);
+  buffer.write("out1\n", 5);
+  buffer.write("err1\n", 5, STDERR_STREAM);
+  buffer.write("out2\n", 5);
+  REQUIRE_EQUALS(buffer.streamWrittenBytes(STDOUT_STREAM), 10);
+  REQUIRE_EQUALS(buffer.streamWrittenBytes(STDERR_STREAM), 5);
+  REQUIRE_SPAN(buffer.streamSpan(STDOUT_STREAM, 5), 5, 10, 5);
+  REQUIRE_SPAN(buffer.streamSpan(STDERR_STREAM, 0), 0, 5, 5);
+
+  // the runs evicted from the buffer are no longer located
+  buffer.write("out3\nout4\n..", 12);
+  REQUIRE_SPAN(buffer.streamSpan(STDOUT_STREAM, 0), 5, 10, 17);
+  REQUIRE_SPAN(buffer.streamSpan(STDERR_STREAM, 0), 2, 7, 3);
+  buffer.write("out5\n", 5);
+  REQUIRE_SPAN(buffer.streamSpan(STDERR_STREAM, 0), 5, 32, 0);
+}
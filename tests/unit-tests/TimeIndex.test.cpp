@@ -0,0 +1,90 @@
+#include <catch2/catch.hpp>
+#include <Poco/Thread.h>
+#include "src/TimeIndex.h"
+#include "src/OutputBuffer.h"
+#include "macros.h"
+
+TEST_CASE("Test time index", "[TimeIndex]") {
+  TimeIndex index(100, 1000);
+  REQUIRE_EQUALS(index.positionSince(0), 0);
+  REQUIRE_EQUALS(index.positionUntil(0), 0);
+  REQUIRE_EQUALS(index.timeAt(0), -1);
+
+  // chunks arriving within the interval share the entry of the first one
+  index.append(10, 1000);
+  index.append(10, 1050);
+  index.append(10, 1200);
+  index.append(10, 5000);
+  REQUIRE_EQUALS(index.entryCount(), 3);
+  REQUIRE_EQUALS(index.timeAt(0), 1000);
+  REQUIRE_EQUALS(index.timeAt(19), 1000);
+  REQUIRE_EQUALS(index.timeAt(20), 1200);
+  REQUIRE_EQUALS(index.timeAt(39), 5000);
+  REQUIRE_EQUALS(index.timeAt(40), -1);
+
+  // the ranges always include the bytes which may have arrived in time
+  REQUIRE_EQUALS(index.positionSince(0), 0);
+  REQUIRE_EQUALS(index.positionSince(1000), 0);
+  REQUIRE_EQUALS(index.positionSince(1050), 0);
+  REQUIRE_EQUALS(index.positionSince(1051), 20);
+  REQUIRE_EQUALS(index.positionSince(1200), 20);
+  REQUIRE_EQUALS(index.positionSince(3000), 30);
+  REQUIRE_EQUALS(index.positionSince(5000), 30);
+  REQUIRE_EQUALS(index.positionSince(5001), 40);
+  REQUIRE_EQUALS(index.positionUntil(999), 0);
+  REQUIRE_EQUALS(index.positionUntil(1000), 20);
+  REQUIRE_EQUALS(index.positionUntil(1199), 20);
+  REQUIRE_EQUALS(index.positionUntil(1200), 30);
+  REQUIRE_EQUALS(index.positionUntil(9999), 40);
+
+  // the entries are dropped along with the output
+  index.trim(25);
+  REQUIRE_EQUALS(index.entryCount(), 2);
+  REQUIRE_EQUALS(index.timeAt(25), 1200);
+  REQUIRE_EQUALS(index.positionSince(0), 20);
+  index.trim(40);
+  REQUIRE_EQUALS(index.entryCount(), 0);
+  REQUIRE_EQUALS(index.positionSince(0), 40);
+}
+
+TEST_CASE("Test bounded time index", "[TimeIndex]") {
+  TimeIndex index(10, 8);
+  for (int i=0; i<8; ++i) {
+    index.append(1, i * 10);
+  }
+  REQUIRE_EQUALS(index.entryCount(), 8);
+
+  // the resolution is halved by merging the adjacent entries
+  index.append(1, 80);
+  REQUIRE_EQUALS(index.interval(), 20);
+  REQUIRE_EQUALS(index.entryCount(), 5);
+  REQUIRE_EQUALS(index.timeAt(0), 0);
+  REQUIRE_EQUALS(index.timeAt(1), 0);
+  REQUIRE_EQUALS(index.timeAt(2), 20);
+  REQUIRE_EQUALS(index.timeAt(7), 60);
+  REQUIRE_EQUALS(index.timeAt(8), 80);
+  REQUIRE_EQUALS(index.positionSince(31), 4);
+  REQUIRE_EQUALS(index.positionSince(30), 2);
+  REQUIRE_EQUALS(index.positionUntil(30), 4);
+  index.append(1, 90);
+  REQUIRE_EQUALS(index.entryCount(), 5);
+  REQUIRE_EQUALS(index.timeAt(9), 80);
+}
+
+TEST_CASE("Test time index in the output buffer", "[TimeIndex]") {
+  int64_t t0 = TimeIndex::now();
+  OutputBuffer buffer(100);
+  buffer.write("hello\n", 6);
+  Poco::Thread::sleep(300);
+  int64_t t1 = TimeIndex::now();
+  buffer.write("world\n", 6);
+
+  REQUIRE(buffer.timeAt(0) >= t0);
+  REQUIRE(buffer.timeAt(0) < t1);
+  REQUIRE(buffer.timeAt(6) >= t1);
+  REQUIRE_EQUALS(buffer.timeAt(12), -1);
+  REQUIRE_EQUALS(buffer.positionSince(t0), 0);
+  REQUIRE_EQUALS(buffer.positionSince(t1), 6);
+  REQUIRE_EQUALS(buffer.positionUntil(t1 - 1), 6);
+  REQUIRE_EQUALS(buffer.positionUntil(t1 + 1000000), 12);
+}
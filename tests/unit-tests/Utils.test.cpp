@@ -35,3 +35,8 @@ TEST_CASE("Sizes are formatted to human readable texts", "[Utils]") {
   REQUIRE_EQUALS("1G", Utils::formatSize(1024L * 1024L * 1024L));
   REQUIRE_EQUALS("500G", Utils::formatSize(500L * 1024L * 1024L * 1024L));
 }
+
+TEST_CASE("Discarded sizes are formatted to marker lines", "[Utils]") {
+  REQUIRE_EQUALS("[100 bytes discarded]", Utils::formatDiscarded(100));
+  REQUIRE_EQUALS("[2048 (2K) bytes discarded]", Utils::formatDiscarded(2048));
+}
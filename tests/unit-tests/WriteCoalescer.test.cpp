@@ -0,0 +1,130 @@
+#include <string>
+#include <vector>
+#include <catch2/catch.hpp>
+#include "src/WriteCoalescer.h"
+#include "src/IOController.h"
+#include "CapturingLogger.h"
+#include "macros.h"
+
+namespace {
+  class StringSink {
+  public:
+    std::vector<std::string> writes;
+    std::vector<ProgramStream> streams;
+
+    WriteCoalescer::Sink sink() {
+      return [this] (ProgramStream stream, const Byte *data, size_t count) {
+        writes.emplace_back((const char*)data, count);
+        streams.push_back(stream);
+      };
+    }
+  };
+
+  void write(WriteCoalescer &coalescer, std::string const& s, int64_t now, ProgramStream stream = STDOUT_STREAM) {
+    coalescer.write(stream, (const Byte*)s.data(), s.size(), now);
+  }
+}
+
+TEST_CASE("Test batching dense output", "[WriteCoalescer]") {
+  StringSink sink;
+  WriteCoalescer coalescer(sink.sink(), 16, 1000);
+
+  // the first chunk passes through, and the next one within the window starts batching
+  write(coalescer, "a\n", 0);
+  REQUIRE_EQUALS(sink.writes.size(), 1);
+  REQUIRE_FALSE(coalescer.batching());
+  write(coalescer, "b\n", 100);
+  write(coalescer, "c\n", 200);
+  REQUIRE(coalescer.batching());
+  REQUIRE_EQUALS(sink.writes.size(), 1);
+  REQUIRE_EQUALS(coalescer.pendingBytes(), 4);
+  REQUIRE_EQUALS(coalescer.deadline(), 1100);
+
+  // the batch is passed on when due
+  coalescer.flushIfDue(1099);
+  REQUIRE_EQUALS(sink.writes.size(), 1);
+  write(coalescer, "d\n", 1050);
+  coalescer.flushIfDue(1100);
+  REQUIRE_EQUALS(sink.writes.size(), 2);
+  REQUIRE_EQUALS(sink.writes[1], "b\nc\nd\n");
+  REQUIRE(coalescer.deadline() < 0);
+
+  // or when it reaches the maximum size, while a large chunk passes through as-is
+  write(coalescer, "0123456789", 1200);
+  write(coalescer, "0123456789", 1300);
+  REQUIRE_EQUALS(sink.writes.size(), 3);
+  REQUIRE_EQUALS(sink.writes[2].size(), 20);
+  write(coalescer, std::string(100, 'x'), 1400);
+  REQUIRE_EQUALS(sink.writes.size(), 4);
+  REQUIRE_EQUALS(sink.writes[3].size(), 100);
+  REQUIRE_EQUALS(coalescer.writes(), 7);
+  REQUIRE_EQUALS(coalescer.flushes(), 4);
+}
+
+TEST_CASE("Test stopping the batching for sparse output", "[WriteCoalescer]") {
+  StringSink sink;
+  WriteCoalescer coalescer(sink.sink(), 1024, 1000);
+  write(coalescer, "a", 0);
+  write(coalescer, "b", 500);
+  REQUIRE(coalescer.batching());
+
+  // a chunk after a quiet window passes through at once, after the batch held back
+  write(coalescer, "c", 1600);
+  REQUIRE_FALSE(coalescer.batching());
+  REQUIRE_EQUALS(sink.writes.size(), 3);
+  REQUIRE_EQUALS(sink.writes[1], "b");
+  REQUIRE_EQUALS(sink.writes[2], "c");
+
+  // a quiet window stops the batching as well
+  write(coalescer, "d", 1700);
+  REQUIRE(coalescer.batching());
+  coalescer.flushIfDue(2700);
+  REQUIRE_FALSE(coalescer.batching());
+  REQUIRE_EQUALS(sink.writes.back(), "d");
+
+  // the streams are never batched together
+  write(coalescer, "e", 2800);
+  write(coalescer, "f", 2900, STDERR_STREAM);
+  write(coalescer, "g", 3000);
+  coalescer.flush();
+  REQUIRE_EQUALS(sink.writes.size(), 7);
+  REQUIRE_EQUALS(sink.streams[5], STDERR_STREAM);
+  REQUIRE_EQUALS(sink.writes[6], "g");
+
+  // without a window, every chunk passes through
+  WriteCoalescer passThrough(sink.sink());
+  write(passThrough, "h", 0);
+  write(passThrough, "i", 0);
+  REQUIRE_EQUALS(sink.writes.size(), 9);
+  REQUIRE_FALSE(passThrough.batching());
+}
+
+TEST_CASE("Test batching the program output", "[WriteCoalescer]") {
+  CapturingLogger logger; Logger::ScopedRootLogger scopedRootLogger(&logger);
+  ProgramExecutor executor({"sh", "-c", "i=0; while [ $i -lt 100 ]; do echo $i; sleep 0.001; i=$((i+1)); done"});
+  OutputBuffer buffer(4096);
+  {
+    IOController ioController(&executor, &buffer);
+    ioController.setCoalescing(64 * 1024, 100000);
+    executor.start();
+    ioController.start();
+    REQUIRE(executor.wait());
+    ioController.join();
+
+    // the lines of the shell are written one by one, but woke up the readers much fewer times
+    IngestStatistics stats = ioController.ingestStatistics();
+    REQUIRE(stats.writes > 0);
+    REQUIRE(stats.wakeups < stats.writes);
+    REQUIRE(stats.seconds > 0);
+    REQUIRE(stats.wakeupsPerSecond() < stats.writesPerSecond());
+  }
+  buffer.close();
+
+  std::string expected;
+  for (int i=0; i<100; ++i) {
+    expected += std::to_string(i) + "\n";
+  }
+  char output[4096];
+  ReadResult result = buffer.read(0, output, sizeof(output));
+  REQUIRE_EQUALS(std::string(output, result.count), expected);
+}